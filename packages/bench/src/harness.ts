@@ -0,0 +1,123 @@
+/**
+ * Minimal benchmark harness.
+ *
+ * Each benchmark is warmed up, then run in batches until a minimum wall time
+ * has passed. Allocation is estimated separately, from heap growth over a
+ * short run that starts right after a forced collection.
+ */
+
+/**
+ * Options for a benchmark run.
+ */
+export interface BenchOptions {
+  /** Minimum timed wall time in milliseconds (default: 1000). */
+  minTimeMs?: number;
+  /** Untimed iterations run first (default: 100). */
+  warmup?: number;
+}
+
+/**
+ * Result of one benchmark.
+ */
+export interface BenchResult {
+  name: string;
+  iterations: number;
+  opsPerSec: number;
+  nsPerOp: number;
+  /**
+   * Heap bytes allocated per iteration, or null if it could not be measured
+   * (no way to force a collection, or one happened during the run).
+   */
+  bytesPerOp: number | null;
+}
+
+const DEFAULT_MIN_TIME_MS = 1000;
+const DEFAULT_WARMUP = 100;
+const BATCH_SIZE = 10;
+const ALLOCATION_ITERATIONS = 100;
+
+/**
+ * Run `fn` repeatedly and measure its average time and allocation.
+ */
+export function bench(name: string, fn: () => unknown, options: BenchOptions = {}): BenchResult {
+  const minTimeMs = options.minTimeMs ?? DEFAULT_MIN_TIME_MS;
+  const warmup = options.warmup ?? DEFAULT_WARMUP;
+
+  // Warm up so the timed loop runs optimized code
+  for (let i = 0; i < warmup; i++) {
+    fn();
+  }
+
+  let iterations = 0;
+  let elapsed = 0;
+  const start = performance.now();
+  while (elapsed < minTimeMs) {
+    for (let i = 0; i < BATCH_SIZE; i++) {
+      fn();
+    }
+    iterations += BATCH_SIZE;
+    elapsed = performance.now() - start;
+  }
+
+  const nsPerOp = (elapsed * 1e6) / iterations;
+  return {
+    name,
+    iterations,
+    opsPerSec: 1e9 / nsPerOp,
+    nsPerOp,
+    bytesPerOp: measureAllocation(fn),
+  };
+}
+
+/**
+ * Force a full collection if the runtime allows it.
+ * @returns false if collection is not available
+ */
+function collectGarbage(): boolean {
+  if (typeof Bun !== "undefined") {
+    Bun.gc(true);
+    return true;
+  }
+  const gc = (globalThis as { gc?: () => void }).gc;
+  if (gc) {
+    gc();
+    return true;
+  }
+  return false;
+}
+
+function measureAllocation(fn: () => unknown): number | null {
+  if (!collectGarbage()) {
+    return null;
+  }
+
+  const before = process.memoryUsage().heapUsed;
+  for (let i = 0; i < ALLOCATION_ITERATIONS; i++) {
+    fn();
+  }
+  const after = process.memoryUsage().heapUsed;
+
+  // A collection during the run makes the difference meaningless
+  if (after < before) {
+    return null;
+  }
+  return (after - before) / ALLOCATION_ITERATIONS;
+}
+
+/**
+ * Format results as an aligned plain-text table.
+ */
+export function formatTable(results: BenchResult[]): string {
+  const nameWidth = Math.max(4, ...results.map((r) => r.name.length));
+  const lines = [
+    `${"name".padEnd(nameWidth)}  ${"ops/sec".padStart(12)}  ${"ns/op".padStart(12)}  ${"bytes/op".padStart(12)}`,
+  ];
+  for (const r of results) {
+    const bytes = r.bytesPerOp === null ? "-" : r.bytesPerOp.toFixed(0);
+    lines.push(
+      `${r.name.padEnd(nameWidth)}  ${r.opsPerSec.toFixed(0).padStart(12)}  ` +
+        `${r.nsPerOp.toFixed(0).padStart(12)}  ${bytes.padStart(12)}`
+    );
+  }
+  return lines.join("\n");
+}
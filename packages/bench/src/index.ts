@@ -0,0 +1,56 @@
+/**
+ * PEX benchmark runner.
+ *
+ * Usage: bun src/index.ts [--json] [--time <ms>] [filter...]
+ *
+ * Runs every workload whose name contains one of the filters (all of them
+ * if none are given). Prints a table by default; with --json, prints one
+ * JSON document with the runtime and every result, for tracking regressions.
+ */
+
+import { bench, formatTable } from "./harness.ts";
+import type { BenchResult } from "./harness.ts";
+import { createWorkloads } from "./workloads.ts";
+
+async function main(args: string[]): Promise<void> {
+  let json = false;
+  let minTimeMs: number | undefined;
+  const filters: string[] = [];
+
+  for (let i = 0; i < args.length; i++) {
+    const arg = args[i]!;
+    if (arg === "--json") {
+      json = true;
+    } else if (arg === "--time") {
+      minTimeMs = Number(args[++i]);
+      if (!Number.isFinite(minTimeMs) || minTimeMs <= 0) {
+        console.error("Error: --time expects a positive number of milliseconds");
+        process.exit(1);
+      }
+    } else {
+      filters.push(arg);
+    }
+  }
+
+  const workloads = (await createWorkloads()).filter(
+    (w) => filters.length === 0 || filters.some((f) => w.name.includes(f))
+  );
+
+  const results: BenchResult[] = [];
+  for (const workload of workloads) {
+    const result = bench(workload.name, workload.run, { minTimeMs });
+    results.push(result);
+    if (!json) {
+      console.error(`${workload.name}: ${result.nsPerOp.toFixed(0)} ns/op`);
+    }
+  }
+
+  if (json) {
+    const runtime = typeof Bun !== "undefined" ? `bun ${Bun.version}` : `node ${process.version}`;
+    console.log(JSON.stringify({ runtime, results }, null, 2));
+  } else {
+    console.log(formatTable(results));
+  }
+}
+
+await main(process.argv.slice(2));
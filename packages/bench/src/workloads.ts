@@ -0,0 +1,158 @@
+/**
+ * Benchmark workloads covering each stage from lexer to VM.
+ */
+
+import {
+  VM,
+  compilePEX,
+  generateBytecode,
+  lowerProgram,
+  lowerProgramToArena,
+  nullValue,
+  readBytecode,
+  stringValue,
+  throwingEffectHandler,
+  writeBytecode,
+} from "@pex/core";
+import type { BytecodeFile } from "@pex/core";
+import { parse, parseTokens, tokenize, Scanner, TokenType } from "@pex/core/parser";
+import { createEmptyBytecodeFile, ConstantType } from "@pex/core/bytecode";
+import { Opcode } from "@pex/core/opcodes";
+
+/**
+ * A named operation to benchmark. Setup happens when the workload is
+ * created, so only `run` is timed.
+ */
+export interface Workload {
+  name: string;
+  run: () => unknown;
+}
+
+/**
+ * Generate a large program of `count` function definitions and bindings
+ * that all feed into one final pipeline.
+ */
+export function largeProgram(count: number): string {
+  const lines: string[] = [];
+  for (let i = 0; i < count; i++) {
+    lines.push(`fn: f${i} (x) (if (< x ${i}) (+ x ${i}) (* x 2))`);
+    lines.push(`let: v${i} ($$ | split "," | (join $ "-") | upper | (replace $ /A(\\w)/g "$1"))`);
+  }
+  lines.push(`(f${count - 1} (len v${count - 1}))`);
+  return lines.join(";\n");
+}
+
+/**
+ * A single-function program that builds an array of `count` numbers.
+ * Codegen never emits MAKE_ARRAY, so the bytecode is assembled directly.
+ */
+function arrayLiteral(count: number): BytecodeFile {
+  const file = createEmptyBytecodeFile();
+  const code: number[] = [];
+  for (let i = 0; i < count; i++) {
+    code.push(Opcode.CONST_U8, i % 2);
+  }
+  code.push(Opcode.MAKE_ARRAY_U16, count & 0xff, count >> 8, Opcode.RETURN);
+
+  file.constantPool.constants = [
+    { type: ConstantType.INT32, value: 0 },
+    { type: ConstantType.INT32, value: 1 },
+  ];
+  file.functionTemplates.templates = [
+    { nameIndex: -1, paramCount: 1, localCount: 1, upvalues: [], codeOffset: 0, codeLength: code.length },
+  ];
+  file.codeSection.code = new Uint8Array(code);
+  return file;
+}
+
+/**
+ * Pull every token from a Scanner without building Token objects.
+ */
+function scanAll(source: string): number {
+  const scanner = new Scanner(source);
+  let count = 1;
+  while (scanner.scan() !== TokenType.EOF) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Workloads for the compiler pipeline, run over a large generated program.
+ */
+function compilerWorkloads(): Workload[] {
+  const source = largeProgram(200);
+  const tokens = tokenize(source);
+  const ast = parseTokens(tokens);
+  const ir = lowerProgramToArena(ast);
+  const tree = lowerProgram(ast);
+  const bytecode = generateBytecode(ir);
+  const bytes = writeBytecode(bytecode);
+
+  return [
+    { name: "lexer/tokenize", run: () => tokenize(source) },
+    { name: "lexer/scan", run: () => scanAll(source) },
+    { name: "parser/parse-tokens", run: () => parseTokens(tokens) },
+    { name: "parser/parse", run: () => parse(source) },
+    { name: "ir/lower", run: () => lowerProgramToArena(ast) },
+    { name: "ir/lower-tree", run: () => lowerProgram(ast) },
+    { name: "codegen/generate", run: () => generateBytecode(ir) },
+    { name: "codegen/generate-tree", run: () => generateBytecode(tree) },
+    { name: "bytecode/write", run: () => writeBytecode(bytecode) },
+    { name: "bytecode/read", run: () => readBytecode(bytes) },
+    { name: "bytecode/round-trip", run: () => readBytecode(writeBytecode(bytecode)) },
+  ];
+}
+
+/**
+ * Workloads for VM execution. Each VM is created once and run repeatedly.
+ */
+function vmWorkloads(): Workload[] {
+  const workloads: Workload[] = [];
+
+  const add = (name: string, bytecode: BytecodeFile, input = nullValue()) => {
+    const vm = new VM(bytecode, throwingEffectHandler);
+    workloads.push({ name, run: () => vm.run(input) });
+  };
+
+  const csv = stringValue(Array.from({ length: 100 }, (_, i) => `user${i}@host${i % 7}`).join(","));
+  add("vm/string-pipeline", compilePEX(
+    '$$ | split "," | (join $ " ") | (replace $ /(\\w+)@(\\w+)/g "$2:$1") | upper | (match $ /\\d+/g) | (len $)'
+  ), csv);
+  add("vm/regex-test", compilePEX('$$ | lower | (test $ /host6$/)'), csv);
+  add("vm/fib-recursion", compilePEX(
+    "fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 15)"
+  ));
+  add("vm/closure-recursion", compilePEX(
+    "fn: outer (k) (fn: fib (n) (if (< n 2) (+ n k) (+ (fib (- n 1)) (fib (- n 2))))) (fib 15); (outer 1)"
+  ));
+  add("vm/make-array-1000", arrayLiteral(1000));
+  add("vm/builtin-8-args", compilePEX('(join "a" "b" "c" "d" "e" "f" "g" "h")'));
+
+  return workloads;
+}
+
+/**
+ * Workloads for the tree-sitter grammar through the native binding.
+ * @returns An empty list if the native modules are not installed
+ */
+async function treeSitterWorkloads(): Promise<Workload[]> {
+  let PEXParser: typeof import("@pex/tree-sitter-pex/src/parser.ts").PEXParser;
+  try {
+    ({ PEXParser } = await import("@pex/tree-sitter-pex/src/parser.ts"));
+  } catch (error) {
+    console.error(`Skipping tree-sitter benchmarks: ${(error as Error).message}`);
+    return [];
+  }
+
+  const parser = new PEXParser();
+  const source = largeProgram(200);
+  return [{ name: "tree-sitter/parse", run: () => parser.parseRaw(source) }];
+}
+
+/**
+ * Create every workload.
+ */
+export async function createWorkloads(): Promise<Workload[]> {
+  return [...compilerWorkloads(), ...vmWorkloads(), ...(await treeSitterWorkloads())];
+}
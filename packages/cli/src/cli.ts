@@ -6,25 +6,54 @@
 
 import {
   parse,
-  lowerProgram,
+  lowerProgramToArena,
   generateBytecode,
+  optimizeBytecode,
+  optimizeIR,
+  writeBytecode,
+  openBytecode,
   VM,
+  type VMProfiler,
+  type BytecodeFile,
   type EffectHandler,
+  type IRArena,
   displayValue,
+  valueFromJSON,
 } from "@pex/core";
-import { readFileSync } from "fs";
+import { CompilationCache } from "@pex/core/cache";
+import { createReadStream, readFileSync, writeFileSync } from "fs";
+import { runStream, type RecordFormat } from "./stream.ts";
 
 interface CLIOptions {
   shellMode: boolean;
   file?: string;
   expr?: string;
   input?: string;
+  compile?: string;
+  optimize: boolean;
+  profile?: string;
+  profileFormat: ProfileFormat;
+  cacheDir?: string;
+  cacheStats: boolean;
+  stream?: RecordFormat;
+  inputFile?: string;
+  workers: number;
   help: boolean;
 }
 
+type ProfileFormat = "json" | "folded";
+
+// Precompiled bytecode artifacts are recognised by extension.
+const BYTECODE_EXTENSION = ".pexb";
+
 function parseArgs(args: string[]): CLIOptions {
   const options: CLIOptions = {
     shellMode: false,
+    optimize: false,
+    profileFormat: "json",
+    cacheDir: process.env.PEX_CACHE_DIR || undefined,
+    cacheStats: false,
+    workers: 1,
     help: false,
   };
 
@@ -60,6 +89,82 @@ function parseArgs(args: string[]): CLIOptions {
         options.expr = args[++i];
         break;
 
+      case "-c":
+      case "--compile":
+        if (i + 1 >= args.length) {
+          console.error("Error: --compile requires an output path");
+          process.exit(1);
+        }
+        options.compile = args[++i];
+        break;
+
+      case "-O":
+      case "--optimize":
+        options.optimize = true;
+        break;
+
+      case "--profile":
+        if (i + 1 >= args.length) {
+          console.error("Error: --profile requires an output path");
+          process.exit(1);
+        }
+        options.profile = args[++i];
+        break;
+
+      case "--profile-format": {
+        const format = args[++i];
+        if (format !== "json" && format !== "folded") {
+          console.error("Error: --profile-format must be 'json' or 'folded'");
+          process.exit(1);
+        }
+        options.profileFormat = format;
+        break;
+      }
+
+      case "--cache-dir":
+        if (i + 1 >= args.length) {
+          console.error("Error: --cache-dir requires a directory");
+          process.exit(1);
+        }
+        options.cacheDir = args[++i];
+        break;
+
+      case "--no-cache":
+        options.cacheDir = undefined;
+        break;
+
+      case "--cache-stats":
+        options.cacheStats = true;
+        break;
+
+      case "-l":
+      case "--lines":
+        options.stream = "lines";
+        break;
+
+      case "--ndjson":
+        options.stream = "ndjson";
+        break;
+
+      case "--input-file":
+        if (i + 1 >= args.length) {
+          console.error("Error: --input-file requires a file path");
+          process.exit(1);
+        }
+        options.inputFile = args[++i];
+        break;
+
+      case "-w":
+      case "--workers": {
+        const workers = Number(args[++i]);
+        if (!Number.isInteger(workers) || workers < 1) {
+          console.error("Error: --workers must be a positive integer");
+          process.exit(1);
+        }
+        options.workers = workers;
+        break;
+      }
+
       case "-i":
       case "--input":
         if (i + 1 >= args.length) {
@@ -100,8 +205,21 @@ OPTIONS:
   -h, --help           Show this help message
   -s, --shell          Enable shell mode (auto-inject $$)
   -e, --expr <EXPR>    Execute expression
-  -f, --file <FILE>    Execute file
+  -f, --file <FILE>    Execute file (.pex source or precompiled .pexb)
+  -c, --compile <OUT>  Compile to a .pexb bytecode file instead of running
+  -O, --optimize       Fold constants in the IR and run the peephole optimizer
+  --profile <OUT>      Profile the run and write the profile to OUT
+  --profile-format <F> Profile format: json (default) or folded (flamegraph)
+  --cache-dir <DIR>    Reuse compiled programs from a shared cache directory
+                       (default: $PEX_CACHE_DIR)
+  --no-cache           Ignore $PEX_CACHE_DIR
+  --cache-stats        Print cache hit/miss counts to stderr
   -i, --input <VALUE>  Provide input value (JSON or string)
+  -l, --lines          Run once per line of input; each line is a string
+  --ndjson             Run once per line of input; each line is JSON, and
+                       results are written as JSON
+  --input-file <FILE>  Read --lines/--ndjson records from FILE, not stdin
+  -w, --workers <N>    Run --lines/--ndjson records on N worker threads
 
 EXAMPLES:
   # Execute expression with input
@@ -113,6 +231,21 @@ EXAMPLES:
   # Execute file
   pex -f program.pex -i '["John", "Doe"]'
 
+  # Compile once, then run the bytecode without reparsing
+  pex -O -f program.pex -c program.pexb
+  pex -f program.pexb -i '["John", "Doe"]'
+
+  # Share compiled programs between invocations
+  pex --cache-dir ~/.cache/pex -f program.pex -i '["John", "Doe"]'
+
+  # Profile a run and render it as a flamegraph
+  pex -f program.pex --profile run.folded --profile-format folded
+  flamegraph.pl run.folded > run.svg
+
+  # Process a file line by line in one process
+  pex --ndjson -O -f program.pex --input-file records.ndjson > results.ndjson
+  cat access.log | pex -l -w 4 "$$ | split \" \" | first"
+
   # Pipe input from stdin
   echo "test@example.com" | pex "$$ | lower | trim"
 
@@ -123,6 +256,17 @@ For more information, see: https://github.com/your-repo/pex
 `);
 }
 
+/**
+ * Load a .pexb file. Under Bun the file is memory-mapped, so the VM reads
+ * constants and code straight from the page cache.
+ */
+function readBytecodeFile(path: string): Uint8Array {
+  if (typeof Bun !== "undefined") {
+    return Bun.mmap(path);
+  }
+  return readFileSync(path);
+}
+
 async function readStdin(): Promise<string> {
   const chunks: Buffer[] = [];
 
@@ -162,6 +306,33 @@ function parseInput(inputStr: string): any {
   }
 }
 
+function compileBytecode(ir: IRArena, options: CLIOptions): BytecodeFile {
+  if (!options.optimize) {
+    return generateBytecode(ir);
+  }
+  return optimizeBytecode(generateBytecode(optimizeIR(ir)));
+}
+
+function createCache(options: CLIOptions): CompilationCache | null {
+  if (!options.cacheDir) {
+    return null;
+  }
+  // One process compiles one program, so only the directory tier matters
+  return new CompilationCache({ directory: options.cacheDir, maxEntries: 1 });
+}
+
+function printCacheStats(cache: CompilationCache | null, options: CLIOptions): void {
+  if (options.cacheStats) {
+    console.error(JSON.stringify(cache ? cache.stats() : null));
+  }
+}
+
+function writeProfile(profiler: VMProfiler, path: string, format: ProfileFormat): void {
+  const output =
+    format === "folded" ? profiler.toFoldedStacks() : JSON.stringify(profiler.toJSON(), null, 2);
+  writeFileSync(path, output + "\n");
+}
+
 async function main() {
   const args = process.argv.slice(2);
   const options = parseArgs(args);
@@ -171,9 +342,21 @@ async function main() {
     process.exit(0);
   }
 
-  // Get source code
-  let source: string;
-  if (options.file) {
+  // Precompiled bytecode skips parsing and compilation entirely
+  let precompiled: BytecodeFile | undefined;
+  let source = "";
+  if (options.file?.endsWith(BYTECODE_EXTENSION)) {
+    if (options.compile) {
+      console.error("Error: --compile expects a source file, not bytecode");
+      process.exit(1);
+    }
+    try {
+      precompiled = openBytecode(readBytecodeFile(options.file));
+    } catch (error) {
+      console.error(`Error reading file '${options.file}': ${(error as Error).message}`);
+      process.exit(1);
+    }
+  } else if (options.file) {
     try {
       source = readFileSync(options.file, "utf-8");
     } catch (error) {
@@ -188,11 +371,45 @@ async function main() {
     process.exit(1);
   }
 
+  if (options.stream && options.input) {
+    console.error("Error: --input cannot be combined with --lines or --ndjson");
+    process.exit(1);
+  }
+  if (options.stream && options.profile && options.workers > 1) {
+    console.error("Error: --profile cannot be combined with --workers");
+    process.exit(1);
+  }
+  if (!options.stream && (options.inputFile || options.workers > 1)) {
+    console.error("Error: --input-file and --workers require --lines or --ndjson");
+    process.exit(1);
+  }
+
+  const cache = precompiled ? null : createCache(options);
+  const compileOptions = { optimize: options.optimize, shellMode: options.shellMode };
+
+  if (options.compile) {
+    try {
+      let bytes: Uint8Array;
+      if (cache) {
+        bytes = cache.compileToBytes(source, compileOptions);
+      } else {
+        const ast = parse(source, { shellMode: options.shellMode });
+        bytes = writeBytecode(compileBytecode(lowerProgramToArena(ast), options));
+      }
+      writeFileSync(options.compile, bytes);
+    } catch (error) {
+      console.error(`Error: ${(error as Error).message}`);
+      process.exit(1);
+    }
+    printCacheStats(cache, options);
+    process.exit(0);
+  }
+
   // Get input
   let input: any = null;
   if (options.input) {
     input = parseInput(options.input);
-  } else if (!process.stdin.isTTY) {
+  } else if (!options.stream && !process.stdin.isTTY) {
     // Read from stdin if available
     const stdinData = await readStdin();
     if (stdinData) {
@@ -202,14 +419,22 @@ async function main() {
 
   // Execute
   try {
-    // Parse
-    const ast = parse(source, { shellMode: options.shellMode });
+    let bytecode: BytecodeFile;
+    if (precompiled) {
+      bytecode = precompiled;
+    } else if (cache) {
+      // A hit skips parsing, lowering and codegen
+      bytecode = cache.compile(source, compileOptions);
+    } else {
+      // Parse
+      const ast = parse(source, { shellMode: options.shellMode });
 
-    // Lower to IR
-    const irModule = lowerProgram(ast);
+      // Lower to IR
+      const ir = lowerProgramToArena(ast);
 
-    // Generate bytecode
-    const bytecode = generateBytecode(irModule);
+      // Generate bytecode
+      bytecode = compileBytecode(ir, options);
+    }
 
     // Create effect handler (no-op for now)
     const effectHandler: EffectHandler = (name, _args, _continuation) => {
@@ -217,9 +442,46 @@ async function main() {
       process.exit(1);
     };
 
+    if (options.stream) {
+      // A closed pipe (e.g. `| head`) just ends the stream
+      process.stdout.on("error", (error: NodeJS.ErrnoException) => {
+        if (error.code !== "EPIPE") {
+          throw error;
+        }
+        process.exit(0);
+      });
+      const profilePath = options.profile;
+      await runStream(
+        bytecode,
+        options.inputFile ? createReadStream(options.inputFile) : process.stdin,
+        process.stdout,
+        {
+          format: options.stream,
+          workers: options.workers,
+          effectHandler,
+          onProfile: profilePath
+            ? (profiler) => writeProfile(profiler, profilePath, options.profileFormat)
+            : undefined,
+        }
+      );
+      printCacheStats(cache, options);
+      return;
+    }
+
     // Run VM
     const vm = new VM(bytecode, effectHandler);
-    const result = vm.run(input ?? null);
+    const profiler = options.profile ? vm.enableProfiling() : null;
+    let result;
+    try {
+      result = vm.run(valueFromJSON(input));
+    } finally {
+      // Failed runs are often the ones worth profiling
+      if (profiler && options.profile) {
+        writeProfile(profiler, options.profile, options.profileFormat);
+      }
+    }
+
+    printCacheStats(cache, options);
 
     // Output result
     const resultStr = displayValue(result);
@@ -0,0 +1,298 @@
+/**
+ * Streaming record mode for the PEX CLI.
+ *
+ * Input is read chunk by chunk and split into records, one per line. Each
+ * record runs through a single reused VM, or through a worker pool when more
+ * than one worker is requested, and produces exactly one output line. Output
+ * is buffered and written with backpressure, so memory stays bounded by the
+ * batch size rather than the size of the input.
+ */
+
+import {
+  VM,
+  displayValue,
+  stringValue,
+  valueFromJSON,
+  valueToJSON,
+  type BytecodeFile,
+  type EffectHandler,
+  type Value,
+  type VMProfiler,
+} from "@pex/core";
+import { VMWorkerPool } from "@pex/core/parallel";
+import type { Readable, Writable } from "stream";
+
+/**
+ * How records are read and results written.
+ * - lines: every line is a string input; results are printed with displayValue
+ * - ndjson: every non-blank line is a JSON input; results are printed as JSON
+ */
+export type RecordFormat = "lines" | "ndjson";
+
+export interface StreamOptions {
+  format: RecordFormat;
+  /** Worker threads to run records on; 1 runs them on the main thread. */
+  workers: number;
+  effectHandler: EffectHandler;
+  /**
+   * Profile the main-thread VM across all records, and call this with the
+   * profile once the stream ends or fails.
+   */
+  onProfile?: (profiler: VMProfiler) => void;
+}
+
+// Records handed to a worker at a time.
+const BATCH_SIZE = 1024;
+
+// Output is written once this many characters have been buffered.
+const OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * Run the program over every record in `input`, writing one line per record
+ * to `output`.
+ * @throws Error naming the line of the first record that fails
+ */
+export async function runStream(
+  bytecode: BytecodeFile,
+  input: Readable,
+  output: Writable,
+  options: StreamOptions
+): Promise<void> {
+  const writer = new BufferedWriter(output);
+  try {
+    if (options.workers > 1) {
+      await runParallel(bytecode, input, writer, options);
+    } else {
+      await runSerial(bytecode, input, writer, options);
+    }
+  } finally {
+    // Results before a failing record are still delivered
+    await writer.flush();
+  }
+}
+
+async function runSerial(
+  bytecode: BytecodeFile,
+  input: Readable,
+  writer: BufferedWriter,
+  options: StreamOptions
+): Promise<void> {
+  const vm = new VM(bytecode, options.effectHandler);
+  const profiler = options.onProfile ? vm.enableProfiling() : null;
+  if (!profiler) {
+    vm.enableCompilation();
+  }
+
+  try {
+    for await (const records of readRecords(input, options.format)) {
+      for (let i = 0; i < records.values.length; i++) {
+        let result: Value;
+        try {
+          result = vm.run(records.values[i]!);
+        } catch (error) {
+          throw new Error(`line ${records.lines[i]}: ${(error as Error).message}`);
+        }
+        writer.write(formatResult(result, options.format));
+      }
+      await writer.drain();
+    }
+  } finally {
+    if (profiler) {
+      options.onProfile!(profiler);
+    }
+  }
+}
+
+async function runParallel(
+  bytecode: BytecodeFile,
+  input: Readable,
+  writer: BufferedWriter,
+  options: StreamOptions
+): Promise<void> {
+  const pool = new VMWorkerPool(bytecode, {
+    workers: options.workers,
+    chunkSize: BATCH_SIZE,
+    compile: true,
+  });
+  const batchSize = BATCH_SIZE * options.workers;
+
+  // One batch runs on the pool while the next one is read
+  let running: Promise<void> | null = null;
+  const submit = async (values: Value[], lines: number[]) => {
+    if (running) {
+      await running;
+    }
+    running = pool.runBatch(values).then(
+      (results) => {
+        for (const result of results) {
+          writer.write(formatResult(result, options.format));
+        }
+        return writer.drain();
+      },
+      (error: Error) => {
+        throw new Error(`lines ${lines[0]}-${lines[lines.length - 1]}: ${error.message}`);
+      }
+    );
+    // Surfaced by the next await on it; not an unhandled rejection meanwhile
+    running.catch(() => {});
+  };
+
+  try {
+    let values: Value[] = [];
+    let lines: number[] = [];
+    for await (const records of readRecords(input, options.format)) {
+      for (let i = 0; i < records.values.length; i++) {
+        values.push(records.values[i]!);
+        lines.push(records.lines[i]!);
+      }
+      if (values.length >= batchSize) {
+        await submit(values, lines);
+        values = [];
+        lines = [];
+      }
+    }
+    if (values.length > 0) {
+      await submit(values, lines);
+    }
+    if (running) {
+      await running;
+    }
+  } finally {
+    await pool.close();
+  }
+}
+
+interface RecordChunk {
+  values: Value[];
+  /** 1-based line number of each record, for error messages. */
+  lines: number[];
+}
+
+/**
+ * Split a stream into records, yielding the complete lines of each chunk as
+ * it arrives. Only the trailing partial line is carried between chunks.
+ */
+async function* readRecords(input: Readable, format: RecordFormat): AsyncGenerator<RecordChunk> {
+  input.setEncoding("utf-8");
+  let pending = "";
+  let lineNumber = 0;
+
+  const parse = (text: string, chunk: RecordChunk) => {
+    lineNumber++;
+    const line = text.endsWith("\r") ? text.slice(0, -1) : text;
+    if (format === "lines") {
+      chunk.values.push(stringValue(line));
+    } else if (line.trim() !== "") {
+      let json: unknown;
+      try {
+        json = JSON.parse(line);
+      } catch (error) {
+        throw new Error(`line ${lineNumber}: invalid JSON: ${(error as Error).message}`);
+      }
+      chunk.values.push(valueFromJSON(json));
+    } else {
+      return;
+    }
+    chunk.lines.push(lineNumber);
+  };
+
+  for await (const data of input) {
+    const text = pending + (data as string);
+    const chunk: RecordChunk = { values: [], lines: [] };
+    let start = 0;
+    let end: number;
+    try {
+      while ((end = text.indexOf("\n", start)) !== -1) {
+        parse(text.slice(start, end), chunk);
+        start = end + 1;
+      }
+    } catch (error) {
+      // Records before a malformed line still run
+      if (chunk.values.length > 0) {
+        yield chunk;
+      }
+      throw error;
+    }
+    pending = text.slice(start);
+    if (chunk.values.length > 0) {
+      yield chunk;
+    }
+  }
+
+  // A final line without a newline is still a record
+  if (pending !== "") {
+    const chunk: RecordChunk = { values: [], lines: [] };
+    parse(pending, chunk);
+    if (chunk.values.length > 0) {
+      yield chunk;
+    }
+  }
+}
+
+function formatResult(result: Value, format: RecordFormat): string {
+  if (format === "ndjson") {
+    return JSON.stringify(valueToJSON(result)) ?? "null";
+  }
+  return displayValue(result);
+}
+
+/**
+ * Collects output lines and writes them in large blocks.
+ */
+class BufferedWriter {
+  private buffer: string = "";
+
+  constructor(private readonly output: Writable) {}
+
+  write(line: string): void {
+    this.buffer += line + "\n";
+  }
+
+  /**
+   * Write the buffer out if it is full, waiting for the stream to drain
+   * when it asks for backpressure.
+   */
+  async drain(): Promise<void> {
+    if (this.buffer.length >= OUTPUT_BUFFER_SIZE) {
+      await this.flush();
+    }
+  }
+
+  /**
+   * Write the buffer out, waiting for the stream to drain when it asks for
+   * backpressure. Nothing is written once the stream has been destroyed.
+   * @throws the stream's error, or an Error if it closes before draining
+   */
+  async flush(): Promise<void> {
+    if (this.buffer === "" || this.output.destroyed) {
+      return;
+    }
+    const block = this.buffer;
+    this.buffer = "";
+    if (!this.output.write(block)) {
+      await this.waitForDrain();
+    }
+  }
+
+  private waitForDrain(): Promise<void> {
+    const output = this.output;
+    return new Promise<void>((resolve, reject) => {
+      const settle = (error?: Error) => {
+        output.off("drain", onDrain);
+        output.off("error", onError);
+        output.off("close", onClose);
+        if (error) {
+          reject(error);
+        } else {
+          resolve();
+        }
+      };
+      const onDrain = () => settle();
+      const onError = (error: Error) => settle(error);
+      const onClose = () => settle(new Error("Output closed before it drained"));
+      output.on("drain", onDrain);
+      output.on("error", onError);
+      output.on("close", onClose);
+    });
+  }
+}
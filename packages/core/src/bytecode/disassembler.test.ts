@@ -129,6 +129,23 @@ describe("disassembler", () => {
       expect(result.size).toBe(3);
     });
 
+    it("disassembles LOAD_LOCAL_CALL_BUILTIN with local, name and arg count", () => {
+      const code = new Uint8Array([Opcode.LOAD_LOCAL_CALL_BUILTIN_U8, 2, 1, 1]);
+      const names = ["foo", "upper"];
+      const result = disassembleInstruction(code, 0, names);
+
+      expect(result.text).toBe('LOAD_LOCAL_CALL_BUILTIN 2 "upper" 1');
+      expect(result.size).toBe(4);
+    });
+
+    it("disassembles fused compare-and-jump instructions", () => {
+      const code = new Uint8Array([Opcode.LT_JUMP_IF_FALSE_U8, 4]);
+      const result = disassembleInstruction(code, 0, []);
+
+      expect(result.text).toBe("LT_JUMP_IF_FALSE_U8 4");
+      expect(result.size).toBe(2);
+    });
+
     it("handles invalid opcodes", () => {
       const code = new Uint8Array([0xff]);
       const result = disassembleInstruction(code, 0, []);
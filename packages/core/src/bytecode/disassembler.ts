@@ -280,6 +280,18 @@ export function disassembleInstruction(
 
       text += ` "${name}" ${argCount}`;
     }
+  } else if (opcode === Opcode.LOAD_LOCAL_CALL_BUILTIN_U8) {
+    // Local index, then name_idx and arg_count (always u8)
+    if (operand !== null) {
+      const nameIdxByte = code[offset + size];
+      const argCountByte = code[offset + size + 1];
+      const nameIdx = nameIdxByte !== undefined ? nameIdxByte : 0;
+      const name = names[nameIdx] || `<unknown ${nameIdx}>`;
+      const argCount = argCountByte !== undefined ? argCountByte : 0;
+      size += 2;
+
+      text += ` ${operand} "${name}" ${argCount}`;
+    }
   } else if (operand !== null) {
     // Single operand - show the value
     const sizeHint = getSizeHint(operandType);
@@ -33,6 +33,7 @@ export enum OpcodeCategory {
   BUILTINS = "Builtins",
   EFFECTS = "Effects",
   ARRAYS = "Arrays",
+  SUPERINSTRUCTIONS = "Superinstructions",
 }
 
 /**
@@ -108,13 +109,16 @@ export enum Opcode {
   // Functions (0x48-0x4A for u8, 0x88-0x8A for u16, 0xc8-0xca for u32)
   MAKE_CLOSURE_U8 = 0x48, // Create closure (u8 function template index)
   CALL_U8 = 0x49, // Call function (u8 arg count)
+  TAIL_CALL_U8 = 0x4a, // Call function in place of the current frame (u8 arg count)
   RETURN = 0x30, // Return from function
 
   MAKE_CLOSURE_U16 = 0x88, // Create closure (u16 function template index)
   CALL_U16 = 0x89, // Call function (u16 arg count)
+  TAIL_CALL_U16 = 0x8a, // Call function in place of the current frame (u16 arg count)
 
   MAKE_CLOSURE_U32 = 0xc8, // Create closure (u32 function template index)
   CALL_U32 = 0xc9, // Call function (u32 arg count)
+  TAIL_CALL_U32 = 0xca, // Call function in place of the current frame (u32 arg count)
 
   // Builtins (0x4B-0x4C for u8, 0x8B-0x8C for u16, 0xcb-0xcc for u32)
   // Format: CALL_BUILTIN <name_idx> <arg_count>
@@ -136,6 +140,18 @@ export enum Opcode {
 
   MAKE_ARRAY_U16 = 0x8f, // Create array (u16 element count)
   MAKE_ARRAY_U32 = 0xcf, // Create array (u32 element count)
+
+  // Superinstructions (0x58-0x5F, u8 only)
+  // Never emitted by codegen; produced by the peephole optimizer from
+  // common instruction pairs (see codegen/peephole.ts)
+  TEE_LOCAL_U8 = 0x58, // STORE_LOCAL + LOAD_LOCAL of the same local (u8 index)
+  LOAD_LOCAL_CALL_BUILTIN_U8 = 0x59, // LOAD_LOCAL + CALL_BUILTIN (u8 local, u8 name index, u8 arg count)
+  EQ_JUMP_IF_FALSE_U8 = 0x5a, // EQ + JUMP_IF_FALSE (u8 offset)
+  NE_JUMP_IF_FALSE_U8 = 0x5b, // NE + JUMP_IF_FALSE (u8 offset)
+  LT_JUMP_IF_FALSE_U8 = 0x5c, // LT + JUMP_IF_FALSE (u8 offset)
+  GT_JUMP_IF_FALSE_U8 = 0x5d, // GT + JUMP_IF_FALSE (u8 offset)
+  LE_JUMP_IF_FALSE_U8 = 0x5e, // LE + JUMP_IF_FALSE (u8 offset)
+  GE_JUMP_IF_FALSE_U8 = 0x5f, // GE + JUMP_IF_FALSE (u8 offset)
 }
 
 /**
@@ -147,6 +163,7 @@ export interface OpcodeMetadata {
   category: OpcodeCategory;
   description: string;
   stackEffect?: string; // Human-readable stack effect (e.g., "a, b -> a+b")
+  extraOperands?: number; // Trailing u8 operands after the main operand (e.g., arg count)
 }
 
 /**
@@ -511,6 +528,13 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     description: "Call function with N arguments",
     stackEffect: "func, arg1, ..., argN -> result",
   },
+  [Opcode.TAIL_CALL_U8]: {
+    name: "TAIL_CALL",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.FUNCTIONS,
+    description: "Call function with N arguments, reusing the current frame",
+    stackEffect: "func, arg1, ..., argN -> (caller stack)",
+  },
   [Opcode.RETURN]: {
     name: "RETURN",
     operandType: OperandType.NONE,
@@ -532,6 +556,13 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     description: "Call function with N arguments",
     stackEffect: "func, arg1, ..., argN -> result",
   },
+  [Opcode.TAIL_CALL_U16]: {
+    name: "TAIL_CALL",
+    operandType: OperandType.U16,
+    category: OpcodeCategory.FUNCTIONS,
+    description: "Call function with N arguments, reusing the current frame",
+    stackEffect: "func, arg1, ..., argN -> (caller stack)",
+  },
   [Opcode.MAKE_CLOSURE_U32]: {
     name: "MAKE_CLOSURE",
     operandType: OperandType.U32,
@@ -546,6 +577,13 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     description: "Call function with N arguments",
     stackEffect: "func, arg1, ..., argN -> result",
   },
+  [Opcode.TAIL_CALL_U32]: {
+    name: "TAIL_CALL",
+    operandType: OperandType.U32,
+    category: OpcodeCategory.FUNCTIONS,
+    description: "Call function with N arguments, reusing the current frame",
+    stackEffect: "func, arg1, ..., argN -> (caller stack)",
+  },
 
   // Builtins
   [Opcode.CALL_BUILTIN_U8_U8]: {
@@ -554,6 +592,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.BUILTINS,
     description: "Call builtin function (name index, arg count)",
     stackEffect: "arg1, ..., argN -> result",
+    extraOperands: 1,
   },
   [Opcode.CALL_BUILTIN_U16_U8]: {
     name: "CALL_BUILTIN",
@@ -561,6 +600,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.BUILTINS,
     description: "Call builtin function (name index, arg count)",
     stackEffect: "arg1, ..., argN -> result",
+    extraOperands: 1,
   },
   [Opcode.CALL_BUILTIN_U32_U8]: {
     name: "CALL_BUILTIN",
@@ -568,6 +608,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.BUILTINS,
     description: "Call builtin function (name index, arg count)",
     stackEffect: "arg1, ..., argN -> result",
+    extraOperands: 1,
   },
 
   // Effects
@@ -577,6 +618,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.EFFECTS,
     description: "Perform algebraic effect (name index, arg count)",
     stackEffect: "arg1, ..., argN -> (suspended, continuation captured)",
+    extraOperands: 1,
   },
   [Opcode.EFFECT_U16_U8]: {
     name: "EFFECT",
@@ -584,6 +626,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.EFFECTS,
     description: "Perform algebraic effect (name index, arg count)",
     stackEffect: "arg1, ..., argN -> (suspended, continuation captured)",
+    extraOperands: 1,
   },
   [Opcode.EFFECT_U32_U8]: {
     name: "EFFECT",
@@ -591,6 +634,7 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     category: OpcodeCategory.EFFECTS,
     description: "Perform algebraic effect (name index, arg count)",
     stackEffect: "arg1, ..., argN -> (suspended, continuation captured)",
+    extraOperands: 1,
   },
 
   // Arrays
@@ -622,6 +666,65 @@ export const OPCODE_METADATA: Record<Opcode, OpcodeMetadata> = {
     description: "Create array from N stack values",
     stackEffect: "elem1, ..., elemN -> array",
   },
+
+  // Superinstructions
+  [Opcode.TEE_LOCAL_U8]: {
+    name: "TEE_LOCAL",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Store top of stack to local variable without popping it",
+    stackEffect: "value -> value",
+  },
+  [Opcode.LOAD_LOCAL_CALL_BUILTIN_U8]: {
+    name: "LOAD_LOCAL_CALL_BUILTIN",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Push local variable, then call builtin function (local, name index, arg count)",
+    stackEffect: "arg1, ..., argN-1 -> result",
+    extraOperands: 2,
+  },
+  [Opcode.EQ_JUMP_IF_FALSE_U8]: {
+    name: "EQ_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a == b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
+  [Opcode.NE_JUMP_IF_FALSE_U8]: {
+    name: "NE_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a != b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
+  [Opcode.LT_JUMP_IF_FALSE_U8]: {
+    name: "LT_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a < b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
+  [Opcode.GT_JUMP_IF_FALSE_U8]: {
+    name: "GT_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a > b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
+  [Opcode.LE_JUMP_IF_FALSE_U8]: {
+    name: "LE_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a <= b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
+  [Opcode.GE_JUMP_IF_FALSE_U8]: {
+    name: "GE_JUMP_IF_FALSE",
+    operandType: OperandType.U8,
+    category: OpcodeCategory.SUPERINSTRUCTIONS,
+    description: "Compare a >= b, jump if false (relative offset)",
+    stackEffect: "a, b ->",
+  },
 };
 
 /**
@@ -656,11 +759,11 @@ export function getOperandSize(type: OperandType): number {
 }
 
 /**
- * Get the total instruction size (opcode + operand).
+ * Get the total instruction size (opcode + operand + trailing u8 operands).
  */
 export function getInstructionSize(opcode: Opcode): number {
-  const operandType = OPCODE_METADATA[opcode].operandType;
-  return 1 + getOperandSize(operandType);
+  const metadata = OPCODE_METADATA[opcode];
+  return 1 + getOperandSize(metadata.operandType) + (metadata.extraOperands ?? 0);
 }
 
 /**
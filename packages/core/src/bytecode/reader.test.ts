@@ -1,5 +1,7 @@
 import { describe, test as it, expect } from "bun:test";
-import { readBytecode, BytecodeReadError } from "./reader";
+import { readBytecode, openBytecode, BytecodeReadError } from "./reader";
+import { writeBytecode } from "./writer";
+import { compilePEX, VM, throwingEffectHandler, stringValue } from "../vm/index";
 import {
   MAGIC_NUMBER,
   VERSION_MAJOR,
@@ -502,4 +504,101 @@ describe("BytecodeReader", () => {
       expect(() => readBytecode(writer.toUint8Array())).toThrow(/UTF-8/);
     });
   });
+
+  describe("openBytecode", () => {
+    const source = 'fn: greet (name) (join "Hello, " name); $$ | (greet $) | (replace $ /o/g "0")';
+
+    it("matches readBytecode for compiled programs", () => {
+      const bytes = writeBytecode(compilePEX(source));
+      const eager = readBytecode(bytes);
+      const lazy = openBytecode(bytes);
+
+      expect(lazy.header).toEqual(eager.header);
+      expect(lazy.functionTemplates).toEqual(eager.functionTemplates);
+      expect(lazy.constantPool).toEqual(eager.constantPool);
+      expect(lazy.nameTable).toEqual(eager.nameTable);
+      expect(lazy.debugInfo).toEqual(eager.debugInfo);
+    });
+
+    it("decodes constants and names on demand", () => {
+      const eager = compilePEX(source);
+      const lazy = openBytecode(writeBytecode(eager));
+
+      expect(lazy.constantCount).toBe(eager.constantPool.constants.length);
+      expect(lazy.nameCount).toBe(eager.nameTable.names.length);
+      expect(lazy.getName(0)).toBe(eager.nameTable.names[0]!);
+      expect(lazy.getConstant(0)).toBe(lazy.getConstant(0));
+    });
+
+    it("decodes the whole constant pool and name table once", () => {
+      const lazy = openBytecode(writeBytecode(compilePEX(source)));
+
+      expect(lazy.constantPool).toBe(lazy.constantPool);
+      expect(lazy.nameTable).toBe(lazy.nameTable);
+      expect(lazy.constantPool.constants[0]).toBe(lazy.getConstant(0));
+    });
+
+    it("shares the code section with the input buffer", () => {
+      const bytes = writeBytecode(compilePEX(source));
+      const lazy = openBytecode(bytes);
+
+      expect(lazy.codeSection.code.buffer).toBe(bytes.buffer);
+    });
+
+    it("runs on the VM", () => {
+      const lazy = openBytecode(writeBytecode(compilePEX(source)));
+      const vm = new VM(lazy, throwingEffectHandler);
+
+      expect(vm.run(stringValue("world"))).toEqual(stringValue("Hell0, w0rld"));
+    });
+
+    it("validates structure when opened", () => {
+      expect(() => openBytecode(new Uint8Array([0, 1, 2, 3]))).toThrow(BytecodeReadError);
+
+      const bytes = createMinimalBytecode();
+      const withTrailing = new Uint8Array(bytes.length + 10);
+      withTrailing.set(bytes);
+      expect(() => openBytecode(withTrailing)).toThrow(/trailing data/);
+    });
+
+    it("reports invalid UTF-8 when the entry is used", () => {
+      const writer = new TestBytecodeWriter();
+
+      // Header
+      writer.writeU32(MAGIC_NUMBER);
+      writer.writeU8(VERSION_MAJOR);
+      writer.writeU8(VERSION_MINOR);
+      writer.writeU8(HeaderFlags.NONE);
+      writer.writeU8(0);
+      writer.writeU32(0);
+      writer.writeU32(0);
+
+      // Constant pool with an invalid UTF-8 string
+      writer.writeU32(1);
+      writer.writeU8(ConstantType.STRING);
+      writer.writeU32(2);
+      writer.writeU8(0xff);
+      writer.writeU8(0xfe);
+
+      // Name table (empty)
+      writer.writeU32(0);
+
+      // Function templates (one entry point function)
+      writer.writeU32(1);
+      writer.writeI32(-1);
+      writer.writeU32(0);
+      writer.writeU32(0);
+      writer.writeU32(0);
+      writer.writeU32(0);
+      writer.writeU32(1);
+
+      // Code section
+      writer.writeU32(1);
+      writer.writeU8(0x30);
+
+      const lazy = openBytecode(writer.toUint8Array());
+      expect(() => lazy.getConstant(0)).toThrow(/UTF-8/);
+      expect(() => lazy.getConstant(1)).toThrow(/out of bounds/);
+    });
+  });
 });
@@ -12,6 +12,7 @@
 
 import {
   type BytecodeFile,
+  type CodeSection,
   type BytecodeHeader,
   type Constant,
   type ConstantPool,
@@ -30,6 +31,8 @@ import {
   VERSION_MAJOR,
 } from "./format";
 
+const utf8Decoder = new TextDecoder("utf-8", { fatal: true });
+
 /**
  * Custom error class for bytecode reading errors.
  */
@@ -157,7 +160,7 @@ class BinaryReader {
 
     // Decode UTF-8
     try {
-      return new TextDecoder("utf-8", { fatal: true }).decode(bytes);
+      return utf8Decoder.decode(bytes);
     } catch {
       throw new BytecodeReadError(
         `Invalid UTF-8 string at offset ${this.offset - length}`,
@@ -166,6 +169,15 @@ class BinaryReader {
     }
   }
 
+  /**
+   * Skip over a string without decoding it.
+   */
+  skipString(): void {
+    const length = this.readU32();
+    this.ensureBytes(length);
+    this.offset += length;
+  }
+
   /**
    * Read raw bytes.
    */
@@ -564,3 +576,245 @@ export function readBytecode(bytes: Uint8Array): BytecodeFile {
     );
   }
 }
+
+// =============================================================================
+// Lazy loading
+// =============================================================================
+
+/**
+ * Skip over a single constant, validating its type tag and bounds.
+ */
+function skipConstant(reader: BinaryReader): void {
+  const type = reader.readU8() as ConstantType;
+
+  switch (type) {
+    case CT.NULL:
+    case CT.TRUE:
+    case CT.FALSE:
+      return;
+    case CT.INT32:
+      reader.readI32();
+      return;
+    case CT.FLOAT64:
+      reader.readF64();
+      return;
+    case CT.STRING:
+      reader.skipString();
+      return;
+    case CT.REGEX:
+      reader.skipString();
+      reader.skipString();
+      return;
+    default:
+      throw new BytecodeReadError(
+        `Unknown constant type: ${type}`,
+        reader.getOffset() - 1
+      );
+  }
+}
+
+/**
+ * A bytecode file backed directly by its serialized bytes.
+ *
+ * Only the header and function templates are decoded up front. Constants and
+ * names are decoded on first use from offsets recorded while scanning, and
+ * the code section is a view into the original buffer, so opening a file
+ * costs one pass over the section headers and no string decoding.
+ *
+ * `constantPool`, `nameTable` and `debugInfo` are still available for tools
+ * that want the whole section; they are decoded in full on first access and
+ * the same object is returned afterwards.
+ */
+export class LazyBytecodeFile implements BytecodeFile {
+  readonly header: BytecodeHeader;
+  readonly functionTemplates: FunctionTemplates;
+  readonly codeSection: CodeSection;
+
+  private readonly reader: BinaryReader;
+  private readonly constantOffsets: Uint32Array;
+  private readonly nameOffsets: Uint32Array;
+  private readonly constants: (Constant | undefined)[];
+  private readonly names: (string | undefined)[];
+  private readonly debugInfoOffset: number;
+  private decodedDebugInfo: DebugInfo | undefined;
+  private decodedConstantPool: ConstantPool | undefined;
+  private decodedNameTable: NameTable | undefined;
+
+  constructor(bytes: Uint8Array) {
+    const reader = new BinaryReader(bytes);
+    this.reader = reader;
+
+    try {
+      this.header = readHeader(reader);
+
+      // writeBytecode() records where the constant pool starts; 0 means
+      // "immediately after the header", as readBytecode() assumes.
+      const poolOffset = this.header.constantPoolOffset;
+      if (poolOffset !== 0) {
+        if (poolOffset < reader.getOffset()) {
+          throw new BytecodeReadError(
+            `Invalid constant pool offset: ${poolOffset}`,
+            reader.getOffset() - 4
+          );
+        }
+        reader.setOffset(poolOffset);
+      }
+
+      const constantCount = reader.readU32();
+      this.constantOffsets = new Uint32Array(constantCount);
+      for (let i = 0; i < constantCount; i++) {
+        this.constantOffsets[i] = reader.getOffset();
+        skipConstant(reader);
+      }
+
+      const nameCount = reader.readU32();
+      this.nameOffsets = new Uint32Array(nameCount);
+      for (let i = 0; i < nameCount; i++) {
+        this.nameOffsets[i] = reader.getOffset();
+        reader.skipString();
+      }
+
+      this.functionTemplates = readFunctionTemplates(reader);
+      const code = readCodeSection(reader);
+      validateFunctionTemplates(this.functionTemplates, code.length);
+
+      if (
+        this.header.entryPoint < 0 ||
+        this.header.entryPoint >= this.functionTemplates.templates.length
+      ) {
+        throw new BytecodeReadError(
+          `Invalid entry point: ${this.header.entryPoint} (function template count: ${this.functionTemplates.templates.length})`
+        );
+      }
+
+      this.codeSection = { code };
+      this.debugInfoOffset = reader.getOffset();
+
+      // Debug info is decoded on demand; without it the file must end here.
+      if ((this.header.flags & HeaderFlags.HAS_DEBUG_INFO) !== 0) {
+        if (reader.remaining() === 0) {
+          throw new BytecodeReadError(
+            "Header indicates debug info, but no data remaining"
+          );
+        }
+      } else if (reader.remaining() > 0) {
+        throw new BytecodeReadError(
+          `Unexpected trailing data: ${reader.remaining()} bytes remaining`,
+          reader.getOffset()
+        );
+      }
+    } catch (error) {
+      if (error instanceof BytecodeReadError) {
+        throw error;
+      }
+      throw new BytecodeReadError(
+        `Failed to read bytecode: ${error instanceof Error ? error.message : String(error)}`,
+        reader.getOffset()
+      );
+    }
+
+    this.constants = new Array(this.constantOffsets.length);
+    this.names = new Array(this.nameOffsets.length);
+  }
+
+  /**
+   * Number of entries in the constant pool.
+   */
+  get constantCount(): number {
+    return this.constantOffsets.length;
+  }
+
+  /**
+   * Number of entries in the name table.
+   */
+  get nameCount(): number {
+    return this.nameOffsets.length;
+  }
+
+  /**
+   * Decode (once) and return the constant at `index`.
+   */
+  getConstant(index: number): Constant {
+    let constant = this.constants[index];
+    if (constant === undefined) {
+      this.reader.setOffset(this.offsetOf(this.constantOffsets, index, "Constant"));
+      constant = readConstant(this.reader);
+      this.constants[index] = constant;
+    }
+    return constant;
+  }
+
+  /**
+   * Decode (once) and return the name at `index`.
+   */
+  getName(index: number): string {
+    let name = this.names[index];
+    if (name === undefined) {
+      this.reader.setOffset(this.offsetOf(this.nameOffsets, index, "Name"));
+      name = this.reader.readString();
+      this.names[index] = name;
+    }
+    return name;
+  }
+
+  get constantPool(): ConstantPool {
+    if (this.decodedConstantPool === undefined) {
+      const constants: Constant[] = [];
+      for (let i = 0; i < this.constantCount; i++) {
+        constants.push(this.getConstant(i));
+      }
+      this.decodedConstantPool = { constants };
+    }
+    return this.decodedConstantPool;
+  }
+
+  get nameTable(): NameTable {
+    if (this.decodedNameTable === undefined) {
+      const names: string[] = [];
+      for (let i = 0; i < this.nameCount; i++) {
+        names.push(this.getName(i));
+      }
+      this.decodedNameTable = { names };
+    }
+    return this.decodedNameTable;
+  }
+
+  get debugInfo(): DebugInfo | undefined {
+    if ((this.header.flags & HeaderFlags.HAS_DEBUG_INFO) === 0) {
+      return undefined;
+    }
+    if (this.decodedDebugInfo === undefined) {
+      this.reader.setOffset(this.debugInfoOffset);
+      const debugInfo = readDebugInfo(this.reader);
+      if (this.reader.remaining() > 0) {
+        throw new BytecodeReadError(
+          `Unexpected trailing data: ${this.reader.remaining()} bytes remaining`,
+          this.reader.getOffset()
+        );
+      }
+      this.decodedDebugInfo = debugInfo;
+    }
+    return this.decodedDebugInfo;
+  }
+
+  private offsetOf(offsets: Uint32Array, index: number, kind: string): number {
+    if (index < 0 || index >= offsets.length || !Number.isInteger(index)) {
+      throw new BytecodeReadError(`${kind} index ${index} out of bounds`);
+    }
+    return offsets[index]!;
+  }
+}
+
+/**
+ * Open a serialized bytecode file (e.g. a .pexb artifact) without decoding
+ * it up front. The returned file reads from `bytes` directly, so the buffer
+ * must not be modified while the file is in use; a memory-mapped file works.
+ *
+ * @param bytes - Binary bytecode data
+ * @returns Lazily-decoded bytecode file
+ * @throws BytecodeReadError if the section structure is invalid; invalid
+ *   UTF-8 in a constant or name is reported when that entry is first used
+ */
+export function openBytecode(bytes: Uint8Array): LazyBytecodeFile {
+  return new LazyBytecodeFile(bytes);
+}
@@ -285,6 +285,29 @@ describe("Bytecode Code Generation", () => {
       expect(code).toContain(Opcode.CALL_U8);
     });
 
+    it("generates TAIL_CALL for calls in tail position of a function", () => {
+      // let loop (fn (n) (if n (loop (- n 1)) (g (loop 0)))) in (loop 3)
+      const module = irModule(
+        irLet("g", irFn(["x"], irVar("x")),
+          irLet("loop",
+            irFn(["n"], irIf(irVar("n"),
+              irCall(irVar("loop"), [irCall(irVar("-"), [irVar("n"), irConst(1)])]),
+              irCall(irVar("g"), [irCall(irVar("loop"), [irConst(0)])]))),
+            irCall(irVar("loop"), [irConst(3)])))
+      );
+      const bytecode = generateBytecode(module);
+
+      const [main, , loop] = bytecode.functionTemplates.templates;
+      const codeOf = (t: typeof main) =>
+        Array.from(bytecode.codeSection.code.subarray(t!.codeOffset, t!.codeOffset + t!.codeLength));
+      // Both branches are tail calls; the nested (loop 0) is not
+      expect(codeOf(loop).filter((op) => op === Opcode.TAIL_CALL_U8)).toHaveLength(2);
+      expect(codeOf(loop)).toContain(Opcode.CALL_U8);
+      // The program body keeps its frame
+      expect(codeOf(main)).toContain(Opcode.CALL_U8);
+      expect(codeOf(main)).not.toContain(Opcode.TAIL_CALL_U8);
+    });
+
     it("handles multiple arguments correctly", () => {
       // (+ 1 2)
       const module = irModule(
@@ -40,6 +40,13 @@
  * For `let f (fn ...)`, we allocate the local for `f` before compiling the
  * function body, so recursive references resolve correctly.
  *
+ * ### Tail Calls
+ * A call in tail position of a function body (the body itself, either
+ * branch of an `if`, the body of a `let`, or the last expression of a `seq`)
+ * is emitted as TAIL_CALL, which replaces the caller's frame instead of
+ * pushing a new one. Tail-recursive functions then run in constant frame
+ * and stack space. The program body itself still uses CALL.
+ *
  * ### Control Flow with Backpatching
  * Structured control flow (if/seq) is converted to jumps:
  * - Generate labels for branch targets
@@ -68,7 +75,7 @@
  * | `(let x v body)` | `<compile v>; STORE_LOCAL <idx>; <compile body>` |
  * | `(if c t e)` | `<compile c>; JUMP_IF_FALSE else; <compile t>; JUMP end; else: <compile e>; end:` |
  * | `(seq a b c)` | `<compile a>; POP; <compile b>; POP; <compile c>` |
- * | `(call f a b)` | `<compile f>; <compile a>; <compile b>; CALL 2` |
+ * | `(call f a b)` | `<compile f>; <compile a>; <compile b>; CALL 2` (`TAIL_CALL 2` in tail position) |
  * | `(fn (x) body)` | `MAKE_CLOSURE <func_idx>` |
  * | `(effect "name" args...)` | `<compile args...>; EFFECT <name_idx> <arg_count>` |
  *
@@ -95,29 +102,8 @@
  * - Invalid IR structures
  */
 
-import type {
-  IRExpr,
-  IRConst,
-  IRVar,
-  IRIf,
-  IRLet,
-  IRSeq,
-  IRCall,
-  IRFn,
-  IREffect,
-  IRModule,
-  ConstValue,
-} from "../ir/types.ts";
-import {
-  isConst,
-  isVar,
-  isIf,
-  isLet,
-  isSeq,
-  isCall,
-  isFn,
-  isEffect,
-} from "../ir/types.ts";
+import type { IRModule, ConstValue } from "../ir/types.ts";
+import { IRArena, IRKind } from "../ir/arena.ts";
 import type {
   BytecodeFile,
   Constant,
@@ -130,6 +116,17 @@ import {
 } from "../bytecode/format.ts";
 import { Opcode } from "../bytecode/opcodes.ts";
 
+/**
+ * Revision of the code this compiler generates. Bump it in any change to
+ * lowering, the IR optimizer, code generation or the peephole pass that
+ * changes the bytecode for some source: CompilationCache keys on it (see
+ * COMPILER_VERSION), so entries written by older compilers are not reused.
+ *
+ * 2: constant folding and dead-branch elimination on the IR
+ * 3: TAIL_CALL for calls in tail position
+ */
+export const CODEGEN_REVISION = 3;
+
 // ============================================
 // Error Types
 // ============================================
@@ -322,22 +319,22 @@ interface ResolvedVar {
 }
 
 /**
- * Context for compiling a function.
+ * Context for compiling a function. Variables are keyed by arena name ID.
  */
 class FunctionContext {
   name: string | null;
-  params: string[];
-  locals: Map<string, number> = new Map(); // name -> local index
+  params: number[];
+  locals: Map<number, number> = new Map(); // name ID -> local index
   localCount = 0;
   upvalues: Upvalue[] = [];
-  upvalueMap: Map<string, number> = new Map(); // name -> upvalue index
+  upvalueMap: Map<number, number> = new Map(); // name ID -> upvalue index
   instructions: InstructionBuilder = new InstructionBuilder();
   parent: FunctionContext | null;
   code: Uint8Array | null = null; // Compiled code (set when exiting)
 
   constructor(
     name: string | null,
-    params: string[],
+    params: number[],
     parent: FunctionContext | null
   ) {
     this.name = name;
@@ -353,7 +350,7 @@ class FunctionContext {
   /**
    * Allocate a new local variable.
    */
-  allocLocal(name: string): number {
+  allocLocal(name: number): number {
     const index = this.localCount++;
     this.locals.set(name, index);
     return index;
@@ -362,7 +359,7 @@ class FunctionContext {
   /**
    * Resolve a variable reference.
    */
-  resolveVar(name: string): ResolvedVar | null {
+  resolveVar(name: number): ResolvedVar | null {
     // Check locals
     const localIndex = this.locals.get(name);
     if (localIndex !== undefined) {
@@ -406,10 +403,12 @@ class CompilationContext {
   functionTemplates: FunctionTemplate[] = [];
   functionCodes: Uint8Array[] = []; // Compiled code for each function
   currentFunction: FunctionContext;
+  arena: IRArena;
 
-  constructor() {
+  constructor(arena: IRArena) {
+    this.arena = arena;
     // Initialize with a top-level function (main entry point)
-    this.currentFunction = new FunctionContext(null, ["input"], null);
+    this.currentFunction = new FunctionContext(null, [arena.intern("input")], null);
   }
 
   /**
@@ -456,7 +455,7 @@ class CompilationContext {
   /**
    * Enter a new function scope.
    */
-  enterFunction(name: string | null, params: string[]): void {
+  enterFunction(name: string | null, params: number[]): void {
     const newFunction = new FunctionContext(name, params, this.currentFunction);
     this.currentFunction = newFunction;
   }
@@ -496,13 +495,15 @@ class CompilationContext {
 // ============================================
 
 /**
- * Generate bytecode from an IR module.
+ * Generate bytecode from an IR module. Tree modules are flattened into an
+ * arena first; `lowerProgramToArena` produces one directly.
  */
-export function generateBytecode(module: IRModule): BytecodeFile {
-  const ctx = new CompilationContext();
+export function generateBytecode(module: IRModule | IRArena): BytecodeFile {
+  const arena = module instanceof IRArena ? module : IRArena.fromModule(module);
+  const ctx = new CompilationContext(arena);
 
   // Compile the main program body
-  compileExpr(module.body, ctx);
+  compileExpr(arena.root, ctx);
 
   // Main function should return the result
   ctx.currentFunction.instructions.emit(Opcode.RETURN);
@@ -551,35 +552,49 @@ export function generateBytecode(module: IRModule): BytecodeFile {
 }
 
 /**
- * Compile an IR expression to bytecode.
+ * Compile an IR node to bytecode. `tail` is set when the node's value is
+ * returned from the enclosing function as-is.
  */
-function compileExpr(expr: IRExpr, ctx: CompilationContext): void {
-  if (isConst(expr)) {
-    compileConst(expr, ctx);
-  } else if (isVar(expr)) {
-    compileVar(expr, ctx);
-  } else if (isIf(expr)) {
-    compileIf(expr, ctx);
-  } else if (isLet(expr)) {
-    compileLet(expr, ctx);
-  } else if (isSeq(expr)) {
-    compileSeq(expr, ctx);
-  } else if (isCall(expr)) {
-    compileCall(expr, ctx);
-  } else if (isFn(expr)) {
-    compileFn(expr, ctx);
-  } else if (isEffect(expr)) {
-    compileEffect(expr, ctx);
-  } else {
-    throw new CodegenError(`Unknown IR expression type: ${(expr as any).type}`);
+function compileExpr(node: number, ctx: CompilationContext, tail: boolean = false): void {
+  const arena = ctx.arena;
+  const a = arena.op0[node]!;
+  const b = arena.op1[node]!;
+  const c = arena.op2[node]!;
+
+  switch (arena.kinds[node] as IRKind) {
+    case IRKind.Const:
+      compileConst(arena.constants[a]!, ctx);
+      break;
+    case IRKind.Var:
+      compileVar(a, ctx);
+      break;
+    case IRKind.If:
+      compileIf(a, b, c, ctx, tail);
+      break;
+    case IRKind.Let:
+      compileLet(a, b, c, ctx, tail);
+      break;
+    case IRKind.Seq:
+      compileSeq(a, ctx, tail);
+      break;
+    case IRKind.Call:
+      compileCall(a, b, ctx, tail);
+      break;
+    case IRKind.Fn:
+      compileFn(a, b, ctx);
+      break;
+    case IRKind.Effect:
+      compileEffect(a, b, ctx);
+      break;
+    default:
+      throw new CodegenError(`Unknown IR node kind: ${arena.kinds[node]}`);
   }
 }
 
 /**
  * Compile a constant expression.
  */
-function compileConst(expr: IRConst, ctx: CompilationContext): void {
-  const { value } = expr;
+function compileConst(value: ConstValue, ctx: CompilationContext): void {
   const instr = ctx.currentFunction.instructions;
 
   // Use specialized opcodes for common constants
@@ -604,8 +619,7 @@ function compileConst(expr: IRConst, ctx: CompilationContext): void {
 /**
  * Compile a variable reference.
  */
-function compileVar(expr: IRVar, ctx: CompilationContext): void {
-  const { name } = expr;
+function compileVar(name: number, ctx: CompilationContext): void {
   const instr = ctx.currentFunction.instructions;
 
   const resolved = ctx.currentFunction.resolveVar(name);
@@ -620,28 +634,34 @@ function compileVar(expr: IRVar, ctx: CompilationContext): void {
   } else {
     // Unknown variable - treat as builtin reference
     // This will be resolved at runtime
-    throw new CodegenError(`Undefined variable: ${name}`);
+    throw new CodegenError(`Undefined variable: ${ctx.arena.names[name]}`);
   }
 }
 
 /**
  * Compile an if expression.
  */
-function compileIf(expr: IRIf, ctx: CompilationContext): void {
+function compileIf(
+  cond: number,
+  thenBranch: number,
+  elseBranch: number,
+  ctx: CompilationContext,
+  tail: boolean
+): void {
   const instr = ctx.currentFunction.instructions;
 
   const elseLabel = instr.generateLabel("else");
   const endLabel = instr.generateLabel("endif");
 
   // Compile condition
-  compileExpr(expr.cond, ctx);
+  compileExpr(cond, ctx);
 
   // Jump to else if false
   const jumpOpcode = selectJumpIfFalseOpcode(0); // Will be patched
   instr.emitJump(jumpOpcode, elseLabel);
 
   // Compile then branch
-  compileExpr(expr.thenBranch, ctx);
+  compileExpr(thenBranch, ctx, tail);
 
   // Jump to end
   const jumpEndOpcode = selectJumpOpcode(0); // Will be patched
@@ -649,7 +669,7 @@ function compileIf(expr: IRIf, ctx: CompilationContext): void {
 
   // Else branch
   instr.markLabel(elseLabel);
-  compileExpr(expr.else, ctx);
+  compileExpr(elseBranch, ctx, tail);
 
   // End
   instr.markLabel(endLabel);
@@ -658,13 +678,18 @@ function compileIf(expr: IRIf, ctx: CompilationContext): void {
 /**
  * Compile a let expression.
  */
-function compileLet(expr: IRLet, ctx: CompilationContext): void {
-  const { name, value, body } = expr;
+function compileLet(
+  name: number,
+  value: number,
+  body: number,
+  ctx: CompilationContext,
+  tail: boolean
+): void {
   const instr = ctx.currentFunction.instructions;
 
   // For recursive functions, allocate the local first
   // so it's available during compilation of the function body
-  if (isFn(value)) {
+  if (ctx.arena.kinds[value] === IRKind.Fn) {
     // Allocate local variable first
     const localIndex = ctx.currentFunction.allocLocal(name);
 
@@ -687,17 +712,18 @@ function compileLet(expr: IRLet, ctx: CompilationContext): void {
   }
 
   // Compile body (result is left on stack)
-  compileExpr(body, ctx);
+  compileExpr(body, ctx, tail);
 }
 
 /**
  * Compile a sequence expression.
  */
-function compileSeq(expr: IRSeq, ctx: CompilationContext): void {
-  const { exprs } = expr;
+function compileSeq(exprs: number, ctx: CompilationContext, tail: boolean): void {
+  const arena = ctx.arena;
   const instr = ctx.currentFunction.instructions;
+  const count = arena.listLength(exprs);
 
-  if (exprs.length === 0) {
+  if (count === 0) {
     // Empty sequence returns null
     instr.emit(Opcode.CONST_NULL);
     return;
@@ -705,75 +731,78 @@ function compileSeq(expr: IRSeq, ctx: CompilationContext): void {
 
   // For mutual recursion support: pre-allocate locals for consecutive let-bound functions
   // This allows functions to reference each other regardless of definition order
-  const preallocated = new Set<string>();
-  let i = 0;
-  while (i < exprs.length) {
-    const e = exprs[i]!;
-    if (e.type === "let" && isFn(e.value)) {
-      // Allocate the local for this function
-      ctx.currentFunction.allocLocal(e.name);
-      preallocated.add(e.name);
-      i++;
-    } else {
+  const preallocated = new Set<number>();
+  for (let i = 0; i < count; i++) {
+    const e = arena.listItem(exprs, i);
+    if (!isFnLet(arena, e)) {
       break;
     }
+    // Allocate the local for this function
+    ctx.currentFunction.allocLocal(arena.op0[e]!);
+    preallocated.add(arena.op0[e]!);
   }
 
   // Now compile all expressions
-  for (let i = 0; i < exprs.length; i++) {
-    const e = exprs[i]!;
+  for (let i = 0; i < count; i++) {
+    const e = arena.listItem(exprs, i);
+    const last = i === count - 1;
 
     // Special handling for let with function value that was pre-allocated (mutual recursion)
-    if (e.type === "let" && isFn(e.value) && preallocated.has(e.name)) {
+    if (isFnLet(arena, e) && preallocated.has(arena.op0[e]!)) {
       // Local was already allocated above, so just compile and store
-      const localIndex = ctx.currentFunction.locals.get(e.name)!;
+      const localIndex = ctx.currentFunction.locals.get(arena.op0[e]!)!;
       // Compile the function value
-      compileExpr(e.value, ctx);
+      compileExpr(arena.op1[e]!, ctx);
       // Store to the pre-allocated local
       const storeOpcode = selectStoreLocalOpcode(localIndex);
       instr.emitWithOperand(storeOpcode, localIndex);
       // Compile body (which just returns the local)
-      compileExpr(e.body, ctx);
+      compileExpr(arena.op2[e]!, ctx, tail && last);
     } else {
-      compileExpr(e, ctx);
+      compileExpr(e, ctx, tail && last);
     }
 
     // Pop intermediate results (except the last one)
-    if (i < exprs.length - 1) {
+    if (!last) {
       instr.emit(Opcode.POP);
     }
   }
 }
 
+/**
+ * Whether a node is a let that binds a function.
+ */
+function isFnLet(arena: IRArena, node: number): boolean {
+  return arena.kinds[node] === IRKind.Let && arena.kinds[arena.op1[node]!] === IRKind.Fn;
+}
+
 /**
  * Compile a function call.
  */
-function compileCall(expr: IRCall, ctx: CompilationContext): void {
-  const { func, args } = expr;
+function compileCall(func: number, args: number, ctx: CompilationContext, tail: boolean): void {
+  const arena = ctx.arena;
   const instr = ctx.currentFunction.instructions;
+  const argCount = arena.listLength(args);
 
   // Check if this is a builtin operation that has a dedicated opcode
-  if (isVar(func)) {
-    const builtinOpcode = getBuiltinOpcode(func.name, args.length);
+  if (arena.kinds[func] === IRKind.Var) {
+    const name = arena.names[arena.op0[func]!]!;
+    const builtinOpcode = getBuiltinOpcode(name, argCount);
     if (builtinOpcode) {
       // Compile arguments
-      for (const arg of args) {
-        compileExpr(arg, ctx);
-      }
+      compileList(args, ctx);
       // Emit the builtin opcode
       instr.emit(builtinOpcode);
       return;
     }
 
     // Check if it's a general builtin call
-    const builtinNameIndex = tryGetBuiltinNameIndex(func.name, ctx);
+    const builtinNameIndex = tryGetBuiltinNameIndex(name, ctx);
     if (builtinNameIndex !== null) {
       // Compile arguments
-      for (const arg of args) {
-        compileExpr(arg, ctx);
-      }
+      compileList(args, ctx);
       // Emit CALL_BUILTIN with two operands
-      emitCallBuiltin(instr, builtinNameIndex, args.length);
+      emitCallBuiltin(instr, builtinNameIndex, argCount);
       return;
     }
   }
@@ -783,29 +812,32 @@ function compileCall(expr: IRCall, ctx: CompilationContext): void {
   compileExpr(func, ctx);
 
   // Compile arguments
-  for (const arg of args) {
-    compileExpr(arg, ctx);
-  }
+  compileList(args, ctx);
 
   // Emit CALL
-  const opcode = selectCallOpcode(args.length);
-  instr.emitWithOperand(opcode, args.length);
+  const opcode = tail ? selectTailCallOpcode(argCount) : selectCallOpcode(argCount);
+  instr.emitWithOperand(opcode, argCount);
 }
 
 /**
  * Compile a function expression.
  */
-function compileFn(expr: IRFn, ctx: CompilationContext): void {
-  const { params, body } = expr;
+function compileFn(params: number, body: number, ctx: CompilationContext): void {
+  const arena = ctx.arena;
   const instr = ctx.currentFunction.instructions;
 
+  const paramIds: number[] = [];
+  for (let i = 0; i < arena.listLength(params); i++) {
+    paramIds.push(arena.listItem(params, i));
+  }
+
   // Enter new function scope
-  ctx.enterFunction(null, params);
+  ctx.enterFunction(null, paramIds);
 
   // Compile function body
-  compileExpr(body, ctx);
+  compileExpr(body, ctx, true);
 
-  // Emit return
+  // Emit return (unreachable after a TAIL_CALL, which returns for us)
   ctx.currentFunction.instructions.emit(Opcode.RETURN);
 
   // Exit function scope and get function index
@@ -821,20 +853,27 @@ function compileFn(expr: IRFn, ctx: CompilationContext): void {
 /**
  * Compile an effect expression.
  */
-function compileEffect(expr: IREffect, ctx: CompilationContext): void {
-  const { name, args } = expr;
+function compileEffect(name: number, args: number, ctx: CompilationContext): void {
   const instr = ctx.currentFunction.instructions;
 
   // Compile arguments
-  for (const arg of args) {
-    compileExpr(arg, ctx);
-  }
+  compileList(args, ctx);
 
   // Add effect name to name table
-  const nameIndex = ctx.addName(name);
+  const nameIndex = ctx.addName(ctx.arena.names[name]!);
 
   // Emit EFFECT with two operands
-  emitEffect(instr, nameIndex, args.length);
+  emitEffect(instr, nameIndex, ctx.arena.listLength(args));
+}
+
+/**
+ * Compile each node of an arena list in order.
+ */
+function compileList(list: number, ctx: CompilationContext): void {
+  const count = ctx.arena.listLength(list);
+  for (let i = 0; i < count; i++) {
+    compileExpr(ctx.arena.listItem(list, i), ctx);
+  }
 }
 
 // ============================================
@@ -951,6 +990,15 @@ function selectCallOpcode(argCount: number): Opcode {
   return Opcode.CALL_U32;
 }
 
+/**
+ * Select TAIL_CALL opcode variant.
+ */
+function selectTailCallOpcode(argCount: number): Opcode {
+  if (argCount <= 0xff) return Opcode.TAIL_CALL_U8;
+  if (argCount <= 0xffff) return Opcode.TAIL_CALL_U16;
+  return Opcode.TAIL_CALL_U32;
+}
+
 
 // ============================================
 // Builtin Recognition
@@ -987,23 +1035,35 @@ function getBuiltinOpcode(name: string, argCount: number): Opcode | null {
   return null;
 }
 
+/**
+ * Builtins compiled to CALL_BUILTIN rather than a dedicated opcode.
+ */
+const CALL_BUILTINS: ReadonlySet<string> = new Set([
+  // String operations
+  "split", "join", "trim", "upper", "lower", "replace", "substring", "len",
+  // Type conversion
+  "int", "float", "string", "bool",
+  // Array operations
+  "first", "last", "get",
+  // Regex operations
+  "match", "test",
+]);
+
+/**
+ * Whether a call to `name` with `argCount` arguments compiles to a builtin
+ * (an opcode or CALL_BUILTIN) rather than a call to a variable. Builtin
+ * names take precedence over bindings in scope.
+ */
+export function isBuiltinCall(name: string, argCount: number): boolean {
+  return getBuiltinOpcode(name, argCount) !== null || CALL_BUILTINS.has(name);
+}
+
 /**
  * Check if a name is a known builtin and return its name index.
  * Returns null if not a builtin.
  */
 function tryGetBuiltinNameIndex(name: string, ctx: CompilationContext): number | null {
-  const builtins = [
-    // String operations
-    "split", "join", "trim", "upper", "lower", "replace", "substring", "len",
-    // Type conversion
-    "int", "float", "string", "bool",
-    // Array operations
-    "first", "last", "get",
-    // Regex operations
-    "match", "test",
-  ];
-
-  if (builtins.includes(name)) {
+  if (CALL_BUILTINS.has(name)) {
     return ctx.addName(name);
   }
 
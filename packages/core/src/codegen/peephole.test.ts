@@ -0,0 +1,241 @@
+import { describe, test as it, expect } from "bun:test";
+import { optimizeBytecode } from "./peephole.ts";
+import { compilePEX } from "../vm/index.ts";
+import { VM, throwingEffectHandler } from "../vm/vm.ts";
+import type { EffectHandler } from "../vm/vm.ts";
+import { nullValue, numberValue, stringValue, booleanValue } from "../vm/values.ts";
+import type { Value } from "../vm/values.ts";
+import { Opcode, getInstructionSize } from "../bytecode/opcodes.ts";
+import type { BytecodeFile } from "../bytecode/format.ts";
+import { createEmptyBytecodeFile } from "../bytecode/format.ts";
+import { writeBytecode } from "../bytecode/writer.ts";
+import { readBytecode } from "../bytecode/reader.ts";
+
+/**
+ * List the opcodes of a function, in order.
+ */
+function opcodes(file: BytecodeFile, funcIndex: number = 0): Opcode[] {
+  const template = file.functionTemplates.templates[funcIndex]!;
+  const code = file.codeSection.code.subarray(
+    template.codeOffset,
+    template.codeOffset + template.codeLength
+  );
+  const result: Opcode[] = [];
+  let ip = 0;
+  while (ip < code.length) {
+    const opcode = code[ip] as Opcode;
+    result.push(opcode);
+    ip += getInstructionSize(opcode);
+  }
+  return result;
+}
+
+function run(
+  file: BytecodeFile,
+  input: Value = nullValue(),
+  handler: EffectHandler = throwingEffectHandler
+): { value: Value } | { error: string } {
+  try {
+    return { value: new VM(file, handler).run(input) };
+  } catch (error) {
+    return { error: (error as Error).message };
+  }
+}
+
+/**
+ * Build a single-function file from raw code.
+ */
+function fileWithCode(code: number[]): BytecodeFile {
+  const file = createEmptyBytecodeFile();
+  file.functionTemplates.templates = [
+    {
+      nameIndex: -1,
+      paramCount: 1,
+      localCount: 1,
+      upvalues: [],
+      codeOffset: 0,
+      codeLength: code.length,
+    },
+  ];
+  file.codeSection.code = new Uint8Array(code);
+  return file;
+}
+
+describe("Peephole Optimizer", () => {
+  describe("Patterns", () => {
+    it("keeps single-use pipeline values on the stack", () => {
+      const file = optimizeBytecode(compilePEX("$$ | lower | trim"));
+
+      expect(opcodes(file)).toEqual([
+        Opcode.LOAD_LOCAL_CALL_BUILTIN_U8,
+        Opcode.CALL_BUILTIN_U8_U8,
+        Opcode.RETURN,
+      ]);
+      expect(run(file, stringValue("  HeLLo  "))).toEqual({ value: stringValue("hello") });
+    });
+
+    it("fuses comparisons with the following conditional jump", () => {
+      const source = "fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 15)";
+      const file = optimizeBytecode(compilePEX(source));
+
+      expect(opcodes(file, 1)).toContain(Opcode.LT_JUMP_IF_FALSE_U8);
+      expect(opcodes(file, 1)).not.toContain(Opcode.LT);
+      expect(run(file)).toEqual({ value: numberValue(610) });
+    });
+
+    it("removes values that are pushed and immediately popped", () => {
+      const file = optimizeBytecode(compilePEX("fn: f (x) x; (f 1)"));
+
+      // The function definition's own value is discarded by the sequence
+      expect(opcodes(file)).not.toContain(Opcode.POP);
+      expect(run(file)).toEqual({ value: numberValue(1) });
+    });
+
+    it("uses TEE_LOCAL for locals that are read again", () => {
+      const file = optimizeBytecode(compilePEX('(and 1 "x")'));
+
+      expect(opcodes(file)).toContain(Opcode.TEE_LOCAL_U8);
+      expect(opcodes(file)).not.toContain(Opcode.STORE_LOCAL_U8);
+      expect(run(file)).toEqual({ value: stringValue("x") });
+    });
+
+    it("folds NOT into the conditional jump", () => {
+      const file = optimizeBytecode(compilePEX("(if (not $$) 1 2)"));
+
+      expect(opcodes(file)).not.toContain(Opcode.NOT);
+      expect(opcodes(file)).toContain(Opcode.JUMP_IF_TRUE_U8);
+      expect(run(file, booleanValue(false))).toEqual({ value: numberValue(1) });
+      expect(run(file, booleanValue(true))).toEqual({ value: numberValue(2) });
+    });
+
+    it("removes DUP/POP and SWAP/SWAP pairs", () => {
+      const file = optimizeBytecode(
+        fileWithCode([
+          Opcode.LOAD_LOCAL_U8, 0,
+          Opcode.DUP,
+          Opcode.POP,
+          Opcode.CONST_ONE,
+          Opcode.SWAP,
+          Opcode.SWAP,
+          Opcode.ADD,
+          Opcode.RETURN,
+        ])
+      );
+
+      expect(opcodes(file)).toEqual([
+        Opcode.LOAD_LOCAL_U8,
+        Opcode.CONST_ONE,
+        Opcode.ADD,
+        Opcode.RETURN,
+      ]);
+      expect(run(file, numberValue(41))).toEqual({ value: numberValue(42) });
+    });
+
+    it("keeps locals captured by closures", () => {
+      const source = "fn: make (start) (fn: add (n) (+ start n)) add; let: f (make 100); (f 42)";
+      const file = optimizeBytecode(compilePEX(source));
+
+      expect(run(file)).toEqual({ value: numberValue(142) });
+    });
+  });
+
+  describe("Jumps", () => {
+    it("relocates jumps into removed instructions", () => {
+      // if input: 1 else: (CONST_NULL; POP) 0
+      const file = optimizeBytecode(
+        fileWithCode([
+          Opcode.LOAD_LOCAL_U8, 0,
+          Opcode.JUMP_IF_FALSE_U8, 2,
+          Opcode.CONST_ONE,
+          Opcode.RETURN,
+          Opcode.CONST_NULL,
+          Opcode.POP,
+          Opcode.CONST_ZERO,
+          Opcode.RETURN,
+        ])
+      );
+
+      expect(opcodes(file)).not.toContain(Opcode.CONST_NULL);
+      expect(run(file, booleanValue(true))).toEqual({ value: numberValue(1) });
+      expect(run(file, booleanValue(false))).toEqual({ value: numberValue(0) });
+    });
+
+    it("does not rewrite a pair whose second instruction is a jump target", () => {
+      const code = [
+        Opcode.CONST_ONE,
+        Opcode.JUMP_U8, 1,
+        Opcode.CONST_NULL,
+        Opcode.POP, // jump target
+        Opcode.CONST_TRUE,
+        Opcode.RETURN,
+      ];
+      const file = optimizeBytecode(fileWithCode(code));
+
+      expect(Array.from(file.codeSection.code)).toEqual(code);
+    });
+
+    it("leaves functions with undecodable jumps unchanged", () => {
+      const code = [Opcode.JUMP_U8, 0x40, Opcode.CONST_NULL, Opcode.POP, Opcode.RETURN];
+      const file = optimizeBytecode(fileWithCode(code));
+
+      expect(Array.from(file.codeSection.code)).toEqual(code);
+    });
+  });
+
+  describe("Semantics", () => {
+    const programs: Array<[string, Value]> = [
+      ["(+ 10 20)", nullValue()],
+      ["$$ | split \" \" | (len $)", stringValue("hello world test")],
+      ["$$ | (* $ 2) | (+ $ $$)", numberValue(5)],
+      ["(if (== $$ 1) \"one\" (if (!= $$ 2) \"many\" \"two\"))", numberValue(2)],
+      ["(if (>= $$ 10) (if (<= $$ 20) \"mid\" \"high\") \"low\")", numberValue(15)],
+      ["(if (> $$ 0) (?? null $$) 0)", numberValue(3)],
+      ["(or 0 \"\")", nullValue()],
+      ["let: x (upper $$); let: y (lower $$); (join x y)", stringValue("Ab")],
+      ["fn: even (n) (if (== n 0) true (odd (- n 1))); fn: odd (n) (if (== n 0) false (even (- n 1))); (even 10)", nullValue()],
+      ["fn: f (x) (fn: g (y) (+ x y)) g; let: h (f 1); (h 2)", nullValue()],
+      ["(/ 10 $$)", numberValue(0)],
+      ["(< \"a\" $$)", stringValue("b")],
+      ["$$ | (len $)", numberValue(5)],
+    ];
+
+    for (const [source, input] of programs) {
+      it(`matches unoptimized bytecode: ${source}`, () => {
+        const bytecode = compilePEX(source);
+        expect(run(optimizeBytecode(bytecode), input)).toEqual(run(bytecode, input));
+      });
+    }
+
+    it("resumes effects in optimized code", () => {
+      const file = compilePEX("fn: f (x) (+ x (ask: x)); (f 3)", { optimize: true });
+      const handler: EffectHandler = (_name, args, continuation) => {
+        continuation.resume(numberValue((args[0] as { value: number }).value * 2));
+      };
+
+      expect(run(file, nullValue(), handler)).toEqual({ value: numberValue(9) });
+    });
+
+    it("does not modify its input", () => {
+      const bytecode = compilePEX("$$ | lower | trim");
+      const before = Array.from(bytecode.codeSection.code);
+      optimizeBytecode(bytecode);
+
+      expect(Array.from(bytecode.codeSection.code)).toEqual(before);
+    });
+
+    it("round-trips through the bytecode writer and reader", () => {
+      const file = compilePEX("fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 10)", {
+        optimize: true,
+      });
+
+      expect(run(readBytecode(writeBytecode(file)))).toEqual({ value: numberValue(55) });
+    });
+
+    it("is idempotent", () => {
+      const once = optimizeBytecode(compilePEX("$$ | lower | (if (== $ \"a\") 1 2)"));
+      const twice = optimizeBytecode(once);
+
+      expect(Array.from(twice.codeSection.code)).toEqual(Array.from(once.codeSection.code));
+    });
+  });
+});
@@ -0,0 +1,586 @@
+/**
+ * Peephole optimizer for PEX bytecode.
+ *
+ * An optional pass that runs after `generateBytecode()`. Each function's code
+ * is decoded into an instruction list, rewritten with a small set of local
+ * patterns until nothing changes, and re-encoded with jump offsets and
+ * function template offsets relocated.
+ *
+ * ## Patterns
+ *
+ * | Before | After |
+ * |--------|-------|
+ * | `DUP; POP`, `SWAP; SWAP` | (removed) |
+ * | `CONST_NULL/TRUE/FALSE/ZERO/ONE; POP` | (removed) |
+ * | `LOAD_LOCAL x; POP`, `LOAD_UPVALUE x; POP` | (removed) |
+ * | `STORE_LOCAL x; LOAD_LOCAL x` (x read nowhere else) | (removed) |
+ * | `STORE_LOCAL x; LOAD_LOCAL x` | `TEE_LOCAL x` |
+ * | `TEE_LOCAL x; POP` | `STORE_LOCAL x` |
+ * | `LOAD_LOCAL x; CALL_BUILTIN n argc` | `LOAD_LOCAL_CALL_BUILTIN x n argc` |
+ * | `LT; JUMP_IF_FALSE L` (and EQ/NE/GT/LE/GE) | `LT_JUMP_IF_FALSE L` |
+ * | `NOT; JUMP_IF_FALSE L` | `JUMP_IF_TRUE L` |
+ *
+ * Pipelines and let-bindings compile to `STORE_LOCAL x; LOAD_LOCAL x` for
+ * every stage. When the local is stored once, loaded once and not captured
+ * by a closure, the pair is dropped and the value simply stays on the stack,
+ * so `$$ | lower | trim` runs as back-to-back CALL_BUILTINs.
+ *
+ * A pair is only rewritten when its second instruction is not a jump target,
+ * so every path into the pair still sees the same stack effect. Jumps into a
+ * removed pair land on the instruction that follows it.
+ *
+ * Superinstructions only have u8 variants; pairs whose operands don't fit
+ * are left as they are.
+ *
+ * ## Usage
+ *
+ * ```typescript
+ * const bytecode = optimizeBytecode(generateBytecode(lowerProgram(ast)));
+ * ```
+ */
+
+import type {
+  BytecodeFile,
+  DebugInfo,
+  FunctionTemplate,
+} from "../bytecode/format.ts";
+import {
+  Opcode,
+  OPCODE_METADATA,
+  OperandType,
+  getOperandSize,
+  isValidOpcode,
+} from "../bytecode/opcodes.ts";
+
+// ============================================
+// Instruction List
+// ============================================
+
+/**
+ * A decoded instruction.
+ */
+interface PeepholeInstruction {
+  opcode: Opcode;
+  // Main operand; unused for jumps, which reference `target` instead
+  operand: number;
+  // Trailing u8 operands (e.g., CALL_BUILTIN arg count)
+  extra: number[];
+  target: PeepholeInstruction | null;
+  // Byte offset within the function (original, then re-encoded)
+  offset: number;
+  // Where jumps to this instruction land after it was removed or fused
+  forward: PeepholeInstruction | null;
+}
+
+const JUMP_OPCODES: ReadonlySet<Opcode> = new Set([
+  Opcode.JUMP_U8,
+  Opcode.JUMP_U16,
+  Opcode.JUMP_U32,
+  Opcode.JUMP_IF_FALSE_U8,
+  Opcode.JUMP_IF_FALSE_U16,
+  Opcode.JUMP_IF_FALSE_U32,
+  Opcode.JUMP_IF_TRUE_U8,
+  Opcode.JUMP_IF_TRUE_U16,
+  Opcode.JUMP_IF_TRUE_U32,
+  Opcode.EQ_JUMP_IF_FALSE_U8,
+  Opcode.NE_JUMP_IF_FALSE_U8,
+  Opcode.LT_JUMP_IF_FALSE_U8,
+  Opcode.GT_JUMP_IF_FALSE_U8,
+  Opcode.LE_JUMP_IF_FALSE_U8,
+  Opcode.GE_JUMP_IF_FALSE_U8,
+]);
+
+/**
+ * Instructions that only push a value and cannot fail, so `X; POP` is a no-op.
+ */
+const PURE_PUSH_OPCODES: ReadonlySet<Opcode> = new Set([
+  Opcode.DUP,
+  Opcode.CONST_NULL,
+  Opcode.CONST_TRUE,
+  Opcode.CONST_FALSE,
+  Opcode.CONST_ZERO,
+  Opcode.CONST_ONE,
+  Opcode.LOAD_LOCAL_U8,
+  Opcode.LOAD_LOCAL_U16,
+  Opcode.LOAD_LOCAL_U32,
+  Opcode.LOAD_UPVALUE_U8,
+  Opcode.LOAD_UPVALUE_U16,
+  Opcode.LOAD_UPVALUE_U32,
+]);
+
+const COMPARE_JUMP_OPCODES: Partial<Record<Opcode, Opcode>> = {
+  [Opcode.EQ]: Opcode.EQ_JUMP_IF_FALSE_U8,
+  [Opcode.NE]: Opcode.NE_JUMP_IF_FALSE_U8,
+  [Opcode.LT]: Opcode.LT_JUMP_IF_FALSE_U8,
+  [Opcode.GT]: Opcode.GT_JUMP_IF_FALSE_U8,
+  [Opcode.LE]: Opcode.LE_JUMP_IF_FALSE_U8,
+  [Opcode.GE]: Opcode.GE_JUMP_IF_FALSE_U8,
+};
+
+const NEGATED_JUMP_OPCODES: Partial<Record<Opcode, Opcode>> = {
+  [Opcode.JUMP_IF_FALSE_U8]: Opcode.JUMP_IF_TRUE_U8,
+  [Opcode.JUMP_IF_FALSE_U16]: Opcode.JUMP_IF_TRUE_U16,
+  [Opcode.JUMP_IF_FALSE_U32]: Opcode.JUMP_IF_TRUE_U32,
+  [Opcode.JUMP_IF_TRUE_U8]: Opcode.JUMP_IF_FALSE_U8,
+  [Opcode.JUMP_IF_TRUE_U16]: Opcode.JUMP_IF_FALSE_U16,
+  [Opcode.JUMP_IF_TRUE_U32]: Opcode.JUMP_IF_FALSE_U32,
+};
+
+function isStoreLocal(opcode: Opcode): boolean {
+  return (
+    opcode === Opcode.STORE_LOCAL_U8 ||
+    opcode === Opcode.STORE_LOCAL_U16 ||
+    opcode === Opcode.STORE_LOCAL_U32
+  );
+}
+
+function isLoadLocal(opcode: Opcode): boolean {
+  return (
+    opcode === Opcode.LOAD_LOCAL_U8 ||
+    opcode === Opcode.LOAD_LOCAL_U16 ||
+    opcode === Opcode.LOAD_LOCAL_U32
+  );
+}
+
+function isMakeClosure(opcode: Opcode): boolean {
+  return (
+    opcode === Opcode.MAKE_CLOSURE_U8 ||
+    opcode === Opcode.MAKE_CLOSURE_U16 ||
+    opcode === Opcode.MAKE_CLOSURE_U32
+  );
+}
+
+function instruction(
+  opcode: Opcode,
+  operand: number = 0,
+  extra: number[] = [],
+  target: PeepholeInstruction | null = null
+): PeepholeInstruction {
+  return { opcode, operand, extra, target, offset: 0, forward: null };
+}
+
+function instructionSize(opcode: Opcode): number {
+  const metadata = OPCODE_METADATA[opcode];
+  return 1 + getOperandSize(metadata.operandType) + (metadata.extraOperands ?? 0);
+}
+
+function resolve(instr: PeepholeInstruction): PeepholeInstruction {
+  let current = instr;
+  while (current.forward !== null) {
+    current = current.forward;
+  }
+  return current;
+}
+
+// ============================================
+// Optimization
+// ============================================
+
+/**
+ * Run the peephole optimizer over every function in a bytecode file.
+ * Returns a new file; the input is not modified.
+ */
+export function optimizeBytecode(file: BytecodeFile): BytecodeFile {
+  const templates = file.functionTemplates.templates;
+  const code = file.codeSection.code;
+
+  const chunks: Uint8Array[] = [];
+  const optimizedTemplates: FunctionTemplate[] = [];
+  const relocations: Array<(offset: number) => number | undefined> = [];
+  let codeOffset = 0;
+
+  for (const template of templates) {
+    const original = code.subarray(
+      template.codeOffset,
+      template.codeOffset + template.codeLength
+    );
+    const optimized = optimizeFunction(original, templates);
+    const functionCode = optimized?.code ?? original;
+    const start = codeOffset;
+
+    optimizedTemplates.push({
+      ...template,
+      codeOffset: start,
+      codeLength: functionCode.length,
+    });
+    relocations.push((offset) => {
+      const relative = offset - template.codeOffset;
+      if (relative < 0 || relative >= template.codeLength) {
+        return undefined;
+      }
+      if (!optimized) {
+        return start + relative;
+      }
+      const moved = optimized.relocate(relative);
+      return moved === undefined ? undefined : start + moved;
+    });
+
+    chunks.push(functionCode);
+    codeOffset += functionCode.length;
+  }
+
+  const optimizedCode = new Uint8Array(codeOffset);
+  let offset = 0;
+  for (const chunk of chunks) {
+    optimizedCode.set(chunk, offset);
+    offset += chunk.length;
+  }
+
+  const result: BytecodeFile = {
+    header: { ...file.header },
+    constantPool: file.constantPool,
+    nameTable: file.nameTable,
+    functionTemplates: { templates: optimizedTemplates },
+    codeSection: { code: optimizedCode },
+  };
+  if (file.debugInfo) {
+    result.debugInfo = relocateDebugInfo(file.debugInfo, relocations);
+  }
+  return result;
+}
+
+/**
+ * Optimize a single function's code.
+ * Returns null if the code can't be decoded, in which case it is kept as-is.
+ */
+function optimizeFunction(
+  code: Uint8Array,
+  templates: FunctionTemplate[]
+): { code: Uint8Array; relocate: (offset: number) => number | undefined } | null {
+  const decoded = decodeFunction(code);
+  if (decoded === null) {
+    return null;
+  }
+
+  // Keyed by original offset; encoding overwrites the offsets of survivors
+  const byOriginalOffset = new Map<number, PeepholeInstruction>();
+  for (const instr of decoded) {
+    byOriginalOffset.set(instr.offset, instr);
+  }
+
+  let instrs = decoded;
+  let changed = true;
+  while (changed) {
+    const pass = rewrite(instrs, templates);
+    instrs = pass.instrs;
+    changed = pass.changed;
+  }
+
+  const optimized = encodeFunction(instrs);
+  if (optimized === null) {
+    return null;
+  }
+
+  return {
+    code: optimized,
+    relocate: (offset) => {
+      const instr = byOriginalOffset.get(offset);
+      return instr === undefined ? undefined : resolve(instr).offset;
+    },
+  };
+}
+
+/**
+ * Decode a function's code into an instruction list with resolved jump targets.
+ */
+function decodeFunction(code: Uint8Array): PeepholeInstruction[] | null {
+  const instrs: PeepholeInstruction[] = [];
+  const jumpOffsets = new Map<PeepholeInstruction, number>();
+  let ip = 0;
+
+  while (ip < code.length) {
+    const opcode = code[ip]!;
+    if (!isValidOpcode(opcode)) {
+      return null;
+    }
+    const metadata = OPCODE_METADATA[opcode];
+    const size = instructionSize(opcode);
+    if (ip + size > code.length) {
+      return null;
+    }
+
+    let operand = 0;
+    switch (metadata.operandType) {
+      case OperandType.U8:
+        operand = code[ip + 1]!;
+        break;
+      case OperandType.U16:
+        operand = code[ip + 1]! | (code[ip + 2]! << 8);
+        break;
+      case OperandType.U32:
+        operand =
+          (code[ip + 1]! | (code[ip + 2]! << 8) | (code[ip + 3]! << 16) | (code[ip + 4]! << 24)) >>> 0;
+        break;
+      case OperandType.NONE:
+        break;
+    }
+
+    const extra: number[] = [];
+    const extraStart = ip + 1 + getOperandSize(metadata.operandType);
+    for (let i = 0; i < (metadata.extraOperands ?? 0); i++) {
+      extra.push(code[extraStart + i]!);
+    }
+
+    const instr = instruction(opcode, operand, extra);
+    instr.offset = ip;
+    instrs.push(instr);
+
+    if (JUMP_OPCODES.has(opcode)) {
+      jumpOffsets.set(instr, ip + size + signExtend(operand, metadata.operandType));
+    }
+    ip += size;
+  }
+
+  const byOffset = new Map<number, PeepholeInstruction>();
+  for (const instr of instrs) {
+    byOffset.set(instr.offset, instr);
+  }
+  for (const [instr, targetOffset] of jumpOffsets) {
+    const target = byOffset.get(targetOffset);
+    if (target === undefined) {
+      // Jumps outside the function or into an operand: leave the code alone
+      return null;
+    }
+    instr.target = target;
+  }
+
+  return instrs;
+}
+
+/**
+ * Run one rewriting pass over the instruction list.
+ */
+function rewrite(
+  instrs: PeepholeInstruction[],
+  templates: FunctionTemplate[]
+): { instrs: PeepholeInstruction[]; changed: boolean } {
+  const targets = new Set<PeepholeInstruction>();
+  for (const instr of instrs) {
+    if (instr.target !== null) {
+      targets.add(instr.target);
+    }
+  }
+  const locals = countLocalUses(instrs, templates);
+
+  const out: PeepholeInstruction[] = [];
+  const removed: PeepholeInstruction[] = [];
+  let changed = false;
+
+  const emit = (instr: PeepholeInstruction): void => {
+    for (const r of removed) {
+      r.forward = instr;
+    }
+    removed.length = 0;
+    out.push(instr);
+  };
+
+  let i = 0;
+  while (i < instrs.length) {
+    const a = instrs[i]!;
+    const b = instrs[i + 1];
+
+    // Only rewrite when something follows the pair, so removed instructions
+    // that are jump targets always have an instruction to forward to.
+    if (b !== undefined && i + 2 < instrs.length && !targets.has(b)) {
+      const replacement = rewritePair(a, b, locals);
+      if (replacement !== undefined) {
+        changed = true;
+        if (replacement === null) {
+          removed.push(a, b);
+        } else {
+          a.forward = replacement;
+          b.forward = replacement;
+          emit(replacement);
+        }
+        i += 2;
+        continue;
+      }
+    }
+
+    emit(a);
+    i++;
+  }
+
+  for (const instr of out) {
+    if (instr.target !== null) {
+      instr.target = resolve(instr.target);
+    }
+  }
+
+  return { instrs: out, changed };
+}
+
+interface LocalUses {
+  stores: Map<number, number>;
+  loads: Map<number, number>;
+  captured: Set<number>;
+}
+
+function countLocalUses(
+  instrs: PeepholeInstruction[],
+  templates: FunctionTemplate[]
+): LocalUses {
+  const uses: LocalUses = { stores: new Map(), loads: new Map(), captured: new Set() };
+  const bump = (map: Map<number, number>, index: number) =>
+    map.set(index, (map.get(index) ?? 0) + 1);
+
+  for (const instr of instrs) {
+    if (isStoreLocal(instr.opcode)) {
+      bump(uses.stores, instr.operand);
+    } else if (isLoadLocal(instr.opcode) || instr.opcode === Opcode.LOAD_LOCAL_CALL_BUILTIN_U8) {
+      bump(uses.loads, instr.operand);
+    } else if (instr.opcode === Opcode.TEE_LOCAL_U8) {
+      bump(uses.stores, instr.operand);
+      bump(uses.loads, instr.operand);
+    } else if (isMakeClosure(instr.opcode)) {
+      const template = templates[instr.operand];
+      for (const upvalue of template?.upvalues ?? []) {
+        if (upvalue.isLocal) {
+          uses.captured.add(upvalue.index);
+        }
+      }
+    }
+  }
+  return uses;
+}
+
+/**
+ * Match a pair of adjacent instructions.
+ * Returns the fused instruction, null to remove both, or undefined for no match.
+ */
+function rewritePair(
+  a: PeepholeInstruction,
+  b: PeepholeInstruction,
+  locals: LocalUses
+): PeepholeInstruction | null | undefined {
+  // Pushes whose value is immediately discarded
+  if (b.opcode === Opcode.POP && PURE_PUSH_OPCODES.has(a.opcode)) {
+    return null;
+  }
+
+  if (a.opcode === Opcode.SWAP && b.opcode === Opcode.SWAP) {
+    return null;
+  }
+
+  if (isStoreLocal(a.opcode) && isLoadLocal(b.opcode) && a.operand === b.operand) {
+    const index = a.operand;
+    if (
+      locals.stores.get(index) === 1 &&
+      locals.loads.get(index) === 1 &&
+      !locals.captured.has(index)
+    ) {
+      return null;
+    }
+    if (index <= 0xff) {
+      return instruction(Opcode.TEE_LOCAL_U8, index);
+    }
+    return undefined;
+  }
+
+  if (a.opcode === Opcode.TEE_LOCAL_U8 && b.opcode === Opcode.POP) {
+    return instruction(Opcode.STORE_LOCAL_U8, a.operand);
+  }
+
+  if (a.opcode === Opcode.LOAD_LOCAL_U8 && b.opcode === Opcode.CALL_BUILTIN_U8_U8) {
+    return instruction(Opcode.LOAD_LOCAL_CALL_BUILTIN_U8, a.operand, [b.operand, b.extra[0]!]);
+  }
+
+  const compareJump = COMPARE_JUMP_OPCODES[a.opcode];
+  if (compareJump !== undefined && b.opcode === Opcode.JUMP_IF_FALSE_U8) {
+    return instruction(compareJump, 0, [], b.target);
+  }
+
+  const negatedJump = NEGATED_JUMP_OPCODES[b.opcode];
+  if (a.opcode === Opcode.NOT && negatedJump !== undefined) {
+    return instruction(negatedJump, 0, [], b.target);
+  }
+
+  return undefined;
+}
+
+// ============================================
+// Encoding
+// ============================================
+
+/**
+ * Encode an instruction list, relocating jumps.
+ * Returns null if a jump offset no longer fits its operand.
+ */
+function encodeFunction(instrs: PeepholeInstruction[]): Uint8Array | null {
+  let length = 0;
+  for (const instr of instrs) {
+    instr.offset = length;
+    length += instructionSize(instr.opcode);
+  }
+
+  const code = new Uint8Array(length);
+  for (const instr of instrs) {
+    const metadata = OPCODE_METADATA[instr.opcode];
+    const size = instructionSize(instr.opcode);
+    let operand = instr.operand;
+
+    if (instr.target !== null) {
+      const relative = instr.target.offset - (instr.offset + size);
+      if (!fitsSigned(relative, metadata.operandType)) {
+        return null;
+      }
+      operand = relative;
+    }
+
+    let ip = instr.offset;
+    code[ip++] = instr.opcode;
+    const operandSize = getOperandSize(metadata.operandType);
+    for (let i = 0; i < operandSize; i++) {
+      code[ip++] = (operand >> (i * 8)) & 0xff;
+    }
+    for (const byte of instr.extra) {
+      code[ip++] = byte;
+    }
+  }
+
+  return code;
+}
+
+function signExtend(value: number, type: OperandType): number {
+  switch (type) {
+    case OperandType.U8:
+      return (value << 24) >> 24;
+    case OperandType.U16:
+      return (value << 16) >> 16;
+    default:
+      return value | 0;
+  }
+}
+
+function fitsSigned(value: number, type: OperandType): boolean {
+  switch (type) {
+    case OperandType.U8:
+      return value >= -0x80 && value <= 0x7f;
+    case OperandType.U16:
+      return value >= -0x8000 && value <= 0x7fff;
+    default:
+      return value >= -0x80000000 && value <= 0x7fffffff;
+  }
+}
+
+/**
+ * Move debug info byte offsets to the instructions that replaced them.
+ */
+function relocateDebugInfo(
+  debugInfo: DebugInfo,
+  relocations: Array<(offset: number) => number | undefined>
+): DebugInfo {
+  return {
+    functions: debugInfo.functions.map((func) => {
+      const relocate = relocations[func.functionIndex];
+      const instructions = [];
+      for (const info of func.instructions) {
+        const byteOffset = relocate?.(info.byteOffset);
+        if (byteOffset !== undefined) {
+          instructions.push({ ...info, byteOffset });
+        }
+      }
+      return { ...func, instructions };
+    }),
+  };
+}
@@ -278,6 +278,24 @@ describe("End-to-End Pipeline Tests", () => {
       `);
       expect(result).toEqual(numberValue(35)); // 10 + 20 + 5
     });
+
+    it("should close each returned frame's upvalues independently", () => {
+      const result = runPexProgram(`
+        fn: make (a b) (fn: sub (x) (- b a)) sub;
+        let: f (make 3 10);
+        let: g (make 2 1);
+        (+ (f 0) (g 0))
+      `);
+      expect(result).toEqual(numberValue(6)); // (10 - 3) + (1 - 2)
+    });
+
+    it("should capture a local at every recursion depth", () => {
+      const result = runPexProgram(`
+        fn: sum (n) (fn: k (x) (+ x n)) (if (<= n 0) 0 (k (sum (- n 1))));
+        (sum 50)
+      `);
+      expect(result).toEqual(numberValue(1275));
+    });
   });
 
   describe("Recursive Functions", () => {
@@ -328,6 +346,30 @@ describe("End-to-End Pipeline Tests", () => {
       `);
       expect(result).toEqual(booleanValue(true));
     });
+
+    it("should run tail recursion in constant frame space", () => {
+      const count = runPexProgram(`
+        fn: count (n acc) (if (<= n 0) acc (count (- n 1) (+ acc 1)));
+        (count 100000 0)
+      `);
+      expect(count).toEqual(numberValue(100000));
+
+      const parity = runPexProgram(`
+        fn: is_even (n) (if (== n 0) true (is_odd (- n 1)));
+        fn: is_odd (n) (if (== n 0) false (is_even (- n 1)));
+        (is_even 100001)
+      `);
+      expect(parity).toEqual(booleanValue(false));
+    });
+
+    it("should keep locals captured by a frame that tail-calls", () => {
+      const result = runPexProgram(`
+        fn: apply (g) (g);
+        fn: wrap (x) (fn: get () (* x 2)) (apply get);
+        (wrap 21)
+      `);
+      expect(result).toEqual(numberValue(42));
+    });
   });
 
   describe("Builtin Functions", () => {
@@ -11,20 +11,32 @@
 export {
   VM,
   VMError,
+  VMBudgetError,
   Continuation,
   throwingEffectHandler,
   runVM,
+  runVMBatch,
   executePEX,
   compilePEX,
   executeBytecode,
   createVM,
   VMRuntimeError,
+  VMProfiler,
 } from "./vm/index.ts";
 
 export type {
   EffectHandler,
+  BatchEffectHandler,
+  VMLimits,
   RunOptions,
+  CompileOptions,
   VMBuiltin,
+  VMProfileReport,
+  OpcodeProfile,
+  BuiltinProfile,
+  FunctionProfile,
+  LocationProfile,
+  HistogramBucket,
 } from "./vm/index.ts";
 
 // =============================================================================
@@ -53,6 +65,7 @@ export {
   stringValue,
   arrayValue,
   objectValue,
+  shapedObjectValue,
   regexValue,
   closureValue,
   continuationValue,
@@ -72,8 +85,15 @@ export {
   toBoolean,
   toNumber,
   toString,
+  valueFromJSON,
+  valueToJSON,
+  valueBytes,
+  getProperty,
+  objectEntries,
 } from "./vm/values.ts";
 
+export { Shape, MAX_TRANSITIONS, MAX_SHARED_KEYS, MAX_SHARED_SHAPES } from "./vm/shape.ts";
+
 // =============================================================================
 // Parser
 // =============================================================================
@@ -103,7 +123,9 @@ export type {
 // IR
 // =============================================================================
 
-export { lowerProgram } from "./ir/lower.ts";
+export { lowerProgram, lowerProgramToArena } from "./ir/lower.ts";
+export { IRArena, IRKind } from "./ir/arena.ts";
+export { optimizeIR } from "./ir/optimize.ts";
 export type { IRModule, IRExpr } from "./ir/types.ts";
 
 // =============================================================================
@@ -111,9 +133,17 @@ export type { IRModule, IRExpr } from "./ir/types.ts";
 // =============================================================================
 
 export { generateBytecode } from "./codegen/bytecode.ts";
+export { optimizeBytecode } from "./codegen/peephole.ts";
 
 // =============================================================================
 // Bytecode
 // =============================================================================
 
 export type { BytecodeFile } from "./bytecode/format.ts";
+export { writeBytecode, BytecodeWriterError } from "./bytecode/writer.ts";
+export {
+  readBytecode,
+  openBytecode,
+  LazyBytecodeFile,
+  BytecodeReadError,
+} from "./bytecode/reader.ts";
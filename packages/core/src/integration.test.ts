@@ -626,3 +626,64 @@ describe("Integration: Effects", () => {
     expect(result).toEqual(numberValue(52));
   });
 });
+
+describe("Integration: Batch Execution", () => {
+  function compile(source: string) {
+    return generateBytecode(lowerProgram(parse(source)));
+  }
+
+  it("runs a program over every input in order", () => {
+    const vm = new VM(compile("$$ | upper | trim"), throwingEffectHandler);
+    const results = vm.runBatch(["  a ", "b", " c"].map(stringValue));
+    expect(results).toEqual([stringValue("A"), stringValue("B"), stringValue("C")]);
+  });
+
+  it("matches individual runs", () => {
+    const source = "fn: sq (x) (* x x); (+ (sq $$) 1)";
+    const inputs = [0, 1, 2, 3, 10].map(numberValue);
+    const expected = inputs.map((input) => runProgram(source, input.value));
+    expect(new VM(compile(source), throwingEffectHandler).runBatch(inputs)).toEqual(expected);
+  });
+
+  it("delivers results to a callback", () => {
+    const seen: [Value, number][] = [];
+    const vm = new VM(compile("(* $$ 2)"), throwingEffectHandler);
+    const results = vm.runBatch([1, 2].map(numberValue), (result, index) => {
+      seen.push([result, index]);
+    });
+    expect(results).toEqual([]);
+    expect(seen).toEqual([
+      [numberValue(2), 0],
+      [numberValue(4), 1],
+    ]);
+  });
+
+  it("streams results lazily", () => {
+    function* inputs() {
+      yield stringValue("x");
+      yield stringValue("y");
+    }
+    const vm = new VM(compile("$$ | upper"), throwingEffectHandler);
+    expect([...vm.runEach(inputs())]).toEqual([stringValue("X"), stringValue("Y")]);
+  });
+
+  it("keeps returned closures independent across inputs", () => {
+    const vm = new VM(
+      compile("fn: adder (n) (fn: add (x) (+ x n)) add; (adder $$)"),
+      throwingEffectHandler
+    );
+    const [add1, add2] = vm.runBatch([numberValue(1), numberValue(2)]);
+    expect(add1!.type).toBe("closure");
+    if (add1!.type === "closure" && add2!.type === "closure") {
+      const [upvalue1, upvalue2] = [add1!.upvalues[0]!, add2!.upvalues[0]!];
+      expect([upvalue1.type, upvalue1.value]).toEqual(["closed", numberValue(1)]);
+      expect([upvalue2.type, upvalue2.value]).toEqual(["closed", numberValue(2)]);
+    }
+  });
+
+  it("recovers after an input fails", () => {
+    const vm = new VM(compile("(/ 10 $$)"), throwingEffectHandler);
+    expect(() => vm.runBatch([numberValue(2), numberValue(0)])).toThrow("Division by zero");
+    expect(vm.runBatch([numberValue(5)])).toEqual([numberValue(2)]);
+  });
+});
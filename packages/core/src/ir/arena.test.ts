@@ -0,0 +1,86 @@
+import { describe, test as it, expect } from "bun:test";
+import { IRArena, IRKind } from "./arena.ts";
+import { lowerProgram, lowerProgramToArena } from "./lower.ts";
+import { printModule } from "./print.ts";
+import { irConst, irVar, irLet, irCall, irFn, irModule } from "./types.ts";
+import { parse } from "../parser/index.ts";
+import { generateBytecode } from "../codegen/bytecode.ts";
+import { writeBytecode } from "../bytecode/writer.ts";
+import { VM, throwingEffectHandler } from "../vm/vm.ts";
+import { numberValue } from "../vm/values.ts";
+
+describe("IRArena", () => {
+  it("interns names", () => {
+    const arena = new IRArena();
+    const x = arena.intern("x");
+    expect(arena.intern("y")).not.toBe(x);
+    expect(arena.intern("x")).toBe(x);
+    expect(arena.names[x]).toBe("x");
+  });
+
+  it("stores nodes after their children", () => {
+    const arena = IRArena.fromModule(
+      irModule(irLet("x", irConst(1), irCall(irVar("+"), [irVar("x"), irConst(2)])))
+    );
+    expect(arena.kinds[arena.root]).toBe(IRKind.Let);
+    expect(arena.root).toBe(arena.size - 1);
+    for (let node = 0; node < arena.size; node++) {
+      if (arena.kinds[node] === IRKind.Let) {
+        expect(arena.op1[node]!).toBeLessThan(node);
+        expect(arena.op2[node]!).toBeLessThan(node);
+      }
+    }
+  });
+
+  it("round-trips IR trees", () => {
+    const module = irModule(
+      irLet("f", irFn(["a", "b"], irCall(irVar("+"), [irVar("a"), irVar("b")]), []), irVar("f"))
+    );
+    expect(printModule(IRArena.fromModule(module).toModule())).toBe(printModule(module));
+  });
+
+  it("grows past its initial capacity", () => {
+    const args = Array.from({ length: 500 }, (_, i) => irConst(i));
+    const module = irModule(irCall(irVar("join"), args));
+    expect(IRArena.fromModule(module).toModule()).toEqual(module);
+  });
+});
+
+describe("lowerProgramToArena", () => {
+  it("records captures across nested functions", () => {
+    const arena = lowerProgramToArena(
+      parse("let: t 3; fn: a (x) (fn: b (y) (fn: c (z) (+ x (+ y (+ z t))))); let: g (a 1); (g 2)")
+    );
+    const captures: string[][] = [];
+    for (let node = 0; node < arena.size; node++) {
+      if (arena.kinds[node] === IRKind.Fn) {
+        const list = arena.op2[node]!;
+        const names: string[] = [];
+        for (let i = 0; i < arena.listLength(list); i++) {
+          names.push(arena.names[arena.listItem(list, i)]!);
+        }
+        captures.push(names);
+      }
+    }
+    // Innermost function first
+    expect(captures).toEqual([["t", "x", "y"], ["t", "x"], ["t"]]);
+  });
+
+  it("compiles to the same bytecode as the IR tree", () => {
+    const source = "fn: add (x) (+ x $$); let: y ($$ | (add $) | (and $ (or $ 1))); (add y)";
+    const ast = parse(source);
+    expect(writeBytecode(generateBytecode(lowerProgramToArena(ast))))
+      .toEqual(writeBytecode(generateBytecode(lowerProgram(ast))));
+  });
+
+  it("lowers programs with many top-level bindings", () => {
+    const lines: string[] = [];
+    // Each binding is a local of the main function, which the VM stack bounds
+    for (let i = 0; i < 5000; i++) {
+      lines.push(`let: v${i} (+ $$ ${i})`);
+    }
+    lines.push("(+ v0 v4999)");
+    const vm = new VM(generateBytecode(lowerProgramToArena(parse(lines.join(";\n")))), throwingEffectHandler);
+    expect(vm.run(numberValue(1))).toEqual(numberValue(5001));
+  });
+});
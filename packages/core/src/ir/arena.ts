@@ -0,0 +1,277 @@
+/**
+ * Flat IR arena
+ *
+ * Stores an IR program as parallel typed arrays instead of a tree of
+ * objects. A node is an index into the arrays; its children are indices of
+ * other nodes, and every name is interned to a numeric ID. Lowering builds
+ * an arena directly and codegen compiles from one, so large generated
+ * programs do not pay for an object per node.
+ *
+ * Node layout (`op0`, `op1`, `op2` per kind):
+ *
+ * | Kind   | op0            | op1        | op2           |
+ * |--------|----------------|------------|---------------|
+ * | Const  | constant index |            |               |
+ * | Var    | name ID        |            |               |
+ * | If     | cond node      | then node  | else node     |
+ * | Let    | name ID        | value node | body node     |
+ * | Seq    | expr list      |            |               |
+ * | Call   | func node      | arg list   |               |
+ * | Fn     | param list     | body node  | capture list  |
+ * | Effect | name ID        | arg list   |               |
+ *
+ * Lists live in a shared `lists` array: a list is the offset of its length,
+ * followed by that many node indices (or name IDs, for params and captures).
+ *
+ * Nodes are appended after their children, so the nodes of any subtree
+ * occupy a contiguous range ending at its root.
+ */
+
+import type { ConstValue, IRExpr, IRModule } from "./types.ts";
+import {
+  irConst,
+  irVar,
+  irIf,
+  irLet,
+  irSeq,
+  irCall,
+  irFn,
+  irEffect,
+  irModule,
+} from "./types.ts";
+
+/**
+ * Node kinds, stored in `IRArena.kinds`
+ */
+export enum IRKind {
+  Const = 0,
+  Var = 1,
+  If = 2,
+  Let = 3,
+  Seq = 4,
+  Call = 5,
+  Fn = 6,
+  Effect = 7,
+}
+
+const INITIAL_CAPACITY = 64;
+
+export class IRArena {
+  kinds: Uint8Array = new Uint8Array(INITIAL_CAPACITY);
+  op0: Int32Array = new Int32Array(INITIAL_CAPACITY);
+  op1: Int32Array = new Int32Array(INITIAL_CAPACITY);
+  op2: Int32Array = new Int32Array(INITIAL_CAPACITY);
+  lists: Int32Array = new Int32Array(INITIAL_CAPACITY);
+
+  /** Number of nodes */
+  size = 0;
+  /** Used length of `lists` */
+  listSize = 0;
+  /** Root node of the program, or -1 while it is being built */
+  root = -1;
+
+  /** Interned names, indexed by name ID */
+  readonly names: string[] = [];
+  /** Constant values, indexed by constant index */
+  readonly constants: ConstValue[] = [];
+
+  private readonly nameIds: Map<string, number> = new Map();
+
+  /**
+   * Intern a name, returning its ID
+   */
+  intern(name: string): number {
+    let id = this.nameIds.get(name);
+    if (id === undefined) {
+      id = this.names.length;
+      this.names.push(name);
+      this.nameIds.set(name, id);
+    }
+    return id;
+  }
+
+  addConst(value: ConstValue): number {
+    this.constants.push(value);
+    return this.addNode(IRKind.Const, this.constants.length - 1, 0, 0);
+  }
+
+  addVar(nameId: number): number {
+    return this.addNode(IRKind.Var, nameId, 0, 0);
+  }
+
+  addIf(cond: number, thenBranch: number, elseBranch: number): number {
+    return this.addNode(IRKind.If, cond, thenBranch, elseBranch);
+  }
+
+  addLet(nameId: number, value: number, body: number): number {
+    return this.addNode(IRKind.Let, nameId, value, body);
+  }
+
+  /**
+   * @param exprs Expression nodes, read from index `from` to the end
+   */
+  addSeq(exprs: ArrayLike<number>, from: number = 0): number {
+    return this.addNode(IRKind.Seq, this.addList(exprs, from), 0, 0);
+  }
+
+  /**
+   * @param args Argument nodes, read from index `from` to the end
+   */
+  addCall(func: number, args: ArrayLike<number>, from: number = 0): number {
+    return this.addNode(IRKind.Call, func, this.addList(args, from), 0);
+  }
+
+  /**
+   * @param params Parameter name IDs
+   * @param captures Captured name IDs
+   */
+  addFn(params: ArrayLike<number>, body: number, captures: ArrayLike<number>): number {
+    return this.addNode(IRKind.Fn, this.addList(params, 0), body, this.addList(captures, 0));
+  }
+
+  /**
+   * @param args Argument nodes, read from index `from` to the end
+   */
+  addEffect(nameId: number, args: ArrayLike<number>, from: number = 0): number {
+    return this.addNode(IRKind.Effect, nameId, this.addList(args, from), 0);
+  }
+
+  listLength(list: number): number {
+    return this.lists[list]!;
+  }
+
+  listItem(list: number, index: number): number {
+    return this.lists[list + 1 + index]!;
+  }
+
+  /**
+   * Materialize the program as an IR tree
+   */
+  toModule(): IRModule {
+    return irModule(this.toExpr(this.root));
+  }
+
+  /**
+   * Materialize one node and its subtree as an IR tree
+   */
+  toExpr(node: number): IRExpr {
+    const a = this.op0[node]!;
+    const b = this.op1[node]!;
+    const c = this.op2[node]!;
+
+    switch (this.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return irConst(this.constants[a]!);
+      case IRKind.Var:
+        return irVar(this.names[a]!);
+      case IRKind.If:
+        return irIf(this.toExpr(a), this.toExpr(b), this.toExpr(c));
+      case IRKind.Let:
+        return irLet(this.names[a]!, this.toExpr(b), this.toExpr(c));
+      case IRKind.Seq:
+        return irSeq(this.mapList(a, (item) => this.toExpr(item)));
+      case IRKind.Call:
+        return irCall(this.toExpr(a), this.mapList(b, (item) => this.toExpr(item)));
+      case IRKind.Fn:
+        return irFn(
+          this.mapList(a, (id) => this.names[id]!),
+          this.toExpr(b),
+          this.mapList(c, (id) => this.names[id]!)
+        );
+      case IRKind.Effect:
+        return irEffect(this.names[a]!, this.mapList(b, (item) => this.toExpr(item)));
+    }
+  }
+
+  /**
+   * Build an arena from an IR tree
+   */
+  static fromModule(module: IRModule): IRArena {
+    const arena = new IRArena();
+    arena.root = arena.fromExpr(module.body);
+    return arena;
+  }
+
+  private fromExpr(expr: IRExpr): number {
+    switch (expr.type) {
+      case "const":
+        return this.addConst(expr.value);
+      case "var":
+        return this.addVar(this.intern(expr.name));
+      case "if": {
+        const cond = this.fromExpr(expr.cond);
+        const thenBranch = this.fromExpr(expr.thenBranch);
+        return this.addIf(cond, thenBranch, this.fromExpr(expr.else));
+      }
+      case "let": {
+        const value = this.fromExpr(expr.value);
+        return this.addLet(this.intern(expr.name), value, this.fromExpr(expr.body));
+      }
+      case "seq":
+        return this.addSeq(expr.exprs.map((e) => this.fromExpr(e)));
+      case "call": {
+        const func = this.fromExpr(expr.func);
+        return this.addCall(func, expr.args.map((arg) => this.fromExpr(arg)));
+      }
+      case "fn": {
+        const params = expr.params.map((param) => this.intern(param));
+        const body = this.fromExpr(expr.body);
+        return this.addFn(params, body, expr.captures.map((name) => this.intern(name)));
+      }
+      case "effect": {
+        const args = expr.args.map((arg) => this.fromExpr(arg));
+        return this.addEffect(this.intern(expr.name), args);
+      }
+    }
+  }
+
+  private mapList<T>(list: number, f: (item: number) => T): T[] {
+    const length = this.lists[list]!;
+    const result: T[] = new Array(length);
+    for (let i = 0; i < length; i++) {
+      result[i] = f(this.lists[list + 1 + i]!);
+    }
+    return result;
+  }
+
+  private addNode(kind: IRKind, a: number, b: number, c: number): number {
+    const node = this.size;
+    if (node === this.kinds.length) {
+      const capacity = node * 2;
+      this.kinds = grow(this.kinds, new Uint8Array(capacity));
+      this.op0 = grow(this.op0, new Int32Array(capacity));
+      this.op1 = grow(this.op1, new Int32Array(capacity));
+      this.op2 = grow(this.op2, new Int32Array(capacity));
+    }
+    this.kinds[node] = kind;
+    this.op0[node] = a;
+    this.op1[node] = b;
+    this.op2[node] = c;
+    this.size++;
+    return node;
+  }
+
+  private addList(items: ArrayLike<number>, from: number): number {
+    const length = items.length - from;
+    const list = this.listSize;
+    const needed = list + 1 + length;
+    if (needed > this.lists.length) {
+      let capacity = this.lists.length * 2;
+      while (capacity < needed) {
+        capacity *= 2;
+      }
+      this.lists = grow(this.lists, new Int32Array(capacity));
+    }
+    this.lists[list] = length;
+    for (let i = 0; i < length; i++) {
+      this.lists[list + 1 + i] = items[from + i]!;
+    }
+    this.listSize = needed;
+    return list;
+  }
+}
+
+function grow<T extends Uint8Array | Int32Array>(from: T, to: T): T {
+  to.set(from);
+  return to;
+}
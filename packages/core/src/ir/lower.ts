@@ -23,18 +23,8 @@ import {
   isArrayRef,
   getArrayIndex,
 } from "../parser/ast.ts";
-import type { IRExpr, IRModule, ConstValue } from "./types.ts";
-import {
-  irConst,
-  irVar,
-  irIf,
-  irLet,
-  irSeq,
-  irCall,
-  irFn,
-  irEffect,
-  irModule,
-} from "./types.ts";
+import type { IRModule, ConstValue } from "./types.ts";
+import { IRArena } from "./arena.ts";
 
 /**
  * Error thrown during AST → IR lowering
@@ -47,59 +37,121 @@ export class LoweringError extends Error {
 }
 
 /**
- * Lowering context tracks scope and pipeline values during transformation
+ * A function whose body is being lowered
  */
-interface LoweringContext {
-  // Current scope for tracking available variables
-  scope: Set<string>;
-  // Current pipeline value ($ reference) - undefined means not in a pipeline
-  pipelineValue?: IRExpr;
+interface FunctionScope {
+  // Number of enclosing bindings when the function was entered
+  level: number;
+  // Name IDs of free variables referenced so far
+  captures: Set<number>;
 }
 
 /**
- * Create a fresh lowering context
+ * Lowering context tracks scope and pipeline values during transformation.
+ *
+ * Scopes are a single stack of bindings rather than a copied set per scope:
+ * entering a scope pushes names and leaving it pops them. Each name ID keeps
+ * its innermost binding, so a variable reference can tell which enclosing
+ * functions it is free in and record their captures as it is lowered.
  */
-function createContext(): LoweringContext {
-  return {
-    scope: new Set(),
-  };
-}
+class LoweringContext {
+  readonly arena = new IRArena();
+
+  // Bound name IDs, the function depth each was bound at, and the binding
+  // each one shadows (-1 if none)
+  private readonly bindings: number[] = [];
+  private readonly bindingDepths: number[] = [];
+  private readonly shadowed: number[] = [];
+  // Name ID -> index of its innermost binding, or -1
+  private readonly innermost: number[] = [];
+
+  private readonly functions: FunctionScope[] = [];
+
+  // Name ID of the current pipeline value ($), or -1 outside a pipeline
+  pipelineValue = -1;
+
+  // Scratch stack for child lists; each caller pushes above its own mark
+  readonly scratch: number[] = [];
+
+  bind(nameId: number): void {
+    this.shadowed.push(this.innermost[nameId] ?? -1);
+    this.innermost[nameId] = this.bindings.length;
+    this.bindings.push(nameId);
+    this.bindingDepths.push(this.functions.length);
+  }
 
-/**
- * Extend context with new scope
- */
-function extendContext(ctx: LoweringContext, names: string[]): LoweringContext {
-  const newScope = new Set(ctx.scope);
-  for (const name of names) {
-    newScope.add(name);
-  }
-  return {
-    scope: newScope,
-    pipelineValue: ctx.pipelineValue,
-  };
+  /**
+   * Pop the `count` most recent bindings
+   */
+  unbind(count: number): void {
+    for (let i = 0; i < count; i++) {
+      this.innermost[this.bindings.pop()!] = this.shadowed.pop()!;
+      this.bindingDepths.pop();
+    }
+  }
+
+  enterFunction(params: number[]): void {
+    this.functions.push({ level: this.bindings.length, captures: new Set() });
+    for (const param of params) {
+      this.bind(param);
+    }
+  }
+
+  /**
+   * Leave the current function, returning its captures sorted by name
+   */
+  exitFunction(): number[] {
+    const scope = this.functions.pop()!;
+    this.unbind(this.bindings.length - scope.level);
+    const names = this.arena.names;
+    return Array.from(scope.captures).sort((a, b) =>
+      names[a]! < names[b]! ? -1 : names[a]! > names[b]! ? 1 : 0
+    );
+  }
+
+  /**
+   * Emit a variable reference, recording it as a capture of every function
+   * between the reference and the variable's binding
+   */
+  variable(nameId: number): number {
+    const binding = this.innermost[nameId] ?? -1;
+    if (binding >= 0) {
+      const depth = this.bindingDepths[binding]!;
+      // A function that already captures the name was reached through the
+      // same binding, so every function outside it captures it too
+      for (let i = this.functions.length - 1; i >= depth; i--) {
+        const captures = this.functions[i]!.captures;
+        if (captures.has(nameId)) {
+          break;
+        }
+        captures.add(nameId);
+      }
+    }
+    return this.arena.addVar(nameId);
+  }
+
+  variableNamed(name: string): number {
+    return this.variable(this.arena.intern(name));
+  }
 }
 
 /**
- * Set pipeline value in context
+ * Lower a complete program to IR module
  */
-function withPipelineValue(ctx: LoweringContext, value: IRExpr): LoweringContext {
-  return {
-    ...ctx,
-    pipelineValue: value,
-  };
+export function lowerProgram(program: Program): IRModule {
+  return lowerProgramToArena(program).toModule();
 }
 
 /**
- * Lower a complete program to IR module
+ * Lower a complete program to a flat IR arena
  */
-export function lowerProgram(program: Program): IRModule {
-  const ctx = createContext();
+export function lowerProgramToArena(program: Program): IRArena {
+  const ctx = new LoweringContext();
   // Add "input" to scope as it's the program input ($$)
-  ctx.scope.add("input");
+  ctx.bind(ctx.arena.intern("input"));
 
   // Pre-scan to collect all top-level fn: and let: names for mutual recursion support
   // This allows functions to reference each other regardless of definition order
-  let currentCtx = ctx;
   for (const expr of program.expressions) {
     if (isList(expr) && expr.elements.length > 1) {
       const first = expr.elements[0]!;
@@ -108,8 +160,7 @@ export function lowerProgram(program: Program): IRModule {
         if (effectName === "let" || effectName === "fn") {
           const nameExpr = expr.elements[1]!;
           if (isIdentifier(nameExpr)) {
-            const name = nameExpr.value as string;
-            currentCtx = extendContext(currentCtx, [name]);
+            ctx.bind(ctx.arena.intern(nameExpr.value as string));
           }
         }
       }
@@ -117,22 +168,20 @@ export function lowerProgram(program: Program): IRModule {
   }
 
   // Lower all expressions with the complete scope
-  const exprs: IRExpr[] = [];
+  const exprs: number[] = [];
   for (const expr of program.expressions) {
-    const lowered = lowerExpression(expr, currentCtx);
-    exprs.push(lowered);
+    exprs.push(lowerExpression(expr, ctx));
   }
 
   // If single expression, use it directly; otherwise wrap in seq
-  const body = exprs.length === 1 ? exprs[0]! : irSeq(exprs);
-
-  return irModule(body);
+  ctx.arena.root = exprs.length === 1 ? exprs[0]! : ctx.arena.addSeq(exprs);
+  return ctx.arena;
 }
 
 /**
  * Lower a single expression
  */
-function lowerExpression(expr: SExpr, ctx: LoweringContext): IRExpr {
+function lowerExpression(expr: SExpr, ctx: LoweringContext): number {
   if (isAtom(expr)) {
     return lowerAtom(expr, ctx);
   }
@@ -151,7 +200,7 @@ function lowerExpression(expr: SExpr, ctx: LoweringContext): IRExpr {
 /**
  * Lower an atom (literal or identifier)
  */
-function lowerAtom(atom: Atom, ctx: LoweringContext): IRExpr {
+function lowerAtom(atom: Atom, ctx: LoweringContext): number {
   // Use switch on atomType to satisfy TypeScript
   switch (atom.atomType) {
     case "null":
@@ -159,22 +208,22 @@ function lowerAtom(atom: Atom, ctx: LoweringContext): IRExpr {
     case "number":
     case "string":
     case "regex":
-      return lowerLiteral(atom);
+      return lowerLiteral(atom, ctx);
 
     case "identifier": {
       const name = String(atom.value);
 
       // Handle $$ (program input) → (var input)
       if (isProgramInput(atom)) {
-        return irVar("input");
+        return ctx.variableNamed("input");
       }
 
       // Handle $ (pipeline value)
       if (isPipelineRef(atom)) {
-        if (!ctx.pipelineValue) {
+        if (ctx.pipelineValue < 0) {
           throw new LoweringError("Pipeline reference $ used outside of pipeline");
         }
-        return ctx.pipelineValue;
+        return ctx.variable(ctx.pipelineValue);
       }
 
       // Handle $N (array reference) → (call get input N)
@@ -183,11 +232,13 @@ function lowerAtom(atom: Atom, ctx: LoweringContext): IRExpr {
         if (index === undefined) {
           throw new LoweringError(`Invalid array reference: ${name}`);
         }
-        return irCall(irVar("get"), [irVar("input"), irConst(index)]);
+        const func = ctx.variableNamed("get");
+        const input = ctx.variableNamed("input");
+        return ctx.arena.addCall(func, [input, ctx.arena.addConst(index)]);
       }
 
       // Regular variable reference
-      return irVar(name);
+      return ctx.variableNamed(name);
     }
 
     case "effect":
@@ -204,7 +255,7 @@ function lowerAtom(atom: Atom, ctx: LoweringContext): IRExpr {
 /**
  * Lower a literal value
  */
-function lowerLiteral(atom: Atom): IRExpr {
+function lowerLiteral(atom: Atom, ctx: LoweringContext): number {
   let value: ConstValue;
 
   switch (atom.atomType) {
@@ -229,13 +280,13 @@ function lowerLiteral(atom: Atom): IRExpr {
       throw new LoweringError(`Unknown literal type: ${atom.atomType}`);
   }
 
-  return irConst(value);
+  return ctx.arena.addConst(value);
 }
 
 /**
  * Lower a list (function call, special form, or effect)
  */
-function lowerList(list: List, ctx: LoweringContext): IRExpr {
+function lowerList(list: List, ctx: LoweringContext): number {
   if (list.elements.length === 0) {
     throw new LoweringError("Cannot lower empty list");
   }
@@ -292,7 +343,7 @@ function lowerList(list: List, ctx: LoweringContext): IRExpr {
  * Example: $$ | lower | trim
  * Becomes: (call trim (call lower input))
  */
-function lowerPipeline(pipeline: Pipeline, ctx: LoweringContext): IRExpr {
+function lowerPipeline(pipeline: Pipeline, ctx: LoweringContext): number {
   if (pipeline.stages.length === 0) {
     throw new LoweringError("Pipeline cannot be empty");
   }
@@ -307,15 +358,16 @@ function lowerPipeline(pipeline: Pipeline, ctx: LoweringContext): IRExpr {
   // Process remaining stages
   for (let i = 1; i < pipeline.stages.length; i++) {
     const stage = pipeline.stages[i]!;
-    const temp = genTemp();
+    const temp = ctx.arena.intern(genTemp());
 
     // Create a let binding for the current pipeline value
     // This allows $ references in the stage to refer to the current value
-    const stageCtx = extendContext(ctx, [temp]);
-    const stageCtxWithPipe = withPipelineValue(stageCtx, irVar(temp));
+    const outerPipelineValue = ctx.pipelineValue;
+    ctx.bind(temp);
+    ctx.pipelineValue = temp;
 
     // Lower the stage with pipeline context
-    let stageExpr: IRExpr;
+    let stageExpr: number;
 
     if (isList(stage)) {
       // Check if stage contains $ reference
@@ -323,7 +375,7 @@ function lowerPipeline(pipeline: Pipeline, ctx: LoweringContext): IRExpr {
 
       if (containsPipelineRef) {
         // Stage explicitly uses $, just lower it
-        stageExpr = lowerList(stage, stageCtxWithPipe);
+        stageExpr = lowerList(stage, ctx);
       } else {
         // No $ present, inject pipeline value as first argument
         const func = stage.elements[0]!;
@@ -339,25 +391,29 @@ function lowerPipeline(pipeline: Pipeline, ctx: LoweringContext): IRExpr {
           ],
         };
 
-        stageExpr = lowerList(modifiedList, stageCtxWithPipe);
+        stageExpr = lowerList(modifiedList, ctx);
       }
     } else if (isIdentifier(stage)) {
       // Bare identifier: auto-call with pipeline value
       const name = stage.value as string;
       if (isProgramInput(stage) || isPipelineRef(stage) || isArrayRef(stage)) {
         // Source refs just evaluate to their value
-        stageExpr = lowerAtom(stage, stageCtxWithPipe);
+        stageExpr = lowerAtom(stage, ctx);
       } else {
         // Regular identifier: call with pipeline value
-        stageExpr = irCall(irVar(name), [irVar(temp)]);
+        const func = ctx.variableNamed(name);
+        stageExpr = ctx.arena.addCall(func, [ctx.variable(temp)]);
       }
     } else {
       // Other expressions (literals, nested pipelines): just evaluate
-      stageExpr = lowerExpression(stage, stageCtxWithPipe);
+      stageExpr = lowerExpression(stage, ctx);
     }
 
+    ctx.pipelineValue = outerPipelineValue;
+    ctx.unbind(1);
+
     // Wrap in let binding
-    currentExpr = irLet(temp, currentExpr, stageExpr);
+    currentExpr = ctx.arena.addLet(temp, currentExpr, stageExpr);
   }
 
   return currentExpr;
@@ -387,7 +443,7 @@ function containsPipelineRefInExpr(expr: SExpr): boolean {
  * We handle this by having the program-level lowering wrap multiple
  * expressions in a sequence, and let: returns its value.
  */
-function lowerLetEffect(args: SExpr[], ctx: LoweringContext): IRExpr {
+function lowerLetEffect(args: SExpr[], ctx: LoweringContext): number {
   if (args.length !== 2 && args.length !== 3) {
     throw new LoweringError(`let: expects 2 or 3 arguments, got ${args.length}`);
   }
@@ -397,25 +453,26 @@ function lowerLetEffect(args: SExpr[], ctx: LoweringContext): IRExpr {
     throw new LoweringError("let: first argument must be an identifier");
   }
 
-  const name = nameExpr.value as string;
+  const name = ctx.arena.intern(nameExpr.value as string);
   const valueExpr = lowerExpression(args[1]!, ctx);
 
-  // Create a new scope that includes this binding
-  const bodyCtx = { ...ctx, scope: new Set([...ctx.scope, name]) };
+  // The body is lowered in a scope that includes this binding
+  ctx.bind(name);
 
   // If body is provided, use it; otherwise, return the value
   const bodyExpr = args.length === 3
-    ? lowerExpression(args[2]!, bodyCtx)
-    : irVar(name);
+    ? lowerExpression(args[2]!, ctx)
+    : ctx.variable(name);
 
-  return irLet(name, valueExpr, bodyExpr);
+  ctx.unbind(1);
+  return ctx.arena.addLet(name, valueExpr, bodyExpr);
 }
 
 /**
  * Lower fn: effect to IR let with fn value
  * (fn: f (x) body) → (let f (fn (x) body) (var f))
  */
-function lowerFnEffect(args: SExpr[], ctx: LoweringContext): IRExpr {
+function lowerFnEffect(args: SExpr[], ctx: LoweringContext): number {
   if (args.length < 3) {
     throw new LoweringError(`fn: expects at least 3 arguments, got ${args.length}`);
   }
@@ -425,7 +482,7 @@ function lowerFnEffect(args: SExpr[], ctx: LoweringContext): IRExpr {
     throw new LoweringError("fn: first argument must be an identifier");
   }
 
-  const name = nameExpr.value as string;
+  const name = ctx.arena.intern(nameExpr.value as string);
 
   const paramsExpr = args[1]!;
   if (!isList(paramsExpr)) {
@@ -433,46 +490,56 @@ function lowerFnEffect(args: SExpr[], ctx: LoweringContext): IRExpr {
   }
 
   // Extract parameter names
-  const params: string[] = [];
+  const params: number[] = [];
   for (const param of paramsExpr.elements) {
     if (!isIdentifier(param)) {
       throw new LoweringError("fn: parameters must be identifiers");
     }
-    params.push((param as Atom).value as string);
+    params.push(ctx.arena.intern((param as Atom).value as string));
   }
 
   // Lower body (may be multiple expressions)
-  const bodyExprs = args.slice(2);
-  const bodyCtx = extendContext(ctx, params);
-  const loweredBodies = bodyExprs.map((expr) => lowerExpression(expr, bodyCtx));
+  // Captures are collected while the body is lowered
+  ctx.enterFunction(params);
+  const mark = ctx.scratch.length;
+  for (let i = 2; i < args.length; i++) {
+    ctx.scratch.push(lowerExpression(args[i]!, ctx));
+  }
 
   // Wrap multiple expressions in seq
-  const body = loweredBodies.length === 1 ? loweredBodies[0]! : irSeq(loweredBodies);
-
-  // Analyze captures
-  const captures = analyzeCaptures(body, new Set(params), ctx.scope);
+  const body = args.length === 3 ? ctx.scratch[mark]! : ctx.arena.addSeq(ctx.scratch, mark);
+  ctx.scratch.length = mark;
+  const captures = ctx.exitFunction();
 
   // Create function
-  const fnExpr = irFn(params, body, captures);
+  const fnExpr = ctx.arena.addFn(params, body, captures);
 
   // Return let that binds the function and returns it
-  return irLet(name, fnExpr, irVar(name));
+  ctx.bind(name);
+  const result = ctx.variable(name);
+  ctx.unbind(1);
+  return ctx.arena.addLet(name, fnExpr, result);
 }
 
 /**
  * Lower an effect to IR effect node
  * (print: x y) → (effect "print" x y)
  */
-function lowerEffect(name: string, args: SExpr[], ctx: LoweringContext): IRExpr {
-  const loweredArgs = args.map((arg) => lowerExpression(arg, ctx));
-  return irEffect(name, loweredArgs);
+function lowerEffect(name: string, args: SExpr[], ctx: LoweringContext): number {
+  const mark = ctx.scratch.length;
+  for (const arg of args) {
+    ctx.scratch.push(lowerExpression(arg, ctx));
+  }
+  const effect = ctx.arena.addEffect(ctx.arena.intern(name), ctx.scratch, mark);
+  ctx.scratch.length = mark;
+  return effect;
 }
 
 /**
  * Lower if special form
  * (if cond then else) → (if cond then else)
  */
-function lowerIf(args: SExpr[], ctx: LoweringContext): IRExpr {
+function lowerIf(args: SExpr[], ctx: LoweringContext): number {
   if (args.length !== 3) {
     throw new LoweringError(`if expects 3 arguments, got ${args.length}`);
   }
@@ -481,131 +548,67 @@ function lowerIf(args: SExpr[], ctx: LoweringContext): IRExpr {
   const thenExpr = lowerExpression(args[1]!, ctx);
   const elseExpr = lowerExpression(args[2]!, ctx);
 
-  return irIf(cond, thenExpr, elseExpr);
+  return ctx.arena.addIf(cond, thenExpr, elseExpr);
 }
 
 /**
  * Lower and special form with short-circuit evaluation
  * (and a b) → (let $t a (if $t b $t))
  */
-function lowerAnd(args: SExpr[], ctx: LoweringContext): IRExpr {
+function lowerAnd(args: SExpr[], ctx: LoweringContext): number {
   if (args.length !== 2) {
     throw new LoweringError(`and expects 2 arguments, got ${args.length}`);
   }
 
   const first = lowerExpression(args[0]!, ctx);
-  const temp = "$and_temp";
-  const tempCtx = extendContext(ctx, [temp]);
-  const second = lowerExpression(args[1]!, tempCtx);
+  const temp = ctx.arena.intern("$and_temp");
+  ctx.bind(temp);
+  const second = lowerExpression(args[1]!, ctx);
 
   // (let $t a (if $t b $t))
-  return irLet(temp, first, irIf(irVar(temp), second, irVar(temp)));
+  const test = ctx.variable(temp);
+  const result = ctx.arena.addIf(test, second, ctx.variable(temp));
+  ctx.unbind(1);
+  return ctx.arena.addLet(temp, first, result);
 }
 
 /**
  * Lower or special form with short-circuit evaluation
  * (or a b) → (let $t a (if $t $t b))
  */
-function lowerOr(args: SExpr[], ctx: LoweringContext): IRExpr {
+function lowerOr(args: SExpr[], ctx: LoweringContext): number {
   if (args.length !== 2) {
     throw new LoweringError(`or expects 2 arguments, got ${args.length}`);
   }
 
   const first = lowerExpression(args[0]!, ctx);
-  const temp = "$or_temp";
-  const tempCtx = extendContext(ctx, [temp]);
-  const second = lowerExpression(args[1]!, tempCtx);
+  const temp = ctx.arena.intern("$or_temp");
+  ctx.bind(temp);
+  const second = lowerExpression(args[1]!, ctx);
 
   // (let $t a (if $t $t b))
-  return irLet(temp, first, irIf(irVar(temp), irVar(temp), second));
+  const test = ctx.variable(temp);
+  const result = ctx.arena.addIf(test, ctx.variable(temp), second);
+  ctx.unbind(1);
+  return ctx.arena.addLet(temp, first, result);
 }
 
 /**
  * Lower a function call
  * (func arg1 arg2) → (call func arg1 arg2)
  */
-function lowerCall(list: List, ctx: LoweringContext): IRExpr {
+function lowerCall(list: List, ctx: LoweringContext): number {
   if (list.elements.length === 0) {
     throw new LoweringError("Cannot lower empty call");
   }
 
   const func = lowerExpression(list.elements[0]!, ctx);
-  const args = list.elements.slice(1).map((arg) => lowerExpression(arg, ctx));
-
-  return irCall(func, args);
-}
-
-/**
- * Analyze free variables (captures) in a function body
- * Returns list of variables that are referenced but not defined locally
- */
-function analyzeCaptures(
-  expr: IRExpr,
-  localVars: Set<string>,
-  outerScope: Set<string>,
-): string[] {
-  const freeVars = new Set<string>();
-
-  function visit(e: IRExpr, locals: Set<string>): void {
-    switch (e.type) {
-      case "const":
-        // No variables
-        break;
-
-      case "var": {
-        // Check if variable is free (not local but in outer scope)
-        if (!locals.has(e.name) && outerScope.has(e.name)) {
-          freeVars.add(e.name);
-        }
-        break;
-      }
-
-      case "if":
-        visit(e.cond, locals);
-        visit(e.thenBranch, locals);
-        visit(e.else, locals);
-        break;
-
-      case "let": {
-        visit(e.value, locals);
-        // Body sees the new binding
-        const newLocals = new Set(locals);
-        newLocals.add(e.name);
-        visit(e.body, newLocals);
-        break;
-      }
-
-      case "seq":
-        for (const subExpr of e.exprs) {
-          visit(subExpr, locals);
-        }
-        break;
-
-      case "call":
-        visit(e.func, locals);
-        for (const arg of e.args) {
-          visit(arg, locals);
-        }
-        break;
-
-      case "fn": {
-        // Function parameters are local to the function body
-        const fnLocals = new Set(locals);
-        for (const param of e.params) {
-          fnLocals.add(param);
-        }
-        visit(e.body, fnLocals);
-        break;
-      }
-
-      case "effect":
-        for (const arg of e.args) {
-          visit(arg, locals);
-        }
-        break;
-    }
+  const mark = ctx.scratch.length;
+  for (let i = 1; i < list.elements.length; i++) {
+    ctx.scratch.push(lowerExpression(list.elements[i]!, ctx));
   }
 
-  visit(expr, localVars);
-  return Array.from(freeVars).sort();
+  const call = ctx.arena.addCall(func, ctx.scratch, mark);
+  ctx.scratch.length = mark;
+  return call;
 }
@@ -0,0 +1,91 @@
+import { describe, test as it, expect } from "bun:test";
+import { optimizeIR } from "./optimize.ts";
+import { lowerProgramToArena } from "./lower.ts";
+import { printModule } from "./print.ts";
+import { IRArena } from "./arena.ts";
+import { irVar, irLet, irSeq, irCall, irModule } from "./types.ts";
+import { parse } from "../parser/index.ts";
+import { generateBytecode } from "../codegen/bytecode.ts";
+import { VM, throwingEffectHandler } from "../vm/vm.ts";
+import type { EffectHandler } from "../vm/vm.ts";
+import type { NumberValue, Value } from "../vm/values.ts";
+import { nullValue, numberValue, stringValue } from "../vm/values.ts";
+
+function optimized(source: string): string {
+  return printModule(optimizeIR(lowerProgramToArena(parse(source))).toModule());
+}
+
+function run(source: string, input: Value = nullValue(), effectHandler: EffectHandler = throwingEffectHandler): Value {
+  const bytecode = generateBytecode(optimizeIR(lowerProgramToArena(parse(source))));
+  return new VM(bytecode, effectHandler).run(input);
+}
+
+describe("optimizeIR", () => {
+  it("folds builtin calls over constants", () => {
+    expect(optimized("(+ 1 (* 2 3))")).toBe("(const 7)");
+    expect(optimized("(- 5)")).toBe("(const -5)");
+    expect(optimized('(len (upper "abc"))')).toBe("(const 3)");
+    expect(optimized('(replace "a-b" "-" "+")')).toBe('(const "a+b")');
+  });
+
+  it("leaves calls that would fail at runtime", () => {
+    expect(optimized("(/ 1 0)")).toBe("(call (var /) (const 1) (const 0))");
+    expect(() => run("(/ 1 0)")).toThrow("Division by zero");
+    expect(optimized('(test /b/ "abc")')).toContain("(call (var test)");
+    // -0 has no constant form
+    expect(optimized("(* -1 0)")).toContain("(call (var *)");
+    expect(Object.is((run("(* -1 0)") as NumberValue).value, -0)).toBe(true);
+  });
+
+  it("removes branches with constant conditions", () => {
+    expect(optimized("(if (> 2 1) (upper $$) (boom:))")).toBe("(call (var upper) (var input))");
+    expect(optimized("(and true (or false 3))")).toBe("(const 3)");
+    expect(optimized('(or null (and 1 "a"))')).toBe('(const "a")');
+  });
+
+  it("propagates constant lets to later statements", () => {
+    expect(optimized('let: x (upper "ab"); (len x)')).toBe("(const 2)");
+    expect(run("let: x 2; fn: f (y) (+ x y); (f 3)")).toEqual(numberValue(5));
+  });
+
+  it("inlines single-use lets into pipelines", () => {
+    expect(optimized("$$ | upper | trim | len")).toBe(
+      "(call (var len) (call (var trim) (call (var upper) (var input))))"
+    );
+    expect(run('$$ | trim | (replace $ "," "-")', stringValue(" a,b "))).toEqual(stringValue("a-b"));
+  });
+
+  it("keeps effects in order", () => {
+    const performed: string[] = [];
+    const handler: EffectHandler = (name, _args, k) => {
+      performed.push(name);
+      k.resume(numberValue(performed.length));
+    };
+    expect(run("let: a (first:); (- (second:) a)", nullValue(), handler)).toEqual(numberValue(1));
+    expect(performed).toEqual(["first", "second"]);
+  });
+
+  it("keeps lets read after their body", () => {
+    // Codegen resolves `x` in the second statement to the first statement's local
+    const module = irModule(
+      irSeq([irLet("x", irCall(irVar("upper"), [irVar("input")]), irVar("x")), irCall(irVar("len"), [irVar("x")])])
+    );
+    const bytecode = generateBytecode(optimizeIR(IRArena.fromModule(module)));
+    expect(new VM(bytecode, throwingEffectHandler).run(stringValue("abc"))).toEqual(numberValue(3));
+  });
+
+  it("keeps nested and/or temps read by an outer branch", () => {
+    const unoptimized = (source: string) =>
+      new VM(generateBytecode(lowerProgramToArena(parse(source))), throwingEffectHandler).run(nullValue());
+    for (const source of ["(and false (and 1 2))", '(or 1 (or false ""))', "(and 0 (or null 3))", "(or (and \"\" 1) (or 3 4))", "(and (and false 1) (and 2 3))"]) {
+      expect(run(source)).toEqual(unoptimized(source));
+    }
+    expect(() => run('(if (and "" (and 1 "")) 7 (last ""))')).toThrow("last expects array");
+  });
+
+  it("keeps dead branches that would not compile", () => {
+    expect(() => generateBytecode(optimizeIR(lowerProgramToArena(parse("(if true 1 missing)"))))).toThrow(
+      "Undefined variable: missing"
+    );
+  });
+});
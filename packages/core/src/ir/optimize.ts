@@ -0,0 +1,697 @@
+/**
+ * IR optimizer for PEX.
+ *
+ * An optional pass between lowering and codegen. It rewrites an IRArena
+ * into a new one with three transformations:
+ *
+ * - **Constant folding**: a builtin call whose arguments are all constants
+ *   is evaluated at compile time with the VM's own builtins, so
+ *   `(+ 1 (* 2 3))` compiles to a single constant.
+ * - **Dead-branch elimination**: an `if` whose condition folds to a
+ *   constant is replaced by the branch that would run.
+ * - **Let inlining**: a let whose value folds to a constant is removed and
+ *   its uses replaced by the constant. A let that is used exactly once, as
+ *   the first thing its body evaluates, is replaced by its value at the use.
+ *   Together these collapse `and`/`or` over literals and pipeline stages.
+ *
+ * ## Safety
+ *
+ * Nothing is folded that would change what a program does at runtime:
+ *
+ * - Calls that throw (arity, type, division by zero) are left in place, so
+ *   the program still fails at the same point with the same error.
+ * - Regex constants are never folded through, since regex values carry
+ *   match state, and results that have no constant form (arrays, objects,
+ *   `-0`) are left as calls.
+ * - Folding uses the default builtins. Programs whose VM replaces builtins
+ *   through `builtinOverrides` should not be compiled with this pass.
+ *
+ * Codegen resolves names by the locals allocated so far in the current
+ * function, not by lexical IR scope, so a top-level `let:` is visible to
+ * the statements after it. The optimizer first walks the arena in codegen
+ * order to find the binding each variable resolves to, and only removes a
+ * let when every reference to it is accounted for. Lets bound to functions
+ * are never removed.
+ *
+ * ## Usage
+ *
+ * ```typescript
+ * const bytecode = generateBytecode(optimizeIR(lowerProgramToArena(ast)));
+ * ```
+ */
+
+import type { ConstValue } from "./types.ts";
+import { IRArena, IRKind } from "./arena.ts";
+import { isBuiltinCall } from "../codegen/bytecode.ts";
+import type { Value } from "../vm/values.ts";
+import {
+  nullValue,
+  booleanValue,
+  numberValue,
+  stringValue,
+  isTruthy,
+  toNumber,
+} from "../vm/values.ts";
+import type { VMBuiltin } from "../vm/builtins.ts";
+import { createVMBuiltins } from "../vm/builtins.ts";
+
+/** Binding of a function parameter or builtin */
+const NO_LET = -1;
+/** Binding of a name codegen will reject as undefined */
+const UNRESOLVED = -2;
+
+/** Outcome of searching for the first thing an expression evaluates */
+const enum Leading {
+  /** The use was reached before anything with an effect */
+  Found,
+  /** The expression is a constant or variable load and did not contain it */
+  Trivial,
+  /** Something that may fail or have an effect runs first */
+  Blocked,
+}
+
+let foldBuiltins: Map<string, VMBuiltin> | null = null;
+
+/**
+ * Optimize an arena, returning a new one. The input is not modified.
+ */
+export function optimizeIR(ir: IRArena): IRArena {
+  const scopes = new ScopeAnalysis(ir);
+  scopes.analyze(ir.root);
+  return new Rewriter(ir, scopes).run();
+}
+
+// ============================================
+// Scope Analysis
+// ============================================
+
+/**
+ * Resolves every variable to the let it reads, mirroring codegen's
+ * FunctionContext: lets allocate a local in the current function when they
+ * are compiled, a leading run of function lets in a sequence is allocated
+ * up front, and names that miss locally are captured from the enclosing
+ * function. Results are indexed by node.
+ */
+class ScopeAnalysis {
+  /** Let node a Var resolves to, NO_LET or UNRESOLVED */
+  readonly binding: Int32Array;
+  /** Number of Vars resolving to each let */
+  readonly uses: Uint32Array;
+  /** Let is read from a nested function */
+  readonly captured: Uint8Array;
+  /** Let is read from outside its own subtree */
+  readonly escapes: Uint8Array;
+  /**
+   * Let is read from outside its subtree on a path where it may not have
+   * run: from outside an if branch it is in. Codegen resolves nested
+   * and/or temps this way, and the read then sees the local's prior value.
+   */
+  readonly conditional: Uint8Array;
+  /** Let shares its local with a pre-allocated function let */
+  readonly pinned: Uint8Array;
+  /** Order in which each let's local was allocated */
+  readonly allocOrder: Int32Array;
+  /** Allocation count when each let's value started compiling */
+  readonly valueStart: Int32Array;
+
+  private readonly open: Uint8Array;
+  private readonly functions: Map<number, number>[] = [new Map()];
+  private allocations = 0;
+  // If branches entered so far, as parent links; -1 is the program itself
+  private readonly branchParent: number[] = [];
+  private branch = -1;
+  private readonly letBranch: Int32Array;
+
+  constructor(private readonly ir: IRArena) {
+    const size = ir.size;
+    this.binding = new Int32Array(size).fill(NO_LET);
+    this.uses = new Uint32Array(size);
+    this.captured = new Uint8Array(size);
+    this.escapes = new Uint8Array(size);
+    this.conditional = new Uint8Array(size);
+    this.letBranch = new Int32Array(size);
+    this.pinned = new Uint8Array(size);
+    this.allocOrder = new Int32Array(size);
+    this.valueStart = new Int32Array(size);
+    this.open = new Uint8Array(size);
+  }
+
+  analyze(node: number): void {
+    const ir = this.ir;
+    const a = ir.op0[node]!;
+    const b = ir.op1[node]!;
+    const c = ir.op2[node]!;
+
+    switch (ir.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return;
+      case IRKind.Var:
+        this.resolve(node, a);
+        return;
+      case IRKind.If:
+        this.analyze(a);
+        this.analyzeBranch(b);
+        this.analyzeBranch(c);
+        return;
+      case IRKind.Let:
+        this.open[node] = 1;
+        this.valueStart[node] = this.allocations;
+        if (ir.kinds[b] === IRKind.Fn) {
+          this.allocate(node);
+          this.analyze(b);
+        } else {
+          this.analyze(b);
+          this.allocate(node);
+        }
+        this.analyze(c);
+        this.open[node] = 0;
+        return;
+      case IRKind.Seq:
+        this.analyzeSeq(a);
+        return;
+      case IRKind.Call:
+        if (!isBuiltinFunc(ir, a, ir.listLength(b))) {
+          this.analyze(a);
+        }
+        this.analyzeList(b);
+        return;
+      case IRKind.Fn: {
+        const locals = new Map<number, number>();
+        for (let i = 0; i < ir.listLength(a); i++) {
+          locals.set(ir.listItem(a, i), NO_LET);
+        }
+        this.functions.push(locals);
+        this.analyze(b);
+        this.functions.pop();
+        return;
+      }
+      case IRKind.Effect:
+        this.analyzeList(b);
+        return;
+    }
+  }
+
+  private analyzeSeq(list: number): void {
+    const ir = this.ir;
+    const count = ir.listLength(list);
+    const locals = this.functions[this.functions.length - 1]!;
+
+    const preallocated = new Set<number>();
+    for (let i = 0; i < count; i++) {
+      const e = ir.listItem(list, i);
+      if (!isFnLet(ir, e)) {
+        break;
+      }
+      this.allocate(e);
+      preallocated.add(ir.op0[e]!);
+    }
+
+    for (let i = 0; i < count; i++) {
+      const e = ir.listItem(list, i);
+      if (isFnLet(ir, e) && preallocated.has(ir.op0[e]!)) {
+        // Codegen stores into whatever local the name has by now
+        const local = locals.get(ir.op0[e]!)!;
+        if (local !== e && local !== NO_LET) {
+          this.pinned[local] = 1;
+        }
+        this.open[e] = 1;
+        this.analyze(ir.op1[e]!);
+        this.analyze(ir.op2[e]!);
+        this.open[e] = 0;
+      } else {
+        this.analyze(e);
+      }
+    }
+  }
+
+  private analyzeBranch(node: number): void {
+    const parent = this.branch;
+    this.branch = this.branchParent.length;
+    this.branchParent.push(parent);
+    this.analyze(node);
+    this.branch = parent;
+  }
+
+  /** Whether code in the current branch only runs after `branch` was entered */
+  private within(branch: number): boolean {
+    for (let current = this.branch; current !== -1; current = this.branchParent[current]!) {
+      if (current === branch) {
+        return true;
+      }
+    }
+    return branch === -1;
+  }
+
+  private analyzeList(list: number): void {
+    for (let i = 0; i < this.ir.listLength(list); i++) {
+      this.analyze(this.ir.listItem(list, i));
+    }
+  }
+
+  private allocate(letNode: number): void {
+    this.functions[this.functions.length - 1]!.set(this.ir.op0[letNode]!, letNode);
+    this.allocOrder[letNode] = this.allocations++;
+    this.letBranch[letNode] = this.branch;
+  }
+
+  private resolve(node: number, name: number): void {
+    const top = this.functions.length - 1;
+    for (let level = top; level >= 0; level--) {
+      const local = this.functions[level]!.get(name);
+      if (local === undefined) {
+        continue;
+      }
+      this.binding[node] = local;
+      if (local !== NO_LET) {
+        this.uses[local]!++;
+        if (level !== top) this.captured[local] = 1;
+        if (!this.open[local]) {
+          this.escapes[local] = 1;
+          if (!this.within(this.letBranch[local]!)) this.conditional[local] = 1;
+        }
+      }
+      return;
+    }
+    this.binding[node] = UNRESOLVED;
+  }
+}
+
+// ============================================
+// Rewriting
+// ============================================
+
+/**
+ * Copies the arena in codegen order, folding and inlining as it goes.
+ * Name IDs are preserved, so scope analysis results stay valid for the
+ * Vars being copied.
+ */
+class Rewriter {
+  private readonly out = new IRArena();
+  /** Constant a removed let was bound to */
+  private readonly constLets: Map<number, ConstValue> = new Map();
+  /** Rewritten value node an inlined let's single use is replaced by */
+  private readonly inlined: Int32Array;
+  private readonly scratch: number[] = [];
+  private readonly seen: Uint8Array;
+
+  constructor(
+    private readonly ir: IRArena,
+    private readonly scopes: ScopeAnalysis
+  ) {
+    for (const name of ir.names) {
+      this.out.intern(name);
+    }
+    this.inlined = new Int32Array(ir.size).fill(-1);
+    this.seen = new Uint8Array(ir.names.length);
+  }
+
+  run(): IRArena {
+    this.out.root = this.rewrite(this.ir.root);
+    return this.out;
+  }
+
+  private rewrite(node: number): number {
+    const ir = this.ir;
+    const out = this.out;
+    const a = ir.op0[node]!;
+    const b = ir.op1[node]!;
+    const c = ir.op2[node]!;
+
+    switch (ir.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return out.addConst(ir.constants[a]!);
+
+      case IRKind.Var: {
+        const letNode = this.scopes.binding[node]!;
+        if (letNode >= 0) {
+          if (this.constLets.has(letNode)) {
+            return out.addConst(this.constLets.get(letNode)!);
+          }
+          if (this.inlined[letNode] !== -1) {
+            return this.inlined[letNode]!;
+          }
+        }
+        return out.addVar(a);
+      }
+
+      case IRKind.If: {
+        const cond = this.rewrite(a);
+        if (out.kinds[cond] === IRKind.Const) {
+          const value = out.constants[out.op0[cond]!]!;
+          if (!isRegex(value)) {
+            const [taken, dead] = isTruthy(toValue(value)) ? [b, c] : [c, b];
+            if (this.canDrop(dead)) {
+              return this.rewrite(taken);
+            }
+          }
+        }
+        const thenBranch = this.rewrite(b);
+        return out.addIf(cond, thenBranch, this.rewrite(c));
+      }
+
+      case IRKind.Let:
+        return this.rewriteLet(node, a, b, c);
+
+      case IRKind.Seq: {
+        const base = this.scratch.length;
+        const count = ir.listLength(a);
+        for (let i = 0; i < count; i++) {
+          const item = this.rewrite(ir.listItem(a, i));
+          // A constant whose result is discarded does nothing
+          if (i === count - 1 || out.kinds[item] !== IRKind.Const) {
+            this.scratch.push(item);
+          }
+        }
+        const length = this.scratch.length - base;
+        const result = length === 1 ? this.scratch[base]! : out.addSeq(this.scratch, base);
+        this.scratch.length = base;
+        return result;
+      }
+
+      case IRKind.Call: {
+        const func = this.rewrite(a);
+        const base = this.scratch.length;
+        for (let i = 0; i < ir.listLength(b); i++) {
+          const arg = this.rewrite(ir.listItem(b, i));
+          this.scratch.push(arg);
+        }
+        let result: number;
+        const folded = this.fold(func, base);
+        if (folded !== undefined) {
+          result = out.addConst(folded);
+        } else {
+          result = out.addCall(func, this.scratch, base);
+        }
+        this.scratch.length = base;
+        return result;
+      }
+
+      case IRKind.Fn: {
+        const params: number[] = [];
+        for (let i = 0; i < ir.listLength(a); i++) {
+          params.push(ir.listItem(a, i));
+        }
+        const body = this.rewrite(b);
+        return out.addFn(params, body, this.liveCaptures(c, body));
+      }
+
+      case IRKind.Effect: {
+        const base = this.scratch.length;
+        for (let i = 0; i < ir.listLength(b); i++) {
+          const arg = this.rewrite(ir.listItem(b, i));
+          this.scratch.push(arg);
+        }
+        const result = out.addEffect(a, this.scratch, base);
+        this.scratch.length = base;
+        return result;
+      }
+    }
+  }
+
+  private rewriteLet(node: number, name: number, value: number, body: number): number {
+    const ir = this.ir;
+    const out = this.out;
+    const scopes = this.scopes;
+
+    if (ir.kinds[value] === IRKind.Fn || scopes.pinned[node] || scopes.conditional[node]) {
+      const newValue = this.rewrite(value);
+      return out.addLet(name, newValue, this.rewrite(body));
+    }
+
+    const newValue = this.rewrite(value);
+    if (out.kinds[newValue] === IRKind.Const) {
+      this.constLets.set(node, out.constants[out.op0[newValue]!]!);
+      return this.rewrite(body);
+    }
+
+    if (
+      scopes.uses[node] === 1 &&
+      !scopes.captured[node] &&
+      !scopes.escapes[node] &&
+      this.findLeadingUse(body, node) === Leading.Found
+    ) {
+      this.inlined[node] = newValue;
+      return this.rewrite(body);
+    }
+
+    return out.addLet(name, newValue, this.rewrite(body));
+  }
+
+  /**
+   * Whether the use of `letNode` is evaluated before anything in `node`
+   * that could fail or have an effect, so that evaluating the let's value
+   * at the use instead of before the body changes nothing observable.
+   */
+  private findLeadingUse(node: number, letNode: number): Leading {
+    const ir = this.ir;
+    const a = ir.op0[node]!;
+    const b = ir.op1[node]!;
+
+    switch (ir.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return Leading.Trivial;
+
+      case IRKind.Var: {
+        const binding = this.scopes.binding[node]!;
+        if (binding === letNode) {
+          return Leading.Found;
+        }
+        // A load of a local allocated inside the let's value would move
+        // ahead of its store
+        if (binding >= 0 && this.scopes.allocOrder[binding]! >= this.scopes.valueStart[letNode]!) {
+          return Leading.Blocked;
+        }
+        return Leading.Trivial;
+      }
+
+      case IRKind.If:
+        return this.findLeadingUse(a, letNode) === Leading.Found ? Leading.Found : Leading.Blocked;
+
+      case IRKind.Seq:
+        return this.findLeadingUseInList(a, letNode);
+
+      case IRKind.Call:
+        if (!isBuiltinFunc(ir, a, ir.listLength(b))) {
+          const func = this.findLeadingUse(a, letNode);
+          if (func !== Leading.Trivial) {
+            return func;
+          }
+        }
+        return this.findLeadingUseInList(b, letNode);
+
+      case IRKind.Effect:
+        return this.findLeadingUseInList(b, letNode);
+
+      case IRKind.Let:
+      case IRKind.Fn:
+        return Leading.Blocked;
+    }
+  }
+
+  private findLeadingUseInList(list: number, letNode: number): Leading {
+    for (let i = 0; i < this.ir.listLength(list); i++) {
+      const result = this.findLeadingUse(this.ir.listItem(list, i), letNode);
+      if (result !== Leading.Trivial) {
+        return result;
+      }
+    }
+    return Leading.Blocked;
+  }
+
+  /**
+   * Whether a dead subtree can be dropped: it must not bind a let that is
+   * read from outside it, or reference a name codegen would reject.
+   */
+  private canDrop(node: number): boolean {
+    return !this.mustKeep(node);
+  }
+
+  private mustKeep(node: number): boolean {
+    const ir = this.ir;
+    const a = ir.op0[node]!;
+    const b = ir.op1[node]!;
+    const c = ir.op2[node]!;
+
+    switch (ir.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return false;
+      case IRKind.Var:
+        return this.scopes.binding[node] === UNRESOLVED;
+      case IRKind.If:
+        return this.mustKeep(a) || this.mustKeep(b) || this.mustKeep(c);
+      case IRKind.Let:
+        return this.scopes.escapes[node] === 1 || this.mustKeep(b) || this.mustKeep(c);
+      case IRKind.Seq:
+        return this.mustKeepList(a);
+      case IRKind.Call:
+        return this.mustKeep(a) || this.mustKeepList(b);
+      case IRKind.Fn:
+        return this.mustKeep(b);
+      case IRKind.Effect:
+        return this.mustKeepList(b);
+    }
+  }
+
+  private mustKeepList(list: number): boolean {
+    for (let i = 0; i < this.ir.listLength(list); i++) {
+      if (this.mustKeep(this.ir.listItem(list, i))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Evaluate a builtin call over the rewritten arguments at
+   * `scratch[base..]`, or return undefined if it cannot be folded.
+   */
+  private fold(func: number, base: number): ConstValue | undefined {
+    const out = this.out;
+    const argCount = this.scratch.length - base;
+    if (out.kinds[func] !== IRKind.Var) {
+      return undefined;
+    }
+    const name = out.names[out.op0[func]!]!;
+    if (!isBuiltinCall(name, argCount)) {
+      return undefined;
+    }
+
+    const args: Value[] = new Array(argCount);
+    for (let i = 0; i < argCount; i++) {
+      const arg = this.scratch[base + i]!;
+      if (out.kinds[arg] !== IRKind.Const) {
+        return undefined;
+      }
+      const value = out.constants[out.op0[arg]!]!;
+      if (isRegex(value)) {
+        return undefined;
+      }
+      args[i] = toValue(value);
+    }
+
+    let result: Value;
+    try {
+      if (name === "-" && argCount === 1) {
+        // Compiled to NEG; the `-` builtin only takes two arguments
+        result = numberValue(-toNumber(args[0]!).value);
+      } else {
+        foldBuiltins ??= createVMBuiltins();
+        const builtin = foldBuiltins.get(name);
+        if (!builtin) {
+          return undefined;
+        }
+        result = builtin(args);
+      }
+    } catch {
+      // Leave the error to runtime
+      return undefined;
+    }
+    return fromValue(result);
+  }
+
+  /**
+   * The captures of a function that its rewritten body still reads.
+   */
+  private liveCaptures(captures: number, body: number): number[] {
+    const ir = this.ir;
+    const seen = this.seen;
+    this.markNames(body);
+    const live: number[] = [];
+    for (let i = 0; i < ir.listLength(captures); i++) {
+      const name = ir.listItem(captures, i);
+      if (seen[name]) {
+        live.push(name);
+      }
+    }
+    seen.fill(0);
+    return live;
+  }
+
+  private markNames(node: number): void {
+    const out = this.out;
+    const a = out.op0[node]!;
+    const b = out.op1[node]!;
+    const c = out.op2[node]!;
+
+    switch (out.kinds[node] as IRKind) {
+      case IRKind.Const:
+        return;
+      case IRKind.Var:
+        this.seen[a] = 1;
+        return;
+      case IRKind.If:
+        this.markNames(a);
+        this.markNames(b);
+        this.markNames(c);
+        return;
+      case IRKind.Let:
+        this.markNames(b);
+        this.markNames(c);
+        return;
+      case IRKind.Seq:
+        this.markList(a);
+        return;
+      case IRKind.Call:
+        this.markNames(a);
+        this.markList(b);
+        return;
+      case IRKind.Fn:
+        this.markNames(b);
+        return;
+      case IRKind.Effect:
+        this.markList(b);
+        return;
+    }
+  }
+
+  private markList(list: number): void {
+    for (let i = 0; i < this.out.listLength(list); i++) {
+      this.markNames(this.out.listItem(list, i));
+    }
+  }
+}
+
+// ============================================
+// Helpers
+// ============================================
+
+/**
+ * Whether a call's function position names a builtin, in which case
+ * codegen never compiles it as a variable.
+ */
+function isBuiltinFunc(ir: IRArena, func: number, argCount: number): boolean {
+  return ir.kinds[func] === IRKind.Var && isBuiltinCall(ir.names[ir.op0[func]!]!, argCount);
+}
+
+function isFnLet(ir: IRArena, node: number): boolean {
+  return ir.kinds[node] === IRKind.Let && ir.kinds[ir.op1[node]!] === IRKind.Fn;
+}
+
+function isRegex(value: ConstValue): value is { type: "regex"; pattern: string; flags: string } {
+  return typeof value === "object" && value !== null;
+}
+
+function toValue(value: Exclude<ConstValue, { type: "regex" }>): Value {
+  if (value === null) return nullValue();
+  if (typeof value === "boolean") return booleanValue(value);
+  if (typeof value === "number") return numberValue(value);
+  return stringValue(value);
+}
+
+/**
+ * The constant form of a value, if it has one. `-0` has none, since codegen
+ * emits it as CONST_ZERO.
+ */
+function fromValue(value: Value): ConstValue | undefined {
+  switch (value.type) {
+    case "null":
+      return null;
+    case "boolean":
+    case "string":
+      return value.value;
+    case "number":
+      return Object.is(value.value, -0) ? undefined : value.value;
+    default:
+      return undefined;
+  }
+}
@@ -2,11 +2,11 @@
  * PEX Parser
  *
  * Converts PEX source code into an Abstract Syntax Tree (AST).
- * The parsing pipeline: Lexer → Parser
+ * The parsing pipeline: Scanner → Parser, in a single pass
  */
 
-import { tokenize } from "./lexer.ts";
-import { parse as parseTokens } from "./parser.ts";
+import { Scanner } from "./lexer.ts";
+import { Parser } from "./parser.ts";
 import type { Program } from "./ast.ts";
 
 export interface ParseOptions {
@@ -21,19 +21,15 @@ export interface ParseOptions {
  * Parse PEX source code into an AST
  */
 export function parse(source: string, options: ParseOptions = {}): Program {
-  // Step 1: Tokenize the source code
-  const tokens = tokenize(source);
-
-  // Step 2: Parse tokens into AST (handles pipes, semicolons, and shell mode)
-  const ast = parseTokens(tokens, options);
-
-  return ast;
+  // The parser pulls tokens from the scanner as it goes (and handles pipes,
+  // semicolons, and shell mode), so no token array is built
+  return new Parser(new Scanner(source), options).parse();
 }
 
 // Re-export types and utilities
 export type { Program, SExpr, Atom, List, Pipeline, AtomType, AtomValue } from "./ast.ts";
-export type { Token, SourceRefToken } from "./lexer.ts";
-export { TokenType } from "./lexer.ts";
+export type { Token, SourceRefToken, TokenSource } from "./lexer.ts";
+export { TokenType, tokenize, Scanner, StringTable } from "./lexer.ts";
 export { LexerError } from "./lexer.ts";
-export { ParseError } from "./parser.ts";
+export { ParseError, Parser, parse as parseTokens } from "./parser.ts";
 export { print } from "./printer.ts";
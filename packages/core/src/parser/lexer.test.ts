@@ -1,5 +1,5 @@
 import { describe, test, expect } from "bun:test";
-import { tokenize, TokenType, LexerError } from "./lexer.ts";
+import { tokenize, TokenType, LexerError, Scanner, StringTable } from "./lexer.ts";
 
 describe("Lexer", () => {
   describe("Numbers", () => {
@@ -412,4 +412,84 @@ describe("Lexer", () => {
       expect(tokens[0]?.type).toBe(TokenType.EOF);
     });
   });
+
+  describe("Scanner", () => {
+    test("yields tokens as spans of the source", () => {
+      const source = '(upper "a b") | $1';
+      const scanner = new Scanner(source);
+      const spans: [TokenType, string][] = [];
+      for (; scanner.type !== TokenType.EOF; scanner.next()) {
+        spans.push([scanner.type, source.slice(scanner.start, scanner.end)]);
+      }
+      expect(spans).toEqual([
+        [TokenType.LPAREN, "("],
+        [TokenType.IDENTIFIER, "upper"],
+        [TokenType.STRING, '"a b"'],
+        [TokenType.RPAREN, ")"],
+        [TokenType.PIPE, "|"],
+        [TokenType.SOURCE_REF, "$1"],
+      ]);
+    });
+
+    test("decodes values and positions on request", () => {
+      const scanner = new Scanner('foo\n  "a\\tb" bar:');
+      scanner.next();
+      expect(scanner.value()).toBe("a\tb");
+      expect(scanner.raw()).toBe('"a\\tb"');
+      expect([scanner.line, scanner.column]).toEqual([2, 3]);
+      scanner.next();
+      expect(scanner.token()).toEqual({ type: TokenType.EFFECT_IDENT, value: "bar", line: 2, column: 10, raw: "bar:" });
+    });
+
+    test("forks an independent lookahead", () => {
+      const scanner = new Scanner("a b c");
+      const ahead = scanner.fork();
+      ahead.next();
+      ahead.next();
+      expect(ahead.value()).toBe("c");
+      expect(scanner.value()).toBe("a");
+    });
+
+    test("finish reports lexer errors ahead without moving", () => {
+      const scanner = new Scanner("a b @");
+      expect(() => scanner.finish()).toThrow(LexerError);
+      expect(scanner.value()).toBe("a");
+    });
+
+    test("matches tokenize", () => {
+      const source = "fn: f (x) (* x 2); $$ | (replace $ /a\\/b/g \"$1\") | f ;; done";
+      const scanner = new Scanner(source);
+      const tokens = [scanner.token()];
+      while (scanner.type !== TokenType.EOF) {
+        scanner.next();
+        tokens.push(scanner.token());
+      }
+      expect(tokens).toEqual(tokenize(source));
+    });
+  });
+
+  describe("StringTable", () => {
+    test("interns spans by content", () => {
+      const table = new StringTable();
+      const source = "name other name";
+      expect(table.intern(source, 0, 4)).toBe("name");
+      expect(table.intern(source, 11, 15)).toBe("name");
+      expect(table.intern(source, 5, 10)).toBe("other");
+      expect(table.intern("")).toBe("");
+    });
+
+    test("keeps strings across growth", () => {
+      const table = new StringTable();
+      const names = Array.from({ length: 500 }, (_, i) => `n${i}`);
+      const source = names.join(" ");
+      let start = 0;
+      for (const name of names) {
+        expect(table.intern(source, start, start + name.length)).toBe(name);
+        start += name.length + 1;
+      }
+      for (const name of names) {
+        expect(table.intern(name)).toBe(name);
+      }
+    });
+  });
 });
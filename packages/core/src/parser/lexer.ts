@@ -47,372 +47,451 @@ export class LexerError extends Error {
   }
 }
 
-export class Lexer {
-  private source: string;
-  private position: number = 0;
-  private line: number = 1;
-  private column: number = 1;
-  private tokens: Token[] = [];
+/**
+ * A stream of tokens positioned on one token at a time. The parser reads
+ * tokens through this interface, from either a Scanner or a Token[].
+ */
+export interface TokenSource {
+  /** Type of the current token */
+  readonly type: TokenType;
+  readonly line: number;
+  readonly column: number;
+
+  /** Move to the next token; stays on EOF once it is reached */
+  next(): void;
+  /** `value` of the current token, as in Token */
+  value(): string | number | boolean | null;
+  /** `raw` of the current token, as in Token */
+  raw(): string;
+  /** The current token as a Token */
+  token(): Token;
+  /** An independent copy positioned on the same token, for lookahead */
+  fork(): TokenSource;
+  /**
+   * Read to the end without moving this source.
+   * @throws LexerError if the rest of the input does not tokenize
+   */
+  finish(): void;
+}
 
-  constructor(source: string) {
-    this.source = source;
-  }
+// Character classes for codes below 128
+const DIGIT = 1;
+const IDENTIFIER_START = 2;
+const IDENTIFIER_PART = 4;
+
+const CHAR_CLASS = new Uint8Array(128);
+for (let code = 0; code < 128; code++) {
+  const char = String.fromCharCode(code);
+  if (/[0-9]/.test(char)) CHAR_CLASS[code]! |= DIGIT;
+  if (/[a-zA-Z_$<>=!?+\-*/%]/.test(char)) CHAR_CLASS[code]! |= IDENTIFIER_START;
+  if (/[a-zA-Z0-9_$<>=!?+\-*/%]/.test(char)) CHAR_CLASS[code]! |= IDENTIFIER_PART;
+}
 
-  tokenize(): Token[] {
-    while (this.position < this.source.length) {
-      this.skipWhitespace();
+const REGEX_FLAGS = /[gimsuvy]/;
 
-      if (this.position >= this.source.length) {
-        break;
-      }
+function hasClass(code: number, charClass: number): boolean {
+  return code < 128 && (CHAR_CLASS[code]! & charClass) !== 0;
+}
 
-      // Skip comments
-      if (this.peek() === ";" && this.peek(1) === ";") {
-        this.skipComment();
-        continue;
-      }
+function isWhitespace(code: number): boolean {
+  if (code <= 32) return code === 32 || (code >= 9 && code <= 13);
+  return code >= 160 && /\s/.test(String.fromCharCode(code));
+}
+
+/**
+ * Interned strings, so every occurrence of a name or string literal in a
+ * program shares one string. Lookups hash a span of the source in place;
+ * the span is only copied out the first time it is seen.
+ */
+export class StringTable {
+  private slots: (string | undefined)[] = new Array(64);
+  private count = 0;
+
+  /** The interned copy of `text.slice(start, end)` */
+  intern(text: string, start: number = 0, end: number = text.length): string {
+    let hash = 0x811c9dc5;
+    for (let i = start; i < end; i++) {
+      hash = Math.imul(hash ^ text.charCodeAt(i), 0x01000193);
+    }
 
-      const token = this.nextToken();
-      if (token) {
-        this.tokens.push(token);
+    const length = end - start;
+    const mask = this.slots.length - 1;
+    let slot = hash & mask;
+    for (;;) {
+      const existing = this.slots[slot];
+      if (existing === undefined) break;
+      if (existing.length === length && text.startsWith(existing, start)) {
+        return existing;
       }
+      slot = (slot + 1) & mask;
     }
 
-    this.tokens.push({
-      type: TokenType.EOF,
-      value: null,
-      line: this.line,
-      column: this.column,
-      raw: "",
-    });
+    const value = start === 0 && end === text.length ? text : text.slice(start, end);
+    this.slots[slot] = value;
+    if (++this.count * 2 > this.slots.length) {
+      this.grow();
+    }
+    return value;
+  }
+
+  private grow(): void {
+    const old = this.slots;
+    this.slots = new Array(old.length * 2);
+    this.count = 0;
+    for (const value of old) {
+      if (value !== undefined) this.intern(value);
+    }
+  }
+}
+
+/**
+ * Pull-based lexer. Each next() scans one token and records it as a span
+ * (`start`, `end`) of the source, so scanning allocates nothing; values are
+ * decoded only when the parser asks for them, and names and string literals
+ * go through a StringTable. Lines and columns are also only worked out on
+ * request.
+ */
+export class Scanner implements TokenSource {
+  type: TokenType = TokenType.EOF;
+  /** Span of the current token in the source */
+  start = 0;
+  end = 0;
+
+  // Whether the current STRING token contains escapes
+  private escaped = false;
+  // Types of the two tokens before the current one, for regex detection
+  private last: TokenType | undefined;
+  private secondLast: TokenType | undefined;
+  private started = false;
+
+  // Line bookkeeping: `lineNumber` is the line of offset `lineOffset`,
+  // which lies on the line starting at `lineStart`
+  private lineOffset = 0;
+  private lineNumber = 1;
+  private lineStart = 0;
+
+  /**
+   * Positions the scanner on the first token.
+   * @throws LexerError if the first token is malformed
+   */
+  constructor(
+    readonly source: string,
+    readonly strings: StringTable = new StringTable()
+  ) {
+    this.scan();
+  }
+
+  get line(): number {
+    this.locate(this.start);
+    return this.lineNumber;
+  }
+
+  get column(): number {
+    this.locate(this.start);
+    return this.start - this.lineStart + 1;
+  }
 
-    return this.tokens;
+  next(): void {
+    this.scan();
   }
 
-  private nextToken(): Token | null {
-    const char = this.peek();
-    const line = this.line;
-    const column = this.column;
-
-    // Single character tokens
-    switch (char) {
-      case "|":
-        this.advance();
-        return { type: TokenType.PIPE, value: "|", line, column, raw: "|" };
-      case ";":
-        this.advance();
-        return { type: TokenType.SEMICOLON, value: ";", line, column, raw: ";" };
-      case "(":
-        this.advance();
-        return { type: TokenType.LPAREN, value: "(", line, column, raw: "(" };
-      case ")":
-        this.advance();
-        return { type: TokenType.RPAREN, value: ")", line, column, raw: ")" };
-      case ",":
-        this.advance();
-        return { type: TokenType.COMMA, value: ",", line, column, raw: "," };
+  /**
+   * Move to the next token and return its type.
+   * @throws LexerError if the next token is malformed
+   */
+  scan(): TokenType {
+    if (this.started) {
+      if (this.type === TokenType.EOF) return this.type;
+      this.secondLast = this.last;
+      this.last = this.type;
+    }
+    this.started = true;
+
+    const source = this.source;
+    let position = this.end;
+    for (;;) {
+      while (position < source.length && isWhitespace(source.charCodeAt(position))) {
+        position++;
+      }
+      // Skip comments up to the end of the line
+      if (source.charCodeAt(position) === 59 && source.charCodeAt(position + 1) === 59) {
+        while (position < source.length && source.charCodeAt(position) !== 10) {
+          position++;
+        }
+        continue;
+      }
+      break;
+    }
+
+    this.start = position;
+    if (position >= source.length) {
+      this.end = position;
+      return (this.type = TokenType.EOF);
+    }
+
+    const code = source.charCodeAt(position);
+    switch (code) {
+      case 124: // |
+        return this.single(TokenType.PIPE);
+      case 59: // ;
+        return this.single(TokenType.SEMICOLON);
+      case 40: // (
+        return this.single(TokenType.LPAREN);
+      case 41: // )
+        return this.single(TokenType.RPAREN);
+      case 44: // ,
+        return this.single(TokenType.COMMA);
     }
 
     // Negative numbers - special case before identifier reading
-    if (char === "-" && this.isDigit(this.peek(1))) {
-      return this.readNumber();
+    if (code === 45 && hasClass(source.charCodeAt(position + 1), DIGIT)) {
+      return this.scanNumber();
     }
 
     // Strings
-    if (char === '"' || char === "'") {
-      return this.readString(char);
+    if (code === 34 || code === 39) {
+      return this.scanString(code);
     }
 
     // Regex: only when in operand position (where a value is expected)
-    if (char === "/" && this.isOperandPosition()) {
-      return this.readRegex();
+    if (code === 47 && this.isOperandPosition()) {
+      return this.scanRegex();
     }
 
     // Numbers
-    if (this.isDigit(char)) {
-      return this.readNumber();
+    if (hasClass(code, DIGIT)) {
+      return this.scanNumber();
     }
 
     // Identifiers and keywords
-    if (this.isIdentifierStart(char)) {
-      return this.readIdentifier();
+    if (hasClass(code, IDENTIFIER_START)) {
+      return this.scanIdentifier();
     }
 
-    throw new LexerError(`Unexpected character '${char}'`, line, column);
+    throw this.error(`Unexpected character '${source[position]}'`);
   }
 
-  private readString(quote: string): Token {
-    const line = this.line;
-    const column = this.column;
-    let value = "";
-    let raw = quote;
-
-    this.advance(); // Skip opening quote
-
-    while (this.position < this.source.length && this.peek() !== quote) {
-      if (this.peek() === "\\") {
-        this.advance();
-        raw += "\\";
-
-        const escapeChar = this.peek();
-        raw += escapeChar;
-
-        switch (escapeChar) {
-          case "n":
-            value += "\n";
-            break;
-          case "t":
-            value += "\t";
-            break;
-          case "r":
-            value += "\r";
-            break;
-          case "\\":
-            value += "\\";
-            break;
-          case quote:
-            value += quote;
-            break;
-          default:
-            value += escapeChar;
-        }
-        this.advance();
-      } else {
-        const char = this.peek();
-        value += char;
-        raw += char;
-        this.advance();
-      }
-    }
-
-    if (this.peek() !== quote) {
-      throw new LexerError(`Unterminated string`, line, column);
+  value(): string | number | boolean | null {
+    switch (this.type) {
+      case TokenType.NUMBER:
+        return parseFloat(this.raw());
+      case TokenType.STRING:
+        return this.escaped
+          ? this.strings.intern(this.unescape())
+          : this.strings.intern(this.source, this.start + 1, this.end - 1);
+      case TokenType.BOOLEAN:
+        return this.source.charCodeAt(this.start) === 116; // t
+      case TokenType.NULL:
+      case TokenType.EOF:
+        return null;
+      case TokenType.EFFECT_IDENT:
+        return this.strings.intern(this.source, this.start, this.end - 1);
+      default:
+        return this.raw();
     }
-
-    this.advance(); // Skip closing quote
-    raw += quote;
-
-    return { type: TokenType.STRING, value, line, column, raw };
   }
 
-  private readRegex(): Token {
-    const line = this.line;
-    const column = this.column;
-    let pattern = "";
-    let raw = "/";
-
-    this.advance(); // Skip opening /
-
-    while (this.position < this.source.length && this.peek() !== "/") {
-      if (this.peek() === "\\") {
-        pattern += this.peek();
-        raw += this.peek();
-        this.advance();
-        if (this.position < this.source.length) {
-          pattern += this.peek();
-          raw += this.peek();
-          this.advance();
-        }
-      } else if (this.peek() === "\n") {
-        throw new LexerError(`Unterminated regex`, line, column);
-      } else {
-        pattern += this.peek();
-        raw += this.peek();
-        this.advance();
-      }
-    }
-
-    if (this.peek() !== "/") {
-      throw new LexerError(`Unterminated regex`, line, column);
-    }
-
-    this.advance(); // Skip closing /
-    raw += "/";
+  raw(): string {
+    return this.type === TokenType.EOF ? "" : this.strings.intern(this.source, this.start, this.end);
+  }
 
-    // Read flags
-    let flags = "";
-    while (
-      this.position < this.source.length &&
-      /[gimsuvy]/.test(this.peek())
-    ) {
-      flags += this.peek();
-      raw += this.peek();
-      this.advance();
+  token(): Token {
+    if (this.type === TokenType.SOURCE_REF) {
+      return this.sourceRefToken();
     }
-
     return {
-      type: TokenType.REGEX,
-      value: `/${pattern}/${flags}`,
-      line,
-      column,
-      raw,
+      type: this.type,
+      value: this.value(),
+      line: this.line,
+      column: this.column,
+      raw: this.raw(),
     };
   }
 
-  private readNumber(): Token {
-    const line = this.line;
-    const column = this.column;
-    let value = "";
+  fork(): Scanner {
+    return Object.assign(Object.create(Scanner.prototype) as Scanner, this);
+  }
 
-    // Handle negative numbers
-    if (this.peek() === "-") {
-      value += this.peek();
-      this.advance();
+  finish(): void {
+    const rest = this.fork();
+    while (rest.scan() !== TokenType.EOF) {
+      // Scanning is the check
     }
+  }
 
-    // Read integer part
-    while (this.position < this.source.length && this.isDigit(this.peek())) {
-      value += this.peek();
-      this.advance();
+  private sourceRefToken(): SourceRefToken {
+    const raw = this.raw();
+    const { line, column } = this;
+    if (raw === "$") {
+      return { type: TokenType.SOURCE_REF, value: raw, refType: 'pipeline', line, column, raw };
     }
+    if (raw === "$$") {
+      return { type: TokenType.SOURCE_REF, value: raw, refType: 'program', line, column, raw };
+    }
+    const arrayIndex = parseInt(raw.slice(1), 10);
+    return { type: TokenType.SOURCE_REF, value: raw, refType: 'array', arrayIndex, line, column, raw };
+  }
 
-    // Read decimal part
-    if (this.peek() === "." && this.isDigit(this.peek(1))) {
-      value += this.peek();
-      this.advance();
+  private single(type: TokenType): TokenType {
+    this.end = this.start + 1;
+    return (this.type = type);
+  }
+
+  private scanString(quote: number): TokenType {
+    const source = this.source;
+    let position = this.start + 1;
+    this.escaped = false;
 
-      while (this.position < this.source.length && this.isDigit(this.peek())) {
-        value += this.peek();
-        this.advance();
+    while (position < source.length && source.charCodeAt(position) !== quote) {
+      if (source.charCodeAt(position) === 92) {
+        this.escaped = true;
+        position++;
       }
+      position++;
     }
 
-    const numValue = parseFloat(value);
-    return {
-      type: TokenType.NUMBER,
-      value: numValue,
-      line,
-      column,
-      raw: value,
-    };
+    if (position >= source.length) {
+      throw this.error(`Unterminated string`);
+    }
+
+    this.end = position + 1;
+    return (this.type = TokenType.STRING);
   }
 
-  private readIdentifier(): Token | SourceRefToken {
-    const line = this.line;
-    const column = this.column;
+  /** Value of the current STRING token with its escapes decoded */
+  private unescape(): string {
+    const source = this.source;
+    const quote = source[this.start];
     let value = "";
-
-    while (
-      this.position < this.source.length &&
-      this.isIdentifierPart(this.peek())
-    ) {
-      value += this.peek();
-      this.advance();
-    }
-
-    // Check for SOURCE_REF patterns: $, $$, $0, $1, etc.
-    if (value === "$") {
-      return {
-        type: TokenType.SOURCE_REF,
-        value: "$",
-        refType: 'pipeline',
-        line,
-        column,
-        raw: "$",
-      };
-    }
-    if (value === "$$") {
-      return {
-        type: TokenType.SOURCE_REF,
-        value: "$$",
-        refType: 'program',
-        line,
-        column,
-        raw: "$$",
-      };
-    }
-    const arrayMatch = value.match(/^\$(\d+)$/);
-    if (arrayMatch) {
-      return {
-        type: TokenType.SOURCE_REF,
-        value,
-        refType: 'array',
-        arrayIndex: parseInt(arrayMatch[1]!, 10),
-        line,
-        column,
-        raw: value,
-      };
-    }
-
-    // Check if followed by colon (effect name pattern)
-    let raw = value;
-    let type: TokenType;
-    let tokenValue: string | boolean | null = value;
-
-    if (this.peek() === ":") {
-      this.advance(); // consume the colon
-      raw = value + ":";
-      tokenValue = value;  // Value without colon, raw includes colon
-      type = TokenType.EFFECT_IDENT;
-    } else {
-      // Check for keywords
-      switch (value) {
-        case "true":
-          type = TokenType.BOOLEAN;
-          tokenValue = true;
+    let from = this.start + 1;
+    const end = this.end - 1;
+
+    for (let position = from; position < end; position++) {
+      if (source.charCodeAt(position) !== 92) continue;
+      value += source.slice(from, position);
+      const escapeChar = source[++position];
+      switch (escapeChar) {
+        case "n":
+          value += "\n";
+          break;
+        case "t":
+          value += "\t";
+          break;
+        case "r":
+          value += "\r";
           break;
-        case "false":
-          type = TokenType.BOOLEAN;
-          tokenValue = false;
+        case "\\":
+          value += "\\";
           break;
-        case "null":
-          type = TokenType.NULL;
-          tokenValue = null;
+        case quote:
+          value += quote;
           break;
         default:
-          type = TokenType.IDENTIFIER;
+          value += escapeChar;
       }
+      from = position + 1;
     }
 
-    return { type, value: tokenValue, line, column, raw };
+    return value + source.slice(from, end);
   }
 
-  private skipWhitespace(): void {
-    while (
-      this.position < this.source.length &&
-      /\s/.test(this.peek())
-    ) {
-      this.advance();
+  private scanRegex(): TokenType {
+    const source = this.source;
+    let position = this.start + 1;
+
+    while (position < source.length && source.charCodeAt(position) !== 47) {
+      const code = source.charCodeAt(position);
+      if (code === 92) {
+        position = Math.min(position + 2, source.length);
+      } else if (code === 10) {
+        throw this.error(`Unterminated regex`);
+      } else {
+        position++;
+      }
     }
-  }
 
-  private skipComment(): void {
-    // Skip until end of line
-    while (
-      this.position < this.source.length &&
-      this.peek() !== "\n"
-    ) {
-      this.advance();
+    if (position >= source.length) {
+      throw this.error(`Unterminated regex`);
     }
-  }
 
-  private peek(offset: number = 0): string {
-    const pos = this.position + offset;
-    return pos < this.source.length ? this.source[pos]! : "";
+    // Read flags
+    position++;
+    while (position < source.length && REGEX_FLAGS.test(source[position]!)) {
+      position++;
+    }
+
+    this.end = position;
+    return (this.type = TokenType.REGEX);
   }
 
-  private advance(): void {
-    if (this.position < this.source.length) {
-      if (this.source[this.position] === "\n") {
-        this.line++;
-        this.column = 1;
-      } else {
-        this.column++;
+  private scanNumber(): TokenType {
+    const source = this.source;
+    let position = this.start;
+
+    // Handle negative numbers
+    if (source.charCodeAt(position) === 45) {
+      position++;
+    }
+
+    // Read integer part
+    while (hasClass(source.charCodeAt(position), DIGIT)) {
+      position++;
+    }
+
+    // Read decimal part
+    if (source.charCodeAt(position) === 46 && hasClass(source.charCodeAt(position + 1), DIGIT)) {
+      position++;
+      while (hasClass(source.charCodeAt(position), DIGIT)) {
+        position++;
       }
-      this.position++;
     }
-  }
 
-  private isDigit(char: string): boolean {
-    return /[0-9]/.test(char);
+    this.end = position;
+    return (this.type = TokenType.NUMBER);
   }
 
-  private isIdentifierStart(char: string): boolean {
-    return /[a-zA-Z_$<>=!?+\-*/%]/.test(char);
-  }
+  private scanIdentifier(): TokenType {
+    const source = this.source;
+    const start = this.start;
+    let position = start;
+
+    while (hasClass(source.charCodeAt(position), IDENTIFIER_PART)) {
+      position++;
+    }
+    this.end = position;
+
+    // Check for SOURCE_REF patterns: $, $$, $0, $1, etc.
+    if (source.charCodeAt(start) === 36) {
+      const length = position - start;
+      if (length === 1 || (length === 2 && source.charCodeAt(start + 1) === 36)) {
+        return (this.type = TokenType.SOURCE_REF);
+      }
+      let digits = start + 1;
+      while (digits < position && hasClass(source.charCodeAt(digits), DIGIT)) {
+        digits++;
+      }
+      if (digits === position) {
+        return (this.type = TokenType.SOURCE_REF);
+      }
+    }
 
-  private isIdentifierPart(char: string): boolean {
-    return /[a-zA-Z0-9_$<>=!?+\-*/%]/.test(char);
+    // Check if followed by colon (effect name pattern); raw includes it
+    if (source.charCodeAt(position) === 58) {
+      this.end = position + 1;
+      return (this.type = TokenType.EFFECT_IDENT);
+    }
+
+    // Check for keywords
+    switch (position - start) {
+      case 4:
+        if (source.startsWith("true", start)) return (this.type = TokenType.BOOLEAN);
+        if (source.startsWith("null", start)) return (this.type = TokenType.NULL);
+        break;
+      case 5:
+        if (source.startsWith("false", start)) return (this.type = TokenType.BOOLEAN);
+        break;
+    }
+    return (this.type = TokenType.IDENTIFIER);
   }
 
   /**
@@ -420,51 +499,38 @@ export class Lexer {
    * Used to distinguish regex literals from division operators.
    */
   private isOperandPosition(): boolean {
-    const lastToken = this.tokens[this.tokens.length - 1];
-
-    // At start of input, need to look ahead to distinguish / identifier from /regex/
-    if (!lastToken) {
-      return this.looksLikeRegex();
-    }
-
-    // After these tokens, we could have either / operator or /regex/
-    // Need to look ahead to distinguish
-    const ambiguousStarters = [
-      TokenType.LPAREN,
-      TokenType.PIPE,
-      TokenType.COMMA,
-      TokenType.SEMICOLON,
-      TokenType.EFFECT_IDENT,
-    ];
-    if (ambiguousStarters.includes(lastToken.type)) {
-      return this.looksLikeRegex();
-    }
-
-    // After a literal value, we're definitely expecting another operand (argument)
-    // so / must be starting a regex
-    const literalTypes = [
-      TokenType.STRING,
-      TokenType.NUMBER,
-      TokenType.BOOLEAN,
-      TokenType.NULL,
-      TokenType.REGEX,
-      TokenType.SOURCE_REF,
-    ];
-    if (literalTypes.includes(lastToken.type)) return true;
-
-    // After an identifier in argument position, another value can follow
-    if (lastToken.type === TokenType.IDENTIFIER) {
-      const secondLastToken = this.tokens[this.tokens.length - 2];
-      const argPositionStarters = [
-        TokenType.EFFECT_IDENT,
-        TokenType.COMMA,
-        TokenType.LPAREN,
-        TokenType.PIPE,
-        TokenType.SEMICOLON,
-      ];
-      if (secondLastToken && argPositionStarters.includes(secondLastToken.type)) {
+    switch (this.last) {
+      // At start of input, and after these tokens, we could have either
+      // / operator or /regex/; look ahead to distinguish
+      case undefined:
+      case TokenType.LPAREN:
+      case TokenType.PIPE:
+      case TokenType.COMMA:
+      case TokenType.SEMICOLON:
+      case TokenType.EFFECT_IDENT:
+        return this.looksLikeRegex();
+
+      // After a literal value, we're definitely expecting another operand
+      // (argument) so / must be starting a regex
+      case TokenType.STRING:
+      case TokenType.NUMBER:
+      case TokenType.BOOLEAN:
+      case TokenType.NULL:
+      case TokenType.REGEX:
+      case TokenType.SOURCE_REF:
         return true;
-      }
+
+      // After an identifier in argument position, another value can follow
+      case TokenType.IDENTIFIER:
+        switch (this.secondLast) {
+          case TokenType.EFFECT_IDENT:
+          case TokenType.COMMA:
+          case TokenType.LPAREN:
+          case TokenType.PIPE:
+          case TokenType.SEMICOLON:
+            return true;
+        }
+        return false;
     }
 
     return false;
@@ -474,52 +540,80 @@ export class Lexer {
    * Look ahead to see if / starts a regex literal or is the division operator
    */
   private looksLikeRegex(): boolean {
-    // Save position
-    const savedPos = this.position;
-    const savedLine = this.line;
-    const savedCol = this.column;
-
-    // Skip the /
-    this.position++;
-
+    const source = this.source;
+    let position = this.start + 1;
     let hasContent = false;
 
     // Look for closing / (handling escapes)
-    while (this.position < this.source.length) {
-      const char = this.peek();
+    while (position < source.length) {
+      const code = source.charCodeAt(position);
 
-      if (char === "\n") {
-        // Regex can't span lines
+      if (code === 10 || code === 47) {
+        // Regex can't span lines; or found closing /
         break;
       }
-
-      if (char === "\\") {
+      if (code === 92) {
         // Escape sequence - skip next char
-        this.position++;
-        if (this.position < this.source.length) {
-          this.position++;
+        position++;
+        if (position < source.length) {
+          position++;
           hasContent = true;
         }
-      } else if (char === "/") {
-        // Found closing /
-        break;
-      } else if (char === " " && !hasContent) {
+      } else if (code === 32 && !hasContent) {
         // Leading space after / suggests it's a division operator
         break;
       } else {
-        this.position++;
+        position++;
         hasContent = true;
       }
     }
 
-    // Restore position
-    this.position = savedPos;
-    this.line = savedLine;
-    this.column = savedCol;
-
     // It's a regex if we have content (even without closing /, which will throw error)
     return hasContent;
   }
+
+  /** Advance the line bookkeeping to `offset` */
+  private locate(offset: number): void {
+    if (offset < this.lineOffset) {
+      this.lineOffset = 0;
+      this.lineNumber = 1;
+      this.lineStart = 0;
+    }
+    const source = this.source;
+    for (let position = this.lineOffset; position < offset; position++) {
+      if (source.charCodeAt(position) === 10) {
+        this.lineNumber++;
+        this.lineStart = position + 1;
+      }
+    }
+    this.lineOffset = offset;
+  }
+
+  private error(message: string): LexerError {
+    return new LexerError(message, this.line, this.column);
+  }
+}
+
+/**
+ * Tokenizes a whole source into a Token[]. The parser reads a Scanner
+ * directly instead; this is for tools that want every token.
+ */
+export class Lexer {
+  private source: string;
+
+  constructor(source: string) {
+    this.source = source;
+  }
+
+  tokenize(): Token[] {
+    const scanner = new Scanner(this.source);
+    const tokens: Token[] = [scanner.token()];
+    while (scanner.type !== TokenType.EOF) {
+      scanner.next();
+      tokens.push(scanner.token());
+    }
+    return tokens;
+  }
 }
 
 export function tokenize(source: string): Token[] {
@@ -1,6 +1,6 @@
 import { describe, test, expect } from "bun:test";
-import { tokenize } from "./lexer.ts";
-import { parse, ParseError } from "./parser.ts";
+import { tokenize, LexerError, Scanner } from "./lexer.ts";
+import { parse, Parser, ParseError } from "./parser.ts";
 import * as AST from "./ast.ts";
 
 // Helper to parse source code
@@ -446,6 +446,39 @@ describe("Parser", () => {
         expect((e as ParseError).line).toBe(1);
       }
     });
+
+    test("reports lexer errors after a syntax error first", () => {
+      expect(() => new Parser(new Scanner(") x @")).parse()).toThrow(LexerError);
+    });
+
+    test("reports a leading list followed by more stage elements", () => {
+      for (const source of ["((a) b | c)", "((a) b , | c)"]) {
+        try {
+          new Parser(new Scanner(source)).parse();
+          expect(true).toBe(false); // Should not reach here
+        } catch (e) {
+          expect((e as ParseError).message).toContain("Expected ')' after pipeline");
+          expect((e as ParseError).column).toBe(6);
+        }
+      }
+    });
+  });
+
+  describe("Streaming", () => {
+    const sources = [
+      "fn: f (x) (if (< x 3) (+ x 3) (* x 2)); (f 1)",
+      "$$ | split \",\" | (join $ \"-\") | upper",
+      "((fn (x) x) 5)",
+      "(a b | c d | (e))",
+    ];
+
+    for (const source of sources) {
+      test(`parses ${JSON.stringify(source)} like the token array`, () => {
+        for (const shellMode of [false, true]) {
+          expect(new Parser(new Scanner(source), { shellMode }).parse()).toEqual(parse(tokenize(source), { shellMode }));
+        }
+      });
+    }
   });
 
   describe("AST Type Guards", () => {
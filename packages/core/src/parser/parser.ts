@@ -1,5 +1,5 @@
-import type { Token } from "./lexer.ts";
-import { TokenType } from "./lexer.ts";
+import type { Token, TokenSource } from "./lexer.ts";
+import { LexerError, TokenType } from "./lexer.ts";
 import type * as AST from "./ast.ts";
 
 // ============================================
@@ -31,12 +31,14 @@ export interface ParseOptions {
 // ============================================
 
 export class Parser {
-  private tokens: Token[];
-  private current: number = 0;
+  private tokens: TokenSource;
   private options: ParseOptions;
 
-  constructor(tokens: Token[], options: ParseOptions = {}) {
-    this.tokens = tokens;
+  /**
+   * @param tokens A Scanner, read in a single pass, or a Token[] from tokenize()
+   */
+  constructor(tokens: TokenSource | Token[], options: ParseOptions = {}) {
+    this.tokens = Array.isArray(tokens) ? new TokenArray(tokens) : tokens;
     this.options = options;
   }
 
@@ -47,15 +49,24 @@ export class Parser {
   parse(): AST.Program {
     const expressions: AST.SExpr[] = [];
 
-    // Parse all top-level expressions (semicolons separate expressions)
-    while (!this.isAtEnd()) {
-      const expr = this.parseExpression();
-      expressions.push(expr);
+    try {
+      // Parse all top-level expressions (semicolons separate expressions)
+      while (!this.isAtEnd()) {
+        const expr = this.parseExpression();
+        expressions.push(expr);
 
-      // Skip semicolons between expressions
-      while (this.match(TokenType.SEMICOLON)) {
-        // Semicolon consumed
+        // Skip semicolons between expressions
+        while (this.match(TokenType.SEMICOLON)) {
+          // Semicolon consumed
+        }
+      }
+    } catch (error) {
+      // A malformed token anywhere in the source is reported before
+      // syntax errors, as if the whole source had been tokenized first
+      if (!(error instanceof LexerError)) {
+        this.tokens.finish();
       }
+      throw error;
     }
 
     // Shell mode: prepend $$ to last expression if it doesn't contain source refs
@@ -112,10 +123,12 @@ export class Parser {
 
   // Parse pipeline: expr | expr | expr
   private parsePipeline(): AST.SExpr {
-    const stages: AST.SExpr[] = [];
+    return this.parsePipelineFrom(this.parsePrimary());
+  }
 
-    // Parse first stage
-    stages.push(this.parsePrimary());
+  // Parse the stages of a pipeline after its first
+  private parsePipelineFrom(first: AST.SExpr): AST.SExpr {
+    const stages: AST.SExpr[] = [first];
 
     // Parse remaining stages separated by PIPE
     while (this.match(TokenType.PIPE)) {
@@ -160,8 +173,13 @@ export class Parser {
       }
     }
 
+    return this.implicitCall(tokens);
+  }
+
+  // The expression for the tokens of one pipeline stage
+  private implicitCall(tokens: AST.SExpr[]): AST.SExpr {
     if (tokens.length === 0) {
-      throw this.error("Expected expression", this.peek());
+      throw this.error("Expected expression");
     }
 
     // Single token - check if we should wrap it
@@ -189,7 +207,7 @@ export class Parser {
 
   // Check if current token is a delimiter (stops implicit call parsing)
   private isDelimiter(): boolean {
-    const type = this.peek().type;
+    const type = this.tokens.type;
     return (
       type === TokenType.PIPE ||
       type === TokenType.RPAREN ||
@@ -197,6 +215,9 @@ export class Parser {
     );
   }
 
+  // Parse a list or, if there is a pipe at its top level, a parenthesized
+  // pipeline. Both are read in one pass: the elements before the first
+  // pipe become the pipeline's first stage.
   private parseList(): AST.SExpr {
     this.consume(TokenType.LPAREN, "Expected '('");
 
@@ -206,24 +227,49 @@ export class Parser {
       return { type: "List", elements: [] };
     }
 
-    // Check if there are pipes at this level
-    // If yes, parse as pipeline
-    // If no, parse as list of elements
-    if (this.hasPipeAtCurrentLevel()) {
-      // Parse as pipeline
-      const pipeline = this.parsePipeline();
+    // A pipeline whose first stage is a list ends that stage after the
+    // list, so `((a) b | c)` fails at `b`. Where a second element follows a
+    // leading list, keep its position in case a pipe turns up later.
+    const startsWithList = this.check(TokenType.LPAREN);
+    let second: TokenSource | undefined;
+
+    const elements: AST.SExpr[] = [];
+    try {
+      while (!this.isAtEnd() && !this.isDelimiter()) {
+        if (startsWithList && elements.length === 1) {
+          second = this.tokens.fork();
+        }
+        if (this.check(TokenType.LPAREN)) {
+          elements.push(this.parseList());
+        } else {
+          elements.push(this.parseAtom());
+        }
+      }
+    } catch (error) {
+      if (second && error instanceof ParseError && this.hasPipeAtLevel(second)) {
+        throw this.error("Expected ')' after pipeline", second);
+      }
+      throw error;
+    }
+
+    if (this.check(TokenType.PIPE)) {
+      if (second) {
+        throw this.error("Expected ')' after pipeline", second);
+      }
+      const pipeline = this.parsePipelineFrom(this.implicitCall(elements));
       this.consume(TokenType.RPAREN, "Expected ')' after pipeline");
       return pipeline;
     }
 
-    // No pipes, parse as list of space-separated elements
-    const elements: AST.SExpr[] = [];
-    while (!this.check(TokenType.RPAREN) && !this.isAtEnd()) {
-      if (this.check(TokenType.LPAREN)) {
-        elements.push(this.parseList());
-      } else {
-        elements.push(this.parseAtom());
+    // A semicolon ends a pipeline stage but cannot appear in a list
+    if (this.check(TokenType.SEMICOLON)) {
+      if (this.hasPipeAtLevel(this.tokens)) {
+        if (second) {
+          throw this.error("Expected ')' after pipeline", second);
+        }
+        throw this.error(elements.length === 0 ? "Expected expression" : "Expected ')' after pipeline");
       }
+      throw this.error(`Unexpected token: ${TokenType.SEMICOLON}`);
     }
 
     this.consume(TokenType.RPAREN, "Expected ')' after list elements");
@@ -234,41 +280,45 @@ export class Parser {
     };
   }
 
-  // Check if there's a pipe at the current level (not inside nested parens)
-  private hasPipeAtCurrentLevel(): boolean {
+  // Check if there's a pipe at the current level (not inside nested parens),
+  // looking ahead from `from` to the closing paren of the current list
+  private hasPipeAtLevel(from: TokenSource): boolean {
+    const tokens = from.fork();
     let depth = 0;
-    let i = this.current;
-
-    while (i < this.tokens.length) {
-      const token = this.tokens[i]!;
 
-      if (token.type === TokenType.LPAREN) {
+    for (; tokens.type !== TokenType.EOF; tokens.next()) {
+      if (tokens.type === TokenType.LPAREN) {
         depth++;
-      } else if (token.type === TokenType.RPAREN) {
+      } else if (tokens.type === TokenType.RPAREN) {
         if (depth === 0) {
           // Reached the closing paren of current list
           return false;
         }
         depth--;
-      } else if (token.type === TokenType.PIPE && depth === 0) {
+      } else if (tokens.type === TokenType.PIPE && depth === 0) {
         return true;
       }
-
-      i++;
     }
 
     return false;
   }
 
   private parseAtom(): AST.Atom {
-    const token = this.peek();
+    const tokens = this.tokens;
+    const type = tokens.type;
+
+    // Literal values and names are read before moving past the token
+    const value = tokens.value();
+    const raw = type === TokenType.IDENTIFIER || type === TokenType.EFFECT_IDENT || type === TokenType.SOURCE_REF
+      ? undefined
+      : tokens.raw();
 
     if (this.match(TokenType.NUMBER)) {
       return {
         type: "Atom",
         atomType: "number",
-        value: token.value as number,
-        raw: token.raw,
+        value: value as number,
+        raw,
       };
     }
 
@@ -276,13 +326,13 @@ export class Parser {
       return {
         type: "Atom",
         atomType: "string",
-        value: token.value as string,
-        raw: token.raw,
+        value: value as string,
+        raw,
       };
     }
 
     if (this.match(TokenType.REGEX)) {
-      const regexStr = token.value as string;
+      const regexStr = value as string;
       const lastSlash = regexStr.lastIndexOf("/");
       const pattern = regexStr.slice(1, lastSlash);
       const flags = regexStr.slice(lastSlash + 1);
@@ -294,7 +344,7 @@ export class Parser {
         type: "Atom",
         atomType: "regex",
         value: regexValue,
-        raw: token.raw,
+        raw,
       };
     }
 
@@ -302,8 +352,8 @@ export class Parser {
       return {
         type: "Atom",
         atomType: "boolean",
-        value: token.value as boolean,
-        raw: token.raw,
+        value: value as boolean,
+        raw,
       };
     }
 
@@ -312,7 +362,7 @@ export class Parser {
         type: "Atom",
         atomType: "null",
         value: null,
-        raw: token.raw,
+        raw,
       };
     }
 
@@ -320,7 +370,7 @@ export class Parser {
       return {
         type: "Atom",
         atomType: "identifier",
-        value: String(token.value),
+        value: value as string,
       };
     }
 
@@ -328,7 +378,7 @@ export class Parser {
       return {
         type: "Atom",
         atomType: "effect",
-        value: String(token.value),
+        value: value as string,
       };
     }
 
@@ -336,63 +386,101 @@ export class Parser {
       return {
         type: "Atom",
         atomType: "identifier",
-        value: String(token.value),
+        value: value as string,
       };
     }
 
-    throw this.error(`Unexpected token: ${token.type}`, token);
+    throw this.error(`Unexpected token: ${type}`);
   }
 
   // ============================================
   // Token Navigation Helpers
   // ============================================
 
-  private peek(): Token {
-    return this.tokens[this.current]!;
-  }
-
-  private previous(): Token {
-    return this.tokens[this.current - 1] ?? this.tokens[0]!;
-  }
-
   private isAtEnd(): boolean {
-    return this.peek().type === TokenType.EOF;
+    return this.tokens.type === TokenType.EOF;
   }
 
-  private advance(): Token {
-    if (!this.isAtEnd()) this.current++;
-    return this.previous();
+  private advance(): void {
+    this.tokens.next();
   }
 
   private check(type: TokenType): boolean {
     if (this.isAtEnd()) return false;
-    return this.peek().type === type;
+    return this.tokens.type === type;
   }
 
-  private match(...types: TokenType[]): boolean {
-    for (const type of types) {
-      if (this.check(type)) {
-        this.advance();
-        return true;
-      }
+  private match(type: TokenType): boolean {
+    if (this.check(type)) {
+      this.advance();
+      return true;
     }
     return false;
   }
 
-  private consume(type: TokenType, message: string): Token {
-    if (this.check(type)) return this.advance();
-    throw this.error(message, this.peek());
+  private consume(type: TokenType, message: string): void {
+    if (!this.match(type)) {
+      throw this.error(message);
+    }
   }
 
   // ============================================
   // Error Handling
   // ============================================
 
-  private error(message: string, token: Token): ParseError {
+  // Error at the current token, or at the token `at` is positioned on
+  private error(message: string, at: TokenSource = this.tokens): ParseError {
+    const token = at.token();
     return new ParseError(message, token.line, token.column, token);
   }
 }
 
+/**
+ * TokenSource over the output of tokenize()
+ */
+class TokenArray implements TokenSource {
+  constructor(
+    private readonly tokens: Token[],
+    private index: number = 0
+  ) {}
+
+  get type(): TokenType {
+    return this.tokens[this.index]!.type;
+  }
+
+  get line(): number {
+    return this.tokens[this.index]!.line;
+  }
+
+  get column(): number {
+    return this.tokens[this.index]!.column;
+  }
+
+  next(): void {
+    if (this.type !== TokenType.EOF) this.index++;
+  }
+
+  value(): string | number | boolean | null {
+    return this.tokens[this.index]!.value;
+  }
+
+  raw(): string {
+    return this.tokens[this.index]!.raw;
+  }
+
+  token(): Token {
+    return this.tokens[this.index]!;
+  }
+
+  fork(): TokenSource {
+    return new TokenArray(this.tokens, this.index);
+  }
+
+  finish(): void {
+    // Already tokenized
+  }
+}
+
 // ============================================
 // Convenience Function
 // ============================================
@@ -16,7 +16,9 @@ import {
   isNull,
   isString,
   isArray,
+  isObject,
   isRegex,
+  getProperty,
   toNumber,
   toString,
   toBoolean,
@@ -114,18 +116,14 @@ const split: VMBuiltin = (args) => {
   const delimiter = toString(args[1]!).value;
   const limit = args[2] ? toNumber(args[2]).value : undefined;
 
-  let parts: string[];
-  if (delimiter === "") {
-    parts = str.split("");
-  } else {
-    parts = str.split(delimiter);
-  }
-
-  if (limit !== undefined && !Number.isNaN(limit) && limit > 0) {
-    parts = parts.slice(0, Math.floor(limit));
+  // Passing the limit to String.prototype.split stops it from materializing
+  // parts that would be dropped; it wraps limits of 2^32 and above.
+  let count: number | undefined;
+  if (limit !== undefined && !Number.isNaN(limit) && limit > 0 && limit < 2 ** 32) {
+    count = Math.floor(limit);
   }
 
-  return arrayValue(parts.map((s) => stringValue(s)));
+  return arrayValue(str.split(delimiter, count).map((s) => stringValue(s)));
 };
 
 /**
@@ -135,12 +133,16 @@ const split: VMBuiltin = (args) => {
  * Returns: concatenated string (no separator)
  */
 const join: VMBuiltin = (args) => {
-  if (args.length === 0) {
-    return stringValue("");
+  if (args.length === 1 && isString(args[0]!)) {
+    return args[0]!;
   }
 
-  const parts = args.map((arg) => toString(arg).value);
-  return stringValue(parts.join(""));
+  // Concatenating lets V8 build a rope and flatten it only when read
+  let result = "";
+  for (const arg of args) {
+    result += toString(arg).value;
+  }
+  return stringValue(result);
 };
 
 /**
@@ -150,7 +152,8 @@ const join: VMBuiltin = (args) => {
 const trim: VMBuiltin = (args) => {
   checkArity("trim", args, 1);
   const str = toString(args[0]!).value;
-  return stringValue(str.trim());
+  const trimmed = str.trim();
+  return trimmed.length === str.length && isString(args[0]!) ? args[0]! : stringValue(trimmed);
 };
 
 /**
@@ -189,7 +192,14 @@ const replace: VMBuiltin = (args) => {
 
   let result: string;
   if (isRegex(pattern)) {
-    result = str.replace(pattern.regex, replacement);
+    const kernel = pattern.kernel;
+    // V8 already scans literal regexes as substrings, so only classes gain
+    if (kernel !== null && kernel.literal === null && !replacement.includes("$")) {
+      result = kernel.replace(str, replacement);
+    } else {
+      pattern.regex.lastIndex = 0;
+      result = str.replace(pattern.regex, replacement);
+    }
   } else {
     const searchStr = toString(pattern).value;
     result = str.replace(searchStr, replacement);
@@ -324,20 +334,27 @@ const last: VMBuiltin = (args) => {
 };
 
 /**
- * get - Get an element from an array by index
- * Signature: get(array, index, default?)
- * - array: array to index into
- * - index: numeric index (floored)
- * - default: optional default value if index is out of bounds
- * Returns: element at index, or default (or null if no default)
+ * get - Get an element from an array by index, or a property of an object
+ * Signature: get(collection, key, default?)
+ * - collection: array to index into, or object to look the key up in
+ * - key: numeric index (floored) for arrays, key (as a string) for objects
+ * - default: optional default value if the index is out of bounds or the
+ *   object does not have the key
+ * Returns: element or property, or default (or null if no default)
  */
 const get: VMBuiltin = (args) => {
   checkArity("get", args, [2, 3]);
-  expectType("get", args[0]!, "array", 0);
+  const defaultValue = args[2] ?? nullValue();
+
+  if (isObject(args[0]!)) {
+    return getProperty(args[0], toString(args[1]!).value) ?? defaultValue;
+  }
+  if (!isArray(args[0]!)) {
+    throw new VMRuntimeError(`get expects array or object (argument 1), got ${args[0]!.type}`);
+  }
 
   const arr = args[0] as any;
   const index = Math.floor(toNumber(args[1]!).value);
-  const defaultValue = args[2] ?? nullValue();
 
   if (index < 0 || index >= arr.elements.length) {
     return defaultValue;
@@ -534,7 +551,13 @@ const match: VMBuiltin = (args) => {
     throw new VMRuntimeError("match expects a regex as second argument");
   }
 
-  const result = str.match(pattern.regex);
+  let result: string[] | null;
+  if (pattern.kernel !== null) {
+    result = pattern.kernel.match(str);
+  } else {
+    pattern.regex.lastIndex = 0;
+    result = str.match(pattern.regex);
+  }
   if (result === null) {
     return nullValue();
   }
@@ -556,6 +579,11 @@ const test: VMBuiltin = (args) => {
     throw new VMRuntimeError("test expects a regex as second argument");
   }
 
+  if (pattern.kernel !== null) {
+    return booleanValue(pattern.kernel.find(str, 0) !== -1);
+  }
+  // test() on a global or sticky regex starts at, and updates, lastIndex
+  pattern.regex.lastIndex = 0;
   return booleanValue(pattern.regex.test(str));
 };
 
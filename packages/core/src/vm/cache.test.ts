@@ -0,0 +1,106 @@
+/**
+ * Tests for the compilation cache.
+ */
+
+import { describe, test as it, expect, afterEach } from "bun:test";
+import { mkdtempSync, readdirSync, rmSync, writeFileSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { COMPILER_VERSION, CompilationCache } from "./cache.ts";
+import { CODEGEN_REVISION } from "../codegen/bytecode.ts";
+import { compilePEX } from "./index.ts";
+import { VM, throwingEffectHandler } from "./vm.ts";
+import { stringValue } from "./values.ts";
+import { writeBytecode } from "../bytecode/writer.ts";
+
+const directories: string[] = [];
+
+function tempDirectory(): string {
+  const directory = mkdtempSync(join(tmpdir(), "pex-cache-"));
+  directories.push(directory);
+  return directory;
+}
+
+afterEach(() => {
+  for (const directory of directories.splice(0)) {
+    rmSync(directory, { recursive: true, force: true });
+  }
+});
+
+describe("CompilationCache", () => {
+  it("serves repeated compilations from memory", () => {
+    const cache = new CompilationCache();
+    const first = cache.compile("$$ | upper");
+    expect(cache.compile("$$ | upper")).toBe(first);
+    expect(cache.stats()).toMatchObject({ memoryHits: 1, diskHits: 0, misses: 1, hitRate: 0.5 });
+  });
+
+  it("produces the same bytecode as the compiler", () => {
+    const cache = new CompilationCache();
+    const source = "fn: f (x) (+ x 1); (f 2)";
+    expect(cache.compileToBytes(source, { optimize: true }))
+      .toEqual(writeBytecode(compilePEX(source, { optimize: true })));
+  });
+
+  it("keys entries by compile options and version", () => {
+    const cache = new CompilationCache();
+    expect(cache.key("upper")).not.toBe(cache.key("upper", { shellMode: true }));
+    expect(cache.key("upper")).not.toBe(cache.key("upper", { optimize: true }));
+    expect(cache.key("upper")).not.toBe(new CompilationCache({ version: "other" }).key("upper"));
+    expect(cache.key("upper")).toBe(new CompilationCache().key("upper"));
+    expect(COMPILER_VERSION).toContain(`+cg${CODEGEN_REVISION}`);
+  });
+
+  it("compiles shell-mode programs", () => {
+    const cache = new CompilationCache();
+    const vm = new VM(cache.compile("upper | trim", { shellMode: true }), throwingEffectHandler);
+    expect(vm.run(stringValue(" a "))).toEqual(stringValue("A"));
+  });
+
+  it("evicts the least recently used entry", () => {
+    const cache = new CompilationCache({ maxEntries: 2 });
+    cache.compile("1");
+    cache.compile("2");
+    cache.compile("1");
+    cache.compile("3");
+    cache.compile("1");
+    expect(cache.stats()).toMatchObject({ memoryHits: 2, misses: 3, evictions: 1, entries: 2 });
+    cache.compile("2");
+    expect(cache.stats().misses).toBe(4);
+  });
+
+  it("shares entries between caches through a directory", () => {
+    const directory = tempDirectory();
+    new CompilationCache({ directory }).compile("$$ | lower");
+    expect(readdirSync(directory).filter((name) => name.endsWith(".pexb"))).toHaveLength(1);
+
+    const other = new CompilationCache({ directory });
+    const bytecode = other.compile("$$ | lower");
+    expect(other.stats()).toMatchObject({ diskHits: 1, misses: 0 });
+    expect(new VM(bytecode, throwingEffectHandler).run(stringValue("AB"))).toEqual(stringValue("ab"));
+  });
+
+  it("recompiles corrupt directory entries", () => {
+    const directory = tempDirectory();
+    const cache = new CompilationCache({ directory });
+    writeFileSync(join(directory, cache.key("$$") + ".pexb"), "not bytecode");
+
+    cache.compile("$$");
+    expect(cache.stats()).toMatchObject({ diskHits: 0, misses: 1 });
+    new CompilationCache({ directory }).compile("$$");
+    expect(readdirSync(directory)).toHaveLength(1);
+  });
+
+  it("does not cache failed compilations", () => {
+    const cache = new CompilationCache();
+    expect(() => cache.compile("(")).toThrow();
+    expect(cache.stats()).toMatchObject({ misses: 1, entries: 0 });
+  });
+
+  it("is used by compilePEX", () => {
+    const cache = new CompilationCache();
+    compilePEX("(+ 1 2)", { cache });
+    compilePEX("(+ 1 2)", { cache });
+    expect(cache.stats()).toMatchObject({ memoryHits: 1, misses: 1 });
+  });
+});
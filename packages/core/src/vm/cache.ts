@@ -0,0 +1,251 @@
+/**
+ * Content-addressed compilation cache.
+ *
+ * Programs are keyed by a SHA-256 hash of the source, the compile options
+ * and the compiler version, and stored as serialized `.pexb` bytes. Lookups
+ * check an in-process LRU first, then an optional directory that several
+ * processes can share. A hit opens the stored bytes with openBytecode(), so
+ * it skips the lexer, parser, lowering and codegen entirely.
+ *
+ * Directory entries are written to a temporary file and renamed into place,
+ * so concurrent writers never expose a partial file. Entries that fail to
+ * open are treated as misses and overwritten.
+ *
+ * This module uses node:fs and node:crypto and is exported from
+ * "@pex/core/cache" rather than the main entry point; compilePEX() accepts a
+ * cache through its options.
+ */
+
+import { createHash } from "node:crypto";
+import { mkdirSync, readFileSync, renameSync, rmSync, writeFileSync } from "node:fs";
+import { join } from "node:path";
+import type { BytecodeFile } from "../bytecode/format.ts";
+import { VERSION_MAJOR, VERSION_MINOR } from "../bytecode/format.ts";
+import { openBytecode } from "../bytecode/reader.ts";
+import { writeBytecode } from "../bytecode/writer.ts";
+import { parse } from "../parser/index.ts";
+import { lowerProgramToArena } from "../ir/lower.ts";
+import { optimizeIR } from "../ir/optimize.ts";
+import { CODEGEN_REVISION, generateBytecode } from "../codegen/bytecode.ts";
+import { optimizeBytecode } from "../codegen/peephole.ts";
+
+/**
+ * Compiler version mixed into every cache key. It follows the bytecode
+ * format and CODEGEN_REVISION, which is bumped whenever the bytecode
+ * generated for the same source changes, so stale entries in shared
+ * directories are never reused.
+ */
+export const COMPILER_VERSION = `0.1.1+pexb${VERSION_MAJOR}.${VERSION_MINOR}+cg${CODEGEN_REVISION}`;
+
+const DEFAULT_MAX_ENTRIES = 256;
+const ENTRY_EXTENSION = ".pexb";
+
+/**
+ * Options for a CompilationCache.
+ */
+export interface CompilationCacheOptions {
+  /** Maximum number of programs kept in memory (default: 256). */
+  maxEntries?: number;
+  /** Directory for entries shared between processes. Created if missing. */
+  directory?: string;
+  /** Version string mixed into keys (default: COMPILER_VERSION). */
+  version?: string;
+}
+
+/**
+ * Options that change the compiled output, and so are part of the key.
+ */
+export interface CachedCompileOptions {
+  /** Run the IR and peephole optimizers. Defaults to false. */
+  optimize?: boolean;
+  /** Parse in shell mode (auto-inject $$). Defaults to false. */
+  shellMode?: boolean;
+}
+
+/**
+ * Hit and miss counts for a CompilationCache.
+ */
+export interface CompilationCacheStats {
+  memoryHits: number;
+  diskHits: number;
+  misses: number;
+  /** Entries evicted from memory. */
+  evictions: number;
+  /** Entries currently held in memory. */
+  entries: number;
+  /** Hits (memory or disk) over lookups, or 0 before the first lookup. */
+  hitRate: number;
+}
+
+interface CacheEntry {
+  bytes: Uint8Array;
+  bytecode: BytecodeFile;
+}
+
+/**
+ * A two-level cache of compiled programs: an in-process LRU backed by an
+ * optional shared directory.
+ */
+export class CompilationCache {
+  private readonly entries: Map<string, CacheEntry> = new Map();
+  private readonly maxEntries: number;
+  private readonly directory: string | null;
+  private readonly version: string;
+
+  private memoryHits: number = 0;
+  private diskHits: number = 0;
+  private misses: number = 0;
+  private evictions: number = 0;
+
+  constructor(options: CompilationCacheOptions = {}) {
+    this.maxEntries = options.maxEntries ?? DEFAULT_MAX_ENTRIES;
+    this.directory = options.directory ?? null;
+    this.version = options.version ?? COMPILER_VERSION;
+
+    if (!Number.isInteger(this.maxEntries) || this.maxEntries < 0) {
+      throw new RangeError(`Max entries must be a non-negative integer, got ${this.maxEntries}`);
+    }
+    if (this.directory !== null) {
+      mkdirSync(this.directory, { recursive: true });
+    }
+  }
+
+  /**
+   * Content address of a program: a hex SHA-256 digest.
+   */
+  key(source: string, options: CachedCompileOptions = {}): string {
+    return createHash("sha256")
+      .update(this.version)
+      .update(options.optimize ? "\0O1" : "\0O0")
+      .update(options.shellMode ? "\0S1\0" : "\0S0\0")
+      .update(source)
+      .digest("hex");
+  }
+
+  /**
+   * Compile `source`, or return the cached bytecode for it.
+   *
+   * @throws Whatever the compiler throws; failed compilations are not cached
+   */
+  compile(source: string, options: CachedCompileOptions = {}): BytecodeFile {
+    return this.lookup(this.key(source, options), source, options).bytecode;
+  }
+
+  /**
+   * Like compile(), but returns the serialized `.pexb` bytes.
+   */
+  compileToBytes(source: string, options: CachedCompileOptions = {}): Uint8Array {
+    return this.lookup(this.key(source, options), source, options).bytes;
+  }
+
+  stats(): CompilationCacheStats {
+    const hits = this.memoryHits + this.diskHits;
+    const lookups = hits + this.misses;
+    return {
+      memoryHits: this.memoryHits,
+      diskHits: this.diskHits,
+      misses: this.misses,
+      evictions: this.evictions,
+      entries: this.entries.size,
+      hitRate: lookups === 0 ? 0 : hits / lookups,
+    };
+  }
+
+  /**
+   * Drop every in-memory entry. The shared directory is left alone.
+   */
+  clear(): void {
+    this.entries.clear();
+  }
+
+  private lookup(key: string, source: string, options: CachedCompileOptions): CacheEntry {
+    const cached = this.entries.get(key);
+    if (cached) {
+      // Re-insert to mark as most recently used
+      this.entries.delete(key);
+      this.entries.set(key, cached);
+      this.memoryHits++;
+      return cached;
+    }
+
+    let entry = this.readEntry(key);
+    if (entry) {
+      this.diskHits++;
+    } else {
+      this.misses++;
+      const bytecode = compileSource(source, options);
+      entry = { bytes: writeBytecode(bytecode), bytecode };
+      this.writeEntry(key, entry.bytes);
+    }
+
+    this.remember(key, entry);
+    return entry;
+  }
+
+  private remember(key: string, entry: CacheEntry): void {
+    if (this.maxEntries === 0) {
+      return;
+    }
+    if (this.entries.size >= this.maxEntries) {
+      // Map iteration order is insertion order, so the first key is the LRU
+      this.entries.delete(this.entries.keys().next().value!);
+      this.evictions++;
+    }
+    this.entries.set(key, entry);
+  }
+
+  private readEntry(key: string): CacheEntry | null {
+    if (this.directory === null) {
+      return null;
+    }
+
+    let bytes: Uint8Array;
+    try {
+      bytes = readEntryFile(join(this.directory, key + ENTRY_EXTENSION));
+    } catch {
+      return null;
+    }
+    try {
+      return { bytes, bytecode: openBytecode(bytes) };
+    } catch {
+      // Corrupt or foreign file: recompile and overwrite it
+      return null;
+    }
+  }
+
+  private writeEntry(key: string, bytes: Uint8Array): void {
+    if (this.directory === null) {
+      return;
+    }
+
+    const path = join(this.directory, key + ENTRY_EXTENSION);
+    const temp = `${path}.${process.pid}.${Math.random().toString(36).slice(2)}.tmp`;
+    try {
+      writeFileSync(temp, bytes);
+      renameSync(temp, path);
+    } catch {
+      // The cache is an optimization; an unwritable directory is not fatal
+      rmSync(temp, { force: true });
+    }
+  }
+}
+
+/**
+ * Run the full compiler pipeline.
+ */
+function compileSource(source: string, options: CachedCompileOptions): BytecodeFile {
+  const ast = parse(source, { shellMode: options.shellMode ?? false });
+  const ir = lowerProgramToArena(ast);
+  return options.optimize ? optimizeBytecode(generateBytecode(optimizeIR(ir))) : generateBytecode(ir);
+}
+
+/**
+ * Read a cache entry. Under Bun the file is memory-mapped; entries are only
+ * ever replaced by rename, so a mapping never sees a file change under it.
+ */
+function readEntryFile(path: string): Uint8Array {
+  if (typeof Bun !== "undefined") {
+    return Bun.mmap(path);
+  }
+  return readFileSync(path);
+}
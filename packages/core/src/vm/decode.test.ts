@@ -0,0 +1,92 @@
+/**
+ * Tests for pre-decoded instruction tables.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import { Opcode } from "../bytecode/opcodes.ts";
+import {
+  DECODED_EXTRA_1,
+  DECODED_EXTRA_2,
+  DECODED_NEXT,
+  DECODED_OPCODE,
+  DECODED_OPERAND,
+  DECODED_STRIDE,
+  DECODED_TRUNCATED,
+  decodeFunction,
+} from "./decode.ts";
+
+/** The decoded entry at byte offset `ip`. */
+function entry(decoded: Int32Array, ip: number) {
+  const base = ip * DECODED_STRIDE;
+  return {
+    opcode: decoded[base + DECODED_OPCODE],
+    operand: decoded[base + DECODED_OPERAND],
+    extra: [decoded[base + DECODED_EXTRA_1], decoded[base + DECODED_EXTRA_2]],
+    next: decoded[base + DECODED_NEXT],
+  };
+}
+
+describe("decodeFunction", () => {
+  it("widens operands and folds widths into the _U8 opcode", () => {
+    const decoded = decodeFunction(
+      new Uint8Array([
+        Opcode.CONST_U16, 0x34, 0x12,
+        Opcode.LOAD_LOCAL_U32, 0x01, 0x00, 0x01, 0x00,
+        Opcode.CALL_BUILTIN_U16_U8, 0x00, 0x01, 2,
+        Opcode.LOAD_LOCAL_CALL_BUILTIN_U8, 0, 3, 1,
+        Opcode.RETURN,
+      ])
+    );
+
+    expect(entry(decoded, 0)).toEqual({ opcode: Opcode.CONST_U8, operand: 0x1234, extra: [0, 0], next: 3 });
+    expect(entry(decoded, 3)).toEqual({ opcode: Opcode.LOAD_LOCAL_U8, operand: 0x10001, extra: [0, 0], next: 8 });
+    expect(entry(decoded, 8)).toEqual({ opcode: Opcode.CALL_BUILTIN_U8_U8, operand: 0x100, extra: [2, 0], next: 12 });
+    expect(entry(decoded, 12)).toEqual({
+      opcode: Opcode.LOAD_LOCAL_CALL_BUILTIN_U8,
+      operand: 0,
+      extra: [3, 1],
+      next: 16,
+    });
+    expect(entry(decoded, 16)).toEqual({ opcode: Opcode.RETURN, operand: 0, extra: [0, 0], next: 17 });
+  });
+
+  it("resolves jumps to absolute offsets", () => {
+    const decoded = decodeFunction(
+      new Uint8Array([
+        Opcode.CONST_TRUE,
+        Opcode.JUMP_IF_FALSE_U16, 0x02, 0x00, // to 6
+        Opcode.JUMP_U8, 0xfc, // back to 2
+        Opcode.LT_JUMP_IF_FALSE_U8, 0x80, // before the start
+        Opcode.RETURN,
+      ])
+    );
+
+    expect(entry(decoded, 1).operand).toBe(6);
+    expect(entry(decoded, 4).operand).toBe(2);
+    expect(entry(decoded, 6).operand).toBe(8 - 128);
+  });
+
+  it("decodes jump targets inside another instruction", () => {
+    // The jump lands on the operand byte of CONST_U8, which reads as CONST_ONE
+    const decoded = decodeFunction(
+      new Uint8Array([Opcode.JUMP_U8, 1, Opcode.CONST_U8, Opcode.CONST_ONE, Opcode.RETURN])
+    );
+
+    expect(entry(decoded, 2).opcode).toBe(Opcode.CONST_U8);
+    expect(entry(decoded, 3)).toEqual({ opcode: Opcode.CONST_ONE, operand: 0, extra: [0, 0], next: 4 });
+  });
+
+  it("marks malformed instructions", () => {
+    expect(entry(decodeFunction(new Uint8Array([0xff])), 0)).toEqual({
+      opcode: 0xff,
+      operand: 0,
+      extra: [0, 0],
+      next: 1,
+    });
+
+    // The failing read is the trailing argument count
+    const truncated = entry(decodeFunction(new Uint8Array([Opcode.NOP, Opcode.CALL_BUILTIN_U16_U8, 0, 0])), 1);
+    expect(truncated.opcode).toBe(DECODED_TRUNCATED);
+    expect(truncated.operand).toBe(4);
+  });
+});
@@ -0,0 +1,158 @@
+/**
+ * Pre-decoded instruction tables for the interpreter.
+ *
+ * Bytecode stores each operand at the narrowest width that fits, so the
+ * same instruction has _U8, _U16 and _U32 variants. Before a function first
+ * runs, its code is decoded once into a fixed-width table indexed by byte
+ * offset. Each entry holds:
+ * - the opcode, with the operand width folded into its _U8 variant
+ * - the operand, widened to a full integer (jumps: the absolute target)
+ * - up to two trailing u8 operands
+ * - the offset of the next instruction
+ *
+ * Instruction pointers stay byte offsets, so error locations, profiles,
+ * debug info and suspended continuations mean the same thing as before.
+ * Only offsets that execution can reach are decoded: the entry point, every
+ * instruction that follows a decoded one, and every jump target.
+ */
+
+import { OPCODE_METADATA, Opcode, OperandType, isValidOpcode } from "../bytecode/opcodes.ts";
+
+/** Number of Int32Array slots per byte offset. */
+export const DECODED_STRIDE = 5;
+
+/** Field offsets within an entry. */
+export const DECODED_OPCODE = 0;
+export const DECODED_OPERAND = 1;
+export const DECODED_EXTRA_1 = 2;
+export const DECODED_EXTRA_2 = 3;
+export const DECODED_NEXT = 4;
+
+/**
+ * Opcode of an entry whose operands run past the end of the code. Its
+ * operand is the offset of the read that fails.
+ */
+export const DECODED_TRUNCATED = -1;
+
+/**
+ * Decode one function's code. Entries for offsets that cannot be reached
+ * are left zeroed; an invalid opcode is kept as-is with the next offset
+ * after it, so executing it reports the same error as before.
+ */
+export function decodeFunction(code: Uint8Array): Int32Array {
+  const decoded = new Int32Array(code.length * DECODED_STRIDE);
+  const visited = new Uint8Array(code.length);
+  const pending = [0];
+
+  while (pending.length > 0) {
+    let ip = pending.pop()!;
+    while (ip >= 0 && ip < code.length && visited[ip] === 0) {
+      visited[ip] = 1;
+      ip = decodeInstruction(code, ip, decoded, pending);
+    }
+  }
+
+  return decoded;
+}
+
+/**
+ * Decode the instruction at `ip`, queueing its jump target if it has one.
+ * @returns The offset of the next instruction, or -1 if decoding stops here
+ */
+function decodeInstruction(code: Uint8Array, ip: number, decoded: Int32Array, pending: number[]): number {
+  const base = ip * DECODED_STRIDE;
+  const opcode = code[ip]!;
+
+  if (!isValidOpcode(opcode)) {
+    decoded[base + DECODED_OPCODE] = opcode;
+    decoded[base + DECODED_NEXT] = ip + 1;
+    return -1;
+  }
+
+  const metadata = OPCODE_METADATA[opcode];
+  const extraOperands = metadata.extraOperands ?? 0;
+  let at = ip + 1;
+
+  let operand = 0;
+  switch (metadata.operandType) {
+    case OperandType.NONE:
+      break;
+    case OperandType.U8:
+      if (at >= code.length) return truncated(decoded, base, at);
+      // Sign-extended below if this is a jump
+      operand = code[at]!;
+      at += 1;
+      break;
+    case OperandType.U16:
+      if (at + 1 >= code.length) return truncated(decoded, base, at);
+      operand = code[at]! | (code[at + 1]! << 8);
+      at += 2;
+      break;
+    case OperandType.U32:
+      if (at + 3 >= code.length) return truncated(decoded, base, at);
+      operand = code[at]! | (code[at + 1]! << 8) | (code[at + 2]! << 16) | (code[at + 3]! << 24);
+      at += 4;
+      break;
+  }
+
+  for (let i = 0; i < extraOperands; i++) {
+    if (at + i >= code.length) return truncated(decoded, base, at + i);
+    decoded[base + DECODED_EXTRA_1 + i] = code[at + i]!;
+  }
+  const next = at + extraOperands;
+
+  const narrow = narrowOpcode(opcode);
+  if (isJump(narrow)) {
+    operand = next + signExtend(operand, metadata.operandType);
+    if (operand >= 0 && operand < code.length) {
+      pending.push(operand);
+    }
+  }
+
+  decoded[base + DECODED_OPCODE] = narrow;
+  decoded[base + DECODED_OPERAND] = operand;
+  decoded[base + DECODED_NEXT] = next;
+  return next;
+}
+
+function truncated(decoded: Int32Array, base: number, at: number): number {
+  decoded[base + DECODED_OPCODE] = DECODED_TRUNCATED;
+  decoded[base + DECODED_OPERAND] = at;
+  return -1;
+}
+
+/**
+ * The _U8 variant of an opcode. Variants differ only in the top two bits
+ * (0x40 u8, 0x80 u16, 0xC0 u32).
+ */
+function narrowOpcode(opcode: Opcode): Opcode {
+  return opcode >= 0x80 ? (((opcode & 0x3f) | 0x40) as Opcode) : opcode;
+}
+
+function signExtend(value: number, type: OperandType): number {
+  switch (type) {
+    case OperandType.U8:
+      return (value << 24) >> 24;
+    case OperandType.U16:
+      return (value << 16) >> 16;
+    default:
+      return value | 0;
+  }
+}
+
+function isJump(opcode: Opcode): boolean {
+  switch (opcode) {
+    case Opcode.JUMP_U8:
+    case Opcode.JUMP_IF_FALSE_U8:
+    case Opcode.JUMP_IF_TRUE_U8:
+    case Opcode.EQ_JUMP_IF_FALSE_U8:
+    case Opcode.NE_JUMP_IF_FALSE_U8:
+    case Opcode.LT_JUMP_IF_FALSE_U8:
+    case Opcode.GT_JUMP_IF_FALSE_U8:
+    case Opcode.LE_JUMP_IF_FALSE_U8:
+    case Opcode.GE_JUMP_IF_FALSE_U8:
+      return true;
+    default:
+      return false;
+  }
+}
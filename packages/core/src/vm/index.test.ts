@@ -128,6 +128,17 @@ describe("VM Public API - Value Creation", () => {
     expect(vmApi.isObject(value)).toBe(true);
   });
 
+  it("reads object properties through the helpers", () => {
+    const value = vmApi.objectValue(new Map([["a", vmApi.numberValue(1)], ["b", vmApi.stringValue("x")]]));
+    expect(vmApi.getProperty(value, "b")).toEqual(vmApi.stringValue("x"));
+    expect(vmApi.getProperty(value, "c")).toBeUndefined();
+    expect(vmApi.objectEntries(value)).toEqual([
+      ["a", vmApi.numberValue(1)],
+      ["b", vmApi.stringValue("x")],
+    ]);
+    expect("properties" in value).toBe(false);
+  });
+
   it("creates regex values", () => {
     const value = vmApi.regexValue("\\d+", "g");
     expect(value.type).toBe("regex");
@@ -185,6 +196,14 @@ describe("VM Public API - Value Helpers", () => {
     expect(result.type).toBe("string");
     expect(result.value).toBe("42");
   });
+
+  it("converts to and from JSON", () => {
+    const json = { name: "pex", tags: ["a", 1, true, null], nested: { x: 1.5 } };
+    const value = vmApi.valueFromJSON(json);
+    expect(value.type).toBe("object");
+    expect(vmApi.valueToJSON(value)).toEqual(json);
+    expect(vmApi.valueToJSON(vmApi.regexValue("a+", "g"))).toBe("/a+/g");
+  });
 });
 
 describe("VM Public API - Builtins", () => {
@@ -15,9 +15,18 @@
 // Core VM
 // =============================================================================
 
-export { VM, VMError, Continuation } from "./vm.ts";
-export type { EffectHandler } from "./vm.ts";
-export { throwingEffectHandler, runVM } from "./vm.ts";
+export { VM, VMError, VMBudgetError, Continuation } from "./vm.ts";
+export type { EffectHandler, BatchEffectHandler, VMLimits } from "./vm.ts";
+export { throwingEffectHandler, runVM, runVMBatch } from "./vm.ts";
+export { VMProfiler } from "./profiler.ts";
+export type {
+  VMProfileReport,
+  OpcodeProfile,
+  BuiltinProfile,
+  FunctionProfile,
+  LocationProfile,
+  HistogramBucket,
+} from "./profiler.ts";
 
 // =============================================================================
 // Value Types and Helpers
@@ -46,6 +55,7 @@ export {
   stringValue,
   arrayValue,
   objectValue,
+  shapedObjectValue,
   regexValue,
   closureValue,
   continuationValue,
@@ -73,8 +83,15 @@ export {
   toBoolean,
   toNumber,
   toString,
+  valueFromJSON,
+  valueToJSON,
+  valueBytes,
+  getProperty,
+  objectEntries,
 } from "./values.ts";
 
+export { Shape, MAX_TRANSITIONS, MAX_SHARED_KEYS, MAX_SHARED_SHAPES } from "./shape.ts";
+
 // =============================================================================
 // Builtin Functions
 // =============================================================================
@@ -96,12 +113,15 @@ export { throwingEffectHandler as defaultEffectHandler, Continuation as EffectCo
 import type { Value } from "./values.ts";
 import { nullValue } from "./values.ts";
 import type { VMBuiltin } from "./builtins.ts";
-import type { EffectHandler } from "./vm.ts";
+import type { EffectHandler, VMLimits } from "./vm.ts";
 import { VM, throwingEffectHandler } from "./vm.ts";
 import type { BytecodeFile } from "../bytecode/format.ts";
+import type { CompilationCache } from "./cache.ts";
 import { parse } from "../parser/index.ts";
-import { lowerProgram } from "../ir/lower.ts";
+import { lowerProgramToArena } from "../ir/lower.ts";
+import { optimizeIR } from "../ir/optimize.ts";
 import { generateBytecode } from "../codegen/bytecode.ts";
+import { optimizeBytecode } from "../codegen/peephole.ts";
 
 /**
  * Options for running PEX code on the VM.
@@ -124,6 +144,33 @@ export interface RunOptions {
    * Map from builtin name to implementation.
    */
   builtinOverrides?: Map<string, VMBuiltin>;
+
+  /**
+   * Fuel, frame and memory budgets for the run (see VMLimits). Exceeding
+   * one throws a VMBudgetError.
+   */
+  limits?: VMLimits;
+}
+
+/**
+ * Options for compiling PEX code to bytecode.
+ */
+export interface CompileOptions {
+  /**
+   * Fold constants and inline lets in the IR (see optimizeIR), then run the
+   * peephole optimizer over the generated bytecode, fusing common
+   * instruction pairs into superinstructions. Defaults to false.
+   *
+   * Folding evaluates builtins at compile time, so don't combine it with
+   * VMs that replace builtins through `builtinOverrides`.
+   */
+  optimize?: boolean;
+
+  /**
+   * Look the program up in (and add it to) a compilation cache. A hit skips
+   * parsing, lowering and codegen. See "@pex/core/cache".
+   */
+  cache?: CompilationCache;
 }
 
 /**
@@ -173,7 +220,7 @@ export function executePEX(source: string, options: RunOptions = {}): Value {
   const ast = parse(source);
 
   // Step 2: Lower AST to IR
-  const ir = lowerProgram(ast);
+  const ir = lowerProgramToArena(ast);
 
   // Step 3: Generate bytecode from IR
   const bytecode = generateBytecode(ir);
@@ -181,7 +228,7 @@ export function executePEX(source: string, options: RunOptions = {}): Value {
   // Step 4: Execute on VM
   const input = options.input ?? nullValue();
   const effectHandler = options.effectHandler ?? throwingEffectHandler;
-  const vm = new VM(bytecode, effectHandler, options.builtinOverrides);
+  const vm = new VM(bytecode, effectHandler, options.builtinOverrides, options.limits);
 
   return vm.run(input);
 }
@@ -193,6 +240,7 @@ export function executePEX(source: string, options: RunOptions = {}): Value {
  * inputs or effect handlers.
  *
  * @param source PEX source code to compile
+ * @param options Compilation options (peephole optimization)
  * @returns Compiled bytecode ready for execution
  *
  * @example
@@ -211,15 +259,24 @@ export function executePEX(source: string, options: RunOptions = {}): Value {
  * });
  * ```
  */
-export function compilePEX(source: string): BytecodeFile {
+export function compilePEX(source: string, options: CompileOptions = {}): BytecodeFile {
+  if (options.cache) {
+    return options.cache.compile(source, { optimize: options.optimize });
+  }
+
   // Step 1: Parse source to AST
   const ast = parse(source);
 
   // Step 2: Lower AST to IR
-  const ir = lowerProgram(ast);
+  const ir = lowerProgramToArena(ast);
 
-  // Step 3: Generate bytecode from IR
-  return generateBytecode(ir);
+  if (!options.optimize) {
+    // Step 3: Generate bytecode from IR
+    return generateBytecode(ir);
+  }
+
+  // Step 3: Fold constants, generate bytecode, then peephole optimize
+  return optimizeBytecode(generateBytecode(optimizeIR(ir)));
 }
 
 /**
@@ -237,7 +294,7 @@ export function executeBytecode(
 ): Value {
   const input = options.input ?? nullValue();
   const effectHandler = options.effectHandler ?? throwingEffectHandler;
-  const vm = new VM(bytecode, effectHandler, options.builtinOverrides);
+  const vm = new VM(bytecode, effectHandler, options.builtinOverrides, options.limits);
 
   return vm.run(input);
 }
@@ -0,0 +1,103 @@
+/**
+ * Tests for the JavaScript compilation tier.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import { compilePEX } from "./index.ts";
+import { VM, throwingEffectHandler, type VMLimits } from "./vm.ts";
+import { nullValue, numberValue, stringValue, valueFromJSON, type Value } from "./values.ts";
+
+/** Run `source` interpreted and compiled, returning both outcomes. */
+function bothTiers(source: string, input: Value = nullValue(), optimize = false, limits: VMLimits = {}) {
+  const bytecode = compilePEX(source, { optimize });
+  const outcome = (vm: VM) => {
+    try {
+      return { value: vm.run(input) };
+    } catch (error) {
+      return { error: (error as Error).message, ip: (error as { ip?: number }).ip };
+    }
+  };
+
+  const compiled = new VM(bytecode, throwingEffectHandler, undefined, limits);
+  expect(compiled.enableCompilation()).toBe(true);
+  return { expected: outcome(new VM(bytecode, throwingEffectHandler, undefined, limits)), actual: outcome(compiled) };
+}
+
+describe("VM.enableCompilation", () => {
+  it("agrees with the interpreter", () => {
+    const programs: [string, Value][] = [
+      ["fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib $$)", numberValue(15)],
+      ['$$ | trim | lower | replace /\\d+/g "#" | split " "', stringValue("  Hello World 123 foo 45  ")],
+      ["(if (> (+ (* $$ 3) (- $$ 2)) 10) (/ $$ 2) (% $$ 7))", numberValue(9)],
+      ["(and $$ (or null (?? null \"x\")))", stringValue("")],
+      ["fn: f (x) (fn: g (y) (fn: h (z) (+ x (+ y z))) h) g; let: g (f 1); let: h (g 2); (h 3)", nullValue()],
+      ["fn: make_counter (start) (fn: count (n) (+ start n)) count; (make_counter 5)", nullValue()],
+      ["fn: ev (n) (if (== n 0) true (od (- n 1))); fn: od (n) (if (== n 0) false (ev (- n 1))); (ev 9)", nullValue()],
+    ];
+    for (const [source, input] of programs) {
+      for (const optimize of [false, true]) {
+        const { expected, actual } = bothTiers(source, input, optimize);
+        expect(actual).toEqual(expected);
+      }
+    }
+  });
+
+  it("reports the interpreter's errors", () => {
+    for (const source of ["(/ 10 (- $$ $$))", "fn: add (a b) (+ a b); (add 1)", "let: x 10; (x)", "(len 5)"]) {
+      const { expected, actual } = bothTiers(source, numberValue(3));
+      expect(expected.error).toBeDefined();
+      expect(actual).toEqual(expected);
+    }
+  });
+
+  it("reads object properties of changing shapes", () => {
+    const bytecode = compilePEX('fn: pick (r k) (get r k); (?? (get $$ "id") (?? (pick $$ "name") (pick $$ 1)))');
+    const inputs = [{ id: 1, name: "a" }, { id: 2 }, { name: "c", id: null }, { 1: 4 }, { id: 5, name: "e" }].map(valueFromJSON);
+    const compiled = new VM(bytecode, throwingEffectHandler);
+    expect(compiled.enableCompilation()).toBe(true);
+    expect(compiled.runBatch(inputs)).toEqual(new VM(bytecode, throwingEffectHandler).runBatch(inputs));
+  });
+
+  it("hands runs near the frame limit back to the interpreter", () => {
+    const sum = "fn: sum (n) (if (<= n 0) 0 (+ n (sum (- n 1)))); (sum $$)";
+    for (const depth of [998, 999, 2000]) {
+      const { expected, actual } = bothTiers(sum, numberValue(depth));
+      expect(actual).toEqual(expected);
+    }
+    expect(bothTiers(sum, numberValue(2000)).actual.error).toContain("Call stack overflow");
+  });
+
+  it("hands runs that exceed their budget back to the interpreter", () => {
+    const fib = "fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib $$)";
+    const loop = "fn: loop (n acc) (if (<= n 0) acc (loop (- n 1) (+ acc n))); (loop $$ 0)";
+    // fib(10) makes 177 calls and loop(100) 101
+    for (const fuel of [0, 100, 176, 177, 1000]) {
+      for (const source of [fib, loop]) {
+        const input = numberValue(source === fib ? 10 : 100);
+        const { expected, actual } = bothTiers(source, input, false, { fuel });
+        expect(actual).toEqual(expected);
+      }
+    }
+    expect(bothTiers(fib, numberValue(10), false, { fuel: 176 }).actual.error).toContain("Fuel exhausted");
+    expect(bothTiers(fib, numberValue(10), false, { fuel: 177 }).actual).toEqual({ value: numberValue(55) });
+
+    const sum = "fn: sum (n) (if (<= n 0) 0 (+ n (sum (- n 1)))); (sum $$)";
+    const { expected, actual } = bothTiers(sum, numberValue(50), false, { maxFrames: 20 });
+    expect(actual).toEqual(expected);
+    expect(actual.error).toBe("Call stack overflow (max 20)");
+  });
+
+  it("leaves VMs with a memory budget to the interpreter", () => {
+    const vm = new VM(compilePEX("(+ 1 2)"), throwingEffectHandler, undefined, { maxMemory: 1024 });
+    expect(vm.enableCompilation()).toBe(false);
+    expect(vm.run(nullValue())).toEqual(numberValue(3));
+  });
+
+  it("leaves programs with effects to the interpreter", () => {
+    const vm = new VM(compilePEX("(+ 1 (ask:))"), (_name, _args, continuation) => {
+      continuation.resume(numberValue(41));
+    });
+    expect(vm.enableCompilation()).toBe(false);
+    expect(vm.run(nullValue())).toEqual(numberValue(42));
+  });
+});
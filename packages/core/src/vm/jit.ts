@@ -0,0 +1,926 @@
+/**
+ * JavaScript compilation tier for the PEX VM.
+ *
+ * VM.enableCompilation() translates every function template of a program
+ * into JavaScript source and compiles it once with `new Function`. Operand
+ * stack slots and locals become JS variables, forward jumps become breaks
+ * out of labeled blocks, and builtins are called directly, so the engine
+ * optimizes the program like any other function instead of running it
+ * through the dispatch loop.
+ *
+ * Only programs that can be translated exactly are compiled: no effects (a
+ * compiled frame cannot be suspended), only forward jumps, and well-formed
+ * code throughout. Anything else keeps running on the interpreter.
+ *
+ * A run that gets close to the stack or frame limits, runs out of fuel, or
+ * calls a closure from another program, is abandoned and repeated on the
+ * interpreter, which reports exactly what it always did. Builtins are called again by the
+ * repeated run, so builtin overrides should not have side effects.
+ *
+ * The generated source depends only on the bytecode and is shared by every
+ * VM that loads the same BytecodeFile.
+ */
+
+import type { BytecodeFile, FunctionTemplate } from "../bytecode/format.ts";
+import { Opcode, OPCODE_METADATA, OperandType, getInstructionSize, isValidOpcode } from "../bytecode/opcodes.ts";
+import type { ClosureValue, Upvalue, Value } from "./values.ts";
+import {
+  nullValue,
+  booleanValue,
+  numberValue,
+  arrayValue,
+  closureValue,
+  getUpvalueValue,
+  isTruthy,
+  valuesEqual,
+  toNumber,
+  displayValue,
+} from "./values.ts";
+import type { VMBuiltin } from "./builtins.ts";
+import { VMRuntimeError } from "./builtins.ts";
+import type { Shape } from "./shape.ts";
+import { VMError, MAX_STACK_SIZE } from "./vm.ts";
+
+/**
+ * What compiled code needs from the VM that runs it.
+ */
+export interface CompileHost {
+  /** Builtins indexed by name table index, as resolved by the VM */
+  builtins: readonly (VMBuiltin | undefined)[];
+  constantCount: number;
+  /** Runtime value of a constant, shared with the interpreter */
+  constant(index: number): Value;
+  nameCount: number;
+  name(index: number): string;
+  /** Fuel each run starts with, counted like the interpreter's (see VMLimits) */
+  fuel: number;
+  /** Call frames a run may have at once */
+  maxFrames: number;
+}
+
+/**
+ * A program compiled to JavaScript.
+ */
+export interface CompiledProgram {
+  /** The generated source, for debugging */
+  readonly source: string;
+  /**
+   * Run the program on an input.
+   * @returns The result, or null if the run must be repeated on the
+   *   interpreter
+   */
+  run(input: Value): Value | null;
+}
+
+type Factory = (runtime: Runtime) => (input: Value) => Value;
+
+/**
+ * Generated source and its compiled factory per program; null when the
+ * program cannot be compiled.
+ */
+const factories = new WeakMap<BytecodeFile, { source: string; factory: Factory } | null>();
+
+/**
+ * Thrown by compiled code to hand the run back to the interpreter.
+ */
+const FALLBACK = Symbol("fallback");
+
+/**
+ * Translate a program to JavaScript.
+ * @returns The compiled program, or null if it has to stay on the
+ *   interpreter
+ */
+export function compileProgram(bytecode: BytecodeFile, host: CompileHost): CompiledProgram | null {
+  let compiled = factories.get(bytecode);
+  if (compiled === undefined) {
+    const source = generateSource(bytecode, host);
+    compiled = source === null ? null : { source, factory: new Function("rt", source) as Factory };
+    factories.set(bytecode, compiled);
+  }
+  if (compiled === null) {
+    return null;
+  }
+
+  const entry = compiled.factory(createRuntime(bytecode, host));
+  return {
+    source: compiled.source,
+    run(input: Value): Value | null {
+      try {
+        return entry(input);
+      } catch (error) {
+        if (error === FALLBACK) {
+          return null;
+        }
+        throw error;
+      }
+    },
+  };
+}
+
+// =============================================================================
+// Runtime support
+// =============================================================================
+
+/**
+ * Inline cache of a GET_INDEX on objects, as in the interpreter.
+ */
+interface PropertySite {
+  shape: Shape | null;
+  key: string;
+  slot: number;
+}
+
+/**
+ * Helpers and program data handed to the generated factory as `rt`.
+ */
+interface Runtime {
+  builtins: readonly (VMBuiltin | undefined)[];
+  templates: readonly FunctionTemplate[];
+  constant(index: number): Value;
+  NULL: Value;
+  TRUE: Value;
+  FALSE: Value;
+  ZERO: Value;
+  ONE: Value;
+  FALLBACK: symbol;
+  fuel: number;
+  maxFrames: number;
+  num(value: Value): number;
+  numberValue: typeof numberValue;
+  booleanValue: typeof booleanValue;
+  arrayValue: typeof arrayValue;
+  closureValue: typeof closureValue;
+  getUpvalueValue: typeof getUpvalueValue;
+  setUpvalueValue(upvalue: Upvalue, value: Value): void;
+  isTruthy: typeof isTruthy;
+  valuesEqual: typeof valuesEqual;
+  callBuiltin(builtin: VMBuiltin, args: Value[], ip: number): Value;
+  divisionByZero(ip: number): VMError;
+  notCallable(value: Value, ip: number): VMError;
+  arityMismatch(closure: ClosureValue, argCount: number, ip: number): VMError;
+  getIndex(site: PropertySite, array: Value, index: Value, ip: number): Value;
+}
+
+function createRuntime(bytecode: BytecodeFile, host: CompileHost): Runtime {
+  return {
+    builtins: host.builtins,
+    templates: bytecode.functionTemplates.templates,
+    constant: (index) => host.constant(index),
+    NULL: nullValue(),
+    TRUE: booleanValue(true),
+    FALSE: booleanValue(false),
+    ZERO: numberValue(0),
+    ONE: numberValue(1),
+    FALLBACK,
+    fuel: host.fuel,
+    maxFrames: host.maxFrames,
+    num: (value) => (value.type === "number" ? value.value : toNumber(value).value),
+    numberValue,
+    booleanValue,
+    arrayValue,
+    closureValue,
+    getUpvalueValue,
+    setUpvalueValue(upvalue, value) {
+      if (upvalue.stack !== null) {
+        upvalue.stack[upvalue.index] = value;
+      } else {
+        upvalue.value = value;
+      }
+    },
+    isTruthy,
+    valuesEqual,
+    callBuiltin(builtin, args, ip) {
+      try {
+        return builtin(args);
+      } catch (error) {
+        if (error instanceof VMRuntimeError) {
+          throw new VMError(error.message, ip);
+        }
+        throw error;
+      }
+    },
+    divisionByZero: (ip) => new VMError("Division by zero", ip),
+    notCallable: (value, ip) => new VMError(`Cannot call non-function value: ${value.type}`, ip),
+    arityMismatch(closure, argCount, ip) {
+      const name = closure.name ?? "<anonymous>";
+      return new VMError(
+        `Function ${name} expects ${closure.template.paramCount} arguments, got ${argCount}`,
+        ip
+      );
+    },
+    getIndex(site, array, index, ip) {
+      if (array.type === "object") {
+        site.shape = array.shape;
+        site.key = index.type === "string" ? index.value : displayValue(index);
+        site.slot = array.shape.slot(site.key);
+        return site.slot < 0 ? nullValue() : array.slots[site.slot]!;
+      }
+      const i = toNumber(index).value;
+      if (array.type !== "array") {
+        throw new VMError(`Cannot index non-array value: ${array.type}`, ip);
+      }
+      const idx = Math.floor(i);
+      return idx < 0 || idx >= array.elements.length ? nullValue() : array.elements[idx]!;
+    },
+  };
+}
+
+// =============================================================================
+// Decoding and analysis
+// =============================================================================
+
+/**
+ * One decoded instruction of a function template.
+ */
+interface Instruction {
+  /** Offset in the template's code */
+  ip: number;
+  /** Offset of the next instruction, where the interpreter reports errors */
+  next: number;
+  opcode: Opcode;
+  /** Main operand; jump offsets are sign-extended */
+  operand: number;
+  /** Trailing u8 operands (builtin name and argument count) */
+  extra: number[];
+  /** Operand stack height before the instruction, or -1 if unreachable */
+  height: number;
+}
+
+/**
+ * A template that passed analysis.
+ */
+interface AnalyzedTemplate {
+  template: FunctionTemplate;
+  instructions: Instruction[];
+  /** Instruction offsets that are jumped to */
+  targets: Set<number>;
+  /** Locals captured by closures made in this template */
+  captured: Set<number>;
+  maxHeight: number;
+}
+
+function decode(code: Uint8Array, ip: number, end: number): Instruction | null {
+  const opcode = code[ip]!;
+  if (!isValidOpcode(opcode)) {
+    return null;
+  }
+  const size = getInstructionSize(opcode);
+  if (ip + size > end) {
+    return null;
+  }
+
+  const jump = isJump(opcode);
+  let operand = 0;
+  switch (OPCODE_METADATA[opcode].operandType) {
+    case OperandType.NONE:
+      break;
+    case OperandType.U8:
+      operand = code[ip + 1]!;
+      if (jump) operand = (operand << 24) >> 24;
+      break;
+    case OperandType.U16:
+      operand = code[ip + 1]! | (code[ip + 2]! << 8);
+      if (jump) operand = (operand << 16) >> 16;
+      break;
+    case OperandType.U32:
+      operand = code[ip + 1]! | (code[ip + 2]! << 8) | (code[ip + 3]! << 16) | (code[ip + 4]! << 24);
+      if (!jump) operand >>>= 0;
+      break;
+  }
+
+  const extraStart = ip + size - (OPCODE_METADATA[opcode].extraOperands ?? 0);
+  const extra = Array.from(code.subarray(extraStart, ip + size));
+  return { ip, next: ip + size, opcode, operand, extra, height: -1 };
+}
+
+function isTailCall(opcode: Opcode): boolean {
+  return opcode === Opcode.TAIL_CALL_U8 || opcode === Opcode.TAIL_CALL_U16 || opcode === Opcode.TAIL_CALL_U32;
+}
+
+function isJump(opcode: Opcode): boolean {
+  switch (opcode) {
+    case Opcode.JUMP_U8:
+    case Opcode.JUMP_U16:
+    case Opcode.JUMP_U32:
+    case Opcode.JUMP_IF_FALSE_U8:
+    case Opcode.JUMP_IF_FALSE_U16:
+    case Opcode.JUMP_IF_FALSE_U32:
+    case Opcode.JUMP_IF_TRUE_U8:
+    case Opcode.JUMP_IF_TRUE_U16:
+    case Opcode.JUMP_IF_TRUE_U32:
+    case Opcode.EQ_JUMP_IF_FALSE_U8:
+    case Opcode.NE_JUMP_IF_FALSE_U8:
+    case Opcode.LT_JUMP_IF_FALSE_U8:
+    case Opcode.GT_JUMP_IF_FALSE_U8:
+    case Opcode.LE_JUMP_IF_FALSE_U8:
+    case Opcode.GE_JUMP_IF_FALSE_U8:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Values an instruction pops and pushes, or null if the tier does not
+ * handle it.
+ */
+function stackEffect(ins: Instruction): { pops: number; pushes: number } | null {
+  switch (ins.opcode) {
+    case Opcode.NOP:
+    case Opcode.JUMP_U8:
+    case Opcode.JUMP_U16:
+    case Opcode.JUMP_U32:
+      return { pops: 0, pushes: 0 };
+    case Opcode.POP:
+    case Opcode.STORE_LOCAL_U8:
+    case Opcode.STORE_LOCAL_U16:
+    case Opcode.STORE_LOCAL_U32:
+    case Opcode.STORE_UPVALUE_U8:
+    case Opcode.STORE_UPVALUE_U16:
+    case Opcode.STORE_UPVALUE_U32:
+    case Opcode.JUMP_IF_FALSE_U8:
+    case Opcode.JUMP_IF_FALSE_U16:
+    case Opcode.JUMP_IF_FALSE_U32:
+    case Opcode.JUMP_IF_TRUE_U8:
+    case Opcode.JUMP_IF_TRUE_U16:
+    case Opcode.JUMP_IF_TRUE_U32:
+    case Opcode.RETURN:
+      return { pops: 1, pushes: 0 };
+    case Opcode.DUP:
+      return { pops: 1, pushes: 2 };
+    case Opcode.SWAP:
+      return { pops: 2, pushes: 2 };
+    case Opcode.CONST_NULL:
+    case Opcode.CONST_TRUE:
+    case Opcode.CONST_FALSE:
+    case Opcode.CONST_ZERO:
+    case Opcode.CONST_ONE:
+    case Opcode.CONST_U8:
+    case Opcode.CONST_U16:
+    case Opcode.CONST_U32:
+    case Opcode.LOAD_LOCAL_U8:
+    case Opcode.LOAD_LOCAL_U16:
+    case Opcode.LOAD_LOCAL_U32:
+    case Opcode.LOAD_UPVALUE_U8:
+    case Opcode.LOAD_UPVALUE_U16:
+    case Opcode.LOAD_UPVALUE_U32:
+    case Opcode.MAKE_CLOSURE_U8:
+    case Opcode.MAKE_CLOSURE_U16:
+    case Opcode.MAKE_CLOSURE_U32:
+      return { pops: 0, pushes: 1 };
+    case Opcode.ADD:
+    case Opcode.SUB:
+    case Opcode.MUL:
+    case Opcode.DIV:
+    case Opcode.MOD:
+    case Opcode.EQ:
+    case Opcode.NE:
+    case Opcode.LT:
+    case Opcode.GT:
+    case Opcode.LE:
+    case Opcode.GE:
+    case Opcode.NULL_COALESCE:
+    case Opcode.GET_INDEX:
+      return { pops: 2, pushes: 1 };
+    case Opcode.NEG:
+    case Opcode.NOT:
+    case Opcode.TEE_LOCAL_U8:
+      return { pops: 1, pushes: 1 };
+    case Opcode.EQ_JUMP_IF_FALSE_U8:
+    case Opcode.NE_JUMP_IF_FALSE_U8:
+    case Opcode.LT_JUMP_IF_FALSE_U8:
+    case Opcode.GT_JUMP_IF_FALSE_U8:
+    case Opcode.LE_JUMP_IF_FALSE_U8:
+    case Opcode.GE_JUMP_IF_FALSE_U8:
+      return { pops: 2, pushes: 0 };
+    case Opcode.CALL_U8:
+    case Opcode.CALL_U16:
+    case Opcode.CALL_U32:
+      return { pops: ins.operand + 1, pushes: 1 };
+    case Opcode.TAIL_CALL_U8:
+    case Opcode.TAIL_CALL_U16:
+    case Opcode.TAIL_CALL_U32:
+      return { pops: ins.operand + 1, pushes: 0 };
+    case Opcode.MAKE_ARRAY_U8:
+    case Opcode.MAKE_ARRAY_U16:
+    case Opcode.MAKE_ARRAY_U32:
+      return { pops: ins.operand, pushes: 1 };
+    case Opcode.CALL_BUILTIN_U8_U8:
+    case Opcode.CALL_BUILTIN_U16_U8:
+    case Opcode.CALL_BUILTIN_U32_U8:
+      return { pops: ins.extra[0]!, pushes: 1 };
+    default:
+      // EFFECT suspends the frame, which compiled code cannot do.
+      // LOAD_LOCAL_CALL_BUILTIN is handled by the caller.
+      return null;
+  }
+}
+
+/**
+ * Decode a template and work out the operand stack height before every
+ * instruction. Returns null if the template uses anything the tier cannot
+ * translate exactly.
+ */
+function analyzeTemplate(
+  bytecode: BytecodeFile,
+  host: CompileHost,
+  template: FunctionTemplate,
+  upvalueCount: number
+): AnalyzedTemplate | null {
+  const code = bytecode.codeSection.code;
+  const start = template.codeOffset;
+  const end = start + template.codeLength;
+  const templateCount = bytecode.functionTemplates.templates.length;
+  const localCount = template.localCount;
+  if (end > code.length || template.paramCount > localCount) {
+    return null;
+  }
+
+  const instructions: Instruction[] = [];
+  const starts = new Set<number>();
+  for (let ip = start; ip < end; ) {
+    const ins = decode(code, ip, end);
+    if (ins === null) {
+      return null;
+    }
+    ins.ip -= start;
+    ins.next -= start;
+    instructions.push(ins);
+    starts.add(ins.ip);
+    ip = start + ins.next;
+  }
+
+  const targetHeights = new Map<number, number>();
+  const captured = new Set<number>();
+  let height: number | null = 0;
+  let maxHeight = 0;
+
+  for (const ins of instructions) {
+    const pending = targetHeights.get(ins.ip);
+    if (pending !== undefined) {
+      if (height !== null && height !== pending) {
+        return null;
+      }
+      height = pending;
+    }
+    if (height === null) {
+      // Unreachable: never executed, so never translated
+      continue;
+    }
+    ins.height = height;
+
+    const { opcode, operand } = ins;
+    let effect: { pops: number; pushes: number } | null;
+    if (opcode === Opcode.LOAD_LOCAL_CALL_BUILTIN_U8) {
+      // The local is pushed first and becomes the builtin's last argument
+      const argCount = ins.extra[1]!;
+      if (height + 1 < argCount) {
+        return null;
+      }
+      maxHeight = Math.max(maxHeight, height + 1);
+      effect = { pops: argCount - 1, pushes: 1 };
+    } else {
+      effect = stackEffect(ins);
+    }
+    if (effect === null || height < effect.pops) {
+      return null;
+    }
+    height = height - effect.pops + effect.pushes;
+    maxHeight = Math.max(maxHeight, height);
+
+    // Operands are checked here so translated code never needs to
+    switch (opcode) {
+      case Opcode.CONST_U8:
+      case Opcode.CONST_U16:
+      case Opcode.CONST_U32:
+        if (operand >= host.constantCount) return null;
+        break;
+      case Opcode.LOAD_LOCAL_U8:
+      case Opcode.LOAD_LOCAL_U16:
+      case Opcode.LOAD_LOCAL_U32:
+      case Opcode.STORE_LOCAL_U8:
+      case Opcode.STORE_LOCAL_U16:
+      case Opcode.STORE_LOCAL_U32:
+      case Opcode.TEE_LOCAL_U8:
+        if (operand >= localCount) return null;
+        break;
+      case Opcode.LOAD_UPVALUE_U8:
+      case Opcode.LOAD_UPVALUE_U16:
+      case Opcode.LOAD_UPVALUE_U32:
+      case Opcode.STORE_UPVALUE_U8:
+      case Opcode.STORE_UPVALUE_U16:
+      case Opcode.STORE_UPVALUE_U32:
+        if (operand >= upvalueCount) return null;
+        break;
+      case Opcode.MAKE_CLOSURE_U8:
+      case Opcode.MAKE_CLOSURE_U16:
+      case Opcode.MAKE_CLOSURE_U32: {
+        if (operand >= templateCount) return null;
+        for (const spec of bytecode.functionTemplates.templates[operand]!.upvalues) {
+          if (spec.isLocal ? spec.index >= localCount : spec.index >= upvalueCount) return null;
+          if (spec.isLocal) captured.add(spec.index);
+        }
+        break;
+      }
+      case Opcode.CALL_BUILTIN_U8_U8:
+      case Opcode.CALL_BUILTIN_U16_U8:
+      case Opcode.CALL_BUILTIN_U32_U8:
+        if (operand >= host.nameCount || host.builtins[operand] === undefined) return null;
+        break;
+      case Opcode.LOAD_LOCAL_CALL_BUILTIN_U8: {
+        const nameIndex = ins.extra[0]!;
+        if (operand >= localCount || nameIndex >= host.nameCount || host.builtins[nameIndex] === undefined) {
+          return null;
+        }
+        break;
+      }
+    }
+
+    if (isJump(opcode)) {
+      const target = ins.next + operand;
+      if (operand < 0 || !starts.has(target)) {
+        return null;
+      }
+      const recorded = targetHeights.get(target);
+      if (recorded !== undefined && recorded !== height) {
+        return null;
+      }
+      targetHeights.set(target, height);
+      if (opcode === Opcode.JUMP_U8 || opcode === Opcode.JUMP_U16 || opcode === Opcode.JUMP_U32) {
+        height = null;
+      }
+    } else if (opcode === Opcode.RETURN || isTailCall(opcode)) {
+      height = null;
+    }
+  }
+
+  // Falling off the end is an interpreter error
+  if (height !== null) {
+    return null;
+  }
+
+  return { template, instructions, targets: new Set(targetHeights.keys()), captured, maxHeight };
+}
+
+// =============================================================================
+// Code generation
+// =============================================================================
+
+function generateSource(bytecode: BytecodeFile, host: CompileHost): string | null {
+  const templates = bytecode.functionTemplates.templates;
+  const entryIndex = bytecode.header.entryPoint;
+  if (entryIndex < 0 || entryIndex >= templates.length) {
+    return null;
+  }
+  // run() passes the input as local 0 of a closure without upvalues
+  const entry = templates[entryIndex]!;
+  if (entry.paramCount !== 1 || entry.upvalues.length !== 0) {
+    return null;
+  }
+
+  const functions: string[] = [];
+  const state = { constants: new Set<number>(), builtins: new Set<number>(), callSites: 0, propertySites: 0 };
+  for (let i = 0; i < templates.length; i++) {
+    const template = templates[i]!;
+    const analyzed = analyzeTemplate(bytecode, host, template, template.upvalues.length);
+    if (analyzed === null) {
+      return null;
+    }
+    functions.push(generateFunction(i, analyzed, bytecode, host, state));
+  }
+
+  const lines = [
+    '"use strict";',
+    "const { NULL, TRUE, FALSE, ZERO, ONE, FALLBACK, num, numberValue, booleanValue, arrayValue, " +
+      "closureValue, getUpvalueValue, setUpvalueValue, isTruthy, valuesEqual, callBuiltin, " +
+      "divisionByZero, notCallable, arityMismatch, getIndex, constant, builtins, templates, maxFrames } = rt;",
+    // Fuel left in the current run; the entry call is not a CALL, so it is
+    // not charged
+    "let fuel = 0;",
+  ];
+  for (let i = 0; i < templates.length; i++) {
+    lines.push(`const T${i} = templates[${i}];`);
+  }
+  for (const index of state.builtins) {
+    lines.push(`const b${index} = builtins[${index}];`);
+  }
+  for (const index of state.constants) {
+    lines.push(`let c${index};`);
+  }
+  for (let i = 0; i < state.callSites; i++) {
+    lines.push(`let k${i}t = null, k${i}f = null;`);
+  }
+  for (let i = 0; i < state.propertySites; i++) {
+    lines.push(`const p${i} = { shape: null, key: "", slot: -1 };`);
+  }
+  lines.push(
+    `const fns = new Map([${templates.map((_, i) => `[T${i}, f${i}]`).join(", ")}]);`,
+    "function lookup(template) {",
+    "  const fn = fns.get(template);",
+    "  if (fn === undefined) throw FALLBACK;",
+    "  return fn;",
+    "}",
+    ...functions,
+    "return (input) => {",
+    "  fuel = rt.fuel + 1;",
+    `  return f${entryIndex}([], 0, 1, input);`,
+    "};"
+  );
+  return lines.join("\n");
+}
+
+function generateFunction(
+  index: number,
+  analyzed: AnalyzedTemplate,
+  bytecode: BytecodeFile,
+  host: CompileHost,
+  state: { constants: Set<number>; builtins: Set<number>; callSites: number; propertySites: number }
+): string {
+  const { template, instructions, targets, captured, maxHeight } = analyzed;
+  const localCount = template.localCount;
+  const out: string[] = [];
+  const s = (slot: number) => `s${slot}`;
+  const local = (slot: number) => (captured.has(slot) ? `u${slot}.value` : `l${slot}`);
+  const range = (from: number, to: number) => Array.from({ length: to - from }, (_, i) => s(from + i)).join(", ");
+  // Checks the closure in `funcSlot` and returns the JS call expression
+  // for it, with each call site remembering the last template it called
+  const call = (funcSlot: number, argCount: number, ip: number, callBp: string, callDepth: string) => {
+    const site = state.callSites++;
+    const args = range(funcSlot + 1, funcSlot + 1 + argCount);
+    out.push(`  f = ${s(funcSlot)};`);
+    out.push(`  if (f.type !== "closure") throw notCallable(f, ${ip});`);
+    out.push(`  if (f.template.paramCount !== ${argCount}) throw arityMismatch(f, ${argCount}, ${ip});`);
+    return (
+      `(f.template === k${site}t ? k${site}f : (k${site}f = lookup(f.template), ` +
+      `k${site}t = f.template, k${site}f))(f.upvalues, ${callBp}, ${callDepth}${args ? `, ${args}` : ""})`
+    );
+  };
+  const builtinCall = (nameIndex: number, argCount: number, height: number, ip: number) => {
+    state.builtins.add(nameIndex);
+    const first = height - argCount;
+    return `${s(first)} = callBuiltin(b${nameIndex}, [${range(first, height)}], ${ip});`;
+  };
+
+  const params = Array.from({ length: template.paramCount }, (_, i) => `l${i}`);
+  out.push(`function f${index}(up, bp, depth${params.map((p) => `, ${p}`).join("")}) {`);
+  // Near the limits the interpreter decides which error is reported first
+  // Running out of fuel or frames falls back, so the interpreter reports it
+  out.push(`  if (--fuel < 0 || depth > maxFrames || bp > ${MAX_STACK_SIZE - localCount - maxHeight}) throw FALLBACK;`);
+  for (let slot = template.paramCount; slot < localCount; slot++) {
+    out.push(`  let l${slot} = NULL;`);
+  }
+  const stackSlots = Array.from({ length: maxHeight }, (_, i) => s(i));
+  out.push(`  let ${[...stackSlots, "t", "f"].join(", ")};`);
+
+  // A tail call to the same template restarts the body in place, as the
+  // interpreter reuses the frame
+  const loops = instructions.some((ins) => ins.height >= 0 && isTailCall(ins.opcode));
+  if (loops) {
+    out.push("  top: for (;;) {");
+  }
+  // Captured locals live in upvalues from the start, shaped like the ones
+  // the interpreter closes when the frame returns
+  for (const slot of [...captured].sort((a, b) => a - b)) {
+    out.push(`  const u${slot} = { type: "closed", stack: null, index: bp + ${slot}, value: l${slot}, next: null };`);
+  }
+
+  // Every jump target closes a labeled block opened here; a jump breaks out
+  // of the block ending at its target
+  const sortedTargets = [...targets].sort((a, b) => b - a);
+  if (sortedTargets.length > 0) {
+    out.push("  " + sortedTargets.map((target) => `L${target}: {`).join(" "));
+  }
+
+  for (const ins of instructions) {
+    if (targets.has(ins.ip)) {
+      out.push(`  } // ${ins.ip}`);
+    }
+    const h = ins.height;
+    if (h < 0) {
+      continue;
+    }
+    const { opcode, operand } = ins;
+    const a = s(h - 2);
+    const b = s(h - 1);
+    const emit = (line: string) => out.push(`  ${line}`);
+
+    switch (opcode) {
+      case Opcode.NOP:
+      case Opcode.POP:
+        break;
+      case Opcode.DUP:
+        emit(`${s(h)} = ${b};`);
+        break;
+      case Opcode.SWAP:
+        emit(`t = ${b}; ${b} = ${a}; ${a} = t;`);
+        break;
+
+      case Opcode.CONST_NULL:
+        emit(`${s(h)} = NULL;`);
+        break;
+      case Opcode.CONST_TRUE:
+        emit(`${s(h)} = TRUE;`);
+        break;
+      case Opcode.CONST_FALSE:
+        emit(`${s(h)} = FALSE;`);
+        break;
+      case Opcode.CONST_ZERO:
+        emit(`${s(h)} = ZERO;`);
+        break;
+      case Opcode.CONST_ONE:
+        emit(`${s(h)} = ONE;`);
+        break;
+      case Opcode.CONST_U8:
+      case Opcode.CONST_U16:
+      case Opcode.CONST_U32:
+        // Converted on first use, like the interpreter, so a bad regex only
+        // throws when it is reached
+        state.constants.add(operand);
+        emit(`${s(h)} = c${operand} ??= constant(${operand});`);
+        break;
+
+      case Opcode.LOAD_LOCAL_U8:
+      case Opcode.LOAD_LOCAL_U16:
+      case Opcode.LOAD_LOCAL_U32:
+        emit(`${s(h)} = ${local(operand)};`);
+        break;
+      case Opcode.STORE_LOCAL_U8:
+      case Opcode.STORE_LOCAL_U16:
+      case Opcode.STORE_LOCAL_U32:
+      case Opcode.TEE_LOCAL_U8:
+        emit(`${local(operand)} = ${b};`);
+        break;
+      case Opcode.LOAD_UPVALUE_U8:
+      case Opcode.LOAD_UPVALUE_U16:
+      case Opcode.LOAD_UPVALUE_U32:
+        emit(`${s(h)} = getUpvalueValue(up[${operand}]);`);
+        break;
+      case Opcode.STORE_UPVALUE_U8:
+      case Opcode.STORE_UPVALUE_U16:
+      case Opcode.STORE_UPVALUE_U32:
+        emit(`setUpvalueValue(up[${operand}], ${b});`);
+        break;
+
+      case Opcode.ADD:
+        emit(`${a} = numberValue(num(${a}) + num(${b}));`);
+        break;
+      case Opcode.SUB:
+        emit(`${a} = numberValue(num(${a}) - num(${b}));`);
+        break;
+      case Opcode.MUL:
+        emit(`${a} = numberValue(num(${a}) * num(${b}));`);
+        break;
+      case Opcode.DIV:
+        emit(`t = num(${b});`);
+        emit(`if (t === 0) throw divisionByZero(${ins.next});`);
+        emit(`${a} = numberValue(num(${a}) / t);`);
+        break;
+      case Opcode.MOD:
+        emit(`${a} = numberValue(num(${a}) % num(${b}));`);
+        break;
+      case Opcode.NEG:
+        emit(`${b} = numberValue(-num(${b}));`);
+        break;
+
+      case Opcode.EQ:
+        emit(`${a} = valuesEqual(${a}, ${b}) ? TRUE : FALSE;`);
+        break;
+      case Opcode.NE:
+        emit(`${a} = valuesEqual(${a}, ${b}) ? FALSE : TRUE;`);
+        break;
+      case Opcode.LT:
+      case Opcode.GT:
+      case Opcode.LE:
+      case Opcode.GE:
+        emit(`${a} = ${comparison(opcode, a, b)} ? TRUE : FALSE;`);
+        break;
+      case Opcode.NOT:
+        emit(`${b} = isTruthy(${b}) ? FALSE : TRUE;`);
+        break;
+      case Opcode.NULL_COALESCE:
+        emit(`if (${a}.type === "null") ${a} = ${b};`);
+        break;
+
+      case Opcode.JUMP_U8:
+      case Opcode.JUMP_U16:
+      case Opcode.JUMP_U32:
+        emit(`break L${ins.next + operand};`);
+        break;
+      case Opcode.JUMP_IF_FALSE_U8:
+      case Opcode.JUMP_IF_FALSE_U16:
+      case Opcode.JUMP_IF_FALSE_U32:
+        emit(`if (!isTruthy(${b})) break L${ins.next + operand};`);
+        break;
+      case Opcode.JUMP_IF_TRUE_U8:
+      case Opcode.JUMP_IF_TRUE_U16:
+      case Opcode.JUMP_IF_TRUE_U32:
+        emit(`if (isTruthy(${b})) break L${ins.next + operand};`);
+        break;
+      case Opcode.EQ_JUMP_IF_FALSE_U8:
+        emit(`if (!valuesEqual(${a}, ${b})) break L${ins.next + operand};`);
+        break;
+      case Opcode.NE_JUMP_IF_FALSE_U8:
+        emit(`if (valuesEqual(${a}, ${b})) break L${ins.next + operand};`);
+        break;
+      case Opcode.LT_JUMP_IF_FALSE_U8:
+      case Opcode.GT_JUMP_IF_FALSE_U8:
+      case Opcode.LE_JUMP_IF_FALSE_U8:
+      case Opcode.GE_JUMP_IF_FALSE_U8:
+        emit(`if (!(${comparison(opcode, a, b)})) break L${ins.next + operand};`);
+        break;
+
+      case Opcode.MAKE_CLOSURE_U8:
+      case Opcode.MAKE_CLOSURE_U16:
+      case Opcode.MAKE_CLOSURE_U32: {
+        const closureTemplate = bytecode.functionTemplates.templates[operand]!;
+        const upvalues = closureTemplate.upvalues.map((spec) =>
+          spec.isLocal ? `u${spec.index}` : `up[${spec.index}]`
+        );
+        const nameIndex = closureTemplate.nameIndex;
+        const name = nameIndex >= 0 && nameIndex < host.nameCount ? JSON.stringify(host.name(nameIndex)) : "null";
+        emit(`${s(h)} = closureValue(T${operand}, [${upvalues.join(", ")}], ${name});`);
+        break;
+      }
+
+      case Opcode.CALL_U8:
+      case Opcode.CALL_U16:
+      case Opcode.CALL_U32: {
+        const funcSlot = h - operand - 1;
+        const callee = call(funcSlot, operand, ins.next, `bp + ${localCount + funcSlot}`, "depth + 1");
+        emit(`${s(funcSlot)} = ${callee};`);
+        break;
+      }
+      case Opcode.TAIL_CALL_U8:
+      case Opcode.TAIL_CALL_U16:
+      case Opcode.TAIL_CALL_U32: {
+        const funcSlot = h - operand - 1;
+        // Other templates still nest on the JS stack, so they count towards
+        // the depth limit and very deep chains fall back to the interpreter
+        const callee = call(funcSlot, operand, ins.next, "bp", "depth + 1");
+        const restart = [
+          "up = f.upvalues;",
+          ...Array.from({ length: operand }, (_, i) => `l${i} = ${s(funcSlot + 1 + i)};`),
+          ...Array.from({ length: localCount - operand }, (_, i) => `l${operand + i} = NULL;`),
+          "if (--fuel < 0) throw FALLBACK;",
+          "continue top;",
+        ];
+        emit(`if (f.template === T${index}) { ${restart.join(" ")} }`);
+        emit(`return ${callee};`);
+        break;
+      }
+      case Opcode.RETURN:
+        emit(`return ${b};`);
+        break;
+
+      case Opcode.CALL_BUILTIN_U8_U8:
+      case Opcode.CALL_BUILTIN_U16_U8:
+      case Opcode.CALL_BUILTIN_U32_U8:
+        emit(builtinCall(operand, ins.extra[0]!, h, ins.next));
+        break;
+      case Opcode.LOAD_LOCAL_CALL_BUILTIN_U8:
+        emit(`${s(h)} = ${local(operand)};`);
+        emit(builtinCall(ins.extra[0]!, ins.extra[1]!, h + 1, ins.next));
+        break;
+
+      case Opcode.MAKE_ARRAY_U8:
+      case Opcode.MAKE_ARRAY_U16:
+      case Opcode.MAKE_ARRAY_U32:
+        emit(`${s(h - operand)} = arrayValue([${range(h - operand, h)}]);`);
+        break;
+      case Opcode.GET_INDEX: {
+        // Objects of the shape last seen here are read straight from the slot
+        const p = `p${state.propertySites++}`;
+        emit(
+          `${a} = ${a}.shape === ${p}.shape && ${b}.value === ${p}.key ` +
+            `? (${p}.slot < 0 ? NULL : ${a}.slots[${p}.slot]) : getIndex(${p}, ${a}, ${b}, ${ins.next});`
+        );
+        break;
+      }
+    }
+  }
+
+  if (loops) {
+    out.push("  }");
+  }
+  out.push("}");
+  return out.join("\n");
+}
+
+/**
+ * A numeric comparison of `a` and `b` as a JS expression.
+ */
+function comparison(opcode: Opcode, a: string, b: string): string {
+  switch (opcode) {
+    case Opcode.LT:
+    case Opcode.LT_JUMP_IF_FALSE_U8:
+      return `num(${a}) < num(${b})`;
+    case Opcode.GT:
+    case Opcode.GT_JUMP_IF_FALSE_U8:
+      return `num(${a}) > num(${b})`;
+    case Opcode.LE:
+    case Opcode.LE_JUMP_IF_FALSE_U8:
+      return `num(${a}) <= num(${b})`;
+    default:
+      return `num(${a}) >= num(${b})`;
+  }
+}
@@ -0,0 +1,47 @@
+/**
+ * Worker thread entry point for VMWorkerPool.
+ *
+ * Opens the shared bytecode once, then runs each chunk of inputs it is sent
+ * on a single reused VM, compiled to JavaScript if the pool asked for it,
+ * and posts the results back. Values cross in both directions encoded by
+ * transfer.ts.
+ */
+
+import { parentPort, workerData } from "node:worker_threads";
+import { openBytecode } from "../bytecode/reader.ts";
+import type { TransferValue } from "./transfer.ts";
+import { decodeValue, encodeValue } from "./transfer.ts";
+import { VM, VMBudgetError, VMError, throwingEffectHandler } from "./vm.ts";
+
+export interface WorkerRequest {
+  inputs: TransferValue[];
+}
+
+export type WorkerResponse =
+  | { results: TransferValue[]; error?: undefined }
+  | { error: { message: string; ip?: number; budget?: VMBudgetError["budget"] } };
+
+if (parentPort) {
+  const port = parentPort;
+  const bytecode = openBytecode(new Uint8Array(workerData.bytecode as SharedArrayBuffer));
+  const vm = new VM(bytecode, throwingEffectHandler, undefined, workerData.limits);
+  if (workerData.compile) {
+    vm.enableCompilation();
+  }
+
+  port.on("message", (request: WorkerRequest) => {
+    let response: WorkerResponse;
+    try {
+      response = { results: vm.runBatch(request.inputs.map(decodeValue)).map(encodeValue) };
+    } catch (error) {
+      response = {
+        error: {
+          message: error instanceof Error ? error.message : String(error),
+          ip: error instanceof VMError ? error.ip : undefined,
+          budget: error instanceof VMBudgetError ? error.budget : undefined,
+        },
+      };
+    }
+    port.postMessage(response);
+  });
+}
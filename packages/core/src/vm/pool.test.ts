@@ -0,0 +1,109 @@
+/**
+ * Tests for the parallel worker pool.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import type { Worker } from "node:worker_threads";
+import { VMWorkerPool, runVMParallel } from "./pool.ts";
+import { compilePEX } from "./index.ts";
+import { VM, VMBudgetError, VMError, throwingEffectHandler } from "./vm.ts";
+import { numberValue, stringValue, valueFromJSON, valueToJSON } from "./values.ts";
+import type { RegexValue } from "./values.ts";
+import { RegexKernel } from "./regex.ts";
+
+describe("VMWorkerPool", () => {
+  const bytecode = compilePEX('$$ | (string $) | (join "#" $)');
+  const inputs = Array.from({ length: 250 }, (_, i) => numberValue(i));
+
+  it("preserves input order across workers and chunks", async () => {
+    const expected = new VM(bytecode, throwingEffectHandler).runBatch(inputs);
+    const results = await runVMParallel(bytecode, inputs, { workers: 3, chunkSize: 7 });
+    expect(results).toEqual(expected);
+  });
+
+  it("runs compiled programs in the workers", async () => {
+    const expected = new VM(bytecode, throwingEffectHandler).runBatch(inputs);
+    const results = await runVMParallel(bytecode, inputs, { workers: 2, chunkSize: 50, compile: true });
+    expect(results).toEqual(expected);
+  });
+
+  it("runs several batches on one pool", async () => {
+    const pool = new VMWorkerPool(compilePEX("$$ | upper"), { workers: 2, chunkSize: 2 });
+    try {
+      const [a, b] = await Promise.all([
+        pool.runBatch(["a", "b", "c"].map(stringValue)),
+        pool.runBatch(["x"].map(stringValue)),
+      ]);
+      expect(a).toEqual(["A", "B", "C"].map(stringValue));
+      expect(b).toEqual([stringValue("X")]);
+      expect(await pool.runBatch([])).toEqual([]);
+    } finally {
+      await pool.close();
+    }
+  });
+
+  it("sends object inputs and results between threads", async () => {
+    const records = Array.from({ length: 20 }, (_, i) =>
+      valueFromJSON({ id: i, user: { name: `u${i}`, tags: ["a", { deep: i }] } })
+    );
+    const program = compilePEX('(+ (get $$ "id") (get (get $$ "user") "name"))');
+    const expected = new VM(program, throwingEffectHandler).runBatch(records);
+    expect(await runVMParallel(program, records, { workers: 2, chunkSize: 3 })).toEqual(expected);
+    expect(await runVMParallel(program, records, { workers: 2, chunkSize: 3, compile: true })).toEqual(expected);
+
+    const results = await runVMParallel(compilePEX("$$"), records, { workers: 2, chunkSize: 3 });
+    expect(results.map(valueToJSON)).toEqual(records.map(valueToJSON));
+    const nested = await runVMParallel(compilePEX('(get $$ "user")'), records, { workers: 2 });
+    expect(nested.map(valueToJSON)).toEqual(records.map((record) => valueToJSON(record).user));
+  });
+
+  it("sends regex results between threads", async () => {
+    const [regex] = await runVMParallel(compilePEX("/ab/g"), [stringValue("")], { workers: 1 });
+    expect(regex).toEqual(new VM(compilePEX("/ab/g"), throwingEffectHandler).run(stringValue("")));
+    expect((regex as RegexValue).kernel).toBeInstanceOf(RegexKernel);
+  });
+
+  it("rejects results that cannot be sent between threads", async () => {
+    const closure = runVMParallel(compilePEX("fn: f (x) x; f"), [stringValue("")], { workers: 1 });
+    await expect(closure).rejects.toThrow("Cannot send a closure value between threads");
+  });
+
+  it("keeps running batches after an idle worker dies", async () => {
+    const pool = new VMWorkerPool(compilePEX("$$ | upper"), { workers: 2, chunkSize: 1 });
+    try {
+      expect(await pool.runBatch(["a", "b"].map(stringValue))).toEqual(["A", "B"].map(stringValue));
+
+      const [worker] = (pool as unknown as { workers: Worker[] }).workers;
+      await worker!.terminate();
+      const results = await pool.runBatch(["c", "d", "e"].map(stringValue));
+      expect(results).toEqual(["C", "D", "E"].map(stringValue));
+
+      const [last] = (pool as unknown as { workers: Worker[] }).workers;
+      await last!.terminate();
+      await expect(pool.runBatch([stringValue("f")])).rejects.toThrow("no workers left");
+    } finally {
+      await pool.close();
+    }
+  });
+
+  it("rejects with the VM error of a failing input", async () => {
+    const failing = runVMParallel(compilePEX("(/ 1 $$)"), [1, 0, 2].map(numberValue), {
+      workers: 2,
+      chunkSize: 1,
+    });
+    await expect(failing).rejects.toThrow("Division by zero");
+    await failing.catch((error) => expect(error).toBeInstanceOf(VMError));
+  });
+
+  it("applies budgets in the workers", async () => {
+    const sum = compilePEX("fn: sum (n) (if (<= n 0) 0 (+ n (sum (- n 1)))); (sum $$)");
+    const failing = runVMParallel(sum, [5, 50].map(numberValue), { workers: 1, limits: { maxFrames: 20 } });
+    await expect(failing).rejects.toThrow("Call stack overflow (max 20)");
+    await failing.catch((error) => expect((error as VMBudgetError).budget).toBe("stack"));
+  });
+
+  it("validates options", () => {
+    expect(() => new VMWorkerPool(bytecode, { workers: 0 })).toThrow(RangeError);
+    expect(() => new VMWorkerPool(bytecode, { chunkSize: 0 })).toThrow(RangeError);
+  });
+});
@@ -0,0 +1,254 @@
+/**
+ * Parallel batch execution on a pool of worker threads.
+ *
+ * The program is serialized once into a SharedArrayBuffer. Every worker opens
+ * it with openBytecode(), so constants and code are read from the same
+ * memory rather than copied per worker. Inputs are split into fixed-size
+ * chunks that idle workers pull from a shared queue; results are written back
+ * by chunk position, so output order always matches input order.
+ *
+ * Inputs and results are sent encoded by transfer.ts, since structured clone
+ * would drop the prototypes of object shapes and regex kernels.
+ *
+ * Workers run with the throwing effect handler: programs that perform
+ * effects should use VM.runBatch() on the main thread instead.
+ *
+ * This module uses node:worker_threads and is exported from
+ * "@pex/core/parallel" rather than the main entry point.
+ */
+
+import { Worker } from "node:worker_threads";
+import { availableParallelism } from "node:os";
+import type { BytecodeFile } from "../bytecode/format.ts";
+import { writeBytecode } from "../bytecode/writer.ts";
+import type { Value } from "./values.ts";
+import type { TransferValue } from "./transfer.ts";
+import { decodeValue, encodeValue } from "./transfer.ts";
+import type { VMLimits } from "./vm.ts";
+import { VMBudgetError, VMError } from "./vm.ts";
+import type { WorkerRequest, WorkerResponse } from "./pool-worker.ts";
+
+/**
+ * Options for a VMWorkerPool.
+ */
+export interface VMWorkerPoolOptions {
+  /** Number of worker threads (default: available parallelism). */
+  workers?: number;
+  /** Number of inputs sent to a worker at a time (default: 1024). */
+  chunkSize?: number;
+  /**
+   * Compile the program to JavaScript in every worker (see
+   * VM.enableCompilation()). Programs the compiled tier cannot translate
+   * are interpreted as usual. Default: false.
+   */
+  compile?: boolean;
+  /** Budgets for every run, as for the VM constructor (see VMLimits). */
+  limits?: VMLimits;
+}
+
+const DEFAULT_CHUNK_SIZE = 1024;
+
+interface PendingBatch {
+  inputs: TransferValue[];
+  results: Value[];
+  nextStart: number;
+  outstanding: number;
+  failed: boolean;
+  resolve: (results: Value[]) => void;
+  reject: (error: Error) => void;
+}
+
+/**
+ * A pool of worker threads that run one program over batches of inputs.
+ */
+export class VMWorkerPool {
+  private readonly workers: Worker[] = [];
+  private readonly idle: Worker[] = [];
+  private readonly chunkSize: number;
+  private readonly queue: PendingBatch[] = [];
+  private readonly assignments = new Map<Worker, { batch: PendingBatch; start: number }>();
+  private closed: boolean = false;
+
+  constructor(bytecode: BytecodeFile, options: VMWorkerPoolOptions = {}) {
+    const workerCount = options.workers ?? availableParallelism();
+    this.chunkSize = options.chunkSize ?? DEFAULT_CHUNK_SIZE;
+
+    if (!Number.isInteger(workerCount) || workerCount < 1) {
+      throw new RangeError(`Worker count must be a positive integer, got ${workerCount}`);
+    }
+    if (!Number.isInteger(this.chunkSize) || this.chunkSize < 1) {
+      throw new RangeError(`Chunk size must be a positive integer, got ${this.chunkSize}`);
+    }
+
+    // Serialize once into shared memory; workers read it without copying.
+    const bytes = writeBytecode(bytecode);
+    const shared = new SharedArrayBuffer(bytes.byteLength);
+    new Uint8Array(shared).set(bytes);
+
+    for (let i = 0; i < workerCount; i++) {
+      const worker = new Worker(new URL("./pool-worker.ts", import.meta.url), {
+        workerData: { bytecode: shared, compile: options.compile ?? false, limits: options.limits ?? {} },
+      });
+      worker.on("message", (response: WorkerResponse) => this.onMessage(worker, response));
+      worker.on("error", (error: Error) => this.onWorkerError(worker, error));
+      worker.on("exit", (code: number) => this.onWorkerError(worker, new Error(`Worker exited with code ${code}`)));
+      worker.unref();
+      this.workers.push(worker);
+      this.idle.push(worker);
+    }
+  }
+
+  /**
+   * Run the program over every input in parallel.
+   * @returns The results in input order
+   * @throws VMError (as a rejection) if any input fails
+   */
+  runBatch(inputs: Value[]): Promise<Value[]> {
+    if (this.closed) {
+      return Promise.reject(new Error("VMWorkerPool has been closed"));
+    }
+    if (inputs.length === 0) {
+      return Promise.resolve([]);
+    }
+    if (this.workers.length === 0) {
+      return Promise.reject(new Error("VMWorkerPool has no workers left"));
+    }
+
+    return new Promise((resolve, reject) => {
+      this.queue.push({
+        // Encoded once here, so a value that cannot be sent rejects the batch
+        inputs: inputs.map(encodeValue),
+        results: new Array(inputs.length),
+        nextStart: 0,
+        outstanding: 0,
+        failed: false,
+        resolve,
+        reject,
+      });
+      this.dispatch();
+    });
+  }
+
+  /**
+   * Terminate all workers. Pending batches are rejected.
+   */
+  async close(): Promise<void> {
+    if (this.closed) {
+      return;
+    }
+    this.closed = true;
+    for (const batch of this.queue) {
+      batch.reject(new Error("VMWorkerPool has been closed"));
+    }
+    this.queue.length = 0;
+    await Promise.all(this.workers.map((worker) => worker.terminate()));
+  }
+
+  /**
+   * Hand the next chunk of the oldest batch to each idle worker.
+   */
+  private dispatch(): void {
+    while (this.idle.length > 0 && this.queue.length > 0) {
+      const batch = this.queue[0]!;
+      if (batch.nextStart >= batch.inputs.length) {
+        // Fully handed out; remaining chunks are in flight.
+        this.queue.shift();
+        continue;
+      }
+
+      const worker = this.idle.pop()!;
+      const start = batch.nextStart;
+      const end = Math.min(start + this.chunkSize, batch.inputs.length);
+      batch.nextStart = end;
+      batch.outstanding++;
+
+      // Keep the worker referenced while it has work so the process stays up.
+      worker.ref();
+      this.assignments.set(worker, { batch, start });
+      const request: WorkerRequest = { inputs: batch.inputs.slice(start, end) };
+      worker.postMessage(request);
+    }
+  }
+
+  private onMessage(worker: Worker, response: WorkerResponse): void {
+    if (this.closed) {
+      // A late result from a worker close() is terminating; unreferencing
+      // it here would let the process exit before close() resolves.
+      return;
+    }
+    const assignment = this.assignments.get(worker);
+    this.assignments.delete(worker);
+    worker.unref();
+    this.idle.push(worker);
+
+    if (assignment) {
+      const { batch, start } = assignment;
+      batch.outstanding--;
+      if (response.error !== undefined) {
+        const { message, ip, budget } = response.error;
+        this.fail(batch, budget !== undefined ? new VMBudgetError(message, budget, ip) : new VMError(message, ip));
+      } else if (!batch.failed) {
+        for (let i = 0; i < response.results.length; i++) {
+          batch.results[start + i] = decodeValue(response.results[i]!);
+        }
+        if (batch.outstanding === 0 && batch.nextStart >= batch.inputs.length) {
+          batch.resolve(batch.results);
+        }
+      }
+    }
+
+    this.dispatch();
+  }
+
+  private onWorkerError(worker: Worker, error: Error): void {
+    // The worker has exited; drop it from the pool. A worker that fails
+    // reports "error" and then "exit", and close() ends with "exit" too.
+    const index = this.workers.indexOf(worker);
+    if (index < 0 || this.closed) {
+      return;
+    }
+    this.workers.splice(index, 1);
+    const idle = this.idle.indexOf(worker);
+    if (idle >= 0) {
+      this.idle.splice(idle, 1);
+    }
+    const assignment = this.assignments.get(worker);
+    this.assignments.delete(worker);
+    if (assignment) {
+      this.fail(assignment.batch, error);
+    }
+    if (this.workers.length === 0) {
+      for (const batch of this.queue) {
+        this.fail(batch, error);
+      }
+      this.queue.length = 0;
+    }
+  }
+
+  private fail(batch: PendingBatch, error: Error): void {
+    if (batch.failed) {
+      return;
+    }
+    batch.failed = true;
+    // Stop handing out the rest of this batch.
+    batch.nextStart = batch.inputs.length;
+    batch.reject(error);
+  }
+}
+
+/**
+ * Run a program over `inputs` on a temporary worker pool.
+ * @returns The results in input order
+ */
+export async function runVMParallel(
+  bytecode: BytecodeFile,
+  inputs: Value[],
+  options: VMWorkerPoolOptions = {}
+): Promise<Value[]> {
+  const pool = new VMWorkerPool(bytecode, options);
+  try {
+    return await pool.runBatch(inputs);
+  } finally {
+    await pool.close();
+  }
+}
@@ -0,0 +1,151 @@
+/**
+ * Tests for the VM profiler.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import { VMProfiler } from "./profiler.ts";
+import { compilePEX } from "./index.ts";
+import { VM, throwingEffectHandler } from "./vm.ts";
+import type { EffectHandler } from "./vm.ts";
+import { nullValue, numberValue, stringValue } from "./values.ts";
+import { addDebugInfo } from "../bytecode/format.ts";
+
+const FIB = "fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 10)";
+
+describe("VMProfiler", () => {
+  it("counts opcode dispatches", () => {
+    const vm = new VM(compilePEX("(+ 1 2)"), throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    expect(vm.run(nullValue())).toEqual(numberValue(3));
+
+    const report = profiler.toJSON();
+    const counts = Object.fromEntries(report.opcodes.map((op) => [op.opcode, op.count]));
+    expect(counts).toEqual({ CONST_ONE: 1, CONST_U8: 1, ADD: 1, RETURN: 1 });
+    expect(report.instructions).toBe(4);
+    expect(report.runs).toBe(1);
+  });
+
+  it("counts function template calls", () => {
+    const vm = new VM(compilePEX(FIB), throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    expect(vm.run(nullValue())).toEqual(numberValue(55));
+
+    const functions = Object.fromEntries(profiler.toJSON().functions.map((f) => [f.name, f.calls]));
+    // Functions compile to anonymous templates, labelled by index
+    expect(functions).toEqual({ "<main>": 1, "fn#1": 177 });
+  });
+
+  it("counts tail calls and attributes their stacks to the callee", () => {
+    const vm = new VM(
+      compilePEX("fn: pong (n) (if (<= n 0) 0 (ping (- n 1))); fn: ping (n) (pong n); (ping 3)"),
+      throwingEffectHandler
+    );
+    const profiler = vm.enableProfiling();
+    expect(vm.run(nullValue())).toEqual(numberValue(0));
+
+    const functions = Object.fromEntries(profiler.toJSON().functions.map((f) => [f.name, f.calls]));
+    expect(functions).toEqual({ "<main>": 1, "fn#1": 4, "fn#2": 4 });
+    // Every tail call replaces the frame, so the stacks never get deeper
+    const stacks = profiler.toFoldedStacks().split("\n").map((line) => line.split(" ")[0]);
+    expect(stacks.sort()).toEqual(["<main>", "<main>;fn#1", "<main>;fn#2"]);
+  });
+
+  it("records builtin calls with a latency histogram", () => {
+    const vm = new VM(compilePEX("$$ | lower | trim | upper"), throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    vm.runBatch(["  a ", " B", "c  "].map(stringValue));
+
+    const builtins = profiler.toJSON().builtins;
+    expect(builtins.map((b) => b.name).sort()).toEqual(["lower", "trim", "upper"]);
+    for (const builtin of builtins) {
+      expect(builtin.calls).toBe(3);
+      expect(builtin.histogram.reduce((sum, bucket) => sum + bucket.count, 0)).toBe(3);
+    }
+  });
+
+  it("exports folded call stacks", () => {
+    const vm = new VM(compilePEX(FIB), throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    vm.run(nullValue());
+
+    const stacks = profiler.toFoldedStacks().split("\n").map((line) => line.split(" ")[0]);
+    expect(stacks).toContain("<main>");
+    expect(stacks).toContain("<main>;fn#1");
+    expect(stacks).toContain("<main>;fn#1;fn#1;fn#1");
+    for (const line of profiler.toFoldedStacks().split("\n")) {
+      expect(line).toMatch(/^\S+ \d+$/);
+    }
+  });
+
+  it("maps instructions to source locations from debug info", () => {
+    const bytecode = compilePEX("(+ 1 2)");
+    // CONST_ONE and CONST_U8 on line 1, ADD and RETURN on line 2
+    addDebugInfo(bytecode, {
+      functions: [
+        {
+          functionIndex: 0,
+          localNames: ["$$"],
+          instructions: [
+            { byteOffset: 0, sourceLocation: { line: 1, column: 1 } },
+            { byteOffset: 3, sourceLocation: { line: 2, column: 4 } },
+          ],
+        },
+      ],
+    });
+
+    const vm = new VM(bytecode, throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    vm.run(nullValue());
+
+    const report = profiler.toJSON();
+    const locations = report.locations
+      .map(({ line, column, instructions }) => ({ line, column, instructions }))
+      .sort((a, b) => a.line - b.line);
+    expect(locations).toEqual([
+      { line: 1, column: 1, instructions: 2 },
+      { line: 2, column: 4, instructions: 2 },
+    ]);
+    expect(report.functions[0]!.location).toEqual({ line: 1, column: 1 });
+  });
+
+  it("profiles runs that resume effects", () => {
+    const handler: EffectHandler = (_name, args, continuation) => {
+      continuation.resume(numberValue((args[0] as { value: number }).value * 2));
+    };
+    const vm = new VM(compilePEX("fn: f (x) (+ x (ask: x)); (f 3)"), handler);
+    const profiler = vm.enableProfiling();
+    expect(vm.run(nullValue())).toEqual(numberValue(9));
+
+    const report = profiler.toJSON();
+    const counts = Object.fromEntries(report.opcodes.map((op) => [op.opcode, op.count]));
+    expect(counts["EFFECT_U8_U8"]).toBe(1);
+    expect(counts["RETURN"]).toBe(2);
+    expect(report.functions.find((f) => f.name === "fn#1")!.calls).toBe(1);
+    for (const op of report.opcodes) {
+      expect(op.timeNs).toBeGreaterThanOrEqual(0);
+    }
+  });
+
+  it("stops recording when disabled", () => {
+    const vm = new VM(compilePEX("$$ | upper"), throwingEffectHandler);
+    const profiler = vm.enableProfiling();
+    vm.run(stringValue("a"));
+    expect(vm.disableProfiling()).toBe(profiler);
+
+    vm.run(stringValue("b"));
+    expect(profiler.toJSON().runs).toBe(1);
+    expect(vm.disableProfiling()).toBeNull();
+  });
+
+  it("accumulates across VMs sharing a profiler", () => {
+    const bytecode = compilePEX("$$ | upper");
+    const profiler = new VMProfiler(bytecode);
+    for (const input of ["a", "b"]) {
+      const vm = new VM(bytecode, throwingEffectHandler);
+      vm.enableProfiling(profiler);
+      vm.run(stringValue(input));
+    }
+    expect(profiler.toJSON().runs).toBe(2);
+    expect(profiler.toJSON().builtins[0]!.calls).toBe(2);
+  });
+});
@@ -0,0 +1,395 @@
+/**
+ * Opt-in profiler for the PEX VM.
+ *
+ * A VMProfiler is attached with VM.enableProfiling(). While one is attached
+ * the VM runs a separate, instrumented dispatch loop that times every
+ * instruction; the normal loop is untouched, so profiling costs nothing when
+ * it is disabled.
+ *
+ * The profiler records:
+ * - Dispatch counts and cumulative time per opcode
+ * - Call counts, cumulative time and a latency histogram per builtin
+ * - Call counts, instruction counts and self time per function template
+ * - Self time per call stack, exported in the folded-stack format read by
+ *   flamegraph tools
+ * - Instruction counts and time per source location, when the bytecode has
+ *   a DebugInfo section
+ *
+ * Times are self times: time spent inside an effect handler that resumes the
+ * VM is counted against the resumed instructions, not the EFFECT.
+ */
+
+import type { BytecodeFile, FunctionTemplate, SourceLocation } from "../bytecode/format.ts";
+import { Opcode } from "../bytecode/opcodes.ts";
+import type { CallFrame } from "./values.ts";
+
+/**
+ * Histogram bucket: the number of calls that took at most `upperBoundNs`
+ * (and more than the previous bucket's bound).
+ */
+export interface HistogramBucket {
+  upperBoundNs: number;
+  count: number;
+}
+
+export interface OpcodeProfile {
+  opcode: string;
+  count: number;
+  timeNs: number;
+}
+
+export interface BuiltinProfile {
+  name: string;
+  calls: number;
+  timeNs: number;
+  histogram: HistogramBucket[];
+}
+
+export interface FunctionProfile {
+  /** Index into the function templates. */
+  index: number;
+  name: string;
+  calls: number;
+  instructions: number;
+  /** Time spent in the function's own instructions. */
+  selfTimeNs: number;
+  /** Location of the function's first instruction, if debug info has one. */
+  location: SourceLocation | null;
+}
+
+export interface LocationProfile {
+  functionIndex: number;
+  line: number;
+  column: number;
+  instructions: number;
+  timeNs: number;
+}
+
+/**
+ * JSON-serializable profile. Lists are sorted by time, highest first.
+ */
+export interface VMProfileReport {
+  runs: number;
+  instructions: number;
+  timeNs: number;
+  opcodes: OpcodeProfile[];
+  builtins: BuiltinProfile[];
+  functions: FunctionProfile[];
+  /** Empty unless the bytecode has debug info. */
+  locations: LocationProfile[];
+}
+
+// Latency buckets are powers of two from 1ns to 2^40ns (about 18 minutes)
+const HISTOGRAM_BUCKETS = 41;
+const NS_PER_MS = 1e6;
+
+interface BuiltinStats {
+  calls: number;
+  timeMs: number;
+  histogram: number[];
+}
+
+/**
+ * Profile data collected from one or more VM runs.
+ */
+export class VMProfiler {
+  private readonly bytecode: BytecodeFile;
+  private readonly templateIndices: Map<FunctionTemplate, number> = new Map();
+
+  private runs: number = 0;
+  private readonly opcodeCounts = new Float64Array(256);
+  private readonly opcodeTimes = new Float64Array(256);
+  private readonly builtinStats: Map<number, BuiltinStats> = new Map();
+  private readonly functionCalls: Float64Array;
+  private readonly functionInstructions: Float64Array;
+  private readonly functionTimes: Float64Array;
+  // Indexed by byte offset in the code section
+  private readonly offsetCounts: Float64Array;
+  private readonly offsetTimes: Float64Array;
+  private readonly stackTimes: Map<string, number> = new Map();
+  private readonly frameStacks: WeakMap<CallFrame, string> = new WeakMap();
+
+  /**
+   * Time spent in nested dispatch loops (effect handlers that resume the VM
+   * from inside an instruction). The VM subtracts it from the instruction
+   * that started the nested loop.
+   */
+  nestedTimeMs: number = 0;
+
+  constructor(bytecode: BytecodeFile) {
+    this.bytecode = bytecode;
+    const templates = bytecode.functionTemplates.templates;
+    templates.forEach((template, index) => this.templateIndices.set(template, index));
+
+    this.functionCalls = new Float64Array(templates.length);
+    this.functionInstructions = new Float64Array(templates.length);
+    this.functionTimes = new Float64Array(templates.length);
+    this.offsetCounts = new Float64Array(bytecode.codeSection.code.length);
+    this.offsetTimes = new Float64Array(bytecode.codeSection.code.length);
+  }
+
+  /**
+   * Index of a template in the profiled program, or -1 if it is not one of
+   * its templates.
+   */
+  templateIndex(template: FunctionTemplate): number {
+    return this.templateIndices.get(template) ?? -1;
+  }
+
+  /**
+   * Folded-stack key for the innermost frame, e.g. "<main>;fn#1;fn#1".
+   * Keys are cached per frame, so this is only O(depth) for new stacks.
+   */
+  stackKey(frames: CallFrame[]): string {
+    let depth = frames.length;
+    while (depth > 0 && !this.frameStacks.has(frames[depth - 1]!)) {
+      depth--;
+    }
+
+    let key = depth > 0 ? this.frameStacks.get(frames[depth - 1]!)! : "";
+    for (let i = depth; i < frames.length; i++) {
+      const frame = frames[i]!;
+      const name = this.functionName(this.templateIndex(frame.closure.template));
+      key = key === "" ? name : `${key};${name}`;
+      this.frameStacks.set(frame, key);
+    }
+    return key;
+  }
+
+  /**
+   * Drop the cached key of a frame that a tail call handed to another
+   * function.
+   */
+  forgetFrame(frame: CallFrame): void {
+    this.frameStacks.delete(frame);
+  }
+
+  recordRun(): void {
+    this.runs++;
+  }
+
+  recordCall(templateIndex: number): void {
+    if (templateIndex >= 0) {
+      this.functionCalls[templateIndex]!++;
+    }
+  }
+
+  /**
+   * Record one executed instruction.
+   * @param offset Byte offset of the instruction in the code section
+   * @param builtinNameIndex Name index of the builtin it called, if any
+   */
+  recordInstruction(
+    opcode: Opcode,
+    offset: number,
+    templateIndex: number,
+    stackKey: string,
+    elapsedMs: number,
+    builtinNameIndex: number | null
+  ): void {
+    this.opcodeCounts[opcode]!++;
+    this.opcodeTimes[opcode]! += elapsedMs;
+
+    if (templateIndex >= 0) {
+      this.functionInstructions[templateIndex]!++;
+      this.functionTimes[templateIndex]! += elapsedMs;
+    }
+    if (offset < this.offsetCounts.length) {
+      this.offsetCounts[offset]!++;
+      this.offsetTimes[offset]! += elapsedMs;
+    }
+    this.stackTimes.set(stackKey, (this.stackTimes.get(stackKey) ?? 0) + elapsedMs);
+
+    if (builtinNameIndex !== null) {
+      let stats = this.builtinStats.get(builtinNameIndex);
+      if (!stats) {
+        stats = { calls: 0, timeMs: 0, histogram: new Array(HISTOGRAM_BUCKETS).fill(0) };
+        this.builtinStats.set(builtinNameIndex, stats);
+      }
+      stats.calls++;
+      stats.timeMs += elapsedMs;
+      stats.histogram[histogramBucket(elapsedMs * NS_PER_MS)]!++;
+    }
+  }
+
+  /**
+   * Build a JSON-serializable report of everything recorded so far.
+   */
+  toJSON(): VMProfileReport {
+    const templates = this.bytecode.functionTemplates.templates;
+    const names = this.bytecode.nameTable.names;
+
+    const opcodes: OpcodeProfile[] = [];
+    let instructions = 0;
+    let timeMs = 0;
+    for (let opcode = 0; opcode < 256; opcode++) {
+      const count = this.opcodeCounts[opcode]!;
+      if (count > 0) {
+        opcodes.push({
+          opcode: Opcode[opcode] ?? `0x${opcode.toString(16)}`,
+          count,
+          timeNs: toNs(this.opcodeTimes[opcode]!),
+        });
+        instructions += count;
+        timeMs += this.opcodeTimes[opcode]!;
+      }
+    }
+
+    const builtins: BuiltinProfile[] = [];
+    for (const [nameIndex, stats] of this.builtinStats) {
+      const histogram: HistogramBucket[] = [];
+      stats.histogram.forEach((count, bucket) => {
+        if (count > 0) {
+          histogram.push({ upperBoundNs: 2 ** bucket, count });
+        }
+      });
+      builtins.push({
+        name: names[nameIndex] ?? `#${nameIndex}`,
+        calls: stats.calls,
+        timeNs: toNs(stats.timeMs),
+        histogram,
+      });
+    }
+
+    const locations = this.functionLocations();
+    const functions: FunctionProfile[] = [];
+    templates.forEach((_template, index) => {
+      const calls = this.functionCalls[index]!;
+      const executed = this.functionInstructions[index]!;
+      if (calls === 0 && executed === 0) {
+        return;
+      }
+      functions.push({
+        index,
+        name: this.functionName(index),
+        calls,
+        instructions: executed,
+        selfTimeNs: toNs(this.functionTimes[index]!),
+        location: locations.get(index) ?? null,
+      });
+    });
+
+    return {
+      runs: this.runs,
+      instructions,
+      timeNs: toNs(timeMs),
+      opcodes: opcodes.sort((a, b) => b.timeNs - a.timeNs),
+      builtins: builtins.sort((a, b) => b.timeNs - a.timeNs),
+      functions: functions.sort((a, b) => b.selfTimeNs - a.selfTimeNs),
+      locations: this.sourceLocations().sort((a, b) => b.timeNs - a.timeNs),
+    };
+  }
+
+  /**
+   * Self time per call stack in the folded-stack format (one
+   * "frame;frame;frame <nanoseconds>" line per stack), as read by
+   * flamegraph.pl, speedscope and inferno.
+   */
+  toFoldedStacks(): string {
+    const lines: string[] = [];
+    for (const [stack, timeMs] of this.stackTimes) {
+      const ns = toNs(timeMs);
+      if (stack !== "" && ns > 0) {
+        lines.push(`${stack} ${ns}`);
+      }
+    }
+    return lines.sort().join("\n");
+  }
+
+  /**
+   * Display name of a function template. Functions compile to anonymous
+   * templates, so they are labelled by template index unless they carry a
+   * name.
+   */
+  private functionName(index: number): string {
+    const template = this.bytecode.functionTemplates.templates[index];
+    const names = this.bytecode.nameTable.names;
+    if (template && template.nameIndex >= 0 && template.nameIndex < names.length) {
+      return names[template.nameIndex]!;
+    }
+    return index === this.bytecode.header.entryPoint ? "<main>" : `fn#${index}`;
+  }
+
+  /**
+   * First source location of each function with debug info.
+   */
+  private functionLocations(): Map<number, SourceLocation> {
+    const result = new Map<number, SourceLocation>();
+    for (const func of this.bytecode.debugInfo?.functions ?? []) {
+      let first: { byteOffset: number; sourceLocation: SourceLocation } | undefined;
+      for (const info of func.instructions) {
+        if (!first || info.byteOffset < first.byteOffset) {
+          first = info;
+        }
+      }
+      if (first) {
+        result.set(func.functionIndex, first.sourceLocation);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Aggregate per-instruction counts by source location. Each instruction
+   * belongs to the closest debug entry at or before it in its function.
+   */
+  private sourceLocations(): LocationProfile[] {
+    const debugInfo = this.bytecode.debugInfo;
+    if (!debugInfo) {
+      return [];
+    }
+
+    const templates = this.bytecode.functionTemplates.templates;
+    const byLocation = new Map<string, LocationProfile>();
+
+    for (const func of debugInfo.functions) {
+      const template = templates[func.functionIndex];
+      if (!template || func.instructions.length === 0) {
+        continue;
+      }
+
+      const entries = [...func.instructions].sort((a, b) => a.byteOffset - b.byteOffset);
+      const end = Math.min(template.codeOffset + template.codeLength, this.offsetCounts.length);
+      let entry = -1;
+
+      for (let offset = template.codeOffset; offset < end; offset++) {
+        while (entry + 1 < entries.length && entries[entry + 1]!.byteOffset <= offset) {
+          entry++;
+        }
+        const count = this.offsetCounts[offset]!;
+        if (entry < 0 || count === 0) {
+          continue;
+        }
+
+        const { line, column } = entries[entry]!.sourceLocation;
+        const key = `${func.functionIndex}:${line}:${column}`;
+        let location = byLocation.get(key);
+        if (!location) {
+          location = { functionIndex: func.functionIndex, line, column, instructions: 0, timeNs: 0 };
+          byLocation.set(key, location);
+        }
+        location.instructions += count;
+        location.timeNs += toNs(this.offsetTimes[offset]!);
+      }
+    }
+
+    return [...byLocation.values()];
+  }
+}
+
+/**
+ * Convert milliseconds from performance.now() to whole nanoseconds.
+ */
+function toNs(ms: number): number {
+  return Math.round(ms * NS_PER_MS);
+}
+
+/**
+ * Smallest power-of-two bucket that holds `ns`.
+ */
+function histogramBucket(ns: number): number {
+  if (ns <= 1) {
+    return 0;
+  }
+  return Math.min(Math.ceil(Math.log2(ns)), HISTOGRAM_BUCKETS - 1);
+}
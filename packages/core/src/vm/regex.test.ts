@@ -0,0 +1,69 @@
+/**
+ * Tests for the regex scanning kernels.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import { RegexKernel } from "./regex.ts";
+import { compilePEX } from "./index.ts";
+import { VM, throwingEffectHandler } from "./vm.ts";
+import { booleanValue, stringValue } from "./values.ts";
+
+const SAMPLES = [
+  "",
+  "Call  (555) 123-4567 ext. 89",
+  "tab\tand\nnewline",
+  "\u00a0nbsp\u3000ideographic\ufeff",
+  "héllo wörld",
+  "a😀b c",
+  "ext.ext.ext",
+];
+
+describe("RegexKernel", () => {
+  it("accepts literals and single character classes", () => {
+    for (const pattern of ["ext\\.", "a\\-b", "\\t", "\\D", "\\s+", "[ \\t]+", "[^a-z\\d]", "[\\]x-]"]) {
+      expect(RegexKernel.compile(pattern, "g")).not.toBeNull();
+    }
+  });
+
+  it("leaves everything else to RegExp", () => {
+    for (const pattern of ["", "a|b", "a.", "a+", "\\bx", "(a)", "[]", "[^]", "[\\D]", "[z-a]", "\\d*"]) {
+      expect(RegexKernel.compile(pattern, "g")).toBeNull();
+    }
+    for (const flags of ["i", "m", "u", "y", "gi"]) {
+      expect(RegexKernel.compile("abc", flags)).toBeNull();
+    }
+  });
+
+  it("agrees with RegExp", () => {
+    for (const pattern of ["ext\\.", "\\D", "\\d+", "\\s+", "\\S", "\\w+", "\\W", "[^\\s,]+", "[a-c\\d]+"]) {
+      for (const flags of ["", "g"]) {
+        const kernel = RegexKernel.compile(pattern, flags)!;
+        const regex = new RegExp(pattern, flags);
+        for (const sample of SAMPLES) {
+          expect(kernel.find(sample, 0) !== -1).toBe(regex.test(sample));
+          expect(kernel.replace(sample, "<>")).toBe(sample.replace(regex, "<>"));
+          expect(kernel.match(sample)).toEqual(sample.match(regex)?.slice(0, flags ? undefined : 1) ?? null);
+          regex.lastIndex = 0;
+        }
+      }
+    }
+  });
+});
+
+describe("regex builtins", () => {
+  it("keep no state between calls on a global regex", () => {
+    const bytecode = compilePEX('let: r /a/g; (and (test "a" r) (test "a" r))');
+    expect(new VM(bytecode, throwingEffectHandler).run(stringValue(""))).toEqual(booleanValue(true));
+  });
+
+  it("share regex constants between VMs on the same bytecode", () => {
+    const bytecode = compilePEX("/\\D/g");
+    const first = new VM(bytecode, throwingEffectHandler).run(stringValue(""));
+    expect(new VM(bytecode, throwingEffectHandler).run(stringValue(""))).toBe(first);
+  });
+
+  it("fall back to RegExp for replacement patterns", () => {
+    const bytecode = compilePEX('(replace $$ /\\d+/g "<$&>")');
+    expect(new VM(bytecode, throwingEffectHandler).run(stringValue("a1b22"))).toEqual(stringValue("a<1>b<22>"));
+  });
+});
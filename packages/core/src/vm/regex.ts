@@ -0,0 +1,324 @@
+/**
+ * Scanning kernels for simple regexes.
+ *
+ * Most regexes in PEX filters are either a literal substring (`/ext\./`) or
+ * one character class, optionally repeated (`/\D/g`, `/[ \t]+/g`).
+ * regexValue() classifies every pattern once, when the regex constant is
+ * loaded, and the match/test/replace builtins scan with the kernel instead
+ * of going through RegExp. Everything else falls back to RegExp.
+ *
+ * Kernels only accept patterns whose meaning is unambiguous: flags other
+ * than `g` (case folding, multiline, unicode, sticky) disable them, as do
+ * empty patterns and escapes other than `\d \w \s`, their negations,
+ * control characters and escaped punctuation. Scanning is done on UTF-16
+ * code units, exactly as RegExp does without the `u` flag.
+ *
+ * The native engine (packages/tree-sitter-pex/engine/regex.cc) accepts
+ * the same patterns.
+ */
+
+/** Characters with a meaning of their own outside a class */
+const SYNTAX_CHARS = "\\^$.|?*+()[]{}";
+
+/** Punctuation that may be escaped to stand for itself */
+const ESCAPABLE_CHARS = "^$\\.*+?()[]{}|/-";
+
+/** Control escapes, as code units */
+const CONTROL_ESCAPES: Record<string, number> = { n: 10, r: 13, t: 9, f: 12, v: 11 };
+
+const CLASS_SIZE = 128;
+
+/**
+ * End (exclusive) of the match found by the last find(). Kernels hold no
+ * state of their own, so one can be shared by every run of a program.
+ */
+let matchEnd = 0;
+
+/**
+ * A compiled kernel for one regex.
+ */
+export class RegexKernel {
+  private constructor(
+    /** Substring to search for, or null for a class kernel */
+    readonly literal: string | null,
+    /** Class membership of each ASCII code unit */
+    private readonly members: Uint8Array,
+    /** Whether code units above ASCII that are not whitespace are members */
+    private readonly otherMembers: boolean,
+    /** Whether non-ASCII whitespace code units are members */
+    private readonly spaceMembers: boolean,
+    /** Class is followed by `+` */
+    private readonly repeat: boolean,
+    /** The regex has the `g` flag */
+    readonly global: boolean
+  ) {}
+
+  /**
+   * Build a kernel for a pattern, or return null if it needs RegExp.
+   */
+  static compile(pattern: string, flags: string): RegexKernel | null {
+    if (flags !== "" && flags !== "g") {
+      return null;
+    }
+    const global = flags === "g";
+
+    const literal = parseLiteral(pattern);
+    if (literal !== null) {
+      return new RegexKernel(literal, new Uint8Array(0), false, false, false, global);
+    }
+
+    const set = new CharSet();
+    const end = parseClass(pattern, set);
+    if (end === -1) {
+      return null;
+    }
+    const repeat = pattern[end] === "+";
+    if (end + (repeat ? 1 : 0) !== pattern.length) {
+      return null;
+    }
+
+    const members = new Uint8Array(CLASS_SIZE);
+    for (let c = 0; c < CLASS_SIZE; c++) {
+      members[c] = set.ascii[c]! ^ (set.negated ? 1 : 0);
+    }
+    return new RegexKernel(null, members, set.negated, set.spaces !== set.negated, repeat, global);
+  }
+
+  /**
+   * Index of the first match at or after `from`, or -1.
+   */
+  find(text: string, from: number): number {
+    if (this.literal !== null) {
+      const index = text.indexOf(this.literal, from);
+      if (index !== -1) {
+        matchEnd = index + this.literal.length;
+      }
+      return index;
+    }
+
+    const length = text.length;
+    for (let i = from; i < length; i++) {
+      if (this.isMember(text.charCodeAt(i))) {
+        let end = i + 1;
+        if (this.repeat) {
+          while (end < length && this.isMember(text.charCodeAt(end))) {
+            end++;
+          }
+        }
+        matchEnd = end;
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /**
+   * String.prototype.replace() for a replacement without `$` patterns.
+   */
+  replace(text: string, replacement: string): string {
+    let result = "";
+    let last = 0;
+    let start = this.find(text, 0);
+    if (start === -1) {
+      return text;
+    }
+    while (start !== -1) {
+      result += text.slice(last, start) + replacement;
+      last = matchEnd;
+      if (!this.global) {
+        break;
+      }
+      start = this.find(text, last);
+    }
+    return result + text.slice(last);
+  }
+
+  /**
+   * String.prototype.match(), as strings: the first match, or every match
+   * for a global regex. Kernels have no capture groups.
+   */
+  match(text: string): string[] | null {
+    let start = this.find(text, 0);
+    if (start === -1) {
+      return null;
+    }
+    const matches: string[] = [];
+    while (start !== -1) {
+      matches.push(text.slice(start, matchEnd));
+      if (!this.global) {
+        break;
+      }
+      start = this.find(text, matchEnd);
+    }
+    return matches;
+  }
+
+  private isMember(unit: number): boolean {
+    if (unit < CLASS_SIZE) {
+      return this.members[unit] === 1;
+    }
+    return isUnicodeSpace(unit) ? this.spaceMembers : this.otherMembers;
+  }
+}
+
+/**
+ * A character class under construction: an ASCII bitmap, whether `\s`
+ * (which also covers non-ASCII whitespace) was included, and negation.
+ */
+class CharSet {
+  readonly ascii = new Uint8Array(CLASS_SIZE);
+  spaces = false;
+  negated = false;
+
+  addRange(from: number, to: number): void {
+    this.ascii.fill(1, from, to + 1);
+  }
+
+  /**
+   * Add the class named by `\d`, `\w` or `\s`. Returns false otherwise.
+   */
+  addEscape(letter: string): boolean {
+    switch (letter) {
+      case "d":
+        this.addRange(48, 57);
+        return true;
+      case "w":
+        this.addRange(48, 57);
+        this.addRange(65, 90);
+        this.addRange(97, 122);
+        this.ascii[95] = 1;
+        return true;
+      case "s":
+        this.addRange(9, 13);
+        this.ascii[32] = 1;
+        this.spaces = true;
+        return true;
+      default:
+        return false;
+    }
+  }
+}
+
+/**
+ * The string a pattern of only literal characters matches, or null.
+ */
+function parseLiteral(pattern: string): string | null {
+  let literal = "";
+  for (let i = 0; i < pattern.length; i++) {
+    const c = pattern[i]!;
+    if (c === "\\") {
+      const unit = parseEscapedUnit(pattern[i + 1]);
+      if (unit === -1) {
+        return null;
+      }
+      literal += String.fromCharCode(unit);
+      i++;
+    } else if (SYNTAX_CHARS.includes(c)) {
+      return null;
+    } else {
+      literal += c;
+    }
+  }
+  return literal.length > 0 ? literal : null;
+}
+
+/**
+ * Parse one class atom (`\d`, `\D`, `\w`, `\W`, `\s`, `\S` or `[...]`)
+ * at the start of `pattern` into `set`, returning the index after it, or
+ * -1 if the pattern does not start with one.
+ */
+function parseClass(pattern: string, set: CharSet): number {
+  if (pattern[0] === "\\") {
+    const letter = pattern[1] ?? "";
+    const lower = letter.toLowerCase();
+    if (!set.addEscape(lower)) {
+      return -1;
+    }
+    set.negated = letter !== lower;
+    return 2;
+  }
+  if (pattern[0] !== "[") {
+    return -1;
+  }
+
+  let i = 1;
+  if (pattern[i] === "^") {
+    set.negated = true;
+    i++;
+  }
+
+  let count = 0;
+  while (i < pattern.length && pattern[i] !== "]") {
+    if (pattern[i] === "\\" && set.addEscape(pattern[i + 1] ?? "")) {
+      i += 2;
+      count++;
+      continue;
+    }
+
+    const from = parseClassUnit(pattern, i);
+    if (from === -1) {
+      return -1;
+    }
+    i += pattern[i] === "\\" ? 2 : 1;
+
+    if (pattern[i] === "-" && i + 1 < pattern.length && pattern[i + 1] !== "]") {
+      const to = parseClassUnit(pattern, i + 1);
+      if (to === -1 || to < from) {
+        return -1;
+      }
+      i += pattern[i + 1] === "\\" ? 3 : 2;
+      set.addRange(from, to);
+    } else {
+      set.addRange(from, from);
+    }
+    count++;
+  }
+
+  if (i >= pattern.length || count === 0) {
+    return -1;
+  }
+  return i + 1;
+}
+
+/**
+ * The ASCII code unit of a literal or escaped character inside a class,
+ * or -1.
+ */
+function parseClassUnit(pattern: string, i: number): number {
+  const c = pattern[i];
+  if (c === undefined) {
+    return -1;
+  }
+  const unit = c === "\\" ? parseEscapedUnit(pattern[i + 1]) : c.charCodeAt(0);
+  return unit < CLASS_SIZE ? unit : -1;
+}
+
+/**
+ * The code unit an escape such as `\.` or `\t` stands for, or -1.
+ */
+function parseEscapedUnit(letter: string | undefined): number {
+  if (letter === undefined) {
+    return -1;
+  }
+  if (ESCAPABLE_CHARS.includes(letter)) {
+    return letter.charCodeAt(0);
+  }
+  return CONTROL_ESCAPES[letter] ?? -1;
+}
+
+/**
+ * Whether a non-ASCII code unit is matched by `\s`.
+ */
+function isUnicodeSpace(unit: number): boolean {
+  return (
+    unit === 0xa0 ||
+    unit === 0x1680 ||
+    (unit >= 0x2000 && unit <= 0x200a) ||
+    unit === 0x2028 ||
+    unit === 0x2029 ||
+    unit === 0x202f ||
+    unit === 0x205f ||
+    unit === 0x3000 ||
+    unit === 0xfeff
+  );
+}
@@ -0,0 +1,77 @@
+/**
+ * Tests for object shapes.
+ */
+
+import { describe, test as it, expect } from "bun:test";
+import { Worker } from "node:worker_threads";
+import { MAX_SHARED_KEYS, MAX_SHARED_SHAPES, MAX_TRANSITIONS, Shape } from "./shape.ts";
+
+describe("Shape", () => {
+  it("shares shapes between objects with the same keys in the same order", () => {
+    const shape = Shape.of(["id", "name"]);
+    expect(Shape.of(["id", "name"])).toBe(shape);
+    expect(Shape.of(["name", "id"])).not.toBe(shape);
+    expect(Shape.of([])).toBe(Shape.EMPTY);
+  });
+
+  it("maps keys to slots", () => {
+    const shape = Shape.of(["id", "name", "tags"]);
+    expect(shape.size).toBe(3);
+    expect(shape.keys).toEqual(["id", "name", "tags"]);
+    expect(shape.slot("name")).toBe(1);
+    expect(shape.slot("email")).toBe(-1);
+  });
+
+  it("stops sharing past the transition limit", () => {
+    const parent = Shape.of(["limit test"]);
+    const children = Array.from({ length: MAX_TRANSITIONS + 1 }, (_, i) => ["limit test", `key${i}`]);
+    for (const keys of children) {
+      Shape.of(keys);
+    }
+    expect(Shape.of(children[0]!)).toBe(Shape.of(children[0]!));
+    const unshared = children[MAX_TRANSITIONS]!;
+    expect(Shape.of(unshared)).not.toBe(Shape.of(unshared));
+    expect(Shape.of(unshared).keys).toEqual(unshared);
+    expect(Shape.of(["limit test"])).toBe(parent);
+  });
+
+  it("gives objects with many keys a shape of their own", () => {
+    const keys = Array.from({ length: MAX_SHARED_KEYS + 1 }, (_, i) => `k${i}`);
+    const shape = Shape.of(keys);
+    expect(Shape.of(keys)).not.toBe(shape);
+    expect(shape.slot(`k${MAX_SHARED_KEYS}`)).toBe(MAX_SHARED_KEYS);
+  });
+
+  it("bounds the shared tree across distinct layouts", async () => {
+    // Exhausting the budget is permanent, so it runs on a thread of its own
+    const script = `
+      const { parentPort } = require("node:worker_threads");
+      import(${JSON.stringify(new URL("./shape.ts", import.meta.url).href)}).then(({ Shape }) => {
+        const first = Shape.of(["a0", "b0"]);
+        for (let i = 0; i < 100000; i++) {
+          Shape.of(["a" + (i % 64), "b" + ((i >> 6) % 64), "c" + (i >> 12)]);
+        }
+        const late = ["late", "layout"];
+        parentPort.postMessage({
+          count: Shape.sharedCount,
+          stillShared: Shape.of(["a0", "b0"]) === first,
+          lateShared: Shape.of(late) === Shape.of(late),
+          lateKeys: Shape.of(late).keys,
+          lateSlot: Shape.of(late).slot("layout"),
+        });
+      });
+    `;
+    const worker = new Worker(script, { eval: true });
+    const result = await new Promise<Record<string, unknown>>((resolve, reject) => {
+      worker.once("message", resolve);
+      worker.once("error", reject);
+    });
+    await worker.terminate();
+
+    expect(result.count).toBe(MAX_SHARED_SHAPES);
+    expect(result.stillShared).toBe(true);
+    expect(result.lateShared).toBe(false);
+    expect(result.lateKeys).toEqual(["late", "layout"]);
+    expect(result.lateSlot).toBe(1);
+  });
+});
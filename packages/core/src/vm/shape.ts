@@ -0,0 +1,123 @@
+/**
+ * Object shapes (hidden classes) for the PEX VM.
+ *
+ * An object stores its values in dense slots and its keys in a Shape shared
+ * by every object with the same keys in the same order. Shapes form a tree
+ * rooted at Shape.EMPTY in which each child adds one key, so an input
+ * stream of records with the same keys yields one shape, and a call site
+ * that has looked a key up in a shape once can reuse the slot for every
+ * later object by comparing shapes by identity.
+ *
+ * The tree is never freed, so it is bounded three ways: a shape records at
+ * most MAX_TRANSITIONS children, objects with more than MAX_SHARED_KEYS keys
+ * are not shared, and the whole tree holds at most MAX_SHARED_SHAPES shapes.
+ * A layout that does not fit gets a dictionary-mode shape of its own, which
+ * holds its keys directly and is freed with its objects, so inputs with
+ * unbounded key sets (maps keyed by id, say) cannot grow the tree past the
+ * budget. Property reads on such objects still work, but miss the inline
+ * caches.
+ */
+
+/** Children a shape records before further key layouts stop being shared. */
+export const MAX_TRANSITIONS = 64;
+
+/** Keys an object may have and still share its shape. */
+export const MAX_SHARED_KEYS = 128;
+
+/** Shapes the shared tree holds across the whole process. */
+export const MAX_SHARED_SHAPES = 16384;
+
+/**
+ * Key layout of an object. Keys are unique; a key's slot is its position.
+ */
+export class Shape {
+  /** The shape of objects without keys. */
+  static readonly EMPTY = new Shape(null, "", 0);
+
+  private static shared = 0;
+
+  /** Number of shapes in the shared tree, besides EMPTY. */
+  static get sharedCount(): number {
+    return Shape.shared;
+  }
+
+  /** Number of keys (and slots). */
+  readonly size: number;
+
+  private readonly parent: Shape | null;
+  private readonly key: string;
+  private transitions: Map<string, Shape> | null = null;
+  // Built on first use, since most shapes in the tree are only passed through
+  private keyList: string[] | null = null;
+  private slotMap: Map<string, number> | null = null;
+
+  private constructor(parent: Shape | null, key: string, size: number, keys: string[] | null = null) {
+    this.parent = parent;
+    this.key = key;
+    this.size = size;
+    this.keyList = keys;
+  }
+
+  /**
+   * The shared shape with `keys`, in order. Keys must be unique.
+   */
+  static of(keys: readonly string[]): Shape {
+    if (keys.length > MAX_SHARED_KEYS) {
+      return Shape.dictionary(keys);
+    }
+    let shape = Shape.EMPTY;
+    for (const key of keys) {
+      const child = shape.with(key);
+      if (child === null) {
+        return Shape.dictionary(keys);
+      }
+      shape = child;
+    }
+    return shape;
+  }
+
+  /** An unshared shape holding `keys` itself. */
+  private static dictionary(keys: readonly string[]): Shape {
+    return new Shape(null, "", keys.length, keys.slice());
+  }
+
+  /** Keys in slot order. */
+  get keys(): readonly string[] {
+    if (this.keyList === null) {
+      const keys = new Array<string>(this.size);
+      for (let shape: Shape = this; shape.parent !== null; shape = shape.parent) {
+        keys[shape.size - 1] = shape.key;
+      }
+      this.keyList = keys;
+    }
+    return this.keyList;
+  }
+
+  /**
+   * Slot holding `key`, or -1 if objects of this shape do not have it.
+   */
+  slot(key: string): number {
+    if (this.slotMap === null) {
+      this.slotMap = new Map(this.keys.map((k, i) => [k, i]));
+    }
+    return this.slotMap.get(key) ?? -1;
+  }
+
+  /**
+   * The child shape that adds `key`, which this shape must not have, or
+   * null if it is not in the tree and the tree has no room for it.
+   */
+  private with(key: string): Shape | null {
+    let child = this.transitions?.get(key);
+    if (child === undefined) {
+      if ((this.transitions?.size ?? 0) >= MAX_TRANSITIONS || Shape.shared >= MAX_SHARED_SHAPES) {
+        return null;
+      }
+      child = new Shape(this, key, this.size + 1);
+      this.transitions ??= new Map();
+      this.transitions.set(key, child);
+      Shape.shared++;
+    }
+    return child;
+  }
+}
@@ -0,0 +1,83 @@
+/**
+ * Encoding of VM values for postMessage().
+ *
+ * Structured clone copies own data only: shapes and regex kernels arrive as
+ * plain objects without their methods, and the shared null and boolean
+ * values arrive as copies. Values therefore cross a thread boundary in this
+ * plain encoding and are rebuilt with the value factories on arrival, so
+ * objects get their shared shape back and regexes are recompiled.
+ *
+ * Closures and continuations reference the running VM and cannot be sent.
+ */
+
+import { Shape } from "./shape.ts";
+import type { Value } from "./values.ts";
+import {
+  arrayValue,
+  booleanValue,
+  nullValue,
+  numberValue,
+  regexValue,
+  shapedObjectValue,
+  stringValue,
+} from "./values.ts";
+
+/**
+ * A value as sent between threads. Objects keep their keys and slots apart,
+ * as in an ObjectValue.
+ */
+export type TransferValue =
+  | null
+  | boolean
+  | number
+  | string
+  | TransferValue[]
+  | { keys: readonly string[]; slots: TransferValue[] }
+  | { pattern: string; flags: string };
+
+/**
+ * Encode a value for postMessage().
+ * @throws Error for closures and continuations
+ */
+export function encodeValue(value: Value): TransferValue {
+  switch (value.type) {
+    case "null":
+      return null;
+    case "boolean":
+    case "number":
+    case "string":
+      return value.value;
+    case "array":
+      return value.elements.map(encodeValue);
+    case "object":
+      return { keys: value.shape.keys, slots: value.slots.map(encodeValue) };
+    case "regex":
+      return { pattern: value.pattern, flags: value.flags };
+    default:
+      throw new Error(`Cannot send a ${value.type} value between threads`);
+  }
+}
+
+/**
+ * Rebuild a value encoded by encodeValue().
+ */
+export function decodeValue(value: TransferValue): Value {
+  switch (typeof value) {
+    case "boolean":
+      return booleanValue(value);
+    case "number":
+      return numberValue(value);
+    case "string":
+      return stringValue(value);
+  }
+  if (value === null) {
+    return nullValue();
+  }
+  if (Array.isArray(value)) {
+    return arrayValue(value.map(decodeValue));
+  }
+  if ("keys" in value) {
+    return shapedObjectValue(Shape.of(value.keys), value.slots.map(decodeValue));
+  }
+  return regexValue(value.pattern, value.flags);
+}
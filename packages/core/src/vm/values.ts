@@ -6,6 +6,8 @@
  */
 
 import type { FunctionTemplate } from "../bytecode/format.ts";
+import { RegexKernel } from "./regex.ts";
+import { Shape } from "./shape.ts";
 
 /**
  * Runtime value types supported by the VM.
@@ -61,21 +63,31 @@ export interface ArrayValue {
 }
 
 /**
- * Object value (key-value pairs).
+ * Object value (key-value pairs). Keys live in a Shape shared by objects
+ * with the same keys (see shape.ts); `slots` holds the values in key order.
+ *
+ * This replaces the former `properties` Map. Read objects with getProperty()
+ * or objectEntries(), and build them with objectValue() or
+ * shapedObjectValue().
  */
 export interface ObjectValue {
   type: "object";
-  properties: Map<string, Value>;
+  shape: Shape;
+  slots: Value[];
 }
 
 /**
  * Regular expression value.
+ * Builtins reset `regex.lastIndex` before each use, so one value can be
+ * shared by every run of a program.
  */
 export interface RegexValue {
   type: "regex";
   pattern: string;
   flags: string;
   regex: RegExp;
+  /** Scanning kernel for simple patterns, or null to use `regex` */
+  kernel: RegexKernel | null;
 }
 
 /**
@@ -85,26 +97,34 @@ export interface RegexValue {
  * Upvalues can be either "open" (pointing to a stack slot) or "closed"
  * (holding a concrete value). This allows recursive functions to work
  * by capturing references that can be updated after closure creation.
+ *
+ * Both states share one object shape: the VM closes an upvalue in place,
+ * so every closure holding it sees the closed value.
  */
-export type Upvalue = OpenUpvalue | ClosedUpvalue;
+export interface Upvalue {
+  type: "open" | "closed";
+  stack: Value[] | null; // Value stack while open, null once closed
+  index: number; // Index in the stack where the value lives while open
+  value: Value; // Captured value once closed
+  next: Upvalue | null; // Next open upvalue below this one (VM bookkeeping)
+}
 
 /**
  * Open upvalue - points to a stack slot that can be modified.
  * Used when the captured variable is still on the stack.
  */
-export interface OpenUpvalue {
+export interface OpenUpvalue extends Upvalue {
   type: "open";
-  stack: Value[]; // Reference to the value stack
-  index: number; // Index in the stack where the value lives
+  stack: Value[];
 }
 
 /**
  * Closed upvalue - holds a concrete value.
  * Used when the captured variable's stack frame has been popped.
  */
-export interface ClosedUpvalue {
+export interface ClosedUpvalue extends Upvalue {
   type: "closed";
-  value: Value;
+  stack: null;
 }
 
 /**
@@ -144,18 +164,25 @@ export interface ContinuationValue {
 // Factory functions for creating values
 // =============================================================================
 
+// Values are immutable, so null and the two booleans are shared singletons.
+// The VM pushes one null per local on every call; sharing them keeps the hot
+// path allocation-free.
+const NULL_VALUE: NullValue = Object.freeze({ type: "null" }) as NullValue;
+const TRUE_VALUE: BooleanValue = Object.freeze({ type: "boolean", value: true }) as BooleanValue;
+const FALSE_VALUE: BooleanValue = Object.freeze({ type: "boolean", value: false }) as BooleanValue;
+
 /**
- * Create a null value.
+ * Get the null value.
  */
 export function nullValue(): NullValue {
-  return { type: "null" };
+  return NULL_VALUE;
 }
 
 /**
- * Create a boolean value.
+ * Get the boolean value for true/false.
  */
 export function booleanValue(value: boolean): BooleanValue {
-  return { type: "boolean", value };
+  return value ? TRUE_VALUE : FALSE_VALUE;
 }
 
 /**
@@ -183,14 +210,37 @@ export function arrayValue(elements: Value[]): ArrayValue {
  * Create an object value.
  */
 export function objectValue(properties: Map<string, Value>): ObjectValue {
-  return { type: "object", properties };
+  return { type: "object", shape: Shape.of([...properties.keys()]), slots: [...properties.values()] };
+}
+
+/**
+ * Create an object value of a given shape, with one value per key.
+ */
+export function shapedObjectValue(shape: Shape, slots: Value[]): ObjectValue {
+  return { type: "object", shape, slots };
+}
+
+/**
+ * Value of `key` on an object, or undefined if it does not have the key.
+ */
+export function getProperty(object: ObjectValue, key: string): Value | undefined {
+  const slot = object.shape.slot(key);
+  return slot < 0 ? undefined : object.slots[slot];
+}
+
+/**
+ * [key, value] pairs of an object, in key order.
+ */
+export function objectEntries(object: ObjectValue): [string, Value][] {
+  return object.shape.keys.map((key, i) => [key, object.slots[i]!]);
 }
 
 /**
  * Create a regex value.
  */
 export function regexValue(pattern: string, flags: string): RegexValue {
-  return { type: "regex", pattern, flags, regex: new RegExp(pattern, flags) };
+  const regex = new RegExp(pattern, flags);
+  return { type: "regex", pattern, flags, regex, kernel: RegexKernel.compile(pattern, flags) };
 }
 
 /**
@@ -218,21 +268,21 @@ export function continuationValue(
  * Create an open upvalue pointing to a stack slot.
  */
 export function openUpvalue(stack: Value[], index: number): OpenUpvalue {
-  return { type: "open", stack, index };
+  return { type: "open", stack, index, value: nullValue(), next: null };
 }
 
 /**
  * Create a closed upvalue holding a concrete value.
  */
 export function closedUpvalue(value: Value): ClosedUpvalue {
-  return { type: "closed", value };
+  return { type: "closed", stack: null, index: -1, value, next: null };
 }
 
 /**
  * Get the current value from an upvalue (open or closed).
  */
 export function getUpvalueValue(upvalue: Upvalue): Value {
-  if (upvalue.type === "open") {
+  if (upvalue.stack !== null) {
     return upvalue.stack[upvalue.index]!;
   }
   return upvalue.value;
@@ -243,8 +293,8 @@ export function getUpvalueValue(upvalue: Upvalue): Value {
  * If already closed, returns it unchanged.
  */
 export function closeUpvalue(upvalue: Upvalue): ClosedUpvalue {
-  if (upvalue.type === "closed") {
-    return upvalue;
+  if (upvalue.stack === null) {
+    return upvalue as ClosedUpvalue;
   }
   return closedUpvalue(upvalue.stack[upvalue.index]!);
 }
@@ -373,12 +423,15 @@ export function valuesEqual(a: Value, b: Value): boolean {
     }
     case "object": {
       const bObject = b as ObjectValue;
-      if (a.properties.size !== bObject.properties.size) return false;
-      for (const [key, value] of a.properties) {
-        const bValue = bObject.properties.get(key);
-        if (!bValue || !valuesEqual(value, bValue)) return false;
+      if (a.shape === bObject.shape) {
+        return a.slots.every((value, i) => valuesEqual(value, bObject.slots[i]!));
       }
-      return true;
+      // Same keys in another order
+      if (a.shape.size !== bObject.shape.size) return false;
+      return a.shape.keys.every((key, i) => {
+        const bValue = getProperty(bObject, key);
+        return bValue !== undefined && valuesEqual(a.slots[i]!, bValue);
+      });
     }
     case "closure":
       // Closures are equal only if they're the same reference
@@ -412,7 +465,7 @@ export function displayValue(value: Value): string {
       return `[${elements.join(", ")}]`;
     }
     case "object": {
-      const entries = Array.from(value.properties.entries())
+      const entries = objectEntries(value)
         .map(([k, v]) => `${k}: ${displayValue(v)}`)
         .join(", ");
       return `{${entries}}`;
@@ -426,6 +479,46 @@ export function displayValue(value: Value): string {
   }
 }
 
+/**
+ * Bytes of an array header with `length` element slots, as charged to a
+ * VM memory budget.
+ */
+export function arrayBytes(length: number): number {
+  return 16 + 8 * length;
+}
+
+/**
+ * Approximate bytes a value holds, as charged to a VM memory budget.
+ * Strings count two bytes per code unit; arrays and objects count their
+ * elements deeply, so a value that shares parts with existing ones is
+ * overestimated. Scalars, regexes and continuations count nothing.
+ */
+export function valueBytes(value: Value): number {
+  switch (value.type) {
+    case "string":
+      return 16 + 2 * value.value.length;
+    case "array": {
+      let bytes = arrayBytes(value.elements.length);
+      for (const element of value.elements) {
+        bytes += valueBytes(element);
+      }
+      return bytes;
+    }
+    case "object": {
+      // Keys belong to the shared shape
+      let bytes = arrayBytes(value.slots.length);
+      for (const property of value.slots) {
+        bytes += valueBytes(property);
+      }
+      return bytes;
+    }
+    case "closure":
+      return arrayBytes(value.upvalues.length);
+    default:
+      return 0;
+  }
+}
+
 // =============================================================================
 // Type coercion functions
 // =============================================================================
@@ -465,3 +558,60 @@ export function toString(value: Value): StringValue {
   if (isString(value)) return value;
   return stringValue(displayValue(value));
 }
+
+// =============================================================================
+// JSON conversion
+// =============================================================================
+
+/**
+ * Convert a parsed JSON value (as returned by JSON.parse) to a VM value.
+ * Anything JSON cannot represent becomes null.
+ */
+export function valueFromJSON(json: unknown): Value {
+  if (json === null || json === undefined) return NULL_VALUE;
+  switch (typeof json) {
+    case "boolean":
+      return booleanValue(json);
+    case "number":
+      return numberValue(json);
+    case "string":
+      return stringValue(json);
+    case "object": {
+      if (Array.isArray(json)) {
+        return arrayValue(json.map(valueFromJSON));
+      }
+      const keys = Object.keys(json);
+      const slots = keys.map((key) => valueFromJSON((json as Record<string, unknown>)[key]));
+      return shapedObjectValue(Shape.of(keys), slots);
+    }
+    default:
+      return NULL_VALUE;
+  }
+}
+
+/**
+ * Convert a VM value to a plain value for JSON.stringify().
+ * Regexes, closures and continuations become their display strings.
+ */
+export function valueToJSON(value: Value): unknown {
+  switch (value.type) {
+    case "null":
+      return null;
+    case "boolean":
+    case "number":
+    case "string":
+      return value.value;
+    case "array":
+      return value.elements.map(valueToJSON);
+    case "object": {
+      const result: Record<string, unknown> = {};
+      const keys = value.shape.keys;
+      for (let i = 0; i < keys.length; i++) {
+        result[keys[i]!] = valueToJSON(value.slots[i]!);
+      }
+      return result;
+    }
+    default:
+      return displayValue(value);
+  }
+}
@@ -11,7 +11,15 @@
  */
 
 import { describe, it, expect } from "bun:test";
-import { VM, throwingEffectHandler, type EffectHandler, Continuation } from "./vm.ts";
+import {
+  VM,
+  throwingEffectHandler,
+  type EffectHandler,
+  type BatchEffectHandler,
+  Continuation,
+  VMError,
+  VMBudgetError,
+} from "./vm.ts";
 import type { BytecodeFile, FunctionTemplate } from "../bytecode/format.ts";
 import { Opcode } from "../bytecode/opcodes.ts";
 import { ConstantType } from "../bytecode/format.ts";
@@ -21,8 +29,10 @@ import {
   numberValue,
   stringValue,
   arrayValue,
+  valueFromJSON,
   type Value,
 } from "./values.ts";
+import { compilePEX } from "./index.ts";
 
 /**
  * Helper to create a minimal bytecode file for testing.
@@ -717,6 +727,38 @@ describe("VM - Builtins", () => {
     );
   });
 
+  it("should pass builtin arguments in order", () => {
+    const bytecode = createBytecode(
+      [
+        Opcode.CONST_U8, 0,
+        Opcode.CONST_U8, 1,
+        Opcode.CONST_U8, 2,
+        Opcode.CONST_U8, 3,
+        Opcode.CONST_U8, 4,
+        Opcode.CONST_U8, 5,
+        Opcode.CONST_U8, 6,
+        Opcode.CONST_U8, 7,
+        Opcode.CALL_BUILTIN_U8_U8, 0, 8, // Call join with 8 args
+        Opcode.RETURN,
+      ],
+      ["a", "b", "c", "d", "e", "f", "g", "h"],
+      ["join"]
+    );
+    const vm = new VM(bytecode, throwingEffectHandler);
+    expect(vm.run(nullValue())).toEqual(stringValue("abcdefgh"));
+  });
+
+  it("should stop split at its limit", () => {
+    const parts = (limit: string) => {
+      const vm = new VM(compilePEX(`(split "a,b,c" "," ${limit})`), throwingEffectHandler);
+      return vm.run(nullValue());
+    };
+    const all = arrayValue([stringValue("a"), stringValue("b"), stringValue("c")]);
+    expect(parts("2.5")).toEqual(arrayValue([stringValue("a"), stringValue("b")]));
+    expect(parts("0")).toEqual(all);
+    expect(parts("4294967297")).toEqual(all);
+  });
+
   it("should throw on unknown builtin", () => {
     const bytecode = createBytecode(
       [
@@ -727,8 +769,41 @@ describe("VM - Builtins", () => {
       [],
       ["unknownBuiltin"]
     );
-    const vm = new VM(bytecode, throwingEffectHandler);
-    expect(() => vm.run(nullValue())).toThrow("Unknown builtin function");
+    expect(() => new VM(bytecode, throwingEffectHandler)).toThrow(
+      "Unknown builtin function: unknownBuiltin"
+    );
+  });
+
+  it("should report unknown builtins before running", () => {
+    // The call is never reached, but is still rejected when the VM is created
+    const bytecode = createBytecode(
+      [
+        Opcode.CONST_ONE,
+        Opcode.RETURN,
+        Opcode.CALL_BUILTIN_U8_U8, 0, 1,
+        Opcode.RETURN,
+      ],
+      [],
+      ["unknownBuiltin"]
+    );
+    expect(() => new VM(bytecode, throwingEffectHandler)).toThrow(
+      "Unknown builtin function: unknownBuiltin"
+    );
+  });
+
+  it("should resolve builtin overrides at load time", () => {
+    const bytecode = createBytecode(
+      [
+        Opcode.CONST_ONE,
+        Opcode.CALL_BUILTIN_U8_U8, 0, 1,
+        Opcode.RETURN,
+      ],
+      [],
+      ["custom"]
+    );
+    const overrides = new Map([["custom", () => stringValue("overridden")]]);
+    const vm = new VM(bytecode, throwingEffectHandler, overrides);
+    expect(vm.run(nullValue())).toEqual(stringValue("overridden"));
   });
 });
 
@@ -748,6 +823,20 @@ describe("VM - Arrays", () => {
     );
   });
 
+  it("should create wide arrays with MAKE_ARRAY_U16", () => {
+    const count = 1000;
+    const bytecode = createBytecode([
+      ...Array.from({ length: count }, (_, i) => [Opcode.CONST_U8, i % 2]).flat(),
+      Opcode.MAKE_ARRAY_U16, count & 0xff, count >> 8,
+      Opcode.RETURN,
+    ], [0, 1]);
+    const vm = new VM(bytecode, throwingEffectHandler);
+    const result = vm.run(nullValue());
+    expect(result).toEqual(
+      arrayValue(Array.from({ length: count }, (_, i) => numberValue(i % 2)))
+    );
+  });
+
   it("should index array with GET_INDEX", () => {
     const bytecode = createBytecode([
       Opcode.CONST_ONE,
@@ -777,6 +866,39 @@ describe("VM - Arrays", () => {
   });
 });
 
+describe("VM - Objects", () => {
+  it("should get properties by key", () => {
+    const input = valueFromJSON({ name: "Ada", 1: "one" });
+    const run = (source: string) => new VM(compilePEX(source), throwingEffectHandler).run(input);
+    expect(run('(get $$ "name")')).toEqual(stringValue("Ada"));
+    expect(run("(get $$ 1)")).toEqual(stringValue("one"));
+    expect(run('(get $$ "age")')).toEqual(nullValue());
+    expect(run('(get $$ "age" 0)')).toEqual(numberValue(0));
+    expect(run('(get $$ "name" 0)')).toEqual(stringValue("Ada"));
+  });
+
+  it("should look up a key at one site across changing shapes", () => {
+    const vm = new VM(compilePEX('(get $$ "id")'), throwingEffectHandler);
+    const inputs = [
+      { id: 1, name: "a" },
+      { id: 2, name: "b" },
+      { name: "c", id: 3 },
+      { name: "d" },
+      { id: 5, name: "e" },
+    ].map(valueFromJSON);
+    expect(vm.runBatch(inputs)).toEqual([numberValue(1), numberValue(2), numberValue(3), nullValue(), numberValue(5)]);
+    expect(() => vm.run(stringValue("id"))).toThrow("Cannot index non-array value: string");
+  });
+
+  it("should keep separate caches for separate sites", () => {
+    const vm = new VM(compilePEX('(+ (get $$ "a") (get $$ "b"))'), throwingEffectHandler);
+    expect(vm.runBatch([valueFromJSON({ a: 1, b: 2 }), valueFromJSON({ b: 3, a: 4 })])).toEqual([
+      numberValue(3),
+      numberValue(7),
+    ]);
+  });
+});
+
 describe("VM - Algebraic Effects", () => {
   it("should capture continuation on effect", () => {
     let capturedContinuation: Continuation | null = null;
@@ -954,6 +1076,63 @@ describe("VM - Algebraic Effects", () => {
     expect(result).toEqual(numberValue(101)); // 100 + 1
     done();
   });
+
+  it("should keep pending continuations independent across runs", () => {
+    const pending: Continuation[] = [];
+    const results: Value[] = [];
+    const effectHandler: EffectHandler = (name, args, continuation) => {
+      if (name === "ask") {
+        pending.push(continuation);
+      } else {
+        results.push(args[0]!);
+        continuation.resume(args[0]!);
+      }
+    };
+
+    // g captures x, so each suspended run holds an open upvalue
+    const vm = new VM(
+      compilePEX("fn: f (x) (fn: g (y) (+ x y)) (done: (g (ask: x))); (f $$)"),
+      effectHandler
+    );
+    vm.run(numberValue(1));
+    vm.run(numberValue(10));
+
+    pending[0]!.resume(numberValue(100));
+    pending[1]!.resume(numberValue(1000));
+    expect(results).toEqual([numberValue(101), numberValue(1010)]);
+  });
+  it("should batch effects of the same name across inputs", async () => {
+    const calls: [string, Value[][]][] = [];
+    const handler: BatchEffectHandler = async (name, requests) => {
+      calls.push([name, requests]);
+      return requests.map(([arg]) => numberValue((arg as { value: number }).value * 10));
+    };
+
+    const vm = new VM(compilePEX("(if (< $$ 0) 0 (+ (a: $$) (b: $$)))"), throwingEffectHandler);
+    const results = await vm.runBatchAsync([1, -1, 2].map(numberValue), handler);
+
+    expect(results).toEqual([numberValue(20), numberValue(0), numberValue(40)]);
+    expect(calls).toEqual([
+      ["a", [[numberValue(1)], [numberValue(2)]]],
+      ["b", [[numberValue(1)], [numberValue(2)]]],
+    ]);
+  });
+
+  it("should reject when the batch handler returns too few results", async () => {
+    const vm = new VM(compilePEX("(a: $$)"), throwingEffectHandler);
+    await expect(vm.runBatchAsync([1, 2].map(numberValue), () => [nullValue()])).rejects.toThrow(
+      "returned 1 results for 2 requests"
+    );
+  });
+
+  it("should restore the effect handler after an async batch", async () => {
+    const effectHandler: EffectHandler = (_name, _args, continuation) => {
+      continuation.resume(stringValue("sync"));
+    };
+    const vm = new VM(compilePEX("(a: $$)"), effectHandler);
+    await vm.runBatchAsync([nullValue()], (_name, requests) => requests.map(() => nullValue()));
+    expect(vm.run(nullValue())).toEqual(stringValue("sync"));
+  });
 });
 
 describe("VM - Error Handling", () => {
@@ -966,6 +1145,16 @@ describe("VM - Error Handling", () => {
     expect(() => vm.run(nullValue())).toThrow("Stack underflow");
   });
 
+  it("should throw on MAKE_ARRAY stack underflow", () => {
+    const bytecode = createBytecode([
+      Opcode.CONST_ONE,
+      Opcode.MAKE_ARRAY_U8, 3, // Only 2 values on the stack
+      Opcode.RETURN,
+    ]);
+    const vm = new VM(bytecode, throwingEffectHandler);
+    expect(() => vm.run(nullValue())).toThrow("Stack underflow");
+  });
+
   it("should throw on invalid opcode", () => {
     const bytecode = createBytecode([
       0xff, // Invalid opcode
@@ -975,6 +1164,26 @@ describe("VM - Error Handling", () => {
     expect(() => vm.run(nullValue())).toThrow("Unknown opcode");
   });
 
+  it("should report malformed code where it is executed", () => {
+    const errorOf = (code: number[]) => {
+      try {
+        new VM(createBytecode(code), throwingEffectHandler).run(nullValue());
+      } catch (error) {
+        return { message: (error as VMError).message, ip: (error as VMError).ip };
+      }
+    };
+
+    expect(errorOf([Opcode.CONST_ONE])).toEqual({ message: "Instruction pointer out of bounds", ip: 1 });
+    expect(errorOf([Opcode.JUMP_U8, 0x40, Opcode.RETURN])).toEqual({
+      message: "Instruction pointer out of bounds",
+      ip: 0x42,
+    });
+    expect(errorOf([Opcode.CONST_ONE, Opcode.CONST_U16, 0])).toEqual({
+      message: "Unexpected end of bytecode",
+      ip: 2,
+    });
+  });
+
   it("should throw on calling non-function", () => {
     const bytecode = createBytecode([
       Opcode.CONST_ONE, // Not a function
@@ -1037,6 +1246,75 @@ describe("VM - Error Handling", () => {
   });
 });
 
+describe("VM - Budgets", () => {
+  const budgetError = (run: () => unknown) => {
+    try {
+      run();
+    } catch (error) {
+      expect(error).toBeInstanceOf(VMBudgetError);
+      return { message: (error as VMBudgetError).message, budget: (error as VMBudgetError).budget };
+    }
+    throw new Error("Expected a budget error");
+  };
+
+  it("should stop backward jumps when fuel runs out", () => {
+    const bytecode = createBytecode([
+      Opcode.JUMP_U8, 0xfe, // Jump to itself forever
+    ]);
+    const vm = new VM(bytecode, throwingEffectHandler, undefined, { fuel: 100 });
+    expect(budgetError(() => vm.run(nullValue()))).toEqual({ message: "Fuel exhausted (limit 100)", budget: "fuel" });
+  });
+
+  it("should charge fuel per call and refill it every run", () => {
+    // fib(10) makes 177 calls
+    const bytecode = compilePEX("fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib $$)");
+    const starved = new VM(bytecode, throwingEffectHandler, undefined, { fuel: 176 });
+    expect(budgetError(() => starved.run(numberValue(10))).budget).toBe("fuel");
+
+    const vm = new VM(bytecode, throwingEffectHandler, undefined, { fuel: 177 });
+    expect(vm.runBatch([numberValue(10), numberValue(10)])).toEqual([numberValue(55), numberValue(55)]);
+  });
+
+  it("should limit call frames", () => {
+    const bytecode = compilePEX("fn: sum (n) (if (<= n 0) 0 (+ n (sum (- n 1)))); (sum $$)");
+    const vm = new VM(bytecode, throwingEffectHandler, undefined, { maxFrames: 20 });
+    expect(vm.run(numberValue(18))).toEqual(numberValue(171));
+    expect(budgetError(() => vm.run(numberValue(19)))).toEqual({
+      message: "Call stack overflow (max 20)",
+      budget: "stack",
+    });
+    expect(budgetError(() => new VM(bytecode, throwingEffectHandler).run(numberValue(2000))).budget).toBe("stack");
+  });
+
+  it("should limit memory created by arrays and builtins", () => {
+    const array = createBytecode([
+      Opcode.CONST_ONE,
+      Opcode.CONST_ZERO,
+      Opcode.MAKE_ARRAY_U8, 2, // 16 + 2 * 8 bytes
+      Opcode.RETURN,
+    ]);
+    expect(new VM(array, throwingEffectHandler, undefined, { maxMemory: 32 }).run(nullValue())).toEqual(
+      arrayValue([numberValue(1), numberValue(0)])
+    );
+    expect(budgetError(() => new VM(array, throwingEffectHandler, undefined, { maxMemory: 31 }).run(nullValue()))).toEqual(
+      { message: "Memory budget exceeded (limit 31 bytes)", budget: "memory" }
+    );
+
+    // An array of 3 strings of 1 character: 16 + 3 * 8 + 3 * (16 + 2)
+    const split = compilePEX('(split $$ " ")');
+    const vm = new VM(split, throwingEffectHandler, undefined, { maxMemory: 94 });
+    expect(vm.run(stringValue("a b c"))).toEqual(arrayValue([stringValue("a"), stringValue("b"), stringValue("c")]));
+    expect(budgetError(() => vm.run(stringValue("a b c d"))).budget).toBe("memory");
+  });
+
+  it("should carry the remaining budget across effects", () => {
+    const bytecode = compilePEX("fn: id (x) x; (+ (id 1) (+ (ask:) (id 2)))");
+    const resume: EffectHandler = (_name, _args, continuation) => continuation.resume(numberValue(10));
+    expect(new VM(bytecode, resume, undefined, { fuel: 2 }).run(nullValue())).toEqual(numberValue(13));
+    expect(budgetError(() => new VM(bytecode, resume, undefined, { fuel: 1 }).run(nullValue())).budget).toBe("fuel");
+  });
+});
+
 describe("VM - Complex Programs", () => {
   it("should compute factorial iteratively", () => {
     // factorial: (n) => {
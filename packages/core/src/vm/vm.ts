@@ -1,7 +1,8 @@
 /**
  * Stack-based Virtual Machine for PEX with algebraic effects support.
  *
- * The VM executes PEX bytecode using a fetch-decode-execute loop.
+ * The VM executes PEX bytecode using a dispatch loop over each function's
+ * pre-decoded code (see decode.ts).
  * It maintains:
  * - An operand stack for computation
  * - A call stack for function invocations
@@ -23,9 +24,14 @@
  */
 
 import type { BytecodeFile, FunctionTemplate, Constant } from "../bytecode/format.ts";
-import { Opcode, OPCODE_METADATA, OperandType } from "../bytecode/opcodes.ts";
+import {
+  Opcode,
+  getInstructionSize,
+  isValidOpcode,
+} from "../bytecode/opcodes.ts";
 import { ConstantType } from "../bytecode/format.ts";
-import type { Value, CallFrame, Upvalue, OpenUpvalue } from "./values.ts";
+import { LazyBytecodeFile } from "../bytecode/reader.ts";
+import type { Value, CallFrame, ClosureValue, ObjectValue, Upvalue } from "./values.ts";
 import {
   nullValue,
   booleanValue,
@@ -44,9 +50,24 @@ import {
   valuesEqual,
   toNumber,
   displayValue,
+  valueBytes,
+  arrayBytes,
 } from "./values.ts";
 import type { VMBuiltin } from "./builtins.ts";
 import { createVMBuiltins, VMRuntimeError } from "./builtins.ts";
+import type { Shape } from "./shape.ts";
+import {
+  DECODED_EXTRA_1,
+  DECODED_EXTRA_2,
+  DECODED_NEXT,
+  DECODED_OPERAND,
+  DECODED_STRIDE,
+  DECODED_TRUNCATED,
+  decodeFunction,
+} from "./decode.ts";
+import { VMProfiler } from "./profiler.ts";
+import type { CompiledProgram } from "./jit.ts";
+import { compileProgram } from "./jit.ts";
 
 /**
  * Effect handler function type.
@@ -59,25 +80,62 @@ export type EffectHandler = (
   continuation: Continuation,
 ) => void;
 
+/**
+ * Batched effect handler used by VM.runBatchAsync().
+ * Called once per effect name with the arguments of every input in the
+ * batch that is suspended on that effect, so the host can serve them with
+ * one round trip. Must return one result per request, in request order.
+ */
+export type BatchEffectHandler = (
+  effectName: string,
+  requests: Value[][],
+) => Value[] | Promise<Value[]>;
+
+/**
+ * An effect performed by one input of an async batch, waiting for the
+ * batch handler.
+ */
+interface PendingEffect {
+  index: number;
+  effectName: string;
+  args: Value[];
+  continuation: Continuation;
+}
+
 /**
  * One-shot continuation for algebraic effects.
- * Captures the VM state and allows resumption exactly once.
+ *
+ * The VM hands its frame and stack buffers to the continuation instead of
+ * copying them, and takes them back on resume. Because a continuation can
+ * only be resumed once, nothing else can observe the buffers in between.
  */
 export class Continuation {
-  private frames: CallFrame[];
-  private stack: Value[];
+  private readonly frames: CallFrame[];
+  private readonly stack: Value[];
+  private readonly stackSize: number;
+  private readonly openUpvalues: Upvalue | null;
+  // Budget the run had left when it suspended
+  private readonly fuel: number;
+  private readonly memory: number;
   private resumed: boolean = false;
   private readonly vm: VM;
 
-  constructor(vm: VM, frames: CallFrame[], stack: Value[]) {
+  constructor(
+    vm: VM,
+    frames: CallFrame[],
+    stack: Value[],
+    stackSize: number = stack.length,
+    openUpvalues: Upvalue | null = null,
+    fuel: number = Infinity,
+    memory: number = Infinity
+  ) {
     this.vm = vm;
-    // Deep copy frames and stack to preserve state
-    this.frames = frames.map((f) => ({
-      closure: f.closure,
-      ip: f.ip,
-      bp: f.bp,
-    }));
-    this.stack = stack.slice();
+    this.frames = frames;
+    this.stack = stack;
+    this.stackSize = stackSize;
+    this.openUpvalues = openUpvalues;
+    this.fuel = fuel;
+    this.memory = memory;
   }
 
   /**
@@ -92,7 +150,15 @@ export class Continuation {
       );
     }
     this.resumed = true;
-    this.vm.restoreContinuation(this.frames, this.stack, value);
+    this.vm.restoreContinuation(
+      this.frames,
+      this.stack,
+      this.stackSize,
+      this.openUpvalues,
+      value,
+      this.fuel,
+      this.memory
+    );
   }
 
   /**
@@ -113,47 +179,258 @@ export class VMError extends Error {
   }
 }
 
+/**
+ * Raised when a run exceeds one of its budgets (see VMLimits). Stack and
+ * frame overflows are budget errors too, so a host can tell a program that
+ * ran out of resources from one that is broken.
+ */
+export class VMBudgetError extends VMError {
+  constructor(
+    message: string,
+    public readonly budget: "fuel" | "stack" | "memory",
+    ip?: number
+  ) {
+    super(message, ip);
+    this.name = "VMBudgetError";
+  }
+}
+
 /**
  * Stack limits for safety.
  */
-const MAX_STACK_SIZE = 10000;
-const MAX_FRAMES = 1000;
+export const MAX_STACK_SIZE = 10000;
+export const MAX_FRAMES = 1000;
+
+/**
+ * Per-run resource budgets. Each run, and each input of a batch, starts
+ * with the full budget; a suspended run keeps what it has left.
+ */
+export interface VMLimits {
+  /**
+   * Calls and backward jumps a run may make. Between two of them a run
+   * stays within one function's straight-line code, so fuel bounds the
+   * instructions it executes. Default: unlimited.
+   */
+  fuel?: number;
+  /** Call frames a run may have at once. Default: MAX_FRAMES. */
+  maxFrames?: number;
+  /**
+   * Bytes of strings, arrays and closures a run may create, as estimated
+   * by valueBytes(). Default: unlimited. A VM with a memory budget is
+   * never compiled (see enableCompilation()).
+   */
+  maxMemory?: number;
+}
+
+/**
+ * Constant values per loaded program, shared by every VM that runs it.
+ */
+const sharedConstantValues = new WeakMap<BytecodeFile, (Value | undefined)[]>();
+
+/**
+ * Decoded code per function, shared by every VM that runs it (see decode.ts).
+ */
+const decodedFunctions = new WeakMap<FunctionTemplate, Int32Array>();
+const EMPTY_DECODED = new Int32Array(0);
+
+/**
+ * Monomorphic inline cache of a GET_INDEX site: the slot of `key` in
+ * objects of `shape` (-1 if they do not have it).
+ */
+interface PropertySite {
+  shape: Shape | null;
+  key: string;
+  slot: number;
+}
+
+/**
+ * Property caches per function, indexed by the offset that follows the
+ * GET_INDEX, and shared by every VM that runs it (shapes are global).
+ */
+const propertySites = new WeakMap<FunctionTemplate, (PropertySite | undefined)[]>();
+
+/**
+ * Name index called by a builtin call instruction at `ip`, or null if the
+ * instruction does not call a builtin.
+ */
+function builtinNameOperand(opcode: Opcode, code: Uint8Array, ip: number): number | null {
+  switch (opcode) {
+    case Opcode.CALL_BUILTIN_U8_U8:
+      return code[ip + 1]!;
+    case Opcode.CALL_BUILTIN_U16_U8:
+      return code[ip + 1]! | (code[ip + 2]! << 8);
+    case Opcode.CALL_BUILTIN_U32_U8:
+      return (code[ip + 1]! | (code[ip + 2]! << 8) | (code[ip + 3]! << 16) | (code[ip + 4]! << 24)) >>> 0;
+    case Opcode.LOAD_LOCAL_CALL_BUILTIN_U8:
+      return code[ip + 2]!;
+    default:
+      return null;
+  }
+}
+
+/**
+ * Evaluate the comparison of a fused compare-and-jump superinstruction.
+ * Operands are converted in the same order as the unfused LT/GT/LE/GE.
+ */
+function compareForJump(opcode: Opcode, a: Value, b: Value): boolean {
+  switch (opcode) {
+    case Opcode.EQ_JUMP_IF_FALSE_U8:
+      return valuesEqual(a, b);
+    case Opcode.NE_JUMP_IF_FALSE_U8:
+      return !valuesEqual(a, b);
+  }
+  const y = toNumber(b).value;
+  const x = toNumber(a).value;
+  switch (opcode) {
+    case Opcode.LT_JUMP_IF_FALSE_U8:
+      return x < y;
+    case Opcode.GT_JUMP_IF_FALSE_U8:
+      return x > y;
+    case Opcode.LE_JUMP_IF_FALSE_U8:
+      return x <= y;
+    default:
+      return x >= y;
+  }
+}
+
+/**
+ * Whether an opcode is one of the TAIL_CALL variants.
+ */
+function isTailCall(opcode: Opcode): boolean {
+  return (
+    opcode === Opcode.TAIL_CALL_U8 ||
+    opcode === Opcode.TAIL_CALL_U16 ||
+    opcode === Opcode.TAIL_CALL_U32
+  );
+}
 
 /**
  * PEX Virtual Machine.
  * Executes bytecode with support for closures, upvalues, and algebraic effects.
  */
 export class VM {
-  // Core VM state
-  private stack: Value[] = [];
+  // Core VM state. The operand stack is allocated once at its maximum size;
+  // sp is the index of the next free slot.
+  private stack: Value[] = new Array<Value>(MAX_STACK_SIZE).fill(nullValue());
+  private sp: number = 0;
   private frames: CallFrame[] = [];
+  // Frames popped by RETURN, reused by the next CALL instead of allocating
+  private framePool: CallFrame[] = [];
   private bytecode: BytecodeFile;
-  private builtins: Map<string, VMBuiltin>;
+  // Set when running off serialized bytes; constants and names are then
+  // decoded on first use instead of being read from materialized arrays.
+  private lazyBytecode: LazyBytecodeFile | null;
+  // Builtin implementations indexed by name table index, resolved at load.
+  // Entries for names that are never called as builtins are undefined.
+  private builtins: (VMBuiltin | undefined)[];
   private effectHandler: EffectHandler;
 
-  // Open upvalues tracking (for proper closure semantics)
-  // Maps stack index to the open upvalue pointing to it
-  private openUpvalues: Map<number, OpenUpvalue> = new Map();
+  // Open upvalues (for proper closure semantics), as a linked list through
+  // Upvalue.next sorted by stack index, highest first. Returning from a frame
+  // only has to close upvalues from the head down to the frame's base.
+  private openUpvalues: Upvalue | null = null;
+
+  // Set while profiling; runs then use the instrumented dispatch loop
+  private profiler: VMProfiler | null = null;
+
+  // Set by enableCompilation(); runs then call the generated code first
+  private compiled: CompiledProgram | null = null;
+
+  // Continuation that owns the stack and frame buffers while an effect is
+  // suspended, until it is resumed
+  private suspended: Continuation | null = null;
+
+  // Set while runBatchAsync() owns the VM
+  private batchPending: boolean = false;
+
+  // Property caches of the running function
+  private sites: (PropertySite | undefined)[] = [];
+
+  // Budgets from the constructor's limits, and what the current run has
+  // left of them
+  private readonly fuelLimit: number;
+  private readonly maxFrames: number;
+  private readonly memoryLimit: number;
+  private fuel: number = Infinity;
+  private memory: number = Infinity;
 
   // Execution state
   private halted: boolean = false;
   private returnValue: Value = nullValue();
 
+  // Runtime values for constants, filled on first use. Values are immutable
+  // so they are shared across instructions, runs and every VM loading the
+  // same bytecode; each regex constant is compiled once.
+  private readonly constantValues: (Value | undefined)[];
+
   constructor(
     bytecode: BytecodeFile,
     effectHandler: EffectHandler,
-    builtinOverrides?: Map<string, VMBuiltin>
+    builtinOverrides?: Map<string, VMBuiltin>,
+    limits: VMLimits = {}
   ) {
     this.bytecode = bytecode;
+    this.fuelLimit = limits.fuel ?? Infinity;
+    this.maxFrames = limits.maxFrames ?? MAX_FRAMES;
+    this.memoryLimit = limits.maxMemory ?? Infinity;
+    this.lazyBytecode = bytecode instanceof LazyBytecodeFile ? bytecode : null;
+
+    let constantValues = sharedConstantValues.get(bytecode);
+    if (!constantValues) {
+      constantValues = [];
+      sharedConstantValues.set(bytecode, constantValues);
+    }
+    this.constantValues = constantValues;
     this.effectHandler = effectHandler;
-    this.builtins = createVMBuiltins();
+
+    const builtins = createVMBuiltins();
 
     // Apply builtin overrides if provided
     if (builtinOverrides) {
       for (const [name, impl] of builtinOverrides) {
-        this.builtins.set(name, impl);
+        builtins.set(name, impl);
+      }
+    }
+
+    this.builtins = this.resolveBuiltins(builtins);
+  }
+
+  /**
+   * Resolve every name the program calls through CALL_BUILTIN to its
+   * implementation, so calls index a dense array instead of looking the
+   * name up in a Map.
+   * @throws VMError if the program calls a builtin that does not exist
+   */
+  private resolveBuiltins(builtins: Map<string, VMBuiltin>): (VMBuiltin | undefined)[] {
+    const resolved: (VMBuiltin | undefined)[] = [];
+    const code = this.bytecode.codeSection.code;
+
+    for (const template of this.bytecode.functionTemplates.templates) {
+      const end = Math.min(template.codeOffset + template.codeLength, code.length);
+      let ip = template.codeOffset;
+
+      while (ip < end) {
+        const opcode = code[ip]!;
+        if (!isValidOpcode(opcode) || ip + getInstructionSize(opcode) > end) {
+          // Malformed code is reported when it is executed
+          break;
+        }
+
+        const nameIndex = builtinNameOperand(opcode, code, ip);
+        if (nameIndex !== null && resolved[nameIndex] === undefined) {
+          const name = this.getName(nameIndex);
+          const builtin = builtins.get(name);
+          if (!builtin) {
+            throw new VMError(`Unknown builtin function: ${name}`, ip - template.codeOffset);
+          }
+          resolved[nameIndex] = builtin;
+        }
+
+        ip += getInstructionSize(opcode);
       }
     }
+
+    return resolved;
   }
 
   /**
@@ -162,11 +439,29 @@ export class VM {
    * @returns The result value from the program
    */
   run(input: Value): Value {
-    // Reset VM state
-    this.stack = [];
-    this.frames = [];
+    if (this.compiled !== null && this.profiler === null) {
+      const result = this.compiled.run(input);
+      if (result !== null) {
+        return result;
+      }
+    }
+
+    // Reset VM state, reusing the stack and frame arrays from the last run
+    // unless an unresumed continuation still owns them. Replacement stacks
+    // start empty and grow as they are pushed to, since suspended batches
+    // can hold one per input.
+    if (this.suspended) {
+      this.stack = [];
+      this.frames = [];
+      this.suspended = null;
+    }
+    this.sp = 0;
+    this.frames.length = 0;
+    this.openUpvalues = null;
     this.halted = false;
     this.returnValue = nullValue();
+    this.fuel = this.fuelLimit;
+    this.memory = this.memoryLimit;
 
     // Get entry point function template
     const entryIndex = this.bytecode.header.entryPoint;
@@ -199,6 +494,11 @@ export class VM {
     };
     this.frames.push(frame);
 
+    if (this.profiler) {
+      this.profiler.recordRun();
+      this.profiler.recordCall(entryIndex);
+    }
+
     // Execute
     this.execute();
 
@@ -206,34 +506,278 @@ export class VM {
   }
 
   /**
-   * Main execution loop - fetch, decode, execute instructions.
+   * Run the program once per input, reusing this VM's stacks, builtins and
+   * decoded constants across inputs.
+   * @param inputs Input values, consumed in order
+   * @param onResult If given, called with each result instead of collecting
+   *   them (useful for large batches)
+   * @returns The results in input order, or an empty array when onResult is
+   *   given
+   * @throws VMError on the first input that fails; earlier results have
+   *   already been delivered to onResult
+   */
+  runBatch(
+    inputs: Iterable<Value>,
+    onResult?: (result: Value, index: number) => void
+  ): Value[] {
+    const results: Value[] = [];
+    let index = 0;
+    for (const input of inputs) {
+      const result = this.run(input);
+      if (onResult) {
+        onResult(result, index);
+      } else {
+        results.push(result);
+      }
+      index++;
+    }
+    return results;
+  }
+
+  /**
+   * Run the program once per input, batching effects across inputs.
+   *
+   * Every input runs until it completes or performs an effect. Suspended
+   * inputs are then grouped by effect name and the handler is called once
+   * per name with all of their arguments; name groups are served
+   * concurrently. Each continuation is resumed with its result, and the
+   * inputs that suspend again form the next round, until all have completed.
+   *
+   * The VM's own effect handler is not called during the batch, and the VM
+   * must not be used for anything else until the returned promise settles.
+   * @returns The results in input order
+   * @throws VMError if an input fails or the handler returns the wrong number
+   *   of results
+   */
+  async runBatchAsync(inputs: Iterable<Value>, handler: BatchEffectHandler): Promise<Value[]> {
+    if (this.batchPending) {
+      throw new VMError("An async batch is already running on this VM");
+    }
+
+    const results: Value[] = [];
+    let pending: PendingEffect[] = [];
+    let index = 0;
+    const effectHandler = this.effectHandler;
+    this.effectHandler = (effectName, args, continuation) => {
+      pending.push({ index, effectName, args, continuation });
+    };
+    this.batchPending = true;
+
+    try {
+      for (const input of inputs) {
+        const suspended = pending.length;
+        const result = this.run(input);
+        if (pending.length === suspended) {
+          results[index] = result;
+        }
+        index++;
+      }
+
+      while (pending.length > 0) {
+        const groups = new Map<string, PendingEffect[]>();
+        for (const effect of pending) {
+          const group = groups.get(effect.effectName);
+          if (group) {
+            group.push(effect);
+          } else {
+            groups.set(effect.effectName, [effect]);
+          }
+        }
+        pending = [];
+
+        const served = await Promise.all(
+          Array.from(groups, async ([effectName, group]) => {
+            const values = await handler(effectName, group.map((effect) => effect.args));
+            if (values.length !== group.length) {
+              throw new VMError(
+                `Batch effect handler for '${effectName}' returned ${values.length} results for ${group.length} requests`
+              );
+            }
+            return { group, values };
+          })
+        );
+
+        for (const { group, values } of served) {
+          for (let i = 0; i < group.length; i++) {
+            const effect = group[i]!;
+            const suspended = pending.length;
+            index = effect.index;
+            effect.continuation.resume(values[i]!);
+            if (pending.length === suspended) {
+              results[effect.index] = this.returnValue;
+            }
+          }
+        }
+      }
+    } finally {
+      this.effectHandler = effectHandler;
+      this.batchPending = false;
+    }
+
+    return results;
+  }
+
+  /**
+   * Lazily run the program over a stream of inputs, yielding each result.
+   * Inputs are pulled one at a time, so this works for unbounded sources.
+   */
+  *runEach(inputs: Iterable<Value>): Generator<Value, void, undefined> {
+    for (const input of inputs) {
+      yield this.run(input);
+    }
+  }
+
+  /**
+   * Run every following run as JavaScript generated from the bytecode (see
+   * jit.ts), compiled once per program. Programs that perform effects, or use
+   * anything else the compiled tier cannot translate, stay on the interpreter,
+   * as do VMs with a memory budget. Profiled runs always use the interpreter.
+   * @returns Whether the program was compiled
+   */
+  enableCompilation(): boolean {
+    if (this.memoryLimit !== Infinity) {
+      // Compiled code does not account for what it allocates
+      this.compiled = null;
+      return false;
+    }
+    this.compiled = compileProgram(this.bytecode, {
+      builtins: this.builtins,
+      constantCount: this.lazyBytecode ? this.lazyBytecode.constantCount : this.bytecode.constantPool.constants.length,
+      constant: (index) => this.getConstant(index),
+      nameCount: this.nameCount(),
+      name: (index) => this.getName(index),
+      fuel: this.fuelLimit,
+      maxFrames: this.maxFrames,
+    });
+    return this.compiled !== null;
+  }
+
+  /**
+   * Go back to interpreting every run.
+   */
+  disableCompilation(): void {
+    this.compiled = null;
+  }
+
+  /**
+   * Record a profile of every following run until disableProfiling() is
+   * called. Profiled runs use a separate, instrumented dispatch loop, so the
+   * normal loop pays nothing for profiling support.
+   * @param profiler Profiler to add to (default: a new one)
+   * @returns The profiler collecting the data
+   */
+  enableProfiling(profiler: VMProfiler = new VMProfiler(this.bytecode)): VMProfiler {
+    this.profiler = profiler;
+    return profiler;
+  }
+
+  /**
+   * Stop profiling.
+   * @returns The profiler that was attached, if any
+   */
+  disableProfiling(): VMProfiler | null {
+    const profiler = this.profiler;
+    this.profiler = null;
+    return profiler;
+  }
+
+  /**
+   * Main execution loop - fetch and execute decoded instructions.
    */
   private execute(): void {
+    if (this.profiler) {
+      this.executeProfiled(this.profiler);
+      return;
+    }
+
+    // Decoded code of the function the top frame is running
+    let template: FunctionTemplate | null = null;
+    let ops = EMPTY_DECODED;
+
     while (!this.halted && this.frames.length > 0) {
       const frame = this.currentFrame();
-      const code = this.getCode(frame.closure);
-
-      // Fetch opcode
-      if (frame.ip >= code.length) {
-        throw new VMError("Instruction pointer out of bounds", frame.ip);
+      if (frame.closure.template !== template) {
+        template = frame.closure.template;
+        ops = this.decoded(template);
+        this.sites = this.propertySites(template);
       }
 
-      const opcode = code[frame.ip] as Opcode;
-      frame.ip++;
+      this.executeInstruction(frame, ops, frame.ip * DECODED_STRIDE);
+    }
+  }
 
-      // Execute instruction
-      this.executeInstruction(opcode, frame, code);
+  /**
+   * Instrumented copy of execute() that times every instruction.
+   */
+  private executeProfiled(profiler: VMProfiler): void {
+    const loopStart = performance.now();
+    const nestedAtStart = profiler.nestedTimeMs;
+    let top: CallFrame | undefined;
+    let templateIndex = -1;
+    let stackKey = "";
+    const code = this.bytecode.codeSection.code;
+
+    try {
+      while (!this.halted && this.frames.length > 0) {
+        const frame = this.currentFrame();
+        if (frame !== top) {
+          top = frame;
+          templateIndex = profiler.templateIndex(frame.closure.template);
+          stackKey = profiler.stackKey(this.frames);
+        }
+        const template = frame.closure.template;
+        const ip = frame.ip;
+
+        if (ip >= template.codeLength) {
+          throw new VMError("Instruction pointer out of bounds", ip);
+        }
+
+        // Profiles report the instruction as encoded, not as decoded
+        const offset = template.codeOffset + ip;
+        const opcode = code[offset] as Opcode;
+        const depth = this.frames.length;
+
+        const nested = profiler.nestedTimeMs;
+        const start = performance.now();
+        try {
+          this.sites = this.propertySites(template);
+          this.executeInstruction(frame, this.decoded(template), ip * DECODED_STRIDE);
+        } finally {
+          const elapsed = performance.now() - start - (profiler.nestedTimeMs - nested);
+          profiler.recordInstruction(
+            opcode,
+            offset,
+            templateIndex,
+            stackKey,
+            elapsed,
+            builtinNameOperand(opcode, code, offset)
+          );
+        }
+
+        if (this.frames.length > depth) {
+          profiler.recordCall(profiler.templateIndex(this.currentFrame().closure.template));
+        } else if (isTailCall(opcode) && this.frames.length === depth) {
+          // The frame now belongs to the callee
+          profiler.forgetFrame(frame);
+          top = undefined;
+          profiler.recordCall(profiler.templateIndex(frame.closure.template));
+        }
+      }
+    } finally {
+      // Time in this loop is excluded from any instruction that started it
+      profiler.nestedTimeMs = nestedAtStart + (performance.now() - loopStart);
     }
   }
 
   /**
-   * Execute a single instruction.
+   * Execute the decoded instruction at `base` in `ops`. The frame's ip is
+   * advanced past it first, so it points at the next instruction while the
+   * instruction runs.
    */
-  private executeInstruction(
-    opcode: Opcode,
-    frame: CallFrame,
-    code: Uint8Array
-  ): void {
+  private executeInstruction(frame: CallFrame, ops: Int32Array, base: number): void {
+    const opcode = ops[base] as Opcode;
+    frame.ip = ops[base + DECODED_NEXT]!;
+
     switch (opcode) {
       // ===================================================================
       // Stack Operations
@@ -285,10 +829,8 @@ export class VM {
         this.push(numberValue(1));
         break;
 
-      case Opcode.CONST_U8:
-      case Opcode.CONST_U16:
-      case Opcode.CONST_U32: {
-        const index = this.readOperand(opcode, frame, code);
+      case Opcode.CONST_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
         const value = this.getConstant(index);
         this.push(value);
         break;
@@ -298,37 +840,29 @@ export class VM {
       // Variables (Locals and Upvalues)
       // ===================================================================
 
-      case Opcode.LOAD_LOCAL_U8:
-      case Opcode.LOAD_LOCAL_U16:
-      case Opcode.LOAD_LOCAL_U32: {
-        const index = this.readOperand(opcode, frame, code);
+      case Opcode.LOAD_LOCAL_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
         const value = this.getLocal(frame, index);
         this.push(value);
         break;
       }
 
-      case Opcode.STORE_LOCAL_U8:
-      case Opcode.STORE_LOCAL_U16:
-      case Opcode.STORE_LOCAL_U32: {
-        const index = this.readOperand(opcode, frame, code);
+      case Opcode.STORE_LOCAL_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
         const value = this.pop();
         this.setLocal(frame, index, value);
         break;
       }
 
-      case Opcode.LOAD_UPVALUE_U8:
-      case Opcode.LOAD_UPVALUE_U16:
-      case Opcode.LOAD_UPVALUE_U32: {
-        const index = this.readOperand(opcode, frame, code);
+      case Opcode.LOAD_UPVALUE_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
         const value = this.getUpvalue(frame, index);
         this.push(value);
         break;
       }
 
-      case Opcode.STORE_UPVALUE_U8:
-      case Opcode.STORE_UPVALUE_U16:
-      case Opcode.STORE_UPVALUE_U32: {
-        const index = this.readOperand(opcode, frame, code);
+      case Opcode.STORE_UPVALUE_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
         const value = this.pop();
         this.setUpvalue(frame, index, value);
         break;
@@ -450,31 +984,21 @@ export class VM {
       // ===================================================================
 
       case Opcode.JUMP_U8:
-      case Opcode.JUMP_U16:
-      case Opcode.JUMP_U32: {
-        const offset = this.readOperandSigned(opcode, frame, code);
-        frame.ip += offset;
+        this.jump(frame, ops[base + DECODED_OPERAND]!);
         break;
-      }
 
-      case Opcode.JUMP_IF_FALSE_U8:
-      case Opcode.JUMP_IF_FALSE_U16:
-      case Opcode.JUMP_IF_FALSE_U32: {
-        const offset = this.readOperandSigned(opcode, frame, code);
+      case Opcode.JUMP_IF_FALSE_U8: {
         const condition = this.pop();
         if (isFalsy(condition)) {
-          frame.ip += offset;
+          this.jump(frame, ops[base + DECODED_OPERAND]!);
         }
         break;
       }
 
-      case Opcode.JUMP_IF_TRUE_U8:
-      case Opcode.JUMP_IF_TRUE_U16:
-      case Opcode.JUMP_IF_TRUE_U32: {
-        const offset = this.readOperandSigned(opcode, frame, code);
+      case Opcode.JUMP_IF_TRUE_U8: {
         const condition = this.pop();
         if (isTruthy(condition)) {
-          frame.ip += offset;
+          this.jump(frame, ops[base + DECODED_OPERAND]!);
         }
         break;
       }
@@ -483,10 +1007,8 @@ export class VM {
       // Functions
       // ===================================================================
 
-      case Opcode.MAKE_CLOSURE_U8:
-      case Opcode.MAKE_CLOSURE_U16:
-      case Opcode.MAKE_CLOSURE_U32: {
-        const templateIndex = this.readOperand(opcode, frame, code);
+      case Opcode.MAKE_CLOSURE_U8: {
+        const templateIndex = ops[base + DECODED_OPERAND]!;
         const template = this.getFunctionTemplate(templateIndex);
 
         // Capture upvalues from current closure or frame
@@ -495,14 +1017,7 @@ export class VM {
           if (upvalueSpec.isLocal) {
             // Capture from current frame's locals - create open upvalue
             // pointing to the stack location (for recursion support)
-            const stackIndex = frame.bp + upvalueSpec.index;
-            // Reuse existing open upvalue if one already exists for this location
-            let upvalue = this.openUpvalues.get(stackIndex);
-            if (!upvalue) {
-              upvalue = openUpvalue(this.stack, stackIndex);
-              this.openUpvalues.set(stackIndex, upvalue);
-            }
-            upvalues.push(upvalue);
+            upvalues.push(this.captureUpvalue(frame.bp + upvalueSpec.index));
           } else {
             // Capture from current closure's upvalues (may be open or closed)
             if (upvalueSpec.index >= frame.closure.upvalues.length) {
@@ -517,53 +1032,34 @@ export class VM {
 
         // Get function name from name table
         const name =
-          template.nameIndex >= 0
-            ? this.bytecode.nameTable.names[template.nameIndex] ?? null
+          template.nameIndex >= 0 && template.nameIndex < this.nameCount()
+            ? this.getName(template.nameIndex)
             : null;
 
         const closure = closureValue(template, upvalues, name);
+        this.allocate(valueBytes(closure), frame);
         this.push(closure);
         break;
       }
 
-      case Opcode.CALL_U8:
-      case Opcode.CALL_U16:
-      case Opcode.CALL_U32: {
-        const argCount = this.readOperand(opcode, frame, code);
+      case Opcode.CALL_U8: {
+        const argCount = ops[base + DECODED_OPERAND]!;
 
         // Arguments are on stack in order: arg0, arg1, ..., argN-1
         // Below them is the function/closure
         // Stack layout: [..., func, arg0, arg1, ..., argN-1]
-
-        // Get the function from below the arguments
-        const funcIndex = this.stack.length - argCount - 1;
-        if (funcIndex < 0) {
-          throw new VMError("Stack underflow during function call", frame.ip);
-        }
-
-        const func = this.stack[funcIndex]!;
-
-        if (!isClosure(func)) {
-          throw new VMError(
-            `Cannot call non-function value: ${func.type}`,
-            frame.ip
-          );
-        }
-
-        // Check arity
-        if (argCount !== func.template.paramCount) {
-          const name = func.name ?? "<anonymous>";
-          throw new VMError(
-            `Function ${name} expects ${func.template.paramCount} arguments, got ${argCount}`,
-            frame.ip
-          );
+        const funcIndex = this.sp - argCount - 1;
+        const func = this.callee(frame, funcIndex, argCount);
+        if (--this.fuel < 0) {
+          throw this.fuelExhausted(frame);
         }
 
         // Create new call frame at current stack position (where func was)
         const newBp = funcIndex;
 
-        // Remove the function value from the stack
-        this.stack.splice(funcIndex, 1);
+        // Slide the arguments down over the function slot
+        this.stack.copyWithin(funcIndex, funcIndex + 1, this.sp);
+        this.sp--;
 
         // Arguments are now at newBp, newBp+1, ..., newBp+argCount-1
         // Reserve space for remaining locals
@@ -572,24 +1068,59 @@ export class VM {
           this.push(nullValue());
         }
 
-        const newFrame: CallFrame = {
-          closure: func,
-          ip: 0,
-          bp: newBp,
-        };
+        const newFrame = this.framePool.pop();
+        if (newFrame === undefined) {
+          this.frames.push({ closure: func, ip: 0, bp: newBp });
+        } else {
+          newFrame.closure = func;
+          newFrame.ip = 0;
+          newFrame.bp = newBp;
+          this.frames.push(newFrame);
+        }
+        if (this.frames.length > this.maxFrames) {
+          throw new VMBudgetError(`Call stack overflow (max ${this.maxFrames})`, "stack");
+        }
+        break;
+      }
+
+      case Opcode.TAIL_CALL_U8: {
+        const argCount = ops[base + DECODED_OPERAND]!;
+        const funcIndex = this.sp - argCount - 1;
+        const func = this.callee(frame, funcIndex, argCount);
+        if (--this.fuel < 0) {
+          throw this.fuelExhausted(frame);
+        }
+
+        // The callee takes over this frame: close what closures captured
+        // from it, then move the arguments down to its base
+        this.closeUpvaluesFrom(frame.bp);
+        this.stack.copyWithin(frame.bp, funcIndex + 1, this.sp);
+        this.sp = frame.bp + argCount;
+
+        const localCount = func.template.localCount;
+        for (let i = argCount; i < localCount; i++) {
+          this.push(nullValue());
+        }
 
-        this.frames.push(newFrame);
+        frame.closure = func;
+        frame.ip = 0;
         break;
       }
 
       case Opcode.RETURN: {
         const returnValue = this.pop();
 
-        // Pop current frame
-        this.frames.pop();
+        // Pop current frame. The profiler keys stacks by frame, so frames
+        // are only reused when not profiling.
+        const popped = this.frames.pop()!;
+        if (this.profiler === null) {
+          this.framePool.push(popped);
+        }
 
         if (this.frames.length === 0) {
-          // Returned from entry point - halt execution
+          // Returned from entry point - halt execution. Close upvalues so
+          // returned closures don't alias the stack reused by the next run.
+          this.closeUpvaluesFrom(0);
           this.returnValue = returnValue;
           this.halted = true;
         } else {
@@ -598,9 +1129,7 @@ export class VM {
           this.closeUpvaluesFrom(oldBp);
 
           // Pop all locals from the frame we're returning from
-          while (this.stack.length > oldBp) {
-            this.stack.pop();
-          }
+          this.sp = oldBp;
 
           // Push return value for caller
           this.push(returnValue);
@@ -612,34 +1141,10 @@ export class VM {
       // Builtins
       // ===================================================================
 
-      case Opcode.CALL_BUILTIN_U8_U8:
-      case Opcode.CALL_BUILTIN_U16_U8:
-      case Opcode.CALL_BUILTIN_U32_U8: {
-        const nameIndex = this.readOperand(opcode, frame, code);
-        const argCount = this.readU8(frame, code);
-
-        const name = this.getName(nameIndex);
-        const builtin = this.builtins.get(name);
-
-        if (!builtin) {
-          throw new VMError(`Unknown builtin function: ${name}`, frame.ip);
-        }
-
-        // Pop arguments (in reverse order)
-        const args: Value[] = [];
-        for (let i = 0; i < argCount; i++) {
-          args.unshift(this.pop());
-        }
-
-        try {
-          const result = builtin(args);
-          this.push(result);
-        } catch (error) {
-          if (error instanceof VMRuntimeError) {
-            throw new VMError(error.message, frame.ip);
-          }
-          throw error;
-        }
+      case Opcode.CALL_BUILTIN_U8_U8: {
+        const nameIndex = ops[base + DECODED_OPERAND]!;
+        const argCount = ops[base + DECODED_EXTRA_1]!;
+        this.callBuiltin(frame, nameIndex, argCount);
         break;
       }
 
@@ -647,22 +1152,25 @@ export class VM {
       // Effects (Algebraic Effects with Continuations)
       // ===================================================================
 
-      case Opcode.EFFECT_U8_U8:
-      case Opcode.EFFECT_U16_U8:
-      case Opcode.EFFECT_U32_U8: {
-        const nameIndex = this.readOperand(opcode, frame, code);
-        const argCount = this.readU8(frame, code);
+      case Opcode.EFFECT_U8_U8: {
+        const nameIndex = ops[base + DECODED_OPERAND]!;
+        const argCount = ops[base + DECODED_EXTRA_1]!;
 
         const effectName = this.getName(nameIndex);
 
-        // Pop arguments (in reverse order)
-        const args: Value[] = [];
-        for (let i = 0; i < argCount; i++) {
-          args.unshift(this.pop());
-        }
+        const args = this.popN(argCount);
 
-        // Capture continuation
-        const continuation = new Continuation(this, this.frames, this.stack);
+        // Capture continuation, handing it the VM's buffers
+        const continuation = new Continuation(
+          this,
+          this.frames,
+          this.stack,
+          this.sp,
+          this.openUpvalues,
+          this.fuel,
+          this.memory
+        );
+        this.suspended = continuation;
 
         // Suspend execution
         this.halted = true;
@@ -677,25 +1185,23 @@ export class VM {
       // Arrays
       // ===================================================================
 
-      case Opcode.MAKE_ARRAY_U8:
-      case Opcode.MAKE_ARRAY_U16:
-      case Opcode.MAKE_ARRAY_U32: {
-        const elementCount = this.readOperand(opcode, frame, code);
-
-        // Pop elements (in reverse order)
-        const elements: Value[] = [];
-        for (let i = 0; i < elementCount; i++) {
-          elements.unshift(this.pop());
-        }
+      case Opcode.MAKE_ARRAY_U8: {
+        const elementCount = ops[base + DECODED_OPERAND]!;
 
-        this.push(arrayValue(elements));
+        // Elements were counted when they were created
+        this.allocate(arrayBytes(elementCount), frame);
+        this.push(arrayValue(this.popN(elementCount)));
         break;
       }
 
       case Opcode.GET_INDEX: {
-        const index = toNumber(this.pop());
+        const index = this.pop();
         const array = this.pop();
 
+        if (array.type === "object") {
+          this.push(this.getProperty(frame, array, index));
+          break;
+        }
         if (!isArray(array)) {
           throw new VMError(
             `Cannot index non-array value: ${array.type}`,
@@ -703,7 +1209,7 @@ export class VM {
           );
         }
 
-        const idx = Math.floor(index.value);
+        const idx = Math.floor(toNumber(index).value);
         if (idx < 0 || idx >= array.elements.length) {
           this.push(nullValue());
         } else {
@@ -713,14 +1219,133 @@ export class VM {
       }
 
       // ===================================================================
-      // Unknown Opcode
+      // Superinstructions (produced by the peephole optimizer)
       // ===================================================================
 
-      default:
+      case Opcode.TEE_LOCAL_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
+        this.setLocal(frame, index, this.peek());
+        break;
+      }
+
+      case Opcode.LOAD_LOCAL_CALL_BUILTIN_U8: {
+        const index = ops[base + DECODED_OPERAND]!;
+        const nameIndex = ops[base + DECODED_EXTRA_1]!;
+        const argCount = ops[base + DECODED_EXTRA_2]!;
+        this.push(this.getLocal(frame, index));
+        this.callBuiltin(frame, nameIndex, argCount);
+        break;
+      }
+
+      case Opcode.EQ_JUMP_IF_FALSE_U8:
+      case Opcode.NE_JUMP_IF_FALSE_U8:
+      case Opcode.LT_JUMP_IF_FALSE_U8:
+      case Opcode.GT_JUMP_IF_FALSE_U8:
+      case Opcode.LE_JUMP_IF_FALSE_U8:
+      case Opcode.GE_JUMP_IF_FALSE_U8: {
+        const b = this.pop();
+        const a = this.pop();
+        if (!compareForJump(opcode, a, b)) {
+          this.jump(frame, ops[base + DECODED_OPERAND]!);
+        }
+        break;
+      }
+
+      // ===================================================================
+      // Malformed Code
+      // ===================================================================
+
+      default: {
+        const ip = base / DECODED_STRIDE;
+        if (opcode === undefined) {
+          // Past the end of the table: ran off the end or jumped outside
+          frame.ip = ip;
+          throw new VMError("Instruction pointer out of bounds", ip);
+        }
+        if (opcode === DECODED_TRUNCATED) {
+          frame.ip = ip;
+          throw new VMError("Unexpected end of bytecode", ops[base + DECODED_OPERAND]);
+        }
         throw new VMError(`Unknown opcode: 0x${(opcode as number).toString(16)}`, frame.ip);
+      }
     }
   }
 
+  /**
+   * Call a builtin by name index with the top `argCount` stack values.
+   */
+  private callBuiltin(frame: CallFrame, nameIndex: number, argCount: number): void {
+    const builtin = this.builtins[nameIndex];
+
+    if (!builtin) {
+      throw new VMError(`Unknown builtin function: ${this.getName(nameIndex)}`, frame.ip);
+    }
+
+    const args = this.popN(argCount);
+
+    try {
+      const result = builtin(args);
+      if (this.memory !== Infinity) {
+        this.allocate(valueBytes(result), frame);
+      }
+      this.push(result);
+    } catch (error) {
+      if (error instanceof VMRuntimeError) {
+        throw new VMError(error.message, frame.ip);
+      }
+      throw error;
+    }
+  }
+
+  /**
+   * Property `key` (converted to a string) of `object`, or null, looked up
+   * through the cache of the GET_INDEX that precedes `frame.ip`.
+   */
+  private getProperty(frame: CallFrame, object: ObjectValue, key: Value): Value {
+    const name = key.type === "string" ? key.value : displayValue(key);
+    let site = this.sites[frame.ip];
+    if (site === undefined) {
+      site = { shape: null, key: "", slot: -1 };
+      this.sites[frame.ip] = site;
+    }
+    if (object.shape !== site.shape || name !== site.key) {
+      site.shape = object.shape;
+      site.key = name;
+      site.slot = object.shape.slot(name);
+    }
+    return site.slot < 0 ? nullValue() : object.slots[site.slot]!;
+  }
+
+  /**
+   * The closure a CALL or TAIL_CALL with `argCount` arguments invokes,
+   * checked for callability and arity.
+   */
+  private callee(frame: CallFrame, funcIndex: number, argCount: number): ClosureValue {
+    if (funcIndex < 0) {
+      throw new VMError("Stack underflow during function call", frame.ip);
+    }
+
+    const func = this.stack[funcIndex]!;
+
+    if (!isClosure(func)) {
+      throw new VMError(
+        `Cannot call non-function value: ${func.type}`,
+        frame.ip
+      );
+    }
+
+    // Check arity
+    if (argCount !== func.template.paramCount) {
+      const name = func.name ?? "<anonymous>";
+      throw new VMError(
+        `Function ${name} expects ${func.template.paramCount} arguments, got ${argCount}`,
+        frame.ip
+      );
+    }
+
+    return func;
+  }
+
   /**
    * Restore VM state from a continuation and resume execution.
    * Called by Continuation.resume().
@@ -728,15 +1353,21 @@ export class VM {
   restoreContinuation(
     frames: CallFrame[],
     stack: Value[],
-    value: Value
+    stackSize: number,
+    openUpvalues: Upvalue | null,
+    value: Value,
+    fuel: number = Infinity,
+    memory: number = Infinity
   ): void {
-    // Restore frames and stack
-    this.frames = frames.map((f) => ({
-      closure: f.closure,
-      ip: f.ip,
-      bp: f.bp,
-    }));
-    this.stack = stack.slice();
+    // Take back the buffers handed over at the effect
+    this.frames = frames;
+    this.stack = stack;
+    this.sp = stackSize;
+    this.openUpvalues = openUpvalues;
+    this.fuel = fuel;
+    this.memory = memory;
+    // Any other pending continuation owns different buffers
+    this.suspended = null;
 
     // Push the resumed value onto the stack (this becomes the effect's result)
     this.push(value);
@@ -751,151 +1382,125 @@ export class VM {
   // =====================================================================
 
   /**
-   * Push a value onto the operand stack.
+   * Jump to `target`, charging one unit of fuel if it is backward.
    */
-  private push(value: Value): void {
-    if (this.stack.length >= MAX_STACK_SIZE) {
-      throw new VMError(`Stack overflow (max ${MAX_STACK_SIZE})`);
+  private jump(frame: CallFrame, target: number): void {
+    if (target < frame.ip && --this.fuel < 0) {
+      throw this.fuelExhausted(frame);
     }
-    this.stack.push(value);
+    frame.ip = target;
   }
 
-  /**
-   * Pop a value from the operand stack.
-   */
-  private pop(): Value {
-    const value = this.stack.pop();
-    if (value === undefined) {
-      throw new VMError("Stack underflow");
-    }
-    return value;
+  private fuelExhausted(frame: CallFrame): VMBudgetError {
+    return new VMBudgetError(`Fuel exhausted (limit ${this.fuelLimit})`, "fuel", frame.ip);
   }
 
   /**
-   * Peek at the top of the stack without removing it.
+   * Charge `bytes` newly created by the current instruction to the run's
+   * memory budget.
    */
-  private peek(): Value {
-    if (this.stack.length === 0) {
-      throw new VMError("Stack underflow");
+  private allocate(bytes: number, frame: CallFrame): void {
+    this.memory -= bytes;
+    if (this.memory < 0) {
+      throw new VMBudgetError(`Memory budget exceeded (limit ${this.memoryLimit} bytes)`, "memory", frame.ip);
     }
-    return this.stack[this.stack.length - 1]!;
   }
 
   /**
-   * Get the current call frame.
+   * Push a value onto the operand stack.
    */
-  private currentFrame(): CallFrame {
-    if (this.frames.length === 0) {
-      throw new VMError("No active call frame");
-    }
-    if (this.frames.length > MAX_FRAMES) {
-      throw new VMError(`Call stack overflow (max ${MAX_FRAMES})`);
+  private push(value: Value): void {
+    if (this.sp >= MAX_STACK_SIZE) {
+      throw new VMBudgetError(`Stack overflow (max ${MAX_STACK_SIZE})`, "stack");
     }
-    return this.frames[this.frames.length - 1]!;
+    this.stack[this.sp++] = value;
   }
 
   /**
-   * Read an operand based on the opcode's operand type.
+   * Pop a value from the operand stack.
    */
-  private readOperand(opcode: Opcode, frame: CallFrame, code: Uint8Array): number {
-    const metadata = OPCODE_METADATA[opcode];
-    switch (metadata.operandType) {
-      case OperandType.NONE:
-        return 0;
-      case OperandType.U8:
-        return this.readU8(frame, code);
-      case OperandType.U16:
-        return this.readU16(frame, code);
-      case OperandType.U32:
-        return this.readU32(frame, code);
+  private pop(): Value {
+    if (this.sp === 0) {
+      throw new VMError("Stack underflow");
     }
+    return this.stack[--this.sp]!;
   }
 
   /**
-   * Read an operand as a signed integer (for relative jumps).
+   * Pop the top `count` values as a new array, in push order.
    */
-  private readOperandSigned(opcode: Opcode, frame: CallFrame, code: Uint8Array): number {
-    const metadata = OPCODE_METADATA[opcode];
-    let value: number;
-
-    switch (metadata.operandType) {
-      case OperandType.NONE:
-        return 0;
-      case OperandType.U8:
-        value = this.readU8(frame, code);
-        // Sign-extend from 8-bit to 32-bit
-        return (value << 24) >> 24;
-      case OperandType.U16:
-        value = this.readU16(frame, code);
-        // Sign-extend from 16-bit to 32-bit
-        return (value << 16) >> 16;
-      case OperandType.U32:
-        value = this.readU32(frame, code);
-        // JavaScript bitwise operations treat numbers as 32-bit signed
-        return value | 0;
+  private popN(count: number): Value[] {
+    if (this.sp < count) {
+      throw new VMError("Stack underflow");
     }
+    this.sp -= count;
+    return this.stack.slice(this.sp, this.sp + count);
   }
 
   /**
-   * Read a u8 operand from bytecode.
+   * Peek at the top of the stack without removing it.
    */
-  private readU8(frame: CallFrame, code: Uint8Array): number {
-    if (frame.ip >= code.length) {
-      throw new VMError("Unexpected end of bytecode", frame.ip);
+  private peek(): Value {
+    if (this.sp === 0) {
+      throw new VMError("Stack underflow");
     }
-    const value = code[frame.ip]!;
-    frame.ip++;
-    return value;
+    return this.stack[this.sp - 1]!;
   }
 
   /**
-   * Read a u16 operand from bytecode (little-endian).
+   * Get the current call frame.
    */
-  private readU16(frame: CallFrame, code: Uint8Array): number {
-    if (frame.ip + 1 >= code.length) {
-      throw new VMError("Unexpected end of bytecode", frame.ip);
+  private currentFrame(): CallFrame {
+    if (this.frames.length === 0) {
+      throw new VMError("No active call frame");
     }
-    const low = code[frame.ip]!;
-    const high = code[frame.ip + 1]!;
-    frame.ip += 2;
-    return low | (high << 8);
+    return this.frames[this.frames.length - 1]!;
   }
 
   /**
-   * Read a u32 operand from bytecode (little-endian).
+   * Property caches of a function, created on first use.
    */
-  private readU32(frame: CallFrame, code: Uint8Array): number {
-    if (frame.ip + 3 >= code.length) {
-      throw new VMError("Unexpected end of bytecode", frame.ip);
+  private propertySites(template: FunctionTemplate): (PropertySite | undefined)[] {
+    let sites = propertySites.get(template);
+    if (sites === undefined) {
+      sites = [];
+      propertySites.set(template, sites);
     }
-    const b0 = code[frame.ip]!;
-    const b1 = code[frame.ip + 1]!;
-    const b2 = code[frame.ip + 2]!;
-    const b3 = code[frame.ip + 3]!;
-    frame.ip += 4;
-    return b0 | (b1 << 8) | (b2 << 16) | (b3 << 24);
+    return sites;
   }
 
   /**
-   * Get the bytecode for a closure's function.
+   * Decoded code for a function, decoded on first use.
    */
-  private getCode(closure: { template: FunctionTemplate }): Uint8Array {
-    const template = closure.template;
-    const start = template.codeOffset;
-    const end = start + template.codeLength;
-    return this.bytecode.codeSection.code.slice(start, end);
+  private decoded(template: FunctionTemplate): Int32Array {
+    let ops = decodedFunctions.get(template);
+    if (ops === undefined) {
+      const start = template.codeOffset;
+      ops = decodeFunction(this.bytecode.codeSection.code.subarray(start, start + template.codeLength));
+      decodedFunctions.set(template, ops);
+    }
+    return ops;
   }
 
   /**
    * Get a constant from the constant pool.
    */
   private getConstant(index: number): Value {
-    if (index < 0 || index >= this.bytecode.constantPool.constants.length) {
+    const lazy = this.lazyBytecode;
+    const count = lazy ? lazy.constantCount : this.bytecode.constantPool.constants.length;
+    if (index < 0 || index >= count) {
       throw new VMError(`Constant index ${index} out of bounds`);
     }
 
-    const constant = this.bytecode.constantPool.constants[index]!;
-    return this.constantToValue(constant);
+    const cached = this.constantValues[index];
+    if (cached !== undefined) {
+      return cached;
+    }
+
+    const constant = lazy ? lazy.getConstant(index) : this.bytecode.constantPool.constants[index]!;
+    const value = this.constantToValue(constant);
+    this.constantValues[index] = value;
+    return value;
   }
 
   /**
@@ -923,10 +1528,19 @@ export class VM {
    * Get a name from the name table.
    */
   private getName(index: number): string {
-    if (index < 0 || index >= this.bytecode.nameTable.names.length) {
+    if (index < 0 || index >= this.nameCount()) {
       throw new VMError(`Name index ${index} out of bounds`);
     }
-    return this.bytecode.nameTable.names[index]!;
+    const lazy = this.lazyBytecode;
+    return lazy ? lazy.getName(index) : this.bytecode.nameTable.names[index]!;
+  }
+
+  /**
+   * Number of entries in the name table.
+   */
+  private nameCount(): number {
+    const lazy = this.lazyBytecode;
+    return lazy ? lazy.nameCount : this.bytecode.nameTable.names.length;
   }
 
   /**
@@ -944,7 +1558,7 @@ export class VM {
    */
   private getLocal(frame: CallFrame, index: number): Value {
     const stackIndex = frame.bp + index;
-    if (stackIndex < 0 || stackIndex >= this.stack.length) {
+    if (stackIndex < 0 || stackIndex >= this.sp) {
       throw new VMError(`Local variable index ${index} out of bounds`);
     }
     return this.stack[stackIndex]!;
@@ -955,7 +1569,7 @@ export class VM {
    */
   private setLocal(frame: CallFrame, index: number, value: Value): void {
     const stackIndex = frame.bp + index;
-    if (stackIndex < 0 || stackIndex >= this.stack.length) {
+    if (stackIndex < 0 || stackIndex >= this.sp) {
       throw new VMError(`Local variable index ${index} out of bounds`);
     }
     this.stack[stackIndex] = value;
@@ -979,7 +1593,7 @@ export class VM {
       throw new VMError(`Upvalue index ${index} out of bounds`);
     }
     const upvalue = frame.closure.upvalues[index]!;
-    if (upvalue.type === "open") {
+    if (upvalue.stack !== null) {
       // Update the stack location
       upvalue.stack[upvalue.index] = value;
     } else {
@@ -988,31 +1602,47 @@ export class VM {
     }
   }
 
+  /**
+   * Get the open upvalue for a stack slot, creating it if needed, so every
+   * closure capturing the same slot shares one upvalue.
+   */
+  private captureUpvalue(stackIndex: number): Upvalue {
+    let previous: Upvalue | null = null;
+    let upvalue = this.openUpvalues;
+    while (upvalue !== null && upvalue.index > stackIndex) {
+      previous = upvalue;
+      upvalue = upvalue.next;
+    }
+    if (upvalue !== null && upvalue.index === stackIndex) {
+      return upvalue;
+    }
+
+    const created = openUpvalue(this.stack, stackIndex);
+    created.next = upvalue;
+    if (previous === null) {
+      this.openUpvalues = created;
+    } else {
+      previous.next = created;
+    }
+    return created;
+  }
+
   /**
    * Close all open upvalues at or above the given stack index.
    * This is called when stack frames are popped to preserve captured values.
+   * Upvalues are closed in place, so closures sharing them see the change.
    */
   private closeUpvaluesFrom(stackIndex: number): void {
-    const toClose: number[] = [];
-
-    // Find all open upvalues at or above the stack index
-    for (const [index, upvalue] of this.openUpvalues.entries()) {
-      if (index >= stackIndex) {
-        // Convert to closed upvalue
-        const value = upvalue.stack[upvalue.index]!;
-        (upvalue as any).type = "closed";
-        (upvalue as any).value = value;
-        // Clean up the stack reference
-        delete (upvalue as any).stack;
-        delete (upvalue as any).index;
-        toClose.push(index);
-      }
-    }
-
-    // Remove from open upvalues map
-    for (const index of toClose) {
-      this.openUpvalues.delete(index);
+    let upvalue = this.openUpvalues;
+    while (upvalue !== null && upvalue.index >= stackIndex) {
+      upvalue.value = upvalue.stack![upvalue.index]!;
+      upvalue.type = "closed";
+      upvalue.stack = null;
+      const next: Upvalue | null = upvalue.next;
+      upvalue.next = null;
+      upvalue = next;
     }
+    this.openUpvalues = upvalue;
   }
 
   // =====================================================================
@@ -1024,7 +1654,7 @@ export class VM {
    */
   getStackTrace(): string {
     const lines: string[] = ["Stack:"];
-    for (let i = this.stack.length - 1; i >= 0; i--) {
+    for (let i = this.sp - 1; i >= 0; i--) {
       lines.push(`  [${i}] ${displayValue(this.stack[i]!)}`);
     }
     lines.push("\nFrames:");
@@ -1063,3 +1693,17 @@ export function runVM(
   const vm = new VM(bytecode, effectHandler, builtinOverrides);
   return vm.run(input);
 }
+
+/**
+ * Create one VM and run it over every input, returning results in order.
+ * Uses a throwing effect handler by default.
+ */
+export function runVMBatch(
+  bytecode: BytecodeFile,
+  inputs: Iterable<Value>,
+  effectHandler: EffectHandler = throwingEffectHandler,
+  builtinOverrides?: Map<string, VMBuiltin>
+): Value[] {
+  const vm = new VM(bytecode, effectHandler, builtinOverrides);
+  return vm.runBatch(inputs);
+}
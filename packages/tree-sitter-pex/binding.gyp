@@ -5,24 +5,51 @@
       "dependencies": [
         "<!(node -p \"require('node-addon-api').targets\"):node_addon_api_except",
       ],
+      "variables": {
+        # The tree-sitter runtime sources shipped with the tree-sitter package
+        "tree_sitter_lib": "<!(node -p \"require('path').join(require('path').dirname(require.resolve('tree-sitter/package.json')), 'vendor', 'tree-sitter', 'lib')\")",
+      },
       "include_dirs": [
         "src",
+        "engine",
+        "frontend",
+        "<(tree_sitter_lib)/include",
+        "<(tree_sitter_lib)/src",
       ],
       "sources": [
         "bindings/node/binding.cc",
         "src/parser.c",
         # NOTE: if your language has an external scanner, add it here.
+        "engine/value.cc",
+        "engine/program.cc",
+        "engine/regex.cc",
+        "engine/builtins.cc",
+        "engine/vm.cc",
+        "engine/columns.cc",
+        "frontend/ast.cc",
+        "<(tree_sitter_lib)/src/lib.c",
       ],
       "conditions": [
         ["OS!='win'", {
           "cflags_c": [
             "-std=c11",
           ],
+          "cflags_cc": [
+            "-std=c++17",
+          ],
+          "xcode_settings": {
+            "CLANG_CXX_LANGUAGE_STANDARD": "c++17",
+          },
         }, { # OS == "win"
           "cflags_c": [
             "/std:c11",
             "/utf-8",
           ],
+          "msvs_settings": {
+            "VCCLCompilerTool": {
+              "AdditionalOptions": ["/std:c++17", "/utf-8"],
+            },
+          },
         }],
       ],
     }
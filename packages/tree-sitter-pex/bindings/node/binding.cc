@@ -1,5 +1,14 @@
 #include <napi.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "columns.h"
+#include "program.h"
+#include "vm.h"
+
 typedef struct TSLanguage TSLanguage;
 
 extern "C" TSLanguage *tree_sitter_pex();
@@ -9,11 +18,477 @@ const napi_type_tag LANGUAGE_TYPE_TAG = {
   0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16
 };
 
+namespace {
+
+// =============================================================================
+// Value conversion
+//
+// JS values use the same {type, ...} shape as packages/core/src/vm/values.ts.
+// =============================================================================
+
+pex::Value ToNative(Napi::Env env, pex::Heap &heap, Napi::Value value) {
+    if (!value.IsObject()) {
+        throw Napi::TypeError::New(env, "Expected a PEX value object");
+    }
+    Napi::Object object = value.As<Napi::Object>();
+    std::string type = object.Get("type").ToString().Utf8Value();
+
+    if (type == "null") {
+        return pex::Value::null();
+    }
+    if (type == "boolean") {
+        return pex::Value::boolean(object.Get("value").ToBoolean().Value());
+    }
+    if (type == "number") {
+        return pex::Value::number(object.Get("value").ToNumber().DoubleValue());
+    }
+    if (type == "string") {
+        return heap.string(object.Get("value").ToString().Utf8Value());
+    }
+    if (type == "array") {
+        Napi::Array elements = object.Get("elements").As<Napi::Array>();
+        auto *array = heap.make<pex::ArrayObject>();
+        uint32_t length = elements.Length();
+        array->elements.reserve(length);
+        for (uint32_t i = 0; i < length; i++) {
+            array->elements.push_back(ToNative(env, heap, elements.Get(i)));
+        }
+        return pex::Value::array(array);
+    }
+    if (type == "object") {
+        // Keys come from the object's shape, values from its slots
+        Napi::Array keys = object.Get("shape").As<Napi::Object>().Get("keys").As<Napi::Array>();
+        Napi::Array slots = object.Get("slots").As<Napi::Array>();
+        auto *result = heap.make<pex::ObjectObject>();
+        uint32_t length = keys.Length();
+        result->properties.reserve(length);
+        for (uint32_t i = 0; i < length; i++) {
+            result->properties.emplace_back(keys.Get(i).ToString().Utf8Value(), ToNative(env, heap, slots.Get(i)));
+        }
+        return pex::Value::object(result);
+    }
+    if (type == "regex") {
+        return pex::Value::regex(heap.make<pex::RegexObject>(object.Get("pattern").ToString().Utf8Value(),
+                                                             object.Get("flags").ToString().Utf8Value()));
+    }
+    throw Napi::TypeError::New(env, "Cannot pass " + type + " values to the native engine");
+}
+
+Napi::Object MakeValue(Napi::Env env, const char *type) {
+    Napi::Object object = Napi::Object::New(env);
+    object.Set("type", Napi::String::New(env, type));
+    return object;
+}
+
+// =============================================================================
+// Column conversion
+//
+// JS columns are plain objects over typed arrays, shaped as described in
+// src/engine.ts. Input buffers are read in place for the duration of the
+// call; output buffers are allocated natively and handed to JS as external
+// ArrayBuffers, so neither direction copies row data.
+// =============================================================================
+
+template <typename Array>
+Array ColumnBuffer(Napi::Env env, Napi::Object column, const char *key, napi_typedarray_type type,
+                   const char *expected) {
+    Napi::Value value = column.Get(key);
+    if (!value.IsTypedArray() || value.As<Napi::TypedArray>().TypedArrayType() != type) {
+        throw Napi::TypeError::New(env, std::string("Column ") + key + " must be a " + expected);
+    }
+    return value.As<Array>();
+}
+
+pex::Column ToColumn(Napi::Env env, Napi::Value value) {
+    if (!value.IsObject()) {
+        throw Napi::TypeError::New(env, "Expected a column object");
+    }
+    Napi::Object object = value.As<Napi::Object>();
+    std::string type = object.Get("type").ToString().Utf8Value();
+
+    // Number and string columns know their length; the others are told it
+    pex::Column column;
+    bool lengthKnown = true;
+    if (type == "null") {
+        column.type = pex::ColumnType::Null;
+        lengthKnown = false;
+    } else if (type == "boolean") {
+        Napi::Uint8Array values = ColumnBuffer<Napi::Uint8Array>(env, object, "values", napi_uint8_array, "Uint8Array");
+        column.type = pex::ColumnType::Boolean;
+        column.bits = values.Data();
+        column.bitBytes = values.ElementLength();
+        lengthKnown = false;
+    } else if (type == "number") {
+        Napi::Float64Array values =
+            ColumnBuffer<Napi::Float64Array>(env, object, "values", napi_float64_array, "Float64Array");
+        column.type = pex::ColumnType::Number;
+        column.numbers = values.Data();
+        column.numberCount = values.ElementLength();
+        column.length = column.numberCount;
+    } else if (type == "string") {
+        Napi::Int32Array offsets = ColumnBuffer<Napi::Int32Array>(env, object, "offsets", napi_int32_array, "Int32Array");
+        Napi::Uint8Array data = ColumnBuffer<Napi::Uint8Array>(env, object, "data", napi_uint8_array, "Uint8Array");
+        column.type = pex::ColumnType::String;
+        column.offsets = offsets.Data();
+        column.offsetCount = offsets.ElementLength();
+        column.data = reinterpret_cast<const char *>(data.Data());
+        column.dataLength = data.ElementLength();
+        column.length = column.offsetCount > 0 ? column.offsetCount - 1 : 0;
+    } else if (type == "struct") {
+        Napi::Value fields = object.Get("fields");
+        if (!fields.IsObject()) {
+            throw Napi::TypeError::New(env, "Column fields must be an object of columns");
+        }
+        Napi::Array names = fields.As<Napi::Object>().GetPropertyNames().As<Napi::Array>();
+        column.type = pex::ColumnType::Struct;
+        for (uint32_t i = 0; i < names.Length(); i++) {
+            std::string name = names.Get(i).ToString().Utf8Value();
+            column.fields.emplace_back(name, ToColumn(env, fields.As<Napi::Object>().Get(name)));
+        }
+        lengthKnown = !column.fields.empty();
+        column.length = lengthKnown ? column.fields.front().second.length : 0;
+    } else {
+        throw Napi::TypeError::New(env, "Unknown column type: " + type);
+    }
+
+    Napi::Value length = object.Get("length");
+    if (!length.IsUndefined()) {
+        double rows = length.ToNumber().DoubleValue();
+        if (!(rows >= 0) || rows != static_cast<double>(static_cast<uint32_t>(rows))) {
+            throw Napi::RangeError::New(env, "Column length must be a non-negative integer");
+        }
+        column.length = static_cast<uint32_t>(rows);
+    } else if (!lengthKnown) {
+        throw Napi::TypeError::New(env, "A " + type + " column needs a length");
+    }
+
+    Napi::Value validity = object.Get("validity");
+    if (!validity.IsUndefined() && !validity.IsNull()) {
+        Napi::Uint8Array bitmap =
+            ColumnBuffer<Napi::Uint8Array>(env, object, "validity", napi_uint8_array, "Uint8Array");
+        column.validity = bitmap.Data();
+        column.validityBytes = bitmap.ElementLength();
+    }
+    return column;
+}
+
+// An ArrayBuffer that takes ownership of `buffer` without copying it
+template <typename T>
+Napi::ArrayBuffer Adopt(Napi::Env env, std::vector<T> &buffer) {
+    if (buffer.empty()) {
+        return Napi::ArrayBuffer::New(env, 0);
+    }
+    auto *owned = new std::vector<T>(std::move(buffer));
+    return Napi::ArrayBuffer::New(
+        env, owned->data(), owned->size() * sizeof(T),
+        [](Napi::Env, void *, std::vector<T> *hint) { delete hint; }, owned);
+}
+
+Napi::Object FromColumn(Napi::Env env, pex::OutputColumn &column) {
+    Napi::Object object = Napi::Object::New(env);
+    object.Set("type", Napi::String::New(env, pex::columnTypeName(column.type)));
+    object.Set("length", Napi::Number::New(env, static_cast<double>(column.length)));
+    switch (column.type) {
+        case pex::ColumnType::Boolean: {
+            size_t bytes = column.bits.size();
+            object.Set("values", Napi::Uint8Array::New(env, bytes, Adopt(env, column.bits), 0));
+            break;
+        }
+        case pex::ColumnType::Number: {
+            size_t count = column.numbers.size();
+            object.Set("values", Napi::Float64Array::New(env, count, Adopt(env, column.numbers), 0));
+            break;
+        }
+        case pex::ColumnType::String: {
+            size_t count = column.offsets.size();
+            size_t bytes = column.data.size();
+            object.Set("offsets", Napi::Int32Array::New(env, count, Adopt(env, column.offsets), 0));
+            object.Set("data", Napi::Uint8Array::New(env, bytes, Adopt(env, column.data), 0));
+            break;
+        }
+        default:
+            break;
+    }
+    if (!column.validity.empty()) {
+        size_t bytes = column.validity.size();
+        object.Set("validity", Napi::Uint8Array::New(env, bytes, Adopt(env, column.validity), 0));
+    }
+    return object;
+}
+
+// =============================================================================
+// Engine: native bytecode VM
+// =============================================================================
+
+class Engine : public Napi::ObjectWrap<Engine> {
+  public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "Engine",
+                           {
+                               InstanceMethod<&Engine::Run>("run"),
+                               InstanceMethod<&Engine::Resume>("resume"),
+                               InstanceMethod<&Engine::RunBatch>("runBatch"),
+                               InstanceMethod<&Engine::RunColumns>("runColumns"),
+                               InstanceMethod<&Engine::PendingEffect>("pendingEffect"),
+                           });
+    }
+
+    // new Engine(bytecode: Uint8Array, templates?: FunctionTemplate[],
+    //            makeObject?: (keys: string[], slots: Value[]) => ObjectValue)
+    //
+    // `bytecode` is the output of writeBytecode(). `templates` is used to fill
+    // in ClosureValue.template when a program returns a function, and
+    // `makeObject` builds the (shaped) object values a program returns.
+    explicit Engine(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Engine>(info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1 || !info[0].IsTypedArray()) {
+            throw Napi::TypeError::New(env, "Engine expects a Uint8Array of PEX bytecode");
+        }
+        Napi::Uint8Array bytes = info[0].As<Napi::Uint8Array>();
+        try {
+            program_ = pex::Program::load(bytes.Data(), bytes.ByteLength());
+        } catch (const pex::LoadError &e) {
+            Napi::Error error = Napi::Error::New(env, e.what());
+            error.Value().Set("name", Napi::String::New(env, "BytecodeReadError"));
+            error.Value().Set("offset", Napi::Number::New(env, static_cast<double>(e.offset())));
+            throw error;
+        }
+        try {
+            vm_ = std::make_unique<pex::VM>(*program_);
+        } catch (const pex::VMError &e) {
+            // Unknown builtins are reported when the program is loaded
+            throw ToJsError(env, e);
+        }
+        if (info.Length() > 1 && info[1].IsArray()) {
+            templates_ = Napi::Persistent(info[1].As<Napi::Object>());
+        }
+        if (info.Length() > 2 && info[2].IsFunction()) {
+            makeObject_ = Napi::Persistent(info[2].As<Napi::Function>());
+        }
+    }
+
+  private:
+    // run(input: Value): Value | undefined (undefined while an effect is pending)
+    Napi::Value Run(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        vm_->reset();
+        pex::Value input = info.Length() > 0 ? ToNative(env, vm_->heap(), info[0]) : pex::Value::null();
+        return Settle(env, [&] { return vm_->run(input); });
+    }
+
+    // resume(value: Value): Value | undefined
+    Napi::Value Resume(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        pex::Value value = info.Length() > 0 ? ToNative(env, vm_->heap(), info[0]) : pex::Value::null();
+        return Settle(env, [&] { return vm_->resume(value); });
+    }
+
+    // runBatch(inputs: Value[], start = 0): Value[]
+    //
+    // Runs inputs[start], inputs[start + 1], ... in one call and returns
+    // their results in order. If an input performs an effect the batch stops
+    // there: the returned array ends before that input, pendingEffect()
+    // describes the effect, and resume() completes that input.
+    Napi::Value RunBatch(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            throw Napi::TypeError::New(env, "runBatch expects an array of inputs");
+        }
+        Napi::Array inputs = info[0].As<Napi::Array>();
+        uint32_t length = inputs.Length();
+        uint32_t start = info.Length() > 1 ? info[1].ToNumber().Uint32Value() : 0;
+
+        Napi::Array results = Napi::Array::New(env, start < length ? length - start : 0);
+        for (uint32_t i = start; i < length; i++) {
+            vm_->reset();
+            pex::Value input = ToNative(env, vm_->heap(), inputs.Get(i));
+            Napi::Value result = Settle(env, [&] { return vm_->run(input); });
+            if (result.IsUndefined()) {
+                results.Set("length", Napi::Number::New(env, i - start));
+                break;
+            }
+            results.Set(i - start, result);
+        }
+        return results;
+    }
+
+    // runColumns(input: Column): Column
+    //
+    // Runs every row of a column in one call, with the row as the input, and
+    // returns the results as a column (see engine/columns.h). Rows cannot
+    // perform effects: a row that does fails the call with a ColumnError, as
+    // does a result that is not null, a boolean, a number or a string.
+    Napi::Value RunColumns(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "runColumns expects an input column");
+        }
+        pex::Column input = ToColumn(env, info[0]);
+        pex::OutputColumn output;
+        try {
+            output = pex::runColumns(*vm_, input);
+        } catch (const pex::VMError &e) {
+            throw ToJsError(env, e);
+        } catch (const pex::ColumnError &e) {
+            Napi::Error error = Napi::Error::New(env, e.what());
+            error.Value().Set("name", Napi::String::New(env, "ColumnError"));
+            if (e.hasRow()) {
+                error.Value().Set("row", Napi::Number::New(env, static_cast<double>(e.row())));
+            }
+            throw error;
+        }
+        return FromColumn(env, output);
+    }
+
+    // pendingEffect(): { name: string, args: Value[] } | null
+    Napi::Value PendingEffect(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        if (!vm_->suspended()) {
+            return env.Null();
+        }
+        const auto &args = vm_->effectArgs();
+        Napi::Array jsArgs = Napi::Array::New(env, args.size());
+        for (size_t i = 0; i < args.size(); i++) {
+            jsArgs.Set(static_cast<uint32_t>(i), ToJs(env, args[i]));
+        }
+        Napi::Object effect = Napi::Object::New(env);
+        effect.Set("name", Napi::String::New(env, vm_->effectName()));
+        effect.Set("args", jsArgs);
+        return effect;
+    }
+
+    template <typename Step>
+    Napi::Value Settle(Napi::Env env, Step step) {
+        pex::RunStatus status;
+        try {
+            status = step();
+        } catch (const pex::VMError &e) {
+            throw ToJsError(env, e);
+        }
+        if (status == pex::RunStatus::Suspended) {
+            return env.Undefined();
+        }
+        return ToJs(env, vm_->result());
+    }
+
+    static Napi::Error ToJsError(Napi::Env env, const pex::VMError &e) {
+        Napi::Error error = Napi::Error::New(env, e.what());
+        error.Value().Set("name", Napi::String::New(env, "VMError"));
+        if (e.hasIp()) {
+            error.Value().Set("ip", Napi::Number::New(env, e.ip()));
+        }
+        return error;
+    }
+
+    Napi::Value ToJs(Napi::Env env, pex::Value value) {
+        switch (value.type()) {
+            case pex::ValueType::Null:
+                return MakeValue(env, "null");
+            case pex::ValueType::Boolean: {
+                Napi::Object object = MakeValue(env, "boolean");
+                object.Set("value", Napi::Boolean::New(env, value.asBoolean()));
+                return object;
+            }
+            case pex::ValueType::Number: {
+                Napi::Object object = MakeValue(env, "number");
+                object.Set("value", Napi::Number::New(env, value.asNumber()));
+                return object;
+            }
+            case pex::ValueType::String: {
+                Napi::Object object = MakeValue(env, "string");
+                std::string_view text = value.asString()->value;
+                object.Set("value", Napi::String::New(env, text.data(), text.size()));
+                return object;
+            }
+            case pex::ValueType::Array: {
+                const auto &elements = value.asArray()->elements;
+                Napi::Array jsElements = Napi::Array::New(env, elements.size());
+                for (size_t i = 0; i < elements.size(); i++) {
+                    jsElements.Set(static_cast<uint32_t>(i), ToJs(env, elements[i]));
+                }
+                Napi::Object object = MakeValue(env, "array");
+                object.Set("elements", jsElements);
+                return object;
+            }
+            case pex::ValueType::Object: {
+                if (makeObject_.IsEmpty()) {
+                    throw Napi::TypeError::New(env, "Cannot return object values without makeObject");
+                }
+                const auto &properties = value.asObject()->properties;
+                Napi::Array keys = Napi::Array::New(env, properties.size());
+                Napi::Array slots = Napi::Array::New(env, properties.size());
+                for (size_t i = 0; i < properties.size(); i++) {
+                    keys.Set(static_cast<uint32_t>(i), Napi::String::New(env, properties[i].first));
+                    slots.Set(static_cast<uint32_t>(i), ToJs(env, properties[i].second));
+                }
+                return makeObject_.Call({keys, slots});
+            }
+            case pex::ValueType::Regex: {
+                const pex::RegexObject *regex = value.asRegex();
+                Napi::Function regexConstructor = env.Global().Get("RegExp").As<Napi::Function>();
+                Napi::Object object = MakeValue(env, "regex");
+                object.Set("pattern", Napi::String::New(env, regex->pattern));
+                object.Set("flags", Napi::String::New(env, regex->flags));
+                object.Set("regex", regexConstructor.New({Napi::String::New(env, regex->pattern),
+                                                          Napi::String::New(env, regex->flags)}));
+                return object;
+            }
+            case pex::ValueType::Closure: {
+                const pex::ClosureObject *closure = value.asClosure();
+                Napi::Object object = MakeValue(env, "closure");
+                object.Set("template", templates_.IsEmpty() ? env.Null() : templates_.Value().Get(closure->templateIndex));
+                object.Set("upvalues", Napi::Array::New(env, 0));
+                object.Set("name", closure->name != nullptr ? Napi::String::New(env, *closure->name) : env.Null());
+                return object;
+            }
+        }
+        return MakeValue(env, "null");
+    }
+
+    std::unique_ptr<pex::Program> program_;
+    std::unique_ptr<pex::VM> vm_;
+    Napi::ObjectReference templates_;
+    Napi::FunctionReference makeObject_;
+};
+
+// =============================================================================
+// Front end: tree-sitter CST to PEX AST
+// =============================================================================
+
+// parseAST(source: string, shellMode?: boolean): Uint8Array
+//
+// Returns the AST serialized as described in frontend/ast.h, so the whole
+// tree crosses into JS as one buffer.
+Napi::Value ParseAst(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+        throw Napi::TypeError::New(env, "parseAST expects a source string");
+    }
+    std::string source = info[0].As<Napi::String>().Utf8Value();
+    bool shellMode = info.Length() > 1 && info[1].ToBoolean().Value();
+
+    std::string ast;
+    try {
+        ast = pex::parseToAst(source.data(), source.size(), shellMode);
+    } catch (const pex::SyntaxError &e) {
+        Napi::Error error = Napi::Error::New(env, e.what());
+        error.Value().Set("name", Napi::String::New(env, "ParseError"));
+        error.Value().Set("line", Napi::Number::New(env, e.line()));
+        error.Value().Set("column", Napi::Number::New(env, e.column()));
+        throw error;
+    }
+    return Napi::Buffer<uint8_t>::Copy(env, reinterpret_cast<const uint8_t *>(ast.data()), ast.size());
+}
+
+}  // namespace
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports["name"] = Napi::String::New(env, "pex");
     auto language = Napi::External<TSLanguage>::New(env, tree_sitter_pex());
     language.TypeTag(&LANGUAGE_TYPE_TAG);
     exports["language"] = language;
+    exports["Engine"] = Engine::Define(env);
+    exports["parseAST"] = Napi::Function::New(env, ParseAst, "parseAST");
     return exports;
 }
 
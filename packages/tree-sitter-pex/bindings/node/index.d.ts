@@ -18,10 +18,31 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+/**
+ * Native bytecode engine. Values use the same `{ type, ... }` shape as
+ * @pex/core's VM values.
+ */
+declare class Engine {
+  /** `makeObject` builds the object values the program returns from their keys and slots. */
+  constructor(bytecode: Uint8Array, templates?: unknown[], makeObject?: (keys: string[], slots: unknown[]) => unknown);
+  /** Run the entry point; returns undefined while an effect is pending. */
+  run(input: unknown): unknown;
+  /** Resume the pending effect with a value. */
+  resume(value: unknown): unknown;
+  /** Run inputs[start..] in one call; stops early at an input that performs an effect. */
+  runBatch(inputs: unknown[], start?: number): unknown[];
+  /** Run every row of a columnar input in one call; returns the results as a column. */
+  runColumns(input: object): object;
+  pendingEffect(): { name: string; args: unknown[] } | null;
+}
+
 type Language = {
   name: string;
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  Engine: typeof Engine;
+  /** Parse source and return its PEX AST serialized as in frontend/ast.h. */
+  parseAST(source: string, shellMode?: boolean): Uint8Array;
 };
 
 declare const language: Language;
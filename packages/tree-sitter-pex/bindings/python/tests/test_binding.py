@@ -0,0 +1,22 @@
+from unittest import TestCase
+
+import tree_sitter_pex
+
+
+class TestParseMany(TestCase):
+    def test_can_load_grammar(self):
+        self.assertNotEqual(tree_sitter_pex.language(), 0)
+
+    def test_parse_many(self):
+        sources = [f"(+ {i}" if i % 10 == 3 else f"$$ | (+ $ {i})" for i in range(100)]
+        results = tree_sitter_pex.parse_many(sources, threads=4)
+        self.assertEqual(len(results), len(sources))
+        for i, (result, source) in enumerate(zip(results, sources)):
+            self.assertEqual(result["errors"] == [], i % 10 != 3, source)
+            self.assertNotIn("tree", result)
+        self.assertEqual(results[3]["errors"][0][2], "Expected ')'")
+
+    def test_trees(self):
+        [result] = tree_sitter_pex.parse_many([b"(+ 1 2)"], trees=True)
+        self.assertEqual(result["errors"], [])
+        self.assertTrue(result["tree"].startswith("(program"))
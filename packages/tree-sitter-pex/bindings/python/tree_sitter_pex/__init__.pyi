@@ -1 +1,10 @@
+from typing import List, Sequence, Tuple, TypedDict, Union
+
+class ParseResult(TypedDict, total=False):
+    errors: List[Tuple[int, int, str]]
+    tree: str
+
 def language() -> int: ...
+def parse_many(
+    sources: Sequence[Union[str, bytes]], threads: int = 0, trees: bool = False
+) -> List[ParseResult]: ...
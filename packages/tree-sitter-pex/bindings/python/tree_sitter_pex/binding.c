@@ -1,6 +1,17 @@
 #include <Python.h>
 
-typedef struct TSLanguage TSLanguage;
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 TSLanguage *tree_sitter_pex(void);
 
@@ -8,9 +19,392 @@ static PyObject* _binding_language(PyObject *self, PyObject *args) {
     return PyLong_FromVoidPtr(tree_sitter_pex());
 }
 
+// =============================================================================
+// parse_many: parallel batch parsing
+// =============================================================================
+
+// Longest source excerpt quoted in an error message, as in frontend/ast.cc
+#define MAX_ERROR_EXCERPT 20
+
+// Most threads parse_many() starts, whatever `threads` asks for
+#define MAX_THREADS 256
+
+typedef struct {
+    uint32_t line;
+    uint32_t column;
+    char *message;
+} SyntaxError;
+
+typedef struct {
+    const char *source;
+    uint32_t length;
+    SyntaxError *errors;
+    size_t error_count;
+    size_t error_capacity;
+    char *tree;
+    bool failed;
+} ParseJob;
+
+typedef struct {
+    ParseJob *jobs;
+    size_t count;
+    size_t first;
+    size_t stride;
+    bool trees;
+} ParseWorker;
+
+static bool is_error(TSNode node) {
+    return ts_node_is_missing(node) || strcmp(ts_node_type(node), "ERROR") == 0;
+}
+
+/*
+ * "Expected ')'", "Unexpected 'xyz'" or "Unexpected end of input", as the
+ * native front end reports them.
+ */
+static char *error_message(TSNode node, const char *source) {
+    if (ts_node_is_missing(node)) {
+        const char *type = ts_node_type(node);
+        char *message = malloc(strlen(type) + 12);
+        if (message != NULL) {
+            sprintf(message, "Expected '%s'", type);
+        }
+        return message;
+    }
+
+    const char *start = source + ts_node_start_byte(node);
+    size_t length = ts_node_end_byte(node) - ts_node_start_byte(node);
+    if (length == 0) {
+        char *message = malloc(24);
+        if (message != NULL) {
+            strcpy(message, "Unexpected end of input");
+        }
+        return message;
+    }
+
+    size_t excerpt = 0;
+    while (excerpt < length && excerpt < MAX_ERROR_EXCERPT && start[excerpt] != '\n') {
+        excerpt++;
+    }
+    // Do not cut a multi-byte character in half
+    while (excerpt < length && excerpt > 0 && ((unsigned char)start[excerpt] & 0xC0) == 0x80) {
+        excerpt--;
+    }
+    char *message = malloc(excerpt + 15);
+    if (message != NULL) {
+        sprintf(message, "Unexpected '%.*s'", (int)excerpt, start);
+    }
+    return message;
+}
+
+static bool add_error(ParseJob *job, TSNode node) {
+    if (job->error_count == job->error_capacity) {
+        size_t capacity = job->error_capacity == 0 ? 4 : job->error_capacity * 2;
+        SyntaxError *errors = realloc(job->errors, capacity * sizeof(SyntaxError));
+        if (errors == NULL) {
+            return false;
+        }
+        job->errors = errors;
+        job->error_capacity = capacity;
+    }
+
+    char *message = error_message(node, job->source);
+    if (message == NULL) {
+        return false;
+    }
+    TSPoint point = ts_node_start_point(node);
+    SyntaxError *error = &job->errors[job->error_count++];
+    error->line = point.row + 1;
+    error->column = point.column + 1;
+    error->message = message;
+    return true;
+}
+
+/*
+ * Record every outermost ERROR or MISSING node of the tree, in document
+ * order. Only subtrees that contain an error are visited.
+ */
+static bool collect_errors(ParseJob *job, TSNode root) {
+    if (!ts_node_has_error(root)) {
+        return true;
+    }
+
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    bool ok = true;
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        if (is_error(node)) {
+            if (!add_error(job, node)) {
+                ok = false;
+                break;
+            }
+        } else if (ts_node_has_error(node) && ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+
+        // Move to the next subtree, climbing out of finished ones
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return ok;
+            }
+        }
+    }
+    ts_tree_cursor_delete(&cursor);
+    return ok;
+}
+
+static void parse_job(TSParser *parser, ParseJob *job, bool trees) {
+    TSTree *tree = ts_parser_parse_string(parser, NULL, job->source, job->length);
+    if (tree == NULL) {
+        job->failed = true;
+        return;
+    }
+    TSNode root = ts_tree_root_node(tree);
+    job->failed = !collect_errors(job, root);
+    if (trees && !job->failed) {
+        job->tree = ts_node_string(root);
+        job->failed = job->tree == NULL;
+    }
+    ts_tree_delete(tree);
+}
+
+/*
+ * Parse jobs first, first + stride, ... with a parser of the worker's own;
+ * TSParser instances must not be shared between threads.
+ */
+static void run_worker(ParseWorker *worker) {
+    TSParser *parser = ts_parser_new();
+    bool ready = ts_parser_set_language(parser, tree_sitter_pex());
+    for (size_t i = worker->first; i < worker->count; i += worker->stride) {
+        if (ready) {
+            parse_job(parser, &worker->jobs[i], worker->trees);
+        } else {
+            worker->jobs[i].failed = true;
+        }
+    }
+    ts_parser_delete(parser);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID worker) {
+    run_worker(worker);
+    return 0;
+}
+#else
+static void *worker_main(void *worker) {
+    run_worker(worker);
+    return NULL;
+}
+#endif
+
+static size_t cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+/*
+ * Run every job on `thread_count` threads. The calling thread is the first
+ * worker; if a thread cannot be started its jobs go to the calling thread.
+ */
+static void run_jobs(ParseJob *jobs, size_t count, size_t thread_count, bool trees) {
+    ParseWorker workers[MAX_THREADS];
+#ifdef _WIN32
+    HANDLE handles[MAX_THREADS];
+#else
+    pthread_t handles[MAX_THREADS];
+#endif
+    bool started[MAX_THREADS];
+
+    for (size_t i = 0; i < thread_count; i++) {
+        workers[i] = (ParseWorker){jobs, count, i, thread_count, trees};
+        started[i] = false;
+    }
+    for (size_t i = 1; i < thread_count; i++) {
+#ifdef _WIN32
+        handles[i] = CreateThread(NULL, 0, worker_main, &workers[i], 0, NULL);
+        started[i] = handles[i] != NULL;
+#else
+        started[i] = pthread_create(&handles[i], NULL, worker_main, &workers[i]) == 0;
+#endif
+    }
+
+    run_worker(&workers[0]);
+    for (size_t i = 1; i < thread_count; i++) {
+        if (!started[i]) {
+            run_worker(&workers[i]);
+            continue;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+}
+
+static void free_jobs(ParseJob *jobs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < jobs[i].error_count; j++) {
+            free(jobs[i].errors[j].message);
+        }
+        free(jobs[i].errors);
+        free(jobs[i].tree);
+    }
+    free(jobs);
+}
+
+/*
+ * {"errors": [(line, column, message), ...], "tree": sexp} for one job;
+ * "tree" is only present when trees were requested.
+ */
+static PyObject *job_result(const ParseJob *job, bool trees) {
+    PyObject *errors = PyList_New((Py_ssize_t)job->error_count);
+    if (errors == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < job->error_count; i++) {
+        const SyntaxError *error = &job->errors[i];
+        PyObject *entry = Py_BuildValue("(IIs)", error->line, error->column, error->message);
+        if (entry == NULL) {
+            Py_DECREF(errors);
+            return NULL;
+        }
+        PyList_SetItem(errors, (Py_ssize_t)i, entry);
+    }
+
+    PyObject *result = PyDict_New();
+    if (result == NULL || PyDict_SetItemString(result, "errors", errors) < 0) {
+        Py_XDECREF(result);
+        Py_DECREF(errors);
+        return NULL;
+    }
+    Py_DECREF(errors);
+
+    if (trees) {
+        PyObject *tree = PyUnicode_FromString(job->tree);
+        if (tree == NULL || PyDict_SetItemString(result, "tree", tree) < 0) {
+            Py_XDECREF(tree);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(tree);
+    }
+    return result;
+}
+
+static PyObject* _binding_parse_many(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"sources", "threads", "trees", NULL};
+    PyObject *sources;
+    int threads = 0;
+    int trees = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ip:parse_many", keywords, &sources, &threads, &trees)) {
+        return NULL;
+    }
+    if (threads < 0) {
+        PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Size(sources);
+    if (count < 0) {
+        return NULL;
+    }
+
+    // UTF-8 bytes of every source, held so the buffers can be read without
+    // the GIL
+    PyObject *buffers = PyList_New(count);
+    ParseJob *jobs = calloc(count > 0 ? (size_t)count : 1, sizeof(ParseJob));
+    if (buffers == NULL || jobs == NULL) {
+        Py_XDECREF(buffers);
+        free(jobs);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *source = PySequence_GetItem(sources, i);
+        if (source == NULL) {
+            goto fail;
+        }
+        PyObject *bytes;
+        if (PyUnicode_Check(source)) {
+            bytes = PyUnicode_AsUTF8String(source);
+        } else if (PyBytes_Check(source)) {
+            bytes = source;
+            Py_INCREF(bytes);
+        } else {
+            PyErr_Format(PyExc_TypeError, "parse_many expects str or bytes sources (item %zd)", i);
+            bytes = NULL;
+        }
+        Py_DECREF(source);
+        if (bytes == NULL) {
+            goto fail;
+        }
+        PyList_SetItem(buffers, i, bytes);
+
+        char *data;
+        Py_ssize_t length;
+        if (PyBytes_AsStringAndSize(bytes, &data, &length) < 0) {
+            goto fail;
+        }
+        if ((size_t)length > UINT32_MAX) {
+            PyErr_Format(PyExc_ValueError, "Source %zd is larger than 4 GiB", i);
+            goto fail;
+        }
+        jobs[i].source = data;
+        jobs[i].length = (uint32_t)length;
+    }
+
+    size_t thread_count = threads > 0 ? (size_t)threads : cpu_count();
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+    if (thread_count > (size_t)count) {
+        thread_count = count > 0 ? (size_t)count : 1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    run_jobs(jobs, (size_t)count, thread_count, trees);
+    Py_END_ALLOW_THREADS
+
+    PyObject *results = PyList_New(count);
+    if (results == NULL) {
+        goto fail;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *result = jobs[i].failed ? PyErr_NoMemory() : job_result(&jobs[i], trees);
+        if (result == NULL) {
+            Py_DECREF(results);
+            goto fail;
+        }
+        PyList_SetItem(results, i, result);
+    }
+    Py_DECREF(buffers);
+    free_jobs(jobs, (size_t)count);
+    return results;
+
+fail:
+    Py_DECREF(buffers);
+    free_jobs(jobs, (size_t)count);
+    return NULL;
+}
+
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+    {"parse_many", (PyCFunction)(void (*)(void))_binding_parse_many, METH_VARARGS | METH_KEYWORDS,
+     "parse_many(sources, threads=0, trees=False)\n--\n\n"
+     "Parse many sources in parallel without holding the GIL.\n\n"
+     "Each source (str or bytes) is parsed on one of `threads` threads (one per\n"
+     "CPU when 0), each with its own parser. Returns one dict per source, in\n"
+     "order: \"errors\" lists its syntax errors as (line, column, message)\n"
+     "tuples (1-based; columns count UTF-8 bytes), and \"tree\" holds the\n"
+     "syntax tree as an S-expression when `trees` is true."},
     {NULL, NULL, 0, NULL}
 };
 
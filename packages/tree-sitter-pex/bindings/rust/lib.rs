@@ -12,12 +12,28 @@
 //! assert!(!tree.root_node().has_error());
 //! ```
 //!
+//! To parse many sources at once, [parse_many][parse_many func] spreads them over threads with
+//! a parser per thread, and [syntax_errors][syntax_errors func] summarizes what went wrong in a
+//! tree:
+//!
+//! ```
+//! let sources = ["$$ | lower", "(+ 1"];
+//! let trees = tree_sitter_pex::parse_many(&sources, 0);
+//! assert!(tree_sitter_pex::syntax_errors(&trees[0], sources[0]).is_empty());
+//! assert!(!tree_sitter_pex::syntax_errors(&trees[1], sources[1]).is_empty());
+//! ```
+//!
 //! [Language]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Language.html
 //! [language func]: fn.language.html
+//! [parse_many func]: fn.parse_many.html
+//! [syntax_errors func]: fn.syntax_errors.html
 //! [Parser]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Parser.html
 //! [tree-sitter]: https://tree-sitter.github.io/
 
-use tree_sitter::Language;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::thread;
+
+use tree_sitter::{Language, Node, Parser, Point, Tree};
 
 extern "C" {
     fn tree_sitter_pex() -> Language;
@@ -30,6 +46,121 @@ pub fn language() -> Language {
     unsafe { tree_sitter_pex() }
 }
 
+/// Longest source excerpt quoted in a [SyntaxError] message, as in the native front end.
+const MAX_ERROR_EXCERPT: usize = 20;
+
+/// Parse every source in parallel, returning their trees in order.
+///
+/// The sources are shared out between `threads` threads (one per CPU when `threads` is 0),
+/// each with a [Parser] of its own. Trees with syntax errors are returned like any other;
+/// see [syntax_errors].
+pub fn parse_many<S: AsRef<[u8]> + Sync>(sources: &[S], threads: usize) -> Vec<Tree> {
+    let threads = if threads == 0 {
+        thread::available_parallelism().map_or(1, |n| n.get())
+    } else {
+        threads
+    }
+    .clamp(1, sources.len().max(1));
+
+    // Workers take the next unparsed source until none are left
+    let next = AtomicUsize::new(0);
+    let parse = || {
+        let mut parser = Parser::new();
+        parser
+            .set_language(&language())
+            .expect("Error loading Pex grammar");
+        let mut parsed = Vec::new();
+        loop {
+            let index = next.fetch_add(1, Ordering::Relaxed);
+            let Some(source) = sources.get(index) else {
+                return parsed;
+            };
+            // Only a timeout or cancellation flag makes parse() return None, and none is set
+            let tree = parser.parse(source, None).expect("parse without a timeout");
+            parsed.push((index, tree));
+        }
+    };
+
+    let mut trees: Vec<Option<Tree>> = (0..sources.len()).map(|_| None).collect();
+    thread::scope(|scope| {
+        let workers: Vec<_> = (1..threads).map(|_| scope.spawn(parse)).collect();
+        let mut store = |parsed: Vec<(usize, Tree)>| {
+            for (index, tree) in parsed {
+                trees[index] = Some(tree);
+            }
+        };
+        store(parse());
+        for worker in workers {
+            store(worker.join().expect("parse_many worker panicked"));
+        }
+    });
+    trees
+        .into_iter()
+        .map(|tree| tree.expect("every source is parsed"))
+        .collect()
+}
+
+/// A syntax error found by [syntax_errors].
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct SyntaxError {
+    /// Where the error starts (zero-based row, column in bytes).
+    pub start: Point,
+    /// "Expected ')'", "Unexpected 'xyz'" or "Unexpected end of input".
+    pub message: String,
+}
+
+/// Every outermost ERROR or MISSING node of `tree`, in document order, described as the native
+/// front end reports them. `source` is the text `tree` was parsed from.
+pub fn syntax_errors(tree: &Tree, source: impl AsRef<[u8]>) -> Vec<SyntaxError> {
+    let source = source.as_ref();
+    let mut errors = Vec::new();
+    let root = tree.root_node();
+    if !root.has_error() {
+        return errors;
+    }
+
+    let mut cursor = root.walk();
+    loop {
+        let node = cursor.node();
+        if node.is_error() || node.is_missing() {
+            errors.push(SyntaxError {
+                start: node.start_position(),
+                message: error_message(node, source),
+            });
+        } else if node.has_error() && cursor.goto_first_child() {
+            continue;
+        }
+
+        // Move to the next subtree, climbing out of finished ones
+        while !cursor.goto_next_sibling() {
+            if !cursor.goto_parent() {
+                return errors;
+            }
+        }
+    }
+}
+
+fn error_message(node: Node, source: &[u8]) -> String {
+    if node.is_missing() {
+        return format!("Expected '{}'", node.kind());
+    }
+
+    let text = &source[node.byte_range()];
+    if text.is_empty() {
+        return "Unexpected end of input".to_string();
+    }
+    let mut excerpt = text
+        .iter()
+        .take(MAX_ERROR_EXCERPT)
+        .take_while(|&&byte| byte != b'\n')
+        .count();
+    // Do not cut a multi-byte character in half
+    while excerpt < text.len() && excerpt > 0 && text[excerpt] & 0xC0 == 0x80 {
+        excerpt -= 1;
+    }
+    format!("Unexpected '{}'", String::from_utf8_lossy(&text[..excerpt]))
+}
+
 /// The content of the [`node-types.json`][] file for this grammar.
 ///
 /// [`node-types.json`]: https://tree-sitter.github.io/tree-sitter/using-parsers#static-node-types
@@ -51,4 +182,27 @@ mod tests {
             .set_language(&super::language())
             .expect("Error loading Pex grammar");
     }
+
+    #[test]
+    fn test_parse_many() {
+        let sources: Vec<String> = (0..100)
+            .map(|i| {
+                if i % 10 == 3 {
+                    format!("(+ {i}")
+                } else {
+                    format!("$$ | (+ $ {i})")
+                }
+            })
+            .collect();
+        let trees = super::parse_many(&sources, 4);
+        assert_eq!(trees.len(), sources.len());
+        for (i, (tree, source)) in trees.iter().zip(&sources).enumerate() {
+            let errors = super::syntax_errors(tree, source);
+            assert_eq!(errors.is_empty(), i % 10 != 3, "{source}: {errors:?}");
+        }
+        assert_eq!(
+            super::syntax_errors(&trees[3], &sources[3])[0].message,
+            "Expected ')'"
+        );
+    }
 }
@@ -0,0 +1,180 @@
+/**
+ * WebAssembly exports of the native PEX front end and engine.
+ *
+ * The module has no JS glue of its own; src/wasm.ts drives it through
+ * these functions. Strings cross in linear memory: the host copies its
+ * input into a pex_alloc() buffer, and each call leaves its output in one
+ * shared buffer, read through pex_output() / pex_output_length() until the
+ * next call. Outputs are:
+ *
+ *   pex_parse_ast      the serialized AST of frontend/ast.h
+ *   pex_engine_run,    the result as JSON (PEX_COMPLETED), or the pending
+ *   pex_engine_resume  effect as {"name", "args"} JSON (PEX_SUSPENDED)
+ *
+ * A failing call returns PEX_ERROR (or null from pex_engine_new) with the
+ * error as {"name", "message", ...} JSON, using the names and extra fields
+ * of the Node addon: VMError (ip), ParseError (line, column),
+ * BytecodeReadError (offset), and JsonError (offset) for malformed input.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.h"
+#include "json.h"
+#include "program.h"
+#include "vm.h"
+
+namespace {
+
+enum Status : int32_t {
+    PEX_COMPLETED = 0,
+    PEX_SUSPENDED = 1,
+    PEX_ERROR = 2,
+};
+
+struct Engine {
+    std::unique_ptr<pex::Program> program;
+    std::unique_ptr<pex::VM> vm;
+};
+
+std::string output;
+
+/** Start `output` as an error object, leaving it open for extra fields. */
+void beginError(const char *name, const char *message) {
+    output = "{\"name\":";
+    pex::appendJsonString(output, name);
+    output += ",\"message\":";
+    pex::appendJsonString(output, message);
+}
+
+void addField(const char *field, double value) {
+    output += ",\"";
+    output += field;
+    output += "\":";
+    output += pex::numberToString(value);
+}
+
+Status fail(const char *name, const char *message) {
+    beginError(name, message);
+    output += '}';
+    return PEX_ERROR;
+}
+
+Status fail(const pex::VMError &e) {
+    beginError("VMError", e.what());
+    if (e.hasIp()) addField("ip", e.ip());
+    output += '}';
+    return PEX_ERROR;
+}
+
+Status fail(const pex::JsonError &e) {
+    beginError("JsonError", e.what());
+    addField("offset", static_cast<double>(e.offset()));
+    output += '}';
+    return PEX_ERROR;
+}
+
+/** Finish a run or resume, leaving its result or pending effect in `output`. */
+template <typename Step>
+Status settle(Engine *engine, Step step) {
+    try {
+        if (step() == pex::RunStatus::Completed) {
+            output = pex::toJson(engine->vm->result());
+            return PEX_COMPLETED;
+        }
+    } catch (const pex::VMError &e) {
+        return fail(e);
+    } catch (const pex::JsonError &e) {
+        return fail(e);
+    } catch (const std::exception &e) {
+        return fail("Error", e.what());
+    }
+
+    output = "{\"name\":";
+    pex::appendJsonString(output, engine->vm->effectName());
+    output += ",\"args\":[";
+    bool first = true;
+    for (pex::Value arg : engine->vm->effectArgs()) {
+        if (!first) output += ',';
+        first = false;
+        pex::appendJson(output, arg);
+    }
+    output += "]}";
+    return PEX_SUSPENDED;
+}
+
+}  // namespace
+
+extern "C" {
+
+/** A buffer of `size` bytes for passing input (never null for size 0). */
+uint8_t *pex_alloc(uint32_t size) { return static_cast<uint8_t *>(std::malloc(size > 0 ? size : 1)); }
+
+void pex_free(uint8_t *pointer) { std::free(pointer); }
+
+const char *pex_output() { return output.data(); }
+
+uint32_t pex_output_length() { return static_cast<uint32_t>(output.size()); }
+
+// Parse UTF-8 source; the AST goes to the output buffer
+int32_t pex_parse_ast(const char *source, uint32_t length, int32_t shellMode) {
+    try {
+        output = pex::parseToAst(source, length, shellMode != 0);
+        return PEX_COMPLETED;
+    } catch (const pex::SyntaxError &e) {
+        beginError("ParseError", e.what());
+        addField("line", e.line());
+        addField("column", e.column());
+        output += '}';
+        return PEX_ERROR;
+    } catch (const std::exception &e) {
+        return fail("Error", e.what());
+    }
+}
+
+// Load bytecode written by writeBytecode(); null (with the error in the
+// output buffer) if it is malformed or calls an unknown builtin
+Engine *pex_engine_new(const uint8_t *bytecode, uint32_t length) {
+    auto engine = std::make_unique<Engine>();
+    try {
+        engine->program = pex::Program::load(bytecode, length);
+        engine->vm = std::make_unique<pex::VM>(*engine->program);
+    } catch (const pex::LoadError &e) {
+        beginError("BytecodeReadError", e.what());
+        addField("offset", static_cast<double>(e.offset()));
+        output += '}';
+        return nullptr;
+    } catch (const pex::VMError &e) {
+        fail(e);
+        return nullptr;
+    } catch (const std::exception &e) {
+        fail("Error", e.what());
+        return nullptr;
+    }
+    return engine.release();
+}
+
+void pex_engine_delete(Engine *engine) { delete engine; }
+
+// Run the program with `input` (JSON text) as $$
+int32_t pex_engine_run(Engine *engine, const char *input, uint32_t length) {
+    engine->vm->reset();
+    return settle(engine, [&] {
+        pex::Value value = pex::parseJson(engine->vm->heap(), std::string_view(input, length));
+        return engine->vm->run(value);
+    });
+}
+
+// Resume the pending effect with `value` (JSON text) as its result
+int32_t pex_engine_resume(Engine *engine, const char *value, uint32_t length) {
+    return settle(engine, [&] {
+        return engine->vm->resume(pex::parseJson(engine->vm->heap(), std::string_view(value, length)));
+    });
+}
+
+}  // extern "C"
@@ -0,0 +1,671 @@
+/**
+ * Built-in functions for the native PEX engine.
+ *
+ * Each builtin mirrors the TypeScript implementation in builtins.ts.
+ * Strings are stored as UTF-8 but indexed in UTF-16 code units like
+ * JavaScript; ASCII strings take a fast path where the two coincide.
+ */
+
+#include "builtins.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace pex {
+
+namespace {
+
+// =============================================================================
+// Helper Functions
+// =============================================================================
+
+void checkArity(const char* name, uint32_t argc, uint32_t expected) {
+  if (argc != expected) {
+    throw RuntimeError(std::string(name) + " expects " + std::to_string(expected) + " argument" +
+                       (expected != 1 ? "s" : "") + ", got " + std::to_string(argc));
+  }
+}
+
+void checkArity(const char* name, uint32_t argc, uint32_t min, uint32_t max) {
+  if (argc < min || argc > max) {
+    throw RuntimeError(std::string(name) + " expects " + std::to_string(min) + "-" + std::to_string(max) +
+                       " arguments, got " + std::to_string(argc));
+  }
+}
+
+void expectType(const char* name, Value value, ValueType expected, uint32_t argIndex) {
+  if (value.type() != expected) {
+    throw RuntimeError(std::string(name) + " expects " + typeName(expected) + " (argument " +
+                       std::to_string(argIndex + 1) + "), got " + typeName(value.type()));
+  }
+}
+
+Value makeString(Heap& heap, std::string_view text) { return heap.string(std::string(text)); }
+
+/** toString(value).value without copying when the value is already a string. */
+struct StringArg {
+  explicit StringArg(Value value) {
+    if (value.isString()) {
+      source = value.asString();
+      view = source->value;
+    } else {
+      owned = displayValue(value);
+      view = owned;
+    }
+  }
+
+  /** A string value for part of `view`, shared with the argument when it is a string. */
+  Value slice(Heap& heap, std::string_view part) const {
+    return source != nullptr ? heap.slice(source, part) : makeString(heap, part);
+  }
+
+  const StringObject* source = nullptr;
+  std::string owned;
+  std::string_view view;
+};
+
+// =============================================================================
+// Case mapping
+// =============================================================================
+
+// Covers ASCII, Latin-1, Latin Extended-A, basic Greek and Cyrillic. Code
+// points outside these blocks are left unchanged.
+
+void appendUpper(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp >= 'a' && cp <= 'z' ? cp - 32 : cp);
+    return;
+  }
+  if (cp == 0xDF) {  // sharp s
+    out += "SS";
+    return;
+  }
+  uint32_t mapped = cp;
+  if (cp == 0xB5) {
+    mapped = 0x39C;
+  } else if (cp >= 0xE0 && cp <= 0xFE && cp != 0xF7) {
+    mapped = cp - 0x20;
+  } else if (cp == 0xFF) {
+    mapped = 0x178;
+  } else if (cp == 0x131) {
+    mapped = 'I';
+  } else if (cp == 0x17F) {
+    mapped = 'S';
+  } else if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) {
+    mapped = cp & ~1u;
+  } else if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+    mapped = (cp & 1) ? cp : cp - 1;
+  } else if (cp == 0x3C2) {
+    mapped = 0x3A3;
+  } else if ((cp >= 0x3B1 && cp <= 0x3C1) || (cp >= 0x3C3 && cp <= 0x3CB)) {
+    mapped = cp - 0x20;
+  } else if (cp == 0x3AC) {
+    mapped = 0x386;
+  } else if (cp >= 0x3AD && cp <= 0x3AF) {
+    mapped = cp - 0x25;
+  } else if (cp == 0x3CC) {
+    mapped = 0x38C;
+  } else if (cp == 0x3CD || cp == 0x3CE) {
+    mapped = cp - 0x3F;
+  } else if (cp >= 0x430 && cp <= 0x44F) {
+    mapped = cp - 0x20;
+  } else if (cp >= 0x450 && cp <= 0x45F) {
+    mapped = cp - 0x50;
+  }
+  appendUtf8(out, mapped);
+}
+
+void appendLower(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp >= 'A' && cp <= 'Z' ? cp + 32 : cp);
+    return;
+  }
+  if (cp == 0x130) {  // dotted capital I lowers to i + combining dot
+    out += 'i';
+    appendUtf8(out, 0x307);
+    return;
+  }
+  uint32_t mapped = cp;
+  if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) {
+    mapped = cp + 0x20;
+  } else if (cp == 0x178) {
+    mapped = 0xFF;
+  } else if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) {
+    mapped = cp | 1u;
+  } else if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+    mapped = (cp & 1) ? cp + 1 : cp;
+  } else if ((cp >= 0x391 && cp <= 0x3A1) || (cp >= 0x3A3 && cp <= 0x3AB)) {
+    mapped = cp + 0x20;
+  } else if (cp == 0x386) {
+    mapped = 0x3AC;
+  } else if (cp >= 0x388 && cp <= 0x38A) {
+    mapped = cp + 0x25;
+  } else if (cp == 0x38C) {
+    mapped = 0x3CC;
+  } else if (cp == 0x38E || cp == 0x38F) {
+    mapped = cp + 0x3F;
+  } else if (cp >= 0x410 && cp <= 0x42F) {
+    mapped = cp + 0x20;
+  } else if (cp >= 0x400 && cp <= 0x40F) {
+    mapped = cp + 0x50;
+  }
+  appendUtf8(out, mapped);
+}
+
+bool isLetter(uint32_t cp) {
+  return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') || (cp >= 0xC0 && !isJsWhitespace(cp));
+}
+
+std::string toUpper(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t length;
+    uint32_t cp = decodeUtf8(text, pos, &length);
+    appendUpper(out, cp);
+    pos += length;
+  }
+  return out;
+}
+
+std::string toLower(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  size_t pos = 0;
+  uint32_t previous = 0;
+  while (pos < text.size()) {
+    size_t length;
+    uint32_t cp = decodeUtf8(text, pos, &length);
+    pos += length;
+    if (cp == 0x3A3) {
+      // Final sigma: a capital sigma ending a word lowers to U+03C2.
+      uint32_t next = 0;
+      if (pos < text.size()) {
+        size_t nextLength;
+        next = decodeUtf8(text, pos, &nextLength);
+      }
+      appendUtf8(out, isLetter(previous) && !isLetter(next) ? 0x3C2 : 0x3C3);
+    } else {
+      appendLower(out, cp);
+    }
+    previous = cp;
+  }
+  return out;
+}
+
+// =============================================================================
+// Replacement patterns (String.prototype.replace GetSubstitution)
+// =============================================================================
+
+using SvMatch = std::match_results<std::string_view::const_iterator>;
+using SvIterator = std::regex_iterator<std::string_view::const_iterator>;
+
+void appendSubstitution(std::string& out, std::string_view replacement, std::string_view subject,
+                        size_t position, size_t matchLength, const SvMatch* groups) {
+  size_t captureCount = groups != nullptr && groups->size() > 0 ? groups->size() - 1 : 0;
+  auto capture = [&](size_t n) {
+    const auto& group = (*groups)[n];
+    if (group.matched) out.append(group.first, group.second);
+  };
+
+  for (size_t i = 0; i < replacement.size(); i++) {
+    char c = replacement[i];
+    if (c != '$' || i + 1 >= replacement.size()) {
+      out += c;
+      continue;
+    }
+    char next = replacement[i + 1];
+    if (next == '$') {
+      out += '$';
+      i++;
+    } else if (next == '&') {
+      out.append(subject.substr(position, matchLength));
+      i++;
+    } else if (next == '`') {
+      out.append(subject.substr(0, position));
+      i++;
+    } else if (next == '\'') {
+      out.append(subject.substr(position + matchLength));
+      i++;
+    } else if (next >= '0' && next <= '9') {
+      size_t single = static_cast<size_t>(next - '0');
+      if (i + 2 < replacement.size() && replacement[i + 2] >= '0' && replacement[i + 2] <= '9') {
+        size_t twoDigit = single * 10 + static_cast<size_t>(replacement[i + 2] - '0');
+        if (twoDigit >= 1 && twoDigit <= captureCount) {
+          capture(twoDigit);
+          i += 2;
+          continue;
+        }
+      }
+      if (single >= 1 && single <= captureCount) {
+        capture(single);
+        i++;
+      } else {
+        out += '$';
+      }
+    } else {
+      out += '$';
+    }
+  }
+}
+
+const RegexObject* checkedRegex(Value value) {
+  const RegexObject* re = value.asRegex();
+  if (!re->valid) throw RuntimeError(re->error);
+  return re;
+}
+
+// Called before running std::regex (not a kernel) over `text`
+void checkRegexInput(const RegexObject* re, std::string_view text) {
+  if (text.size() > re->maxInput) {
+    throw RuntimeError("Input too long for /" + re->pattern + "/ in the native engine: " +
+                       std::to_string(text.size()) + " bytes (max " + std::to_string(re->maxInput) + ")");
+  }
+}
+
+// =============================================================================
+// String Operations
+// =============================================================================
+
+Value split(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("split", argc, 2, 3);
+  expectType("split", args[0], ValueType::String, 0);
+
+  const StringObject* str = args[0].asString();
+  std::string_view text = str->value;
+  StringArg delimiter(args[1]);
+  size_t limit = SIZE_MAX;
+  if (argc > 2) {
+    double n = toNumber(args[2]);
+    if (!std::isnan(n) && n > 0) limit = n >= 9e15 ? SIZE_MAX : static_cast<size_t>(std::floor(n));
+  }
+
+  auto* result = heap.make<ArrayObject>();
+  auto& parts = result->elements;
+  if (delimiter.view.empty()) {
+    // One element per code point; JavaScript would split astral characters
+    // into lone surrogates, which UTF-8 cannot represent.
+    size_t pos = 0;
+    while (pos < text.size() && parts.size() < limit) {
+      size_t length = 1;
+      if (!str->ascii) decodeUtf8(text, pos, &length);
+      parts.push_back(heap.slice(str, text.substr(pos, length)));
+      pos += length;
+    }
+  } else {
+    size_t start = 0;
+    while (parts.size() < limit) {
+      size_t found = text.find(delimiter.view, start);
+      if (found == std::string_view::npos) {
+        parts.push_back(heap.slice(str, text.substr(start)));
+        break;
+      }
+      parts.push_back(heap.slice(str, text.substr(start, found - start)));
+      start = found + delimiter.view.size();
+    }
+  }
+  return Value::array(result);
+}
+
+Value join(Heap& heap, const Value* args, uint32_t argc) {
+  if (argc == 1 && args[0].isString()) return args[0];
+  std::string out;
+  for (uint32_t i = 0; i < argc; i++) {
+    appendDisplay(out, args[i]);
+  }
+  return heap.string(std::move(out));
+}
+
+Value trim(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("trim", argc, 1);
+  StringArg str(args[0]);
+  return str.slice(heap, trimJsWhitespace(str.view));
+}
+
+Value upper(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("upper", argc, 1);
+  StringArg str(args[0]);
+  if (str.source != nullptr && str.source->ascii &&
+      std::none_of(str.view.begin(), str.view.end(), [](char c) { return c >= 'a' && c <= 'z'; })) {
+    return args[0];
+  }
+  return heap.string(toUpper(str.view));
+}
+
+Value lower(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("lower", argc, 1);
+  StringArg str(args[0]);
+  if (str.source != nullptr && str.source->ascii &&
+      std::none_of(str.view.begin(), str.view.end(), [](char c) { return c >= 'A' && c <= 'Z'; })) {
+    return args[0];
+  }
+  return heap.string(toLower(str.view));
+}
+
+Value replace(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("replace", argc, 3);
+  StringArg str(args[0]);
+  StringArg replacement(args[2]);
+  std::string_view text = str.view;
+  std::string out;
+
+  if (args[1].isRegex() && args[1].asRegex()->kernel.usable()) {
+    const RegexObject* re = args[1].asRegex();
+    size_t last = 0;
+    KernelMatch m;
+    while (re->kernel.find(text, last, &m)) {
+      out.append(text.substr(last, m.begin - last));
+      for (size_t unit = 0; unit < m.units; unit++) {
+        appendSubstitution(out, replacement.view, text, m.begin, m.end - m.begin, nullptr);
+      }
+      last = m.end;
+      if (!re->global) break;
+    }
+    if (last == 0 && out.empty()) return args[0].isString() ? args[0] : makeString(heap, text);
+    out.append(text.substr(last));
+  } else if (args[1].isRegex()) {
+    const RegexObject* re = checkedRegex(args[1]);
+    checkRegexInput(re, text);
+    size_t last = 0;
+    for (SvIterator it(text.begin(), text.end(), re->regex), end; it != end; ++it) {
+      const SvMatch& m = *it;
+      size_t position = static_cast<size_t>(m.position(0));
+      size_t length = static_cast<size_t>(m.length(0));
+      out.append(text.substr(last, position - last));
+      appendSubstitution(out, replacement.view, text, position, length, &m);
+      last = position + length;
+      if (!re->global) break;
+    }
+    out.append(text.substr(last));
+  } else {
+    StringArg search(args[1]);
+    size_t found = text.find(search.view);
+    if (found == std::string_view::npos) {
+      return args[0].isString() ? args[0] : makeString(heap, text);
+    }
+    out.append(text.substr(0, found));
+    appendSubstitution(out, replacement.view, text, found, search.view.size(), nullptr);
+    out.append(text.substr(found + search.view.size()));
+  }
+  return heap.string(std::move(out));
+}
+
+/** Clamp a JS substring() index: NaN -> 0, then into [0, length]. */
+size_t clampIndex(double index, size_t length) {
+  if (std::isnan(index) || index <= 0) return 0;
+  if (index >= static_cast<double>(length)) return length;
+  return static_cast<size_t>(index);
+}
+
+Value substring(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("substring", argc, 2, 3);
+  expectType("substring", args[0], ValueType::String, 0);
+
+  const StringObject* str = args[0].asString();
+  size_t length = str->ascii ? str->value.size() : utf16Length(str->value);
+  size_t start = clampIndex(std::floor(toNumber(args[1])), length);
+  size_t end = argc > 2 ? clampIndex(std::floor(toNumber(args[2])), length) : length;
+  if (start > end) std::swap(start, end);
+
+  if (str->ascii) return heap.slice(str, str->value.substr(start, end - start));
+  size_t from = utf16ToByteOffset(str->value, start);
+  size_t to = utf16ToByteOffset(str->value, end);
+  return heap.slice(str, str->value.substr(from, to - from));
+}
+
+Value len(Heap&, const Value* args, uint32_t argc) {
+  checkArity("len", argc, 1);
+  Value value = args[0];
+  if (value.isString()) {
+    const StringObject* str = value.asString();
+    return Value::number(static_cast<double>(str->ascii ? str->value.size() : utf16Length(str->value)));
+  }
+  if (value.isArray()) {
+    return Value::number(static_cast<double>(value.asArray()->elements.size()));
+  }
+  throw RuntimeError(std::string("len expects string or array, got ") + typeName(value.type()));
+}
+
+// =============================================================================
+// Type Conversion
+// =============================================================================
+
+Value toInt(Heap&, const Value* args, uint32_t argc) {
+  checkArity("int", argc, 1);
+  double num = toNumber(args[0]);
+  return Value::number(std::isnan(num) ? 0 : std::floor(num));
+}
+
+Value toFloat(Heap&, const Value* args, uint32_t argc) {
+  checkArity("float", argc, 1);
+  double num = toNumber(args[0]);
+  return Value::number(std::isnan(num) ? 0.0 : num);
+}
+
+Value toStringBuiltin(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("string", argc, 1);
+  if (args[0].isString()) return args[0];
+  return heap.string(displayValue(args[0]));
+}
+
+Value toBool(Heap&, const Value* args, uint32_t argc) {
+  checkArity("bool", argc, 1);
+  return Value::boolean(isTruthy(args[0]));
+}
+
+// =============================================================================
+// Array Operations
+// =============================================================================
+
+Value first(Heap&, const Value* args, uint32_t argc) {
+  checkArity("first", argc, 1);
+  expectType("first", args[0], ValueType::Array, 0);
+  const auto& elements = args[0].asArray()->elements;
+  return elements.empty() ? Value::null() : elements.front();
+}
+
+Value last(Heap&, const Value* args, uint32_t argc) {
+  checkArity("last", argc, 1);
+  expectType("last", args[0], ValueType::Array, 0);
+  const auto& elements = args[0].asArray()->elements;
+  return elements.empty() ? Value::null() : elements.back();
+}
+
+Value get(Heap&, const Value* args, uint32_t argc) {
+  checkArity("get", argc, 2, 3);
+  Value fallback = argc > 2 ? args[2] : Value::null();
+  if (args[0].isObject()) {
+    const Value* property = args[0].asObject()->find(StringArg(args[1]).view);
+    return property != nullptr ? *property : fallback;
+  }
+  if (!args[0].isArray()) {
+    throw RuntimeError(std::string("get expects array or object (argument 1), got ") + typeName(args[0].type()));
+  }
+  const auto& elements = args[0].asArray()->elements;
+  double index = std::floor(toNumber(args[1]));
+  if (!(index >= 0 && index < static_cast<double>(elements.size()))) return fallback;
+  return elements[static_cast<size_t>(index)];
+}
+
+// =============================================================================
+// Logic, Comparison, Math
+// =============================================================================
+
+Value notBuiltin(Heap&, const Value* args, uint32_t argc) {
+  checkArity("not", argc, 1);
+  return Value::boolean(!isTruthy(args[0]));
+}
+
+Value eq(Heap&, const Value* args, uint32_t argc) {
+  checkArity("==", argc, 2);
+  return Value::boolean(valuesEqual(args[0], args[1]));
+}
+
+Value ne(Heap&, const Value* args, uint32_t argc) {
+  checkArity("!=", argc, 2);
+  return Value::boolean(!valuesEqual(args[0], args[1]));
+}
+
+Value lt(Heap&, const Value* args, uint32_t argc) {
+  checkArity("<", argc, 2);
+  return Value::boolean(toNumber(args[0]) < toNumber(args[1]));
+}
+
+Value gt(Heap&, const Value* args, uint32_t argc) {
+  checkArity(">", argc, 2);
+  return Value::boolean(toNumber(args[0]) > toNumber(args[1]));
+}
+
+Value le(Heap&, const Value* args, uint32_t argc) {
+  checkArity("<=", argc, 2);
+  return Value::boolean(toNumber(args[0]) <= toNumber(args[1]));
+}
+
+Value ge(Heap&, const Value* args, uint32_t argc) {
+  checkArity(">=", argc, 2);
+  return Value::boolean(toNumber(args[0]) >= toNumber(args[1]));
+}
+
+Value add(Heap&, const Value* args, uint32_t argc) {
+  double sum = 0;
+  for (uint32_t i = 0; i < argc; i++) sum += toNumber(args[i]);
+  return Value::number(sum);
+}
+
+Value sub(Heap&, const Value* args, uint32_t argc) {
+  checkArity("-", argc, 2);
+  return Value::number(toNumber(args[0]) - toNumber(args[1]));
+}
+
+Value mul(Heap&, const Value* args, uint32_t argc) {
+  double product = 1;
+  for (uint32_t i = 0; i < argc; i++) product *= toNumber(args[i]);
+  return Value::number(product);
+}
+
+Value div(Heap&, const Value* args, uint32_t argc) {
+  checkArity("/", argc, 2);
+  double a = toNumber(args[0]);
+  double b = toNumber(args[1]);
+  if (b == 0) throw RuntimeError("Division by zero");
+  return Value::number(a / b);
+}
+
+Value mod(Heap&, const Value* args, uint32_t argc) {
+  checkArity("%", argc, 2);
+  return Value::number(std::fmod(toNumber(args[0]), toNumber(args[1])));
+}
+
+Value nullCoalesce(Heap&, const Value* args, uint32_t argc) {
+  checkArity("??", argc, 2);
+  return args[0].isNull() ? args[1] : args[0];
+}
+
+// =============================================================================
+// Regex Operations
+// =============================================================================
+
+Value match(Heap& heap, const Value* args, uint32_t argc) {
+  checkArity("match", argc, 2);
+  StringArg str(args[0]);
+  if (!args[1].isRegex()) throw RuntimeError("match expects a regex as second argument");
+  const RegexObject* re = checkedRegex(args[1]);
+  std::string_view text = str.view;
+
+  auto* result = heap.make<ArrayObject>();
+  if (re->kernel.usable()) {
+    KernelMatch m;
+    size_t from = 0;
+    while (re->kernel.find(text, from, &m)) {
+      result->elements.push_back(str.slice(heap, text.substr(m.begin, m.end - m.begin)));
+      from = m.end;
+      if (!re->global) break;
+    }
+    if (result->elements.empty()) return Value::null();
+    return Value::array(result);
+  }
+  checkRegexInput(re, text);
+  if (re->global) {
+    for (SvIterator it(text.begin(), text.end(), re->regex), end; it != end; ++it) {
+      result->elements.push_back(
+          str.slice(heap, text.substr(static_cast<size_t>(it->position(0)), static_cast<size_t>(it->length(0)))));
+    }
+    if (result->elements.empty()) return Value::null();
+    return Value::array(result);
+  }
+
+  SvMatch m;
+  if (!std::regex_search(text.begin(), text.end(), m, re->regex)) return Value::null();
+  for (size_t i = 0; i < m.size(); i++) {
+    // Unmatched groups are undefined in JavaScript; null is the closest value.
+    result->elements.push_back(
+        m[i].matched
+            ? str.slice(heap, text.substr(static_cast<size_t>(m.position(i)), static_cast<size_t>(m.length(i))))
+            : Value::null());
+  }
+  return Value::array(result);
+}
+
+Value test(Heap&, const Value* args, uint32_t argc) {
+  checkArity("test", argc, 2);
+  StringArg str(args[0]);
+  if (!args[1].isRegex()) throw RuntimeError("test expects a regex as second argument");
+  const RegexObject* re = checkedRegex(args[1]);
+  if (re->kernel.usable()) {
+    KernelMatch m;
+    return Value::boolean(re->kernel.find(str.view, 0, &m));
+  }
+  checkRegexInput(re, str.view);
+  return Value::boolean(std::regex_search(str.view.begin(), str.view.end(), re->regex));
+}
+
+}  // namespace
+
+Builtin findBuiltin(std::string_view name) {
+  static const std::unordered_map<std::string_view, Builtin> builtins = {
+      // String operations
+      {"split", split},
+      {"join", join},
+      {"trim", trim},
+      {"upper", upper},
+      {"lower", lower},
+      {"replace", replace},
+      {"substring", substring},
+      {"len", len},
+      // Type conversion
+      {"int", toInt},
+      {"float", toFloat},
+      {"string", toStringBuiltin},
+      {"bool", toBool},
+      // Array operations
+      {"first", first},
+      {"last", last},
+      {"get", get},
+      // Logic operations
+      {"not", notBuiltin},
+      // Comparison operations
+      {"==", eq},
+      {"!=", ne},
+      {"<", lt},
+      {">", gt},
+      {"<=", le},
+      {">=", ge},
+      // Math operations
+      {"+", add},
+      {"-", sub},
+      {"*", mul},
+      {"/", div},
+      {"%", mod},
+      // Null handling
+      {"??", nullCoalesce},
+      // Regex operations
+      {"match", match},
+      {"test", test},
+  };
+  auto it = builtins.find(name);
+  return it == builtins.end() ? nullptr : it->second;
+}
+
+}  // namespace pex
@@ -0,0 +1,42 @@
+/**
+ * Built-in functions for the native PEX engine.
+ *
+ * Native counterparts of packages/core/src/vm/builtins.ts with identical
+ * names, arity checks and error messages.
+ */
+
+#ifndef PEX_ENGINE_BUILTINS_H_
+#define PEX_ENGINE_BUILTINS_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "value.h"
+
+namespace pex {
+
+/**
+ * Runtime error raised by a builtin (VMRuntimeError). The VM rethrows it as
+ * a VMError carrying the current instruction pointer.
+ */
+class RuntimeError : public std::runtime_error {
+ public:
+  explicit RuntimeError(const std::string& message) : std::runtime_error(message) {}
+};
+
+/**
+ * Builtin signature. Arguments are a view into the operand stack and are
+ * only valid for the duration of the call.
+ */
+using Builtin = Value (*)(Heap& heap, const Value* args, uint32_t argc);
+
+/**
+ * Look up a builtin by name; returns nullptr for unknown names.
+ */
+Builtin findBuiltin(std::string_view name);
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_BUILTINS_H_
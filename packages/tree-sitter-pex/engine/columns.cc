@@ -0,0 +1,233 @@
+#include "columns.h"
+
+#include <limits>
+#include <string_view>
+#include <unordered_set>
+
+namespace pex {
+
+namespace {
+
+size_t bitmapBytes(size_t length) { return (length + 7) / 8; }
+
+void setBit(std::vector<uint8_t>& bitmap, size_t row) { bitmap[row >> 3] |= static_cast<uint8_t>(1u << (row & 7)); }
+
+std::string rowsLabel(const Column& column) {
+  return std::string(columnTypeName(column.type)) + " column of " + std::to_string(column.length) + " rows";
+}
+
+void requireLength(const Column& column, const char* buffer, size_t have, size_t need) {
+  if (have < need) {
+    throw ColumnError(std::string(buffer) + " of a " + rowsLabel(column) + " needs " + std::to_string(need) +
+                      " entries, got " + std::to_string(have));
+  }
+}
+
+/**
+ * Collects results into an OutputColumn. Rows before the first non-null
+ * result are null in whatever type the column ends up with.
+ */
+class ColumnBuilder {
+ public:
+  explicit ColumnBuilder(size_t length) : valid_(bitmapBytes(length), 0) { out_.length = length; }
+
+  void append(size_t row, Value value) {
+    if (value.isNull()) {
+      nulls_++;
+      if (out_.type == ColumnType::String) endString();
+      return;
+    }
+
+    ColumnType type = typeOf(value, row);
+    if (out_.type == ColumnType::Null) {
+      start(type, row);
+    } else if (type != out_.type) {
+      throw ColumnError("Row " + std::to_string(row) + " returned a " + columnTypeName(type) + " in a " +
+                            columnTypeName(out_.type) + " column",
+                        row);
+    }
+
+    setBit(valid_, row);
+    switch (type) {
+      case ColumnType::Number:
+        out_.numbers[row] = value.asNumber();
+        break;
+      case ColumnType::Boolean:
+        if (value.asBoolean()) setBit(out_.bits, row);
+        break;
+      case ColumnType::String: {
+        std::string_view text = value.asString()->value;
+        out_.data.insert(out_.data.end(), text.begin(), text.end());
+        endString();
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  OutputColumn finish() {
+    if (nulls_ > 0 && out_.type != ColumnType::Null) out_.validity = std::move(valid_);
+    return std::move(out_);
+  }
+
+ private:
+  static ColumnType typeOf(Value value, size_t row) {
+    switch (value.type()) {
+      case ValueType::Boolean:
+        return ColumnType::Boolean;
+      case ValueType::Number:
+        return ColumnType::Number;
+      case ValueType::String:
+        return ColumnType::String;
+      default:
+        throw ColumnError("Row " + std::to_string(row) + " returned a value of type " + typeName(value.type()) +
+                              ", which a column cannot hold",
+                          row);
+    }
+  }
+
+  void start(ColumnType type, size_t row) {
+    out_.type = type;
+    switch (type) {
+      case ColumnType::Number:
+        out_.numbers.assign(out_.length, 0.0);
+        break;
+      case ColumnType::Boolean:
+        out_.bits.assign(bitmapBytes(out_.length), 0);
+        break;
+      case ColumnType::String:
+        // Every earlier row is an empty null string
+        out_.offsets.reserve(out_.length + 1);
+        out_.offsets.assign(row + 1, 0);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void endString() {
+    if (out_.data.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      throw ColumnError("String column data exceeds 2 GiB");
+    }
+    out_.offsets.push_back(static_cast<int32_t>(out_.data.size()));
+  }
+
+  OutputColumn out_;
+  std::vector<uint8_t> valid_;
+  size_t nulls_ = 0;
+};
+
+}  // namespace
+
+const char* columnTypeName(ColumnType type) {
+  switch (type) {
+    case ColumnType::Null:
+      return "null";
+    case ColumnType::Boolean:
+      return "boolean";
+    case ColumnType::Number:
+      return "number";
+    case ColumnType::String:
+      return "string";
+    case ColumnType::Struct:
+      return "struct";
+  }
+  return "null";
+}
+
+void validateColumn(const Column& column) {
+  if (column.validity != nullptr) {
+    requireLength(column, "Validity bitmap", column.validityBytes, bitmapBytes(column.length));
+  }
+
+  switch (column.type) {
+    case ColumnType::Null:
+      break;
+    case ColumnType::Boolean:
+      requireLength(column, "Value bitmap", column.bitBytes, bitmapBytes(column.length));
+      break;
+    case ColumnType::Number:
+      requireLength(column, "Values", column.numberCount, column.length);
+      break;
+    case ColumnType::String: {
+      requireLength(column, "Offsets", column.offsetCount, column.length + 1);
+      int32_t previous = 0;
+      for (size_t row = 0; row <= column.length; row++) {
+        int32_t offset = column.offsets[row];
+        if (offset < previous || static_cast<size_t>(offset) > column.dataLength) {
+          throw ColumnError("String offsets must be ascending and within the data buffer (offset " +
+                                std::to_string(row) + ")",
+                            row);
+        }
+        previous = offset;
+      }
+      break;
+    }
+    case ColumnType::Struct: {
+      std::unordered_set<std::string_view> names;
+      for (const auto& field : column.fields) {
+        if (!names.insert(field.first).second) {
+          throw ColumnError("Duplicate struct field \"" + field.first + "\"");
+        }
+        if (field.second.length < column.length) {
+          throw ColumnError("Field \"" + field.first + "\" of a " + rowsLabel(column) + " has only " +
+                            std::to_string(field.second.length) + " rows");
+        }
+        validateColumn(field.second);
+      }
+      break;
+    }
+  }
+}
+
+Value columnValue(Heap& heap, const Column& column, size_t row) {
+  if (!column.isValid(row)) return Value::null();
+
+  switch (column.type) {
+    case ColumnType::Null:
+      return Value::null();
+    case ColumnType::Boolean:
+      return Value::boolean(((column.bits[row >> 3] >> (row & 7)) & 1) != 0);
+    case ColumnType::Number:
+      return Value::number(column.numbers[row]);
+    case ColumnType::String: {
+      int32_t begin = column.offsets[row];
+      return heap.borrow(std::string_view(column.data + begin, static_cast<size_t>(column.offsets[row + 1] - begin)));
+    }
+    case ColumnType::Struct: {
+      auto* object = heap.make<ObjectObject>();
+      object->properties.reserve(column.fields.size());
+      for (const auto& field : column.fields) {
+        object->properties.emplace_back(field.first, columnValue(heap, field.second, row));
+      }
+      return Value::object(object);
+    }
+  }
+  return Value::null();
+}
+
+OutputColumn runColumns(VM& vm, const Column& input) {
+  validateColumn(input);
+
+  ColumnBuilder builder(input.length);
+  try {
+    for (size_t row = 0; row < input.length; row++) {
+      vm.reset();
+      if (vm.run(columnValue(vm.heap(), input, row)) == RunStatus::Suspended) {
+        throw ColumnError("Row " + std::to_string(row) + " performed effect \"" + vm.effectName() +
+                              "\", but columnar runs cannot suspend",
+                          row);
+      }
+      builder.append(row, vm.result());
+    }
+  } catch (...) {
+    // The heap borrows from the input buffers, which the host may free
+    vm.reset();
+    throw;
+  }
+  vm.reset();
+  return builder.finish();
+}
+
+}  // namespace pex
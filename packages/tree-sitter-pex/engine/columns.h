@@ -0,0 +1,131 @@
+/**
+ * Columnar batch input and output for the native PEX engine.
+ *
+ * Columns use the Apache Arrow layouts: numbers are a buffer of doubles,
+ * booleans and validity are bitmaps (least significant bit first, 1 means
+ * set), and strings are `length + 1` int32 offsets into a UTF-8 data buffer.
+ * A struct column is a set of named child columns of the same length.
+ *
+ * Each row of the input column is run as `$$` without converting the column
+ * first: numbers and booleans become scalars, strings borrow their bytes
+ * from the data buffer, and struct rows become objects of their fields.
+ * Results are written straight into the buffers of the output column.
+ */
+
+#ifndef PEX_ENGINE_COLUMNS_H_
+#define PEX_ENGINE_COLUMNS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "value.h"
+#include "vm.h"
+
+namespace pex {
+
+enum class ColumnType : uint8_t {
+  Null,
+  Boolean,
+  Number,
+  String,
+  Struct,
+};
+
+/**
+ * Column type name as used by the JS bindings ("number", "string", ...).
+ */
+const char* columnTypeName(ColumnType type);
+
+/**
+ * Error raised for a column whose buffers are inconsistent, or for results
+ * that do not fit in a column. `row` is the row at fault, if any.
+ */
+class ColumnError : public std::runtime_error {
+ public:
+  explicit ColumnError(const std::string& message) : std::runtime_error(message), hasRow_(false), row_(0) {}
+  ColumnError(const std::string& message, size_t row) : std::runtime_error(message), hasRow_(true), row_(row) {}
+
+  bool hasRow() const { return hasRow_; }
+  size_t row() const { return row_; }
+
+ private:
+  bool hasRow_;
+  size_t row_;
+};
+
+/**
+ * A read-only view of an input column. The buffers belong to the host and
+ * must outlive every value read from the column.
+ */
+struct Column {
+  ColumnType type = ColumnType::Null;
+  size_t length = 0;
+
+  // Validity bitmap of ceil(length / 8) bytes, or nullptr if no row is null
+  const uint8_t* validity = nullptr;
+  size_t validityBytes = 0;
+
+  // Number: `length` doubles
+  const double* numbers = nullptr;
+  size_t numberCount = 0;
+
+  // Boolean: bitmap of ceil(length / 8) bytes
+  const uint8_t* bits = nullptr;
+  size_t bitBytes = 0;
+
+  // String: `length + 1` offsets into `data`
+  const int32_t* offsets = nullptr;
+  size_t offsetCount = 0;
+  const char* data = nullptr;
+  size_t dataLength = 0;
+
+  // Struct: children in property order
+  std::vector<std::pair<std::string, Column>> fields;
+
+  bool isValid(size_t row) const { return validity == nullptr || ((validity[row >> 3] >> (row & 7)) & 1) != 0; }
+};
+
+/**
+ * Check that every buffer of `column` (and of its children) covers its
+ * length and that string offsets stay within the data buffer, so rows can
+ * then be read without bounds checks.
+ * @throws ColumnError naming the first problem found
+ */
+void validateColumn(const Column& column);
+
+/**
+ * Row `row` of a validated column as a value on `heap`.
+ */
+Value columnValue(Heap& heap, const Column& column, size_t row);
+
+/**
+ * An output column. Its type is taken from the first non-null result; every
+ * other result must be null or of the same type. `validity` is empty when no
+ * row is null.
+ */
+struct OutputColumn {
+  ColumnType type = ColumnType::Null;
+  size_t length = 0;
+  std::vector<uint8_t> validity;
+  std::vector<double> numbers;
+  std::vector<uint8_t> bits;
+  std::vector<int32_t> offsets;
+  std::vector<uint8_t> data;
+};
+
+/**
+ * Run the program on `vm` once per row of `input`, collecting the results.
+ * The VM is reset before every row, as in a batch.
+ * @throws VMError from a failing row
+ * @throws ColumnError for an invalid input column, a row that performs an
+ *   effect (rows cannot be suspended), or a result a column cannot hold
+ */
+OutputColumn runColumns(VM& vm, const Column& input);
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_COLUMNS_H_
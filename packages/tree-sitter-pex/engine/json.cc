@@ -0,0 +1,309 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace pex {
+
+namespace {
+
+// Deepest nesting of arrays and objects parseJson() accepts
+constexpr size_t kMaxJsonDepth = 1000;
+
+class JsonParser {
+ public:
+  JsonParser(Heap& heap, std::string_view text) : heap_(heap), text_(text) {}
+
+  Value parse() {
+    Value value = parseValue(0);
+    skipWhitespace();
+    if (pos_ < text_.size()) fail("Unexpected character after JSON value");
+    return value;
+  }
+
+ private:
+  [[noreturn]] void fail(const std::string& message) const {
+    throw JsonError(message + " at offset " + std::to_string(pos_), pos_);
+  }
+
+  void skipWhitespace() {
+    while (pos_ < text_.size()) {
+      char c = text_[pos_];
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+      pos_++;
+    }
+  }
+
+  bool consume(char expected) {
+    skipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == expected) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char expected) {
+    if (!consume(expected)) fail(std::string("Expected '") + expected + "'");
+  }
+
+  bool literal(std::string_view word) {
+    if (text_.substr(pos_, word.size()) != word) return false;
+    pos_ += word.size();
+    return true;
+  }
+
+  Value parseValue(size_t depth) {
+    skipWhitespace();
+    if (pos_ >= text_.size()) fail("Unexpected end of JSON input");
+
+    char c = text_[pos_];
+    if (c == '{' || c == '[') {
+      if (depth >= kMaxJsonDepth) fail("JSON nested too deeply");
+      return c == '{' ? parseObject(depth + 1) : parseArray(depth + 1);
+    }
+    if (c == '"') return heap_.string(parseString());
+    if (c == '-' || (c >= '0' && c <= '9')) return parseNumber();
+    if (literal("true")) return Value::boolean(true);
+    if (literal("false")) return Value::boolean(false);
+    if (literal("null")) return Value::null();
+    fail("Unexpected character in JSON");
+  }
+
+  Value parseObject(size_t depth) {
+    pos_++;
+    auto* object = heap_.make<ObjectObject>();
+    if (consume('}')) return Value::object(object);
+    do {
+      skipWhitespace();
+      if (pos_ >= text_.size() || text_[pos_] != '"') fail("Expected a property name");
+      std::string key = parseString();
+      expect(':');
+      object->set(std::move(key), parseValue(depth));
+    } while (consume(','));
+    expect('}');
+    return Value::object(object);
+  }
+
+  Value parseArray(size_t depth) {
+    pos_++;
+    auto* array = heap_.make<ArrayObject>();
+    if (consume(']')) return Value::array(array);
+    do {
+      array->elements.push_back(parseValue(depth));
+    } while (consume(','));
+    expect(']');
+    return Value::array(array);
+  }
+
+  Value parseNumber() {
+    size_t start = pos_;
+    auto digits = [&] {
+      size_t first = pos_;
+      while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') pos_++;
+      if (pos_ == first) fail("Expected a digit");
+    };
+
+    if (text_[pos_] == '-') pos_++;
+    if (pos_ < text_.size() && text_[pos_] == '0') {
+      pos_++;
+    } else {
+      digits();
+    }
+    if (pos_ < text_.size() && text_[pos_] == '.') {
+      pos_++;
+      digits();
+    }
+    if (pos_ < text_.size() && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+      pos_++;
+      if (pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-')) pos_++;
+      digits();
+    }
+    return Value::number(stringToNumber(text_.substr(start, pos_ - start)));
+  }
+
+  uint32_t hex4() {
+    if (pos_ + 4 > text_.size()) fail("Bad Unicode escape in JSON string");
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; i++) {
+      char c = text_[pos_++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= static_cast<uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        value |= static_cast<uint32_t>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        value |= static_cast<uint32_t>(c - 'A' + 10);
+      } else {
+        pos_--;
+        fail("Bad Unicode escape in JSON string");
+      }
+    }
+    return value;
+  }
+
+  std::string parseString() {
+    pos_++;
+    std::string out;
+    for (;;) {
+      if (pos_ >= text_.size()) fail("Unterminated string in JSON");
+      char c = text_[pos_];
+      if (c == '"') {
+        pos_++;
+        return out;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) fail("Bad control character in JSON string");
+      if (c != '\\') {
+        out += c;
+        pos_++;
+        continue;
+      }
+
+      pos_++;
+      if (pos_ >= text_.size()) fail("Unterminated string in JSON");
+      char escape = text_[pos_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out += escape;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          uint32_t unit = hex4();
+          if (unit >= 0xD800 && unit < 0xDC00 && text_.substr(pos_, 2) == "\\u") {
+            size_t low = pos_;
+            pos_ += 2;
+            uint32_t next = hex4();
+            if (next >= 0xDC00 && next < 0xE000) {
+              unit = 0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00);
+            } else {
+              pos_ = low;
+            }
+          }
+          // Strings are UTF-8, which cannot hold unpaired surrogates
+          appendUtf8(out, unit >= 0xD800 && unit < 0xE000 ? 0xFFFD : unit);
+          break;
+        }
+        default:
+          pos_--;
+          fail("Bad escaped character in JSON string");
+      }
+    }
+  }
+
+  Heap& heap_;
+  std::string_view text_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+Value parseJson(Heap& heap, std::string_view text) { return JsonParser(heap, text).parse(); }
+
+void appendJson(std::string& out, Value value) {
+  switch (value.type()) {
+    case ValueType::Null:
+      out += "null";
+      break;
+    case ValueType::Boolean:
+      out += value.asBoolean() ? "true" : "false";
+      break;
+    case ValueType::Number:
+      out += std::isfinite(value.asNumber()) ? numberToString(value.asNumber()) : "null";
+      break;
+    case ValueType::String:
+      appendJsonString(out, value.asString()->value);
+      break;
+    case ValueType::Array: {
+      out += '[';
+      bool first = true;
+      for (Value element : value.asArray()->elements) {
+        if (!first) out += ',';
+        first = false;
+        appendJson(out, element);
+      }
+      out += ']';
+      break;
+    }
+    case ValueType::Object: {
+      out += '{';
+      bool first = true;
+      for (const auto& entry : value.asObject()->properties) {
+        if (!first) out += ',';
+        first = false;
+        appendJsonString(out, entry.first);
+        out += ':';
+        appendJson(out, entry.second);
+      }
+      out += '}';
+      break;
+    }
+    case ValueType::Regex:
+    case ValueType::Closure:
+      appendJsonString(out, displayValue(value));
+      break;
+  }
+}
+
+void appendJsonString(std::string& out, std::string_view text) {
+  static const char kHex[] = "0123456789abcdef";
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += "\\u00";
+          out += kHex[(c >> 4) & 0xF];
+          out += kHex[c & 0xF];
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+std::string toJson(Value value) {
+  std::string out;
+  appendJson(out, value);
+  return out;
+}
+
+}  // namespace pex
@@ -0,0 +1,56 @@
+/**
+ * JSON conversion for engine values, matching valueFromJSON() and
+ * valueToJSON() in packages/core/src/vm/values.ts.
+ *
+ * Hosts that cannot hand values over as objects (the WebAssembly build)
+ * pass inputs and results as JSON text instead. Objects keep the key order
+ * of the text (JSON.parse() would move integer-like keys first); a repeated
+ * key keeps its first position and its last value. Results that JSON
+ * cannot hold become what valueToJSON() makes of them: non-finite numbers
+ * are null, and regexes and closures are their display strings.
+ */
+
+#ifndef PEX_ENGINE_JSON_H_
+#define PEX_ENGINE_JSON_H_
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "value.h"
+
+namespace pex {
+
+/**
+ * Error raised for malformed JSON text. `offset` is the byte offset of the
+ * problem.
+ */
+class JsonError : public std::runtime_error {
+ public:
+  JsonError(const std::string& message, size_t offset) : std::runtime_error(message), offset_(offset) {}
+
+  size_t offset() const { return offset_; }
+
+ private:
+  size_t offset_;
+};
+
+/**
+ * Parse JSON text into a value on `heap`.
+ * @throws JsonError for malformed or too deeply nested text
+ */
+Value parseJson(Heap& heap, std::string_view text);
+
+/**
+ * JSON text of a value.
+ */
+std::string toJson(Value value);
+void appendJson(std::string& out, Value value);
+
+/** Append `text` as a JSON string literal. */
+void appendJsonString(std::string& out, std::string_view text);
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_JSON_H_
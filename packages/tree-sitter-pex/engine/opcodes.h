@@ -0,0 +1,289 @@
+/**
+ * Opcode numbering for the native PEX engine.
+ *
+ * Must stay in sync with the Opcode enum in
+ * packages/core/src/bytecode/opcodes.ts. The top two bits of an opcode give
+ * its operand width: 0x00-0x3F none, 0x40-0x7F u8, 0x80-0xBF u16,
+ * 0xC0-0xFF u32 (all little-endian).
+ */
+
+#ifndef PEX_ENGINE_OPCODES_H_
+#define PEX_ENGINE_OPCODES_H_
+
+#include <cstdint>
+
+namespace pex {
+
+enum Opcode : uint8_t {
+  // Stack operations
+  OP_NOP = 0x00,
+  OP_POP = 0x01,
+  OP_DUP = 0x02,
+  OP_SWAP = 0x03,
+
+  // Constants
+  OP_CONST_NULL = 0x10,
+  OP_CONST_TRUE = 0x11,
+  OP_CONST_FALSE = 0x12,
+  OP_CONST_ZERO = 0x13,
+  OP_CONST_ONE = 0x14,
+  OP_CONST_U8 = 0x40,
+  OP_CONST_U16 = 0x80,
+  OP_CONST_U32 = 0xc0,
+
+  // Variables
+  OP_LOAD_LOCAL_U8 = 0x41,
+  OP_STORE_LOCAL_U8 = 0x42,
+  OP_LOAD_UPVALUE_U8 = 0x43,
+  OP_STORE_UPVALUE_U8 = 0x44,
+  OP_LOAD_LOCAL_U16 = 0x81,
+  OP_STORE_LOCAL_U16 = 0x82,
+  OP_LOAD_UPVALUE_U16 = 0x83,
+  OP_STORE_UPVALUE_U16 = 0x84,
+  OP_LOAD_LOCAL_U32 = 0xc1,
+  OP_STORE_LOCAL_U32 = 0xc2,
+  OP_LOAD_UPVALUE_U32 = 0xc3,
+  OP_STORE_UPVALUE_U32 = 0xc4,
+
+  // Arithmetic
+  OP_ADD = 0x20,
+  OP_SUB = 0x21,
+  OP_MUL = 0x22,
+  OP_DIV = 0x23,
+  OP_MOD = 0x24,
+  OP_NEG = 0x25,
+
+  // Comparison
+  OP_EQ = 0x26,
+  OP_NE = 0x27,
+  OP_LT = 0x28,
+  OP_GT = 0x29,
+  OP_LE = 0x2a,
+  OP_GE = 0x2b,
+
+  // Logic
+  OP_NOT = 0x2c,
+  OP_NULL_COALESCE = 0x2d,
+
+  // Control flow
+  OP_JUMP_U8 = 0x45,
+  OP_JUMP_IF_FALSE_U8 = 0x46,
+  OP_JUMP_IF_TRUE_U8 = 0x47,
+  OP_JUMP_U16 = 0x85,
+  OP_JUMP_IF_FALSE_U16 = 0x86,
+  OP_JUMP_IF_TRUE_U16 = 0x87,
+  OP_JUMP_U32 = 0xc5,
+  OP_JUMP_IF_FALSE_U32 = 0xc6,
+  OP_JUMP_IF_TRUE_U32 = 0xc7,
+
+  // Functions
+  OP_MAKE_CLOSURE_U8 = 0x48,
+  OP_CALL_U8 = 0x49,
+  OP_TAIL_CALL_U8 = 0x4a,
+  OP_RETURN = 0x30,
+  OP_MAKE_CLOSURE_U16 = 0x88,
+  OP_CALL_U16 = 0x89,
+  OP_TAIL_CALL_U16 = 0x8a,
+  OP_MAKE_CLOSURE_U32 = 0xc8,
+  OP_CALL_U32 = 0xc9,
+  OP_TAIL_CALL_U32 = 0xca,
+
+  // Builtins (name index operand, then u8 argument count)
+  OP_CALL_BUILTIN_U8_U8 = 0x4b,
+  OP_CALL_BUILTIN_U16_U8 = 0x8b,
+  OP_CALL_BUILTIN_U32_U8 = 0xcb,
+
+  // Effects (name index operand, then u8 argument count)
+  OP_EFFECT_U8_U8 = 0x4d,
+  OP_EFFECT_U16_U8 = 0x8d,
+  OP_EFFECT_U32_U8 = 0xcd,
+
+  // Arrays
+  OP_MAKE_ARRAY_U8 = 0x4f,
+  OP_GET_INDEX = 0x31,
+  OP_MAKE_ARRAY_U16 = 0x8f,
+  OP_MAKE_ARRAY_U32 = 0xcf,
+
+  // Superinstructions (produced by the peephole optimizer, u8 only)
+  OP_TEE_LOCAL_U8 = 0x58,
+  OP_LOAD_LOCAL_CALL_BUILTIN_U8 = 0x59,  // local index, name index, argument count
+  OP_EQ_JUMP_IF_FALSE_U8 = 0x5a,
+  OP_NE_JUMP_IF_FALSE_U8 = 0x5b,
+  OP_LT_JUMP_IF_FALSE_U8 = 0x5c,
+  OP_GT_JUMP_IF_FALSE_U8 = 0x5d,
+  OP_LE_JUMP_IF_FALSE_U8 = 0x5e,
+  OP_GE_JUMP_IF_FALSE_U8 = 0x5f,
+};
+
+/**
+ * Total instruction size: opcode, operand, then any trailing u8 operands.
+ */
+inline uint32_t instructionSize(uint8_t opcode) {
+  static const uint32_t kOperandSize[] = {0, 1, 2, 4};
+  uint32_t size = 1 + kOperandSize[opcode >> 6];
+  switch (opcode) {
+    case OP_CALL_BUILTIN_U8_U8:
+    case OP_CALL_BUILTIN_U16_U8:
+    case OP_CALL_BUILTIN_U32_U8:
+    case OP_EFFECT_U8_U8:
+    case OP_EFFECT_U16_U8:
+    case OP_EFFECT_U32_U8:
+      return size + 1;
+    case OP_LOAD_LOCAL_CALL_BUILTIN_U8:
+      return size + 2;
+    default:
+      return size;
+  }
+}
+
+/**
+ * Operations of pre-decoded instructions (see Instruction in program.h).
+ * Operand widths are folded away, so each operation has one entry; the
+ * last three mark malformed code and the end of a function.
+ */
+#define PEX_DECODED_OPS(X)   \
+  X(NOP)                     \
+  X(POP)                     \
+  X(DUP)                     \
+  X(SWAP)                    \
+  X(CONST_NULL)              \
+  X(CONST_TRUE)              \
+  X(CONST_FALSE)             \
+  X(CONST_ZERO)              \
+  X(CONST_ONE)               \
+  X(CONST)                   \
+  X(LOAD_LOCAL)              \
+  X(STORE_LOCAL)             \
+  X(LOAD_UPVALUE)            \
+  X(STORE_UPVALUE)           \
+  X(ADD)                     \
+  X(SUB)                     \
+  X(MUL)                     \
+  X(DIV)                     \
+  X(MOD)                     \
+  X(NEG)                     \
+  X(EQ)                      \
+  X(NE)                      \
+  X(LT)                      \
+  X(GT)                      \
+  X(LE)                      \
+  X(GE)                      \
+  X(NOT)                     \
+  X(NULL_COALESCE)           \
+  X(JUMP)                    \
+  X(JUMP_IF_FALSE)           \
+  X(JUMP_IF_TRUE)            \
+  X(MAKE_CLOSURE)            \
+  X(CALL)                    \
+  X(TAIL_CALL)               \
+  X(RETURN)                  \
+  X(CALL_BUILTIN)            \
+  X(EFFECT)                  \
+  X(MAKE_ARRAY)              \
+  X(GET_INDEX)               \
+  X(TEE_LOCAL)               \
+  X(LOAD_LOCAL_CALL_BUILTIN) \
+  X(EQ_JUMP_IF_FALSE)        \
+  X(NE_JUMP_IF_FALSE)        \
+  X(LT_JUMP_IF_FALSE)        \
+  X(GT_JUMP_IF_FALSE)        \
+  X(LE_JUMP_IF_FALSE)        \
+  X(GE_JUMP_IF_FALSE)        \
+  X(UNKNOWN)                 \
+  X(TRUNCATED)               \
+  X(END)
+
+enum DecodedOp : uint8_t {
+#define PEX_DECODED_OP_ENUM(name) DOP_##name,
+  PEX_DECODED_OPS(PEX_DECODED_OP_ENUM)
+#undef PEX_DECODED_OP_ENUM
+  kDecodedOpCount
+};
+
+/**
+ * Decoded operation for an opcode byte; DOP_UNKNOWN if it is not valid.
+ */
+inline DecodedOp decodedOp(uint8_t opcode) {
+  switch (opcode) {
+    case OP_NOP: return DOP_NOP;
+    case OP_POP: return DOP_POP;
+    case OP_DUP: return DOP_DUP;
+    case OP_SWAP: return DOP_SWAP;
+    case OP_CONST_NULL: return DOP_CONST_NULL;
+    case OP_CONST_TRUE: return DOP_CONST_TRUE;
+    case OP_CONST_FALSE: return DOP_CONST_FALSE;
+    case OP_CONST_ZERO: return DOP_CONST_ZERO;
+    case OP_CONST_ONE: return DOP_CONST_ONE;
+    case OP_CONST_U8:
+    case OP_CONST_U16:
+    case OP_CONST_U32: return DOP_CONST;
+    case OP_LOAD_LOCAL_U8:
+    case OP_LOAD_LOCAL_U16:
+    case OP_LOAD_LOCAL_U32: return DOP_LOAD_LOCAL;
+    case OP_STORE_LOCAL_U8:
+    case OP_STORE_LOCAL_U16:
+    case OP_STORE_LOCAL_U32: return DOP_STORE_LOCAL;
+    case OP_LOAD_UPVALUE_U8:
+    case OP_LOAD_UPVALUE_U16:
+    case OP_LOAD_UPVALUE_U32: return DOP_LOAD_UPVALUE;
+    case OP_STORE_UPVALUE_U8:
+    case OP_STORE_UPVALUE_U16:
+    case OP_STORE_UPVALUE_U32: return DOP_STORE_UPVALUE;
+    case OP_ADD: return DOP_ADD;
+    case OP_SUB: return DOP_SUB;
+    case OP_MUL: return DOP_MUL;
+    case OP_DIV: return DOP_DIV;
+    case OP_MOD: return DOP_MOD;
+    case OP_NEG: return DOP_NEG;
+    case OP_EQ: return DOP_EQ;
+    case OP_NE: return DOP_NE;
+    case OP_LT: return DOP_LT;
+    case OP_GT: return DOP_GT;
+    case OP_LE: return DOP_LE;
+    case OP_GE: return DOP_GE;
+    case OP_NOT: return DOP_NOT;
+    case OP_NULL_COALESCE: return DOP_NULL_COALESCE;
+    case OP_JUMP_U8:
+    case OP_JUMP_U16:
+    case OP_JUMP_U32: return DOP_JUMP;
+    case OP_JUMP_IF_FALSE_U8:
+    case OP_JUMP_IF_FALSE_U16:
+    case OP_JUMP_IF_FALSE_U32: return DOP_JUMP_IF_FALSE;
+    case OP_JUMP_IF_TRUE_U8:
+    case OP_JUMP_IF_TRUE_U16:
+    case OP_JUMP_IF_TRUE_U32: return DOP_JUMP_IF_TRUE;
+    case OP_MAKE_CLOSURE_U8:
+    case OP_MAKE_CLOSURE_U16:
+    case OP_MAKE_CLOSURE_U32: return DOP_MAKE_CLOSURE;
+    case OP_CALL_U8:
+    case OP_CALL_U16:
+    case OP_CALL_U32: return DOP_CALL;
+    case OP_TAIL_CALL_U8:
+    case OP_TAIL_CALL_U16:
+    case OP_TAIL_CALL_U32: return DOP_TAIL_CALL;
+    case OP_RETURN: return DOP_RETURN;
+    case OP_CALL_BUILTIN_U8_U8:
+    case OP_CALL_BUILTIN_U16_U8:
+    case OP_CALL_BUILTIN_U32_U8: return DOP_CALL_BUILTIN;
+    case OP_EFFECT_U8_U8:
+    case OP_EFFECT_U16_U8:
+    case OP_EFFECT_U32_U8: return DOP_EFFECT;
+    case OP_MAKE_ARRAY_U8:
+    case OP_MAKE_ARRAY_U16:
+    case OP_MAKE_ARRAY_U32: return DOP_MAKE_ARRAY;
+    case OP_GET_INDEX: return DOP_GET_INDEX;
+    case OP_TEE_LOCAL_U8: return DOP_TEE_LOCAL;
+    case OP_LOAD_LOCAL_CALL_BUILTIN_U8: return DOP_LOAD_LOCAL_CALL_BUILTIN;
+    case OP_EQ_JUMP_IF_FALSE_U8: return DOP_EQ_JUMP_IF_FALSE;
+    case OP_NE_JUMP_IF_FALSE_U8: return DOP_NE_JUMP_IF_FALSE;
+    case OP_LT_JUMP_IF_FALSE_U8: return DOP_LT_JUMP_IF_FALSE;
+    case OP_GT_JUMP_IF_FALSE_U8: return DOP_GT_JUMP_IF_FALSE;
+    case OP_LE_JUMP_IF_FALSE_U8: return DOP_LE_JUMP_IF_FALSE;
+    case OP_GE_JUMP_IF_FALSE_U8: return DOP_GE_JUMP_IF_FALSE;
+    default: return DOP_UNKNOWN;
+  }
+}
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_OPCODES_H_
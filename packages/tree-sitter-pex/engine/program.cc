@@ -0,0 +1,396 @@
+/**
+ * Bytecode loader for the native PEX engine.
+ *
+ * Error messages match BytecodeReadError messages from reader.ts so the
+ * native and TypeScript loaders reject the same inputs the same way.
+ */
+
+#include "program.h"
+
+#include <cstring>
+
+#include "opcodes.h"
+
+namespace pex {
+
+namespace {
+
+enum ConstantType : uint8_t {
+  kConstNull = 0x00,
+  kConstTrue = 0x01,
+  kConstFalse = 0x02,
+  kConstInt32 = 0x03,
+  kConstFloat64 = 0x04,
+  kConstString = 0x05,
+  kConstRegex = 0x06,
+};
+
+/**
+ * Little-endian reader with bounds checking.
+ */
+class BinaryReader {
+ public:
+  BinaryReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  size_t offset() const { return offset_; }
+  size_t remaining() const { return size_ - offset_; }
+
+  uint8_t readU8() {
+    ensureBytes(1);
+    return data_[offset_++];
+  }
+
+  uint32_t readU32() {
+    ensureBytes(4);
+    uint32_t value = static_cast<uint32_t>(data_[offset_]) |
+                     (static_cast<uint32_t>(data_[offset_ + 1]) << 8) |
+                     (static_cast<uint32_t>(data_[offset_ + 2]) << 16) |
+                     (static_cast<uint32_t>(data_[offset_ + 3]) << 24);
+    offset_ += 4;
+    return value;
+  }
+
+  int32_t readI32() { return static_cast<int32_t>(readU32()); }
+
+  double readF64() {
+    ensureBytes(8);
+    uint64_t bits = 0;
+    for (int i = 7; i >= 0; i--) {
+      bits = (bits << 8) | data_[offset_ + static_cast<size_t>(i)];
+    }
+    offset_ += 8;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  std::string readString() {
+    uint32_t length = readU32();
+    ensureBytes(length);
+    size_t start = offset_;
+    if (!validUtf8(data_ + start, length)) {
+      throw LoadError("Invalid UTF-8 string at offset " + std::to_string(start), start);
+    }
+    offset_ += length;
+    return std::string(reinterpret_cast<const char*>(data_ + start), length);
+  }
+
+  const uint8_t* readBytes(size_t length) {
+    ensureBytes(length);
+    const uint8_t* bytes = data_ + offset_;
+    offset_ += length;
+    return bytes;
+  }
+
+ private:
+  void ensureBytes(size_t count) const {
+    if (remaining() < count) {
+      throw LoadError("Unexpected end of bytecode: need " + std::to_string(count) +
+                          " bytes, have " + std::to_string(remaining()),
+                      offset_);
+    }
+  }
+
+  static bool validUtf8(const uint8_t* bytes, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+      uint8_t c = bytes[i];
+      size_t extra;
+      uint32_t cp;
+      if (c < 0x80) {
+        i++;
+        continue;
+      } else if ((c & 0xE0) == 0xC0) {
+        extra = 1;
+        cp = c & 0x1F;
+      } else if ((c & 0xF0) == 0xE0) {
+        extra = 2;
+        cp = c & 0x0F;
+      } else if ((c & 0xF8) == 0xF0) {
+        extra = 3;
+        cp = c & 0x07;
+      } else {
+        return false;
+      }
+      if (i + extra >= length) return false;
+      for (size_t j = 1; j <= extra; j++) {
+        if ((bytes[i + j] & 0xC0) != 0x80) return false;
+        cp = (cp << 6) | (bytes[i + j] & 0x3F);
+      }
+      static const uint32_t kMinimum[] = {0, 0x80, 0x800, 0x10000};
+      if (cp < kMinimum[extra] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+      i += extra + 1;
+    }
+    return true;
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+std::string hex(uint32_t value) {
+  static const char* digits = "0123456789abcdef";
+  if (value == 0) return "0";
+  std::string out;
+  while (value != 0) {
+    out.insert(out.begin(), digits[value & 0xF]);
+    value >>= 4;
+  }
+  return out;
+}
+
+bool isJump(DecodedOp op) {
+  switch (op) {
+    case DOP_JUMP:
+    case DOP_JUMP_IF_FALSE:
+    case DOP_JUMP_IF_TRUE:
+    case DOP_EQ_JUMP_IF_FALSE:
+    case DOP_NE_JUMP_IF_FALSE:
+    case DOP_LT_JUMP_IF_FALSE:
+    case DOP_GT_JUMP_IF_FALSE:
+    case DOP_LE_JUMP_IF_FALSE:
+    case DOP_GE_JUMP_IF_FALSE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Decode the instruction at `ip` into out[ip], queueing its jump target.
+ * Returns the offset of the next instruction, or `length` if decoding
+ * stops here. Malformed instructions decode to DOP_UNKNOWN (operand: the
+ * opcode byte) or DOP_TRUNCATED (operand: the offset of the failing read),
+ * with the error ips the interpreter reports.
+ */
+uint32_t decodeInstruction(const uint8_t* code, uint32_t length, uint32_t ip, Instruction* out,
+                           std::vector<uint32_t>& pending) {
+  Instruction& insn = out[ip];
+  uint8_t opcode = code[ip];
+  DecodedOp op = decodedOp(opcode);
+  if (op == DOP_UNKNOWN) {
+    insn = Instruction{DOP_UNKNOWN, 0, 0, opcode, ip + 1};
+    return length;
+  }
+
+  static const uint32_t kOperandSize[] = {0, 1, 2, 4};
+  uint32_t width = kOperandSize[opcode >> 6];
+  uint32_t at = ip + 1;
+  if (at + width > length) {
+    insn = Instruction{DOP_TRUNCATED, 0, 0, at, ip};
+    return length;
+  }
+  uint32_t operand = 0;
+  for (uint32_t i = 0; i < width; i++) operand |= static_cast<uint32_t>(code[at + i]) << (8 * i);
+  at += width;
+
+  uint32_t end = ip + instructionSize(opcode);
+  if (end > length) {
+    insn = Instruction{DOP_TRUNCATED, 0, 0, length, ip};
+    return length;
+  }
+  uint8_t extra1 = at < end ? code[at] : 0;
+  uint8_t extra2 = at + 1 < end ? code[at + 1] : 0;
+
+  if (isJump(op)) {
+    int32_t offset;
+    switch (opcode >> 6) {
+      case 1:
+        offset = static_cast<int8_t>(operand);
+        break;
+      case 2:
+        offset = static_cast<int16_t>(operand);
+        break;
+      default:
+        offset = static_cast<int32_t>(operand);
+        break;
+    }
+    operand = static_cast<uint32_t>(static_cast<int64_t>(end) + offset);
+    if (operand < length) pending.push_back(operand);
+  }
+
+  insn = Instruction{static_cast<uint8_t>(op), extra1, extra2, operand, end};
+  return end;
+}
+
+/**
+ * Decode a function's code into out[0..length], which starts as DOP_END.
+ * Only offsets execution can reach are decoded: the entry, every
+ * instruction that follows a decoded one, and every jump target.
+ */
+void decodeFunction(const uint8_t* code, uint32_t length, Instruction* out) {
+  std::vector<uint32_t> pending{0};
+  std::vector<bool> visited(length, false);
+  while (!pending.empty()) {
+    uint32_t ip = pending.back();
+    pending.pop_back();
+    while (ip < length && !visited[ip]) {
+      visited[ip] = true;
+      ip = decodeInstruction(code, length, ip, out, pending);
+    }
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<Program> Program::load(const uint8_t* data, size_t size) {
+  BinaryReader reader(data, size);
+  std::unique_ptr<Program> program(new Program());
+
+  // Header
+  uint32_t magic = reader.readU32();
+  if (magic != kMagicNumber) {
+    throw LoadError("Invalid magic number: expected 0x" + hex(kMagicNumber) + ", got 0x" + hex(magic),
+                    reader.offset() - 4);
+  }
+  uint8_t versionMajor = reader.readU8();
+  uint8_t versionMinor = reader.readU8();
+  if (versionMajor != kVersionMajor) {
+    throw LoadError("Incompatible bytecode version: expected " + std::to_string(kVersionMajor) +
+                        ".x, got " + std::to_string(versionMajor) + "." + std::to_string(versionMinor),
+                    reader.offset() - 2);
+  }
+  uint8_t flags = reader.readU8();
+  reader.readU8();  // reserved
+  program->entryPoint_ = reader.readU32();
+  reader.readU32();  // constant pool offset; sections are laid out back to back
+
+  // Constant pool
+  uint32_t constantCount = reader.readU32();
+  program->constants_.reserve(constantCount);
+  for (uint32_t i = 0; i < constantCount; i++) {
+    uint8_t type = reader.readU8();
+    switch (type) {
+      case kConstNull:
+        program->constants_.push_back(Value::null());
+        break;
+      case kConstTrue:
+        program->constants_.push_back(Value::boolean(true));
+        break;
+      case kConstFalse:
+        program->constants_.push_back(Value::boolean(false));
+        break;
+      case kConstInt32:
+        program->constants_.push_back(Value::number(reader.readI32()));
+        break;
+      case kConstFloat64:
+        program->constants_.push_back(Value::number(reader.readF64()));
+        break;
+      case kConstString:
+        program->constants_.push_back(program->heap_.string(reader.readString()));
+        break;
+      case kConstRegex: {
+        std::string pattern = reader.readString();
+        std::string regexFlags = reader.readString();
+        program->constants_.push_back(
+            Value::regex(program->heap_.make<RegexObject>(std::move(pattern), std::move(regexFlags))));
+        break;
+      }
+      default:
+        throw LoadError("Unknown constant type: " + std::to_string(type), reader.offset() - 1);
+    }
+  }
+
+  // Name table
+  uint32_t nameCount = reader.readU32();
+  program->names_.reserve(nameCount);
+  for (uint32_t i = 0; i < nameCount; i++) {
+    program->names_.push_back(reader.readString());
+  }
+
+  // Function templates
+  uint32_t templateCount = reader.readU32();
+  program->templates_.reserve(templateCount);
+  for (uint32_t i = 0; i < templateCount; i++) {
+    FunctionTemplate fn;
+    fn.nameIndex = reader.readI32();
+    fn.paramCount = reader.readU32();
+    fn.localCount = reader.readU32();
+    uint32_t upvalueCount = reader.readU32();
+    fn.upvalues.reserve(upvalueCount);
+    for (uint32_t j = 0; j < upvalueCount; j++) {
+      UpvalueSpec spec;
+      spec.isLocal = reader.readU8() != 0;
+      spec.index = reader.readU32();
+      fn.upvalues.push_back(spec);
+    }
+    fn.codeOffset = reader.readU32();
+    fn.codeLength = reader.readU32();
+    program->templates_.push_back(std::move(fn));
+  }
+
+  // Code section
+  uint32_t codeLength = reader.readU32();
+  const uint8_t* code = reader.readBytes(codeLength);
+  program->code_.assign(code, code + codeLength);
+
+  for (size_t i = 0; i < program->templates_.size(); i++) {
+    const FunctionTemplate& fn = program->templates_[i];
+    std::string prefix = "Function template " + std::to_string(i) + ": ";
+    if (fn.codeOffset >= codeLength) {
+      throw LoadError(prefix + "invalid code offset " + std::to_string(fn.codeOffset) +
+                          " (code section length: " + std::to_string(codeLength) + ")",
+                      reader.offset());
+    }
+    if (static_cast<uint64_t>(fn.codeOffset) + fn.codeLength > codeLength) {
+      throw LoadError(prefix + "invalid code length " + std::to_string(fn.codeLength) +
+                          " (offset: " + std::to_string(fn.codeOffset) +
+                          ", code section length: " + std::to_string(codeLength) + ")",
+                      reader.offset());
+    }
+    if (fn.paramCount > fn.localCount) {
+      throw LoadError(prefix + "param count (" + std::to_string(fn.paramCount) +
+                          ") exceeds local count (" + std::to_string(fn.localCount) + ")",
+                      reader.offset());
+    }
+  }
+
+  // Pre-decode every function so execution never decodes operands
+  size_t instructionCount = 0;
+  for (FunctionTemplate& fn : program->templates_) {
+    fn.instructionOffset = static_cast<uint32_t>(instructionCount);
+    instructionCount += static_cast<size_t>(fn.codeLength) + 1;
+  }
+  program->instructions_.resize(instructionCount);
+  for (const FunctionTemplate& fn : program->templates_) {
+    Instruction* out = program->instructions_.data() + fn.instructionOffset;
+    for (uint32_t ip = 0; ip <= fn.codeLength; ip++) out[ip] = Instruction{DOP_END, 0, 0, 0, ip};
+    decodeFunction(program->code_.data() + fn.codeOffset, fn.codeLength, out);
+  }
+
+  if (program->entryPoint_ >= program->templates_.size()) {
+    throw LoadError("Invalid entry point: " + std::to_string(program->entryPoint_) +
+                        " (function template count: " + std::to_string(program->templates_.size()) + ")",
+                    reader.offset());
+  }
+
+  // Debug info is only validated; the engine reports errors by ip.
+  if ((flags & kFlagHasDebugInfo) != 0) {
+    if (reader.remaining() == 0) {
+      throw LoadError("Header indicates debug info, but no data remaining", reader.offset());
+    }
+    uint32_t functionCount = reader.readU32();
+    for (uint32_t i = 0; i < functionCount; i++) {
+      reader.readU32();  // function index
+      uint32_t localNameCount = reader.readU32();
+      for (uint32_t j = 0; j < localNameCount; j++) reader.readString();
+      uint32_t instructionCount = reader.readU32();
+      reader.readBytes(static_cast<size_t>(instructionCount) * 12);
+    }
+  }
+
+  if (reader.remaining() > 0) {
+    throw LoadError("Unexpected trailing data: " + std::to_string(reader.remaining()) + " bytes remaining",
+                    reader.offset());
+  }
+
+  return program;
+}
+
+const std::string* Program::templateName(const FunctionTemplate& fn) const {
+  if (fn.nameIndex < 0 || static_cast<size_t>(fn.nameIndex) >= names_.size()) return nullptr;
+  return &names_[static_cast<size_t>(fn.nameIndex)];
+}
+
+}  // namespace pex
@@ -0,0 +1,109 @@
+/**
+ * Loaded bytecode program for the native PEX engine.
+ *
+ * Parses the binary layout produced by writeBytecode() in
+ * packages/core/src/bytecode/writer.ts (header, constant pool, name table,
+ * function templates, code section, optional debug info) and applies the
+ * same validation as readBytecode().
+ */
+
+#ifndef PEX_ENGINE_PROGRAM_H_
+#define PEX_ENGINE_PROGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "value.h"
+
+namespace pex {
+
+constexpr uint32_t kMagicNumber = 0x50455842;  // "PEXB"
+constexpr uint8_t kVersionMajor = 1;
+constexpr uint8_t kFlagHasDebugInfo = 0x01;
+
+/**
+ * Error raised when a bytecode buffer is malformed (BytecodeReadError).
+ */
+class LoadError : public std::runtime_error {
+ public:
+  LoadError(const std::string& message, size_t offset)
+      : std::runtime_error(message), offset_(offset) {}
+
+  size_t offset() const { return offset_; }
+
+ private:
+  size_t offset_;
+};
+
+struct UpvalueSpec {
+  bool isLocal;
+  uint32_t index;
+};
+
+struct FunctionTemplate {
+  int32_t nameIndex;
+  uint32_t paramCount;
+  uint32_t localCount;
+  std::vector<UpvalueSpec> upvalues;
+  uint32_t codeOffset;
+  uint32_t codeLength;
+  // Start of the function's entries in Program::instructions()
+  uint32_t instructionOffset;
+};
+
+/**
+ * Pre-decoded instruction (decode.ts in packages/core). Each function's
+ * code becomes one entry per byte offset, so ips stay byte offsets, plus a
+ * DOP_END entry at its length. Offsets that execution cannot reach are
+ * left as DOP_END.
+ */
+struct Instruction {
+  uint8_t op;      // DecodedOp
+  uint8_t extra1;  // Trailing u8 operands (argument counts, name index)
+  uint8_t extra2;
+  uint32_t operand;  // Widened operand; absolute target for jumps
+  uint32_t next;     // Offset of the following instruction
+};
+
+/**
+ * Immutable, fully validated program. Constants are decoded once into
+ * values on the program's own heap, so regexes are compiled a single time
+ * and string constants are shared between runs.
+ */
+class Program {
+ public:
+  static std::unique_ptr<Program> load(const uint8_t* data, size_t size);
+
+  uint32_t entryPoint() const { return entryPoint_; }
+  const std::vector<Value>& constants() const { return constants_; }
+  const std::vector<std::string>& names() const { return names_; }
+  const std::vector<FunctionTemplate>& templates() const { return templates_; }
+  const std::vector<uint8_t>& code() const { return code_; }
+
+  /** Decoded code of a function, indexed by byte offset. */
+  const Instruction* instructions(const FunctionTemplate& fn) const {
+    return instructions_.data() + fn.instructionOffset;
+  }
+
+  /** Name of a template, or nullptr when anonymous. */
+  const std::string* templateName(const FunctionTemplate& fn) const;
+
+ private:
+  Program() = default;
+
+  uint32_t entryPoint_ = 0;
+  Heap heap_;
+  std::vector<Value> constants_;
+  std::vector<std::string> names_;
+  std::vector<FunctionTemplate> templates_;
+  std::vector<uint8_t> code_;
+  std::vector<Instruction> instructions_;
+};
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_PROGRAM_H_
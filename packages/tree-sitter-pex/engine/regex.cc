@@ -0,0 +1,274 @@
+/**
+ * Scanning kernels for simple regexes.
+ *
+ * Accepts exactly the patterns packages/core/src/vm/regex.ts accepts, so
+ * both engines take a kernel for the same programs.
+ */
+
+#include "regex.h"
+
+#include "value.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pex {
+
+namespace {
+
+/** Characters with a meaning of their own outside a class */
+constexpr std::string_view kSyntaxChars = "\\^$.|?*+()[]{}";
+
+/** Punctuation that may be escaped to stand for itself */
+constexpr std::string_view kEscapableChars = "^$\\.*+?()[]{}|/-";
+
+/**
+ * A character class under construction: an ASCII bitmap, whether `\s`
+ * (which also covers non-ASCII whitespace) was included, and negation.
+ */
+struct CharSet {
+  std::array<bool, 128> ascii{};
+  bool spaces = false;
+  bool negated = false;
+
+  void addRange(int from, int to) {
+    for (int c = from; c <= to; c++) ascii[static_cast<size_t>(c)] = true;
+  }
+
+  /** Add the class named by `\d`, `\w` or `\s`. Returns false otherwise. */
+  bool addEscape(char letter) {
+    switch (letter) {
+      case 'd':
+        addRange('0', '9');
+        return true;
+      case 'w':
+        addRange('0', '9');
+        addRange('A', 'Z');
+        addRange('a', 'z');
+        ascii['_'] = true;
+        return true;
+      case 's':
+        addRange('\t', '\r');
+        ascii[' '] = true;
+        spaces = true;
+        return true;
+      default:
+        return false;
+    }
+  }
+};
+
+/** The byte an escape such as `\.` or `\t` stands for, or -1. */
+int escapedByte(std::string_view pattern, size_t i) {
+  if (i >= pattern.size()) return -1;
+  char letter = pattern[i];
+  if (kEscapableChars.find(letter) != std::string_view::npos) return static_cast<unsigned char>(letter);
+  switch (letter) {
+    case 'n':
+      return '\n';
+    case 'r':
+      return '\r';
+    case 't':
+      return '\t';
+    case 'f':
+      return '\f';
+    case 'v':
+      return '\v';
+    default:
+      return -1;
+  }
+}
+
+/** The text a pattern of only literal characters matches; false otherwise. */
+bool parseLiteral(std::string_view pattern, std::string* literal) {
+  for (size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (c == '\\') {
+      int byte = escapedByte(pattern, i + 1);
+      if (byte < 0) return false;
+      *literal += static_cast<char>(byte);
+      i++;
+    } else if (kSyntaxChars.find(c) != std::string_view::npos) {
+      return false;
+    } else {
+      *literal += c;
+    }
+  }
+  return !literal->empty();
+}
+
+/** The ASCII byte of a literal or escaped character inside a class, or -1. */
+int classByte(std::string_view pattern, size_t i) {
+  if (i >= pattern.size()) return -1;
+  int byte = pattern[i] == '\\' ? escapedByte(pattern, i + 1) : static_cast<unsigned char>(pattern[i]);
+  return byte < 128 ? byte : -1;
+}
+
+/**
+ * Parse one class atom (`\d`, `\D`, `\w`, `\W`, `\s`, `\S` or `[...]`) at
+ * the start of `pattern`, returning the offset after it, or npos.
+ */
+size_t parseClass(std::string_view pattern, CharSet* set) {
+  constexpr size_t kFail = std::string_view::npos;
+  if (pattern.empty()) return kFail;
+
+  if (pattern[0] == '\\') {
+    if (pattern.size() < 2) return kFail;
+    char letter = pattern[1];
+    bool upper = letter >= 'A' && letter <= 'Z';
+    if (!set->addEscape(upper ? static_cast<char>(letter - 'A' + 'a') : letter)) return kFail;
+    set->negated = upper;
+    return 2;
+  }
+  if (pattern[0] != '[') return kFail;
+
+  size_t i = 1;
+  if (i < pattern.size() && pattern[i] == '^') {
+    set->negated = true;
+    i++;
+  }
+
+  size_t count = 0;
+  while (i < pattern.size() && pattern[i] != ']') {
+    if (pattern[i] == '\\' && i + 1 < pattern.size() && set->addEscape(pattern[i + 1])) {
+      i += 2;
+      count++;
+      continue;
+    }
+
+    int from = classByte(pattern, i);
+    if (from < 0) return kFail;
+    i += pattern[i] == '\\' ? 2 : 1;
+
+    if (i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']') {
+      int to = classByte(pattern, i + 1);
+      if (to < 0 || to < from) return kFail;
+      i += pattern[i + 1] == '\\' ? 3 : 2;
+      set->addRange(from, to);
+    } else {
+      set->addRange(from, from);
+    }
+    count++;
+  }
+
+  if (i >= pattern.size() || count == 0) return kFail;
+  return i + 1;
+}
+
+}  // namespace
+
+RegexKernel RegexKernel::compile(std::string_view pattern, std::string_view flags) {
+  RegexKernel kernel;
+  if (!flags.empty() && flags != "g") return kernel;
+
+  if (parseLiteral(pattern, &kernel.literal_)) {
+    kernel.kind_ = Kind::Literal;
+    return kernel;
+  }
+  kernel.literal_.clear();
+
+  CharSet set;
+  size_t end = parseClass(pattern, &set);
+  if (end == std::string_view::npos) return kernel;
+  bool repeat = end < pattern.size() && pattern[end] == '+';
+  if (end + (repeat ? 1 : 0) != pattern.size()) return kernel;
+
+  kernel.kind_ = Kind::Class;
+  kernel.repeat_ = repeat;
+  kernel.otherMembers_ = set.negated;
+  kernel.spaceMembers_ = set.spaces != set.negated;
+  for (size_t c = 0; c < 128; c++) {
+    kernel.members_[c] = set.ascii[c] != set.negated;
+  }
+
+  // Collect member bytes as ranges; classes with too many use the scalar scan
+  kernel.vectorScan_ = true;
+  for (size_t c = 0; c < 128; c++) {
+    if (!kernel.members_[c] || (c > 0 && kernel.members_[c - 1])) continue;
+    if (kernel.rangeCount_ == kMaxRanges) {
+      kernel.vectorScan_ = false;
+      break;
+    }
+    size_t last = c;
+    while (last + 1 < 128 && kernel.members_[last + 1]) last++;
+    kernel.rangeLow_[kernel.rangeCount_] = static_cast<uint8_t>(c);
+    kernel.rangeHigh_[kernel.rangeCount_] = static_cast<uint8_t>(last);
+    kernel.rangeCount_++;
+  }
+  return kernel;
+}
+
+bool RegexKernel::find(std::string_view text, size_t from, KernelMatch* match) const {
+  if (kind_ == Kind::Literal) {
+    size_t found = text.find(literal_, from);
+    if (found == std::string_view::npos) return false;
+    *match = {found, found + literal_.size(), 1};
+    return true;
+  }
+
+  size_t pos = skip(text, from);
+  while (pos < text.size()) {
+    size_t length = 1;
+    uint32_t cp = static_cast<unsigned char>(text[pos]);
+    if (cp >= 0x80) cp = decodeUtf8(text, pos, &length);
+    if (!isMember(cp)) {
+      pos = skip(text, pos + length);
+      continue;
+    }
+
+    size_t end = pos + length;
+    if (repeat_) {
+      while (end < text.size()) {
+        size_t nextLength = 1;
+        uint32_t next = static_cast<unsigned char>(text[end]);
+        if (next >= 0x80) next = decodeUtf8(text, end, &nextLength);
+        if (!isMember(next)) break;
+        end += nextLength;
+      }
+    }
+    *match = {pos, end, !repeat_ && cp > 0xFFFF ? 2u : 1u};
+    return true;
+  }
+  return false;
+}
+
+bool RegexKernel::isMember(uint32_t cp) const {
+  if (cp < 128) return members_[cp];
+  return isJsWhitespace(cp) ? spaceMembers_ : otherMembers_;
+}
+
+size_t RegexKernel::skip(std::string_view text, size_t from) const {
+  // Any non-ASCII lead byte may start a member when some non-ASCII is in the class
+  const bool highCandidates = otherMembers_ || spaceMembers_;
+  const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+  size_t pos = from;
+
+#if defined(__SSE2__)
+  if (vectorScan_) {
+    const __m128i zero = _mm_setzero_si128();
+    while (pos + 16 <= text.size()) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + pos));
+      __m128i hits = zero;
+      for (size_t r = 0; r < rangeCount_; r++) {
+        // chunk - low <= high - low, unsigned; bytes >= 0x80 fall outside every range
+        __m128i offset = _mm_sub_epi8(chunk, _mm_set1_epi8(static_cast<char>(rangeLow_[r])));
+        __m128i width = _mm_set1_epi8(static_cast<char>(rangeHigh_[r] - rangeLow_[r]));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_max_epu8(offset, width), width));
+      }
+      int mask = _mm_movemask_epi8(hits);
+      if (highCandidates) mask |= _mm_movemask_epi8(chunk);
+      if (mask != 0) return pos + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+      pos += 16;
+    }
+  }
+#endif
+
+  for (; pos < text.size(); pos++) {
+    unsigned char byte = bytes[pos];
+    if (byte < 0x80 ? members_[byte] : highCandidates) return pos;
+  }
+  return pos;
+}
+
+}  // namespace pex
@@ -0,0 +1,73 @@
+/**
+ * Scanning kernels for simple regexes in the native PEX engine.
+ *
+ * Mirrors packages/core/src/vm/regex.ts: a literal substring or a single,
+ * optionally repeated, character class (`/\D/g`, `/[ \t]+/g`) is matched by
+ * scanning the UTF-8 bytes directly instead of running std::regex. Class
+ * scans test 16 bytes at a time with SSE2 where it is available.
+ *
+ * A kernel is classified once, when the program's regex constants are
+ * loaded, and holds no per-match state.
+ */
+
+#ifndef PEX_ENGINE_REGEX_H_
+#define PEX_ENGINE_REGEX_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace pex {
+
+/** One match found by RegexKernel::find(), as byte offsets. */
+struct KernelMatch {
+  size_t begin;
+  size_t end;
+  /**
+   * UTF-16 code units covered. JavaScript matches a class without `+`
+   * once per code unit, so an astral character counts as two matches;
+   * UTF-8 cannot split it, so callers repeat the whole character.
+   */
+  size_t units;
+};
+
+class RegexKernel {
+ public:
+  enum class Kind : uint8_t { None, Literal, Class };
+
+  /** Classify a pattern. The kernel is Kind::None when std::regex is needed. */
+  static RegexKernel compile(std::string_view pattern, std::string_view flags);
+
+  Kind kind() const { return kind_; }
+  bool usable() const { return kind_ != Kind::None; }
+
+  /** Find the first match starting at or after byte `from`. */
+  bool find(std::string_view text, size_t from, KernelMatch* match) const;
+
+ private:
+  static constexpr size_t kMaxRanges = 6;
+
+  bool isMember(uint32_t codePoint) const;
+  /** First byte at or after `from` that may start a match. */
+  size_t skip(std::string_view text, size_t from) const;
+
+  Kind kind_ = Kind::None;
+  std::string literal_;
+  std::array<bool, 128> members_{};
+  /** Non-ASCII code points that are not whitespace are members */
+  bool otherMembers_ = false;
+  /** Non-ASCII whitespace is a member */
+  bool spaceMembers_ = false;
+  bool repeat_ = false;
+  /** Member ASCII bytes as inclusive ranges, for the vector scan */
+  std::array<uint8_t, kMaxRanges> rangeLow_{};
+  std::array<uint8_t, kMaxRanges> rangeHigh_{};
+  size_t rangeCount_ = 0;
+  bool vectorScan_ = false;
+};
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_REGEX_H_
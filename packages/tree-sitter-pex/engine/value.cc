@@ -0,0 +1,504 @@
+/**
+ * Value helpers for the native PEX engine.
+ *
+ * Everything here has to agree with the JavaScript semantics used by the
+ * TypeScript VM (values.ts), in particular String(number), Number(string)
+ * and UTF-16 string lengths.
+ */
+
+#include "value.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace pex {
+
+const char* typeName(ValueType type) {
+  switch (type) {
+    case ValueType::Null:
+      return "null";
+    case ValueType::Boolean:
+      return "boolean";
+    case ValueType::Number:
+      return "number";
+    case ValueType::String:
+      return "string";
+    case ValueType::Array:
+      return "array";
+    case ValueType::Object:
+      return "object";
+    case ValueType::Regex:
+      return "regex";
+    case ValueType::Closure:
+      return "closure";
+  }
+  return "unknown";
+}
+
+// =============================================================================
+// Heap payloads
+// =============================================================================
+
+static bool isAscii(std::string_view text) {
+  for (unsigned char c : text) {
+    if (c >= 0x80) return false;
+  }
+  return true;
+}
+
+StringObject::StringObject(std::string text) : owned(std::move(text)), value(owned), ascii(isAscii(value)) {}
+
+StringObject::StringObject(const StringObject& parent, std::string_view slice)
+    : value(slice), ascii(parent.ascii || isAscii(slice)) {}
+
+StringObject::StringObject(Borrowed, std::string_view bytes) : value(bytes), ascii(isAscii(bytes)) {}
+
+const Value* ObjectObject::find(std::string_view key) const {
+  for (const auto& entry : properties) {
+    if (entry.first == key) return &entry.second;
+  }
+  return nullptr;
+}
+
+void ObjectObject::set(std::string key, Value value) {
+  for (auto& entry : properties) {
+    if (entry.first == key) {
+      entry.second = value;
+      return;
+    }
+  }
+  properties.emplace_back(std::move(key), value);
+}
+
+static std::regex::flag_type regexSyntax(std::string_view flags) {
+  std::regex::flag_type syntax = std::regex::ECMAScript;
+  if (flags.find('i') != std::string_view::npos) syntax |= std::regex::icase;
+  if (flags.find('m') != std::string_view::npos) syntax |= std::regex::multiline;
+  return syntax;
+}
+
+// Stack std::regex may use for one match. Node runs workers on 4 MiB
+// stacks and the wasm build on its own 4 MiB, so this leaves half for the
+// caller.
+static constexpr size_t kRegexStackBudget = 2 * 1024 * 1024;
+
+// Stack per input character at a given group nesting depth: measured at
+// about 400 bytes plus 300 per level with libstdc++, with a margin
+static size_t regexStackPerChar(std::string_view pattern) {
+  size_t depth = 0;
+  size_t maxDepth = 0;
+  bool inClass = false;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (c == '\\') {
+      i++;
+    } else if (inClass) {
+      inClass = c != ']';
+    } else if (c == '[') {
+      inClass = true;
+    } else if (c == '(') {
+      maxDepth = std::max(maxDepth, ++depth);
+    } else if (c == ')' && depth > 0) {
+      depth--;
+    }
+  }
+  return 640 + 480 * maxDepth;
+}
+
+RegexObject::RegexObject(std::string source, std::string flagText)
+    : pattern(std::move(source)),
+      flags(std::move(flagText)),
+      kernel(RegexKernel::compile(pattern, flags)),
+      global(flags.find('g') != std::string::npos),
+      valid(true),
+      maxInput(kRegexStackBudget / regexStackPerChar(pattern)) {
+  try {
+    regex.assign(pattern, regexSyntax(flags));
+  } catch (const std::regex_error& e) {
+    valid = false;
+    error = "Invalid regular expression: /" + pattern + "/: " + e.what();
+  }
+}
+
+// =============================================================================
+// Truthiness, equality, coercion
+// =============================================================================
+
+bool isTruthy(Value value) {
+  switch (value.type()) {
+    case ValueType::Null:
+      return false;
+    case ValueType::Boolean:
+      return value.asBoolean();
+    case ValueType::Number:
+      return value.asNumber() != 0 && !std::isnan(value.asNumber());
+    case ValueType::String:
+      return !value.asString()->value.empty();
+    default:
+      return true;
+  }
+}
+
+bool valuesEqual(Value a, Value b) {
+  if (a.type() != b.type()) return false;
+
+  switch (a.type()) {
+    case ValueType::Null:
+      return true;
+    case ValueType::Boolean:
+      return a.asBoolean() == b.asBoolean();
+    case ValueType::Number:
+      return a.asNumber() == b.asNumber();
+    case ValueType::String:
+      return a.asString() == b.asString() || a.asString()->value == b.asString()->value;
+    case ValueType::Regex:
+      return a.asRegex()->pattern == b.asRegex()->pattern &&
+             a.asRegex()->flags == b.asRegex()->flags;
+    case ValueType::Array: {
+      const auto& left = a.asArray()->elements;
+      const auto& right = b.asArray()->elements;
+      if (left.size() != right.size()) return false;
+      for (size_t i = 0; i < left.size(); i++) {
+        if (!valuesEqual(left[i], right[i])) return false;
+      }
+      return true;
+    }
+    case ValueType::Object: {
+      const ObjectObject* left = a.asObject();
+      const ObjectObject* right = b.asObject();
+      if (left->properties.size() != right->properties.size()) return false;
+      for (const auto& entry : left->properties) {
+        const Value* other = right->find(entry.first);
+        if (other == nullptr || !valuesEqual(entry.second, *other)) return false;
+      }
+      return true;
+    }
+    case ValueType::Closure:
+      return a.asClosure() == b.asClosure();
+  }
+  return false;
+}
+
+double toNumber(Value value) {
+  switch (value.type()) {
+    case ValueType::Number:
+      return value.asNumber();
+    case ValueType::Boolean:
+      return value.asBoolean() ? 1 : 0;
+    case ValueType::String:
+      return stringToNumber(value.asString()->value);
+    case ValueType::Null:
+      return 0;
+    default:
+      return NAN;
+  }
+}
+
+// =============================================================================
+// Display
+// =============================================================================
+
+void appendDisplay(std::string& out, Value value) {
+  switch (value.type()) {
+    case ValueType::Null:
+      out += "null";
+      return;
+    case ValueType::Boolean:
+      out += value.asBoolean() ? "true" : "false";
+      return;
+    case ValueType::Number:
+      out += numberToString(value.asNumber());
+      return;
+    case ValueType::String:
+      out += value.asString()->value;
+      return;
+    case ValueType::Regex:
+      out += '/';
+      out += value.asRegex()->pattern;
+      out += '/';
+      out += value.asRegex()->flags;
+      return;
+    case ValueType::Array: {
+      out += '[';
+      bool first = true;
+      for (Value element : value.asArray()->elements) {
+        if (!first) out += ", ";
+        first = false;
+        appendDisplay(out, element);
+      }
+      out += ']';
+      return;
+    }
+    case ValueType::Object: {
+      out += '{';
+      bool first = true;
+      for (const auto& entry : value.asObject()->properties) {
+        if (!first) out += ", ";
+        first = false;
+        out += entry.first;
+        out += ": ";
+        appendDisplay(out, entry.second);
+      }
+      out += '}';
+      return;
+    }
+    case ValueType::Closure: {
+      const std::string* name = value.asClosure()->name;
+      if (name != nullptr && !name->empty()) {
+        out += "<function ";
+        out += *name;
+        out += '>';
+      } else {
+        out += "<function>";
+      }
+      return;
+    }
+  }
+}
+
+std::string displayValue(Value value) {
+  if (value.isString()) return std::string(value.asString()->value);
+  std::string out;
+  appendDisplay(out, value);
+  return out;
+}
+
+// =============================================================================
+// Number <-> string
+// =============================================================================
+
+std::string numberToString(double value) {
+  if (std::isnan(value)) return "NaN";
+  if (value == 0) return "0";
+  if (std::isinf(value)) return value < 0 ? "-Infinity" : "Infinity";
+
+  // Integers that fit in a double's mantissa print without any exponent
+  // handling; this covers almost every number a pipeline produces.
+  if (std::fabs(value) < 9007199254740992.0 && value == std::trunc(value)) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(value));
+    return std::string(buffer, result.ptr);
+  }
+
+  // Shortest round-trip digits, then lay them out per Number::toString.
+  char buffer[40];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+  std::string_view text(buffer, static_cast<size_t>(result.ptr - buffer));
+
+  std::string out;
+  if (text.front() == '-') {
+    out += '-';
+    text.remove_prefix(1);
+  }
+
+  size_t ePos = text.find('e');
+  std::string digits;
+  for (char c : text.substr(0, ePos)) {
+    if (c != '.') digits += c;
+  }
+  int exponent = std::atoi(std::string(text.substr(ePos + 1)).c_str());
+  int k = static_cast<int>(digits.size());
+  int n = exponent + 1;
+
+  if (k <= n && n <= 21) {
+    out += digits;
+    out.append(static_cast<size_t>(n - k), '0');
+  } else if (0 < n && n <= 21) {
+    out += digits.substr(0, static_cast<size_t>(n));
+    out += '.';
+    out += digits.substr(static_cast<size_t>(n));
+  } else if (-6 < n && n <= 0) {
+    out += "0.";
+    out.append(static_cast<size_t>(-n), '0');
+    out += digits;
+  } else {
+    out += digits[0];
+    if (k > 1) {
+      out += '.';
+      out += digits.substr(1);
+    }
+    out += 'e';
+    out += n - 1 >= 0 ? '+' : '-';
+    out += std::to_string(std::abs(n - 1));
+  }
+  return out;
+}
+
+uint32_t decodeUtf8(std::string_view text, size_t pos, size_t* length) {
+  unsigned char c = static_cast<unsigned char>(text[pos]);
+  size_t needed = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+  if (c < 0x80 || pos + needed > text.size()) {
+    *length = 1;
+    return c;
+  }
+  uint32_t cp = needed == 2 ? (c & 0x1F) : needed == 3 ? (c & 0x0F) : (c & 0x07);
+  for (size_t i = 1; i < needed; i++) {
+    cp = (cp << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+  }
+  *length = needed;
+  return cp;
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+bool isJsWhitespace(uint32_t cp) {
+  switch (cp) {
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+    case 0x0C:
+    case 0x0D:
+    case 0x20:
+    case 0xA0:
+    case 0x1680:
+    case 0x2028:
+    case 0x2029:
+    case 0x202F:
+    case 0x205F:
+    case 0x3000:
+    case 0xFEFF:
+      return true;
+    default:
+      return cp >= 0x2000 && cp <= 0x200A;
+  }
+}
+
+std::string_view trimJsWhitespace(std::string_view text) {
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t length;
+    uint32_t cp = decodeUtf8(text, start, &length);
+    if (!isJsWhitespace(cp)) break;
+    start += length;
+  }
+  size_t end = text.size();
+  while (end > start) {
+    size_t lead = end - 1;
+    while (lead > start && (static_cast<unsigned char>(text[lead]) & 0xC0) == 0x80) lead--;
+    size_t length;
+    uint32_t cp = decodeUtf8(text, lead, &length);
+    if (!isJsWhitespace(cp)) break;
+    end = lead;
+  }
+  return text.substr(start, end - start);
+}
+
+static double parseRadix(std::string_view digits, int radix) {
+  if (digits.empty()) return NAN;
+  double result = 0;
+  for (char c : digits) {
+    int digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'z') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'Z') {
+      digit = c - 'A' + 10;
+    } else {
+      return NAN;
+    }
+    if (digit >= radix) return NAN;
+    result = result * radix + digit;
+  }
+  return result;
+}
+
+double stringToNumber(std::string_view input) {
+  std::string_view text = trimJsWhitespace(input);
+  if (text.empty()) return 0;
+
+  if (text.size() > 2 && text[0] == '0') {
+    char prefix = text[1];
+    if (prefix == 'x' || prefix == 'X') return parseRadix(text.substr(2), 16);
+    if (prefix == 'o' || prefix == 'O') return parseRadix(text.substr(2), 8);
+    if (prefix == 'b' || prefix == 'B') return parseRadix(text.substr(2), 2);
+  }
+
+  // StrDecimalLiteral: [+-] (Infinity | digits [. digits] | . digits) [e [+-] digits]
+  size_t pos = 0;
+  bool negative = false;
+  if (text[pos] == '+' || text[pos] == '-') {
+    negative = text[pos] == '-';
+    pos++;
+  }
+  std::string_view body = text.substr(pos);
+  if (body == "Infinity") return negative ? -INFINITY : INFINITY;
+
+  size_t i = 0;
+  size_t intDigits = 0;
+  size_t fracDigits = 0;
+  while (i < body.size() && body[i] >= '0' && body[i] <= '9') {
+    i++;
+    intDigits++;
+  }
+  if (i < body.size() && body[i] == '.') {
+    i++;
+    while (i < body.size() && body[i] >= '0' && body[i] <= '9') {
+      i++;
+      fracDigits++;
+    }
+  }
+  if (intDigits == 0 && fracDigits == 0) return NAN;
+  if (i < body.size() && (body[i] == 'e' || body[i] == 'E')) {
+    i++;
+    if (i < body.size() && (body[i] == '+' || body[i] == '-')) i++;
+    size_t expDigits = 0;
+    while (i < body.size() && body[i] >= '0' && body[i] <= '9') {
+      i++;
+      expDigits++;
+    }
+    if (expDigits == 0) return NAN;
+  }
+  if (i != body.size()) return NAN;
+
+  // The literal is validated, so strtod only has to do the rounding.
+  std::string literal(body);
+  double value = std::strtod(literal.c_str(), nullptr);
+  return negative ? -value : value;
+}
+
+// =============================================================================
+// UTF-16 indexing over UTF-8 storage
+// =============================================================================
+
+size_t utf16Length(std::string_view text) {
+  size_t units = 0;
+  for (unsigned char c : text) {
+    if ((c & 0xC0) != 0x80) units++;
+    if (c >= 0xF0) units++;  // astral code points are surrogate pairs
+  }
+  return units;
+}
+
+size_t utf16ToByteOffset(std::string_view text, size_t units) {
+  size_t pos = 0;
+  size_t seen = 0;
+  while (pos < text.size() && seen < units) {
+    size_t length;
+    uint32_t cp = decodeUtf8(text, pos, &length);
+    seen += cp >= 0x10000 ? 2 : 1;
+    pos += length;
+  }
+  return pos;
+}
+
+}  // namespace pex
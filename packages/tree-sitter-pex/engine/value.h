@@ -0,0 +1,330 @@
+/**
+ * Runtime values for the native PEX engine.
+ *
+ * Mirrors packages/core/src/vm/values.ts. Scalars (null, booleans, numbers)
+ * are stored inline in a NaN-boxed Value; strings, arrays, objects, regexes,
+ * closures and upvalues are allocated on a Heap that is owned by the VM and
+ * released in one go between runs.
+ */
+
+#ifndef PEX_ENGINE_VALUE_H_
+#define PEX_ENGINE_VALUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "regex.h"
+
+namespace pex {
+
+struct FunctionTemplate;
+
+/**
+ * Runtime value types supported by the engine.
+ * Continuations are never materialised as values: a suspended effect is
+ * state on the VM itself.
+ */
+enum class ValueType : uint8_t {
+  Null,
+  Boolean,
+  Number,
+  String,
+  Array,
+  Object,
+  Regex,
+  Closure,
+};
+
+/**
+ * Type name as reported by the TypeScript VM ("null", "number", ...).
+ */
+const char* typeName(ValueType type);
+
+/**
+ * Base class for everything allocated on a Heap.
+ */
+struct HeapObject {
+  virtual ~HeapObject() = default;
+};
+
+struct StringObject;
+struct ArrayObject;
+struct ObjectObject;
+struct RegexObject;
+struct ClosureObject;
+
+/**
+ * A NaN-boxed runtime value: 8 bytes, cheap to copy, heap payloads borrowed.
+ *
+ * Numbers are stored as their IEEE-754 bits. Every other type lives in the
+ * negative quiet-NaN space: the top 16 bits hold the tag (0xFFF8 + n) and
+ * the low 48 bits hold the payload (a pointer, or 0/1 for booleans). NaN
+ * results are canonicalised to a positive quiet NaN so they never collide
+ * with a tag.
+ */
+class Value {
+ public:
+  Value() : bits_(kNullBits) {}
+
+  static Value null() { return Value(); }
+  static Value boolean(bool value) { return Value(kBooleanTag | (value ? 1 : 0)); }
+  static Value number(double value) {
+    if (value != value) return Value(kCanonicalNaN);
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return Value(bits);
+  }
+  static Value string(StringObject* object);
+  static Value array(ArrayObject* object);
+  static Value object(ObjectObject* object);
+  static Value regex(RegexObject* object);
+  static Value closure(ClosureObject* object);
+
+  ValueType type() const {
+    if (isNumber()) return ValueType::Number;
+    static constexpr ValueType kTagTypes[] = {
+        ValueType::Null,  ValueType::Boolean, ValueType::String, ValueType::Array,
+        ValueType::Object, ValueType::Regex,  ValueType::Closure, ValueType::Null,
+    };
+    return kTagTypes[(bits_ >> kTagShift) & 0x7];
+  }
+  bool isNull() const { return bits_ == kNullBits; }
+  bool isBoolean() const { return (bits_ & kTagMask) == kBooleanTag; }
+  bool isNumber() const { return bits_ < kNullBits; }
+  bool isString() const { return (bits_ & kTagMask) == kStringTag; }
+  bool isArray() const { return (bits_ & kTagMask) == kArrayTag; }
+  bool isObject() const { return (bits_ & kTagMask) == kObjectTag; }
+  bool isRegex() const { return (bits_ & kTagMask) == kRegexTag; }
+  bool isClosure() const { return (bits_ & kTagMask) == kClosureTag; }
+
+  bool asBoolean() const { return (bits_ & 1) != 0; }
+  double asNumber() const {
+    double value;
+    std::memcpy(&value, &bits_, sizeof value);
+    return value;
+  }
+  StringObject* asString() const;
+  ArrayObject* asArray() const;
+  ObjectObject* asObject() const;
+  RegexObject* asRegex() const;
+  ClosureObject* asClosure() const;
+
+ private:
+  static constexpr int kTagShift = 48;
+  static constexpr uint64_t kTagMask = 0xFFFFull << kTagShift;
+  static constexpr uint64_t kPayloadMask = (1ull << kTagShift) - 1;
+  static constexpr uint64_t kNullBits = 0xFFF8ull << kTagShift;
+  static constexpr uint64_t kBooleanTag = 0xFFF9ull << kTagShift;
+  static constexpr uint64_t kStringTag = 0xFFFAull << kTagShift;
+  static constexpr uint64_t kArrayTag = 0xFFFBull << kTagShift;
+  static constexpr uint64_t kObjectTag = 0xFFFCull << kTagShift;
+  static constexpr uint64_t kRegexTag = 0xFFFDull << kTagShift;
+  static constexpr uint64_t kClosureTag = 0xFFFEull << kTagShift;
+  static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ull;
+
+  explicit Value(uint64_t bits) : bits_(bits) {}
+  static Value box(uint64_t tag, const HeapObject* object) {
+    return Value(tag | (reinterpret_cast<uintptr_t>(object) & kPayloadMask));
+  }
+  HeapObject* pointer() const { return reinterpret_cast<HeapObject*>(static_cast<uintptr_t>(bits_ & kPayloadMask)); }
+
+  uint64_t bits_;
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay one machine word");
+
+/**
+ * UTF-8 string payload. `ascii` caches whether UTF-16 indices equal byte
+ * offsets, which is the common case and keeps len/substring O(1).
+ *
+ * `value` either views `owned` or is a slice of a parent string. Heaps only
+ * release objects all at once, and a slice is always allocated on the VM
+ * heap while its parent is on that heap or the longer-lived program heap,
+ * so split, substring, trim and match can share the parent's bytes instead
+ * of copying them. A borrowed string views bytes owned by the host, such as
+ * a column buffer, which must stay alive until the heap is cleared.
+ */
+struct StringObject final : HeapObject {
+  struct Borrowed {};
+
+  explicit StringObject(std::string text);
+  StringObject(const StringObject& parent, std::string_view slice);
+  StringObject(Borrowed, std::string_view bytes);
+  StringObject(const StringObject&) = delete;
+  StringObject& operator=(const StringObject&) = delete;
+
+  std::string owned;
+  std::string_view value;
+  bool ascii;
+};
+
+struct ArrayObject final : HeapObject {
+  ArrayObject() = default;
+  explicit ArrayObject(std::vector<Value> items) : elements(std::move(items)) {}
+
+  std::vector<Value> elements;
+};
+
+/**
+ * Object payload. Insertion order is preserved to match Map iteration in the
+ * TypeScript VM.
+ */
+struct ObjectObject final : HeapObject {
+  const Value* find(std::string_view key) const;
+  void set(std::string key, Value value);
+
+  std::vector<std::pair<std::string, Value>> properties;
+};
+
+/**
+ * Regex payload compiled with the ECMAScript grammar of std::regex.
+ * Supported flags: g (global), i (ignore case), m (multiline). Other flags
+ * are kept for display but do not change matching. Patterns std::regex
+ * rejects (e.g. lookbehind) leave `valid` false and report `error` when the
+ * regex is first used, mirroring `new RegExp` throwing at CONST time.
+ * Simple patterns also get a scanning kernel that builtins prefer.
+ *
+ * std::regex (libstdc++) matches recursively, several hundred bytes of
+ * stack per input character and more per level of group nesting, so the
+ * builtins refuse inputs longer than `maxInput` instead of overflowing the
+ * native stack. Kernel matches have no such limit.
+ */
+struct RegexObject final : HeapObject {
+  RegexObject(std::string source, std::string flagText);
+
+  std::string pattern;
+  std::string flags;
+  std::regex regex;
+  RegexKernel kernel;
+  bool global;
+  bool valid;
+  std::string error;
+  /** Longest input, in bytes, std::regex may be run on */
+  size_t maxInput;
+};
+
+/**
+ * A captured variable. Open upvalues point at a stack slot; closing copies
+ * the slot into `closed` so the closure outlives the frame.
+ */
+struct Upvalue final : HeapObject {
+  explicit Upvalue(uint32_t slot) : index(slot) {}
+
+  bool open = true;
+  uint32_t index;
+  Value closed;
+};
+
+struct ClosureObject final : HeapObject {
+  ClosureObject(const FunctionTemplate* fn, uint32_t fnIndex, const std::string* fnName)
+      : tmpl(fn), templateIndex(fnIndex), name(fnName) {}
+
+  const FunctionTemplate* tmpl;
+  uint32_t templateIndex;
+  const std::string* name;  // nullptr for anonymous functions
+  std::vector<Upvalue*> upvalues;
+};
+
+// Heap pointers must fit in the 48-bit payload (true for user-space
+// addresses on every 64-bit platform Node supports, and for 32-bit targets).
+inline Value Value::string(StringObject* object) { return box(kStringTag, object); }
+inline Value Value::array(ArrayObject* object) { return box(kArrayTag, object); }
+inline Value Value::object(ObjectObject* object) { return box(kObjectTag, object); }
+inline Value Value::regex(RegexObject* object) { return box(kRegexTag, object); }
+inline Value Value::closure(ClosureObject* object) { return box(kClosureTag, object); }
+
+inline StringObject* Value::asString() const { return static_cast<StringObject*>(pointer()); }
+inline ArrayObject* Value::asArray() const { return static_cast<ArrayObject*>(pointer()); }
+inline ObjectObject* Value::asObject() const { return static_cast<ObjectObject*>(pointer()); }
+inline RegexObject* Value::asRegex() const { return static_cast<RegexObject*>(pointer()); }
+inline ClosureObject* Value::asClosure() const { return static_cast<ClosureObject*>(pointer()); }
+
+/**
+ * Arena for heap values. Objects live until clear() is called; the VM clears
+ * its heap at the start of every run, so nothing is freed mid-execution.
+ */
+class Heap {
+ public:
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    auto object = std::make_unique<T>(std::forward<Args>(args)...);
+    T* raw = object.get();
+    objects_.push_back(std::move(object));
+    return raw;
+  }
+
+  Value string(std::string text) { return Value::string(make<StringObject>(std::move(text))); }
+
+  /** A string sharing `text`, which must lie within `parent`'s value. */
+  Value slice(const StringObject* parent, std::string_view text) {
+    if (text.size() == parent->value.size()) return Value::string(const_cast<StringObject*>(parent));
+    return Value::string(make<StringObject>(*parent, text));
+  }
+
+  /** A string viewing host-owned `bytes` (see StringObject). */
+  Value borrow(std::string_view bytes) {
+    return Value::string(make<StringObject>(StringObject::Borrowed{}, bytes));
+  }
+
+  void clear() { objects_.clear(); }
+  size_t size() const { return objects_.size(); }
+
+ private:
+  std::vector<std::unique_ptr<HeapObject>> objects_;
+};
+
+// =============================================================================
+// Helpers (JavaScript-compatible semantics, see values.ts)
+// =============================================================================
+
+/** null, false, 0, NaN and "" are falsy; everything else is truthy. */
+bool isTruthy(Value value);
+
+/** Deep equality; closures compare by identity. */
+bool valuesEqual(Value a, Value b);
+
+/** Number(value) coercion used by arithmetic and comparisons. */
+double toNumber(Value value);
+
+/** Human-readable representation, identical to displayValue(). */
+std::string displayValue(Value value);
+void appendDisplay(std::string& out, Value value);
+
+/** String(number) as specified by ECMAScript Number::toString. */
+std::string numberToString(double value);
+
+/** Number(string) as specified by ECMAScript StringToNumber. */
+double stringToNumber(std::string_view text);
+
+/**
+ * Decode one UTF-8 code point starting at `pos` and store its byte length.
+ * Invalid bytes decode as themselves so malformed input never loops.
+ */
+uint32_t decodeUtf8(std::string_view text, size_t pos, size_t* length);
+void appendUtf8(std::string& out, uint32_t codePoint);
+
+/** Whether a code point is JavaScript whitespace or a line terminator. */
+bool isJsWhitespace(uint32_t codePoint);
+
+/** String.prototype.trim(). */
+std::string_view trimJsWhitespace(std::string_view text);
+
+/** Length of a UTF-8 string in UTF-16 code units. */
+size_t utf16Length(std::string_view text);
+
+/**
+ * Byte offset of the given UTF-16 index, clamped to the string length.
+ * Indices that fall inside a surrogate pair round up to the next code point.
+ */
+size_t utf16ToByteOffset(std::string_view text, size_t units);
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_VALUE_H_
@@ -0,0 +1,732 @@
+/**
+ * Dispatch loop for the native PEX engine.
+ *
+ * Runs the instructions Program pre-decoded at load time, so no operand is
+ * decoded while executing.
+ *
+ * The hot state (code pointer, ip, stack pointer) lives in locals inside
+ * execute() and is written back to the current frame only when control
+ * leaves it: calls, returns, effects and errors.
+ */
+
+#include "vm.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "opcodes.h"
+
+namespace pex {
+
+namespace {
+
+const std::string kMainName = "<main>";
+
+std::string hexOpcode(uint8_t opcode) {
+  static const char* digits = "0123456789abcdef";
+  std::string out;
+  if (opcode >= 0x10) out += digits[opcode >> 4];
+  out += digits[opcode & 0xF];
+  return out;
+}
+
+/**
+ * Evaluate the comparison of a fused compare-and-jump superinstruction.
+ * Operands are converted in the same order as the unfused LT/GT/LE/GE.
+ */
+inline bool compareForJump(uint8_t op, Value a, Value b) {
+  switch (op) {
+    case DOP_EQ_JUMP_IF_FALSE:
+      return valuesEqual(a, b);
+    case DOP_NE_JUMP_IF_FALSE:
+      return !valuesEqual(a, b);
+    default:
+      break;
+  }
+  double y = toNumber(b);
+  double x = toNumber(a);
+  switch (op) {
+    case DOP_LT_JUMP_IF_FALSE:
+      return x < y;
+    case DOP_GT_JUMP_IF_FALSE:
+      return x > y;
+    case DOP_LE_JUMP_IF_FALSE:
+      return x <= y;
+    default:
+      return x >= y;
+  }
+}
+
+}  // namespace
+
+VM::VM(const Program& program)
+    : program_(program),
+      stack_(new Value[kMaxStackSize]),
+      builtins_(program.names().size(), nullptr) {
+  frames_.reserve(kMaxFrames + 1);
+  resolveBuiltins();
+}
+
+void VM::reset() {
+  sp_ = 0;
+  frames_.clear();
+  openUpvalues_.clear();
+  effectArgs_.clear();
+  effectName_ = nullptr;
+  suspended_ = false;
+  result_ = Value::null();
+  entryClosure_ = nullptr;
+  heap_.clear();
+}
+
+RunStatus VM::run(Value input) {
+  // Reset execution state; heap values (including `input`) stay alive.
+  sp_ = 0;
+  frames_.clear();
+  openUpvalues_.clear();
+  effectArgs_.clear();
+  suspended_ = false;
+  result_ = Value::null();
+
+  uint32_t entryIndex = program_.entryPoint();
+  if (entryIndex >= program_.templates().size()) {
+    throw VMError("Invalid entry point index: " + std::to_string(entryIndex));
+  }
+  const FunctionTemplate& entry = program_.templates()[entryIndex];
+  entryClosure_ = heap_.make<ClosureObject>(&entry, entryIndex, &kMainName);
+
+  // Push input as argument, then reserve space for the remaining locals
+  push(input);
+  for (uint32_t i = 1; i < entry.localCount; i++) push(Value::null());
+
+  frames_.push_back(CallFrame{entryClosure_, program_.instructions(entry), entry.codeLength, 0, 0});
+  return execute();
+}
+
+RunStatus VM::resume(Value value) {
+  if (!suspended_) throw VMError("No suspended effect to resume");
+  suspended_ = false;
+  effectArgs_.clear();
+  push(value);
+  return execute();
+}
+
+// openUpvalues_ is sorted by stack slot, so the upvalues of the innermost
+// frame are always at the back.
+Upvalue* VM::captureUpvalue(uint32_t stackIndex) {
+  size_t insertAt = openUpvalues_.size();
+  while (insertAt > 0 && openUpvalues_[insertAt - 1]->index >= stackIndex) {
+    if (openUpvalues_[insertAt - 1]->index == stackIndex) return openUpvalues_[insertAt - 1];
+    insertAt--;
+  }
+  Upvalue* upvalue = heap_.make<Upvalue>(stackIndex);
+  openUpvalues_.insert(openUpvalues_.begin() + static_cast<std::ptrdiff_t>(insertAt), upvalue);
+  return upvalue;
+}
+
+void VM::closeUpvaluesFrom(uint32_t stackIndex) {
+  while (!openUpvalues_.empty() && openUpvalues_.back()->index >= stackIndex) {
+    Upvalue* upvalue = openUpvalues_.back();
+    upvalue->closed = stack_[upvalue->index];
+    upvalue->open = false;
+    openUpvalues_.pop_back();
+  }
+}
+
+/**
+ * Resolve every name the program calls through CALL_BUILTIN, so calls index
+ * builtins_ directly. Unknown builtins are reported here rather than when
+ * the call is first executed.
+ */
+void VM::resolveBuiltins() {
+  const std::vector<uint8_t>& code = program_.code();
+  for (const FunctionTemplate& fn : program_.templates()) {
+    size_t end = std::min<size_t>(static_cast<size_t>(fn.codeOffset) + fn.codeLength, code.size());
+    size_t ip = fn.codeOffset;
+    while (ip < end) {
+      uint8_t opcode = code[ip];
+      size_t size = instructionSize(opcode);
+      // Malformed code is reported when it is executed
+      if (ip + size > end) break;
+
+      uint32_t nameIndex;
+      switch (opcode) {
+        case OP_CALL_BUILTIN_U8_U8:
+          nameIndex = code[ip + 1];
+          break;
+        case OP_CALL_BUILTIN_U16_U8:
+          nameIndex = static_cast<uint32_t>(code[ip + 1]) | (static_cast<uint32_t>(code[ip + 2]) << 8);
+          break;
+        case OP_CALL_BUILTIN_U32_U8:
+          nameIndex = static_cast<uint32_t>(code[ip + 1]) | (static_cast<uint32_t>(code[ip + 2]) << 8) |
+                      (static_cast<uint32_t>(code[ip + 3]) << 16) | (static_cast<uint32_t>(code[ip + 4]) << 24);
+          break;
+        case OP_LOAD_LOCAL_CALL_BUILTIN_U8:
+          nameIndex = code[ip + 2];
+          break;
+        default:
+          ip += size;
+          continue;
+      }
+
+      if (nameIndex >= program_.names().size()) {
+        throw VMError("Name index " + std::to_string(nameIndex) + " out of bounds");
+      }
+      if (builtins_[nameIndex] == nullptr) {
+        builtins_[nameIndex] = findBuiltin(program_.names()[nameIndex]);
+        if (builtins_[nameIndex] == nullptr) {
+          throw VMError("Unknown builtin function: " + program_.names()[nameIndex],
+                        static_cast<uint32_t>(ip - fn.codeOffset));
+        }
+      }
+      ip += size;
+    }
+  }
+}
+
+void VM::callBuiltin(uint32_t nameIndex, uint32_t argCount, uint32_t ip) {
+  Builtin builtin = nameIndex < builtins_.size() ? builtins_[nameIndex] : nullptr;
+  if (builtin == nullptr) {
+    if (nameIndex >= program_.names().size()) {
+      throw VMError("Name index " + std::to_string(nameIndex) + " out of bounds");
+    }
+    throw VMError("Unknown builtin function: " + program_.names()[nameIndex], ip);
+  }
+
+  if (sp_ < argCount) throw VMError("Stack underflow");
+  const Value* args = stack_.get() + (sp_ - argCount);
+  Value result;
+  try {
+    result = builtin(heap_, args, argCount);
+  } catch (const RuntimeError& error) {
+    throw VMError(error.what(), ip);
+  }
+  sp_ -= argCount;
+  push(result);
+}
+
+// Handlers end in DISPATCH(). With computed gotos each handler jumps
+// straight to the next one through a table of label addresses, giving the
+// branch predictor one indirect jump per handler instead of the switch's
+// single shared one. Other compilers fall back to the switch.
+#if defined(__GNUC__)
+#define TARGET(name) \
+  op_##name:         \
+  case DOP_##name
+#define DISPATCH()             \
+  do {                         \
+    insn = code + ip;          \
+    ip = insn->next;           \
+    goto* kDispatch[insn->op]; \
+  } while (0)
+#else
+#define TARGET(name) case DOP_##name
+#define DISPATCH() continue
+#endif
+
+// Taken jumps check their target; falling off the end reaches DOP_END.
+#define JUMP_TO(target)                                                      \
+  do {                                                                       \
+    ip = (target);                                                           \
+    if (ip > length) throw VMError("Instruction pointer out of bounds", ip); \
+  } while (0)
+
+RunStatus VM::execute() {
+#if defined(__GNUC__)
+  static void* const kDispatch[kDecodedOpCount] = {
+#define PEX_DISPATCH_LABEL(name) &&op_##name,
+      PEX_DECODED_OPS(PEX_DISPATCH_LABEL)
+#undef PEX_DISPATCH_LABEL
+  };
+#endif
+
+  CallFrame* frame = &frames_.back();
+  const Instruction* code = frame->code;
+  uint32_t length = frame->codeLength;
+  uint32_t ip = frame->ip;
+  const Instruction* insn;
+  Value* stack = stack_.get();
+
+  const std::vector<Value>& constants = program_.constants();
+
+  for (;;) {
+    // The ip of the running instruction is already its successor's
+    insn = code + ip;
+    ip = insn->next;
+    switch (insn->op) {
+      // =================================================================
+      // Stack Operations
+      // =================================================================
+
+      TARGET(NOP):
+        DISPATCH();
+
+      TARGET(POP):
+        pop();
+        DISPATCH();
+
+      TARGET(DUP):
+        if (sp_ == 0) throw VMError("Stack underflow");
+        push(stack[sp_ - 1]);
+        DISPATCH();
+
+      TARGET(SWAP): {
+        Value a = pop();
+        Value b = pop();
+        push(a);
+        push(b);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Constants
+      // =================================================================
+
+      TARGET(CONST_NULL):
+        push(Value::null());
+        DISPATCH();
+
+      TARGET(CONST_TRUE):
+        push(Value::boolean(true));
+        DISPATCH();
+
+      TARGET(CONST_FALSE):
+        push(Value::boolean(false));
+        DISPATCH();
+
+      TARGET(CONST_ZERO):
+        push(Value::number(0));
+        DISPATCH();
+
+      TARGET(CONST_ONE):
+        push(Value::number(1));
+        DISPATCH();
+
+      TARGET(CONST): {
+        uint32_t index = insn->operand;
+        if (index >= constants.size()) {
+          throw VMError("Constant index " + std::to_string(index) + " out of bounds");
+        }
+        Value constant = constants[index];
+        if (constant.isRegex() && !constant.asRegex()->valid) {
+          throw VMError(constant.asRegex()->error, ip);
+        }
+        push(constant);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Variables (Locals and Upvalues)
+      // =================================================================
+
+      TARGET(LOAD_LOCAL): {
+        uint32_t index = insn->operand;
+        size_t slot = static_cast<size_t>(frame->bp) + index;
+        if (slot >= sp_) throw VMError("Local variable index " + std::to_string(index) + " out of bounds");
+        push(stack[slot]);
+        DISPATCH();
+      }
+
+      TARGET(STORE_LOCAL): {
+        uint32_t index = insn->operand;
+        Value value = pop();
+        size_t slot = static_cast<size_t>(frame->bp) + index;
+        if (slot >= sp_) throw VMError("Local variable index " + std::to_string(index) + " out of bounds");
+        stack[slot] = value;
+        DISPATCH();
+      }
+
+      TARGET(LOAD_UPVALUE): {
+        uint32_t index = insn->operand;
+        const auto& upvalues = frame->closure->upvalues;
+        if (index >= upvalues.size()) throw VMError("Upvalue index " + std::to_string(index) + " out of bounds");
+        Upvalue* upvalue = upvalues[index];
+        push(upvalue->open ? stack[upvalue->index] : upvalue->closed);
+        DISPATCH();
+      }
+
+      TARGET(STORE_UPVALUE): {
+        uint32_t index = insn->operand;
+        Value value = pop();
+        const auto& upvalues = frame->closure->upvalues;
+        if (index >= upvalues.size()) throw VMError("Upvalue index " + std::to_string(index) + " out of bounds");
+        Upvalue* upvalue = upvalues[index];
+        if (upvalue->open) {
+          stack[upvalue->index] = value;
+        } else {
+          upvalue->closed = value;
+        }
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Arithmetic
+      // =================================================================
+
+      TARGET(ADD): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::number(a + b));
+        DISPATCH();
+      }
+
+      TARGET(SUB): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::number(a - b));
+        DISPATCH();
+      }
+
+      TARGET(MUL): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::number(a * b));
+        DISPATCH();
+      }
+
+      TARGET(DIV): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        if (b == 0) throw VMError("Division by zero", ip);
+        push(Value::number(a / b));
+        DISPATCH();
+      }
+
+      TARGET(MOD): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::number(std::fmod(a, b)));
+        DISPATCH();
+      }
+
+      TARGET(NEG):
+        push(Value::number(-toNumber(pop())));
+        DISPATCH();
+
+      // =================================================================
+      // Comparison
+      // =================================================================
+
+      TARGET(EQ): {
+        Value b = pop();
+        Value a = pop();
+        push(Value::boolean(valuesEqual(a, b)));
+        DISPATCH();
+      }
+
+      TARGET(NE): {
+        Value b = pop();
+        Value a = pop();
+        push(Value::boolean(!valuesEqual(a, b)));
+        DISPATCH();
+      }
+
+      TARGET(LT): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::boolean(a < b));
+        DISPATCH();
+      }
+
+      TARGET(GT): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::boolean(a > b));
+        DISPATCH();
+      }
+
+      TARGET(LE): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::boolean(a <= b));
+        DISPATCH();
+      }
+
+      TARGET(GE): {
+        double b = toNumber(pop());
+        double a = toNumber(pop());
+        push(Value::boolean(a >= b));
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Logic
+      // =================================================================
+
+      TARGET(NOT):
+        push(Value::boolean(!isTruthy(pop())));
+        DISPATCH();
+
+      TARGET(NULL_COALESCE): {
+        Value b = pop();
+        Value a = pop();
+        push(a.isNull() ? b : a);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Control Flow
+      // =================================================================
+
+      TARGET(JUMP): {
+        JUMP_TO(insn->operand);
+        DISPATCH();
+      }
+
+      TARGET(JUMP_IF_FALSE): {
+        if (!isTruthy(pop())) JUMP_TO(insn->operand);
+        DISPATCH();
+      }
+
+      TARGET(JUMP_IF_TRUE): {
+        if (isTruthy(pop())) JUMP_TO(insn->operand);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Functions
+      // =================================================================
+
+      TARGET(MAKE_CLOSURE): {
+        uint32_t templateIndex = insn->operand;
+        const auto& templates = program_.templates();
+        if (templateIndex >= templates.size()) {
+          throw VMError("Function template index " + std::to_string(templateIndex) + " out of bounds");
+        }
+        const FunctionTemplate& fn = templates[templateIndex];
+        auto* closure = heap_.make<ClosureObject>(&fn, templateIndex, program_.templateName(fn));
+        closure->upvalues.reserve(fn.upvalues.size());
+
+        for (const UpvalueSpec& spec : fn.upvalues) {
+          if (spec.isLocal) {
+            // Capture from the current frame's locals as an open upvalue,
+            // reusing an existing one so recursive closures see updates.
+            size_t slot = static_cast<size_t>(frame->bp) + spec.index;
+            if (slot >= sp_) {
+              throw VMError("Local variable index " + std::to_string(spec.index) + " out of bounds");
+            }
+            closure->upvalues.push_back(captureUpvalue(static_cast<uint32_t>(slot)));
+          } else {
+            const auto& enclosing = frame->closure->upvalues;
+            if (spec.index >= enclosing.size()) {
+              throw VMError("Upvalue index " + std::to_string(spec.index) + " out of bounds", ip);
+            }
+            closure->upvalues.push_back(enclosing[spec.index]);
+          }
+        }
+
+        push(Value::closure(closure));
+        DISPATCH();
+      }
+
+      TARGET(CALL):
+      TARGET(TAIL_CALL): {
+        uint32_t argCount = insn->operand;
+
+        // Stack layout: [..., func, arg0, arg1, ..., argN-1]
+        if (sp_ < static_cast<size_t>(argCount) + 1) {
+          throw VMError("Stack underflow during function call", ip);
+        }
+        size_t funcIndex = sp_ - argCount - 1;
+        Value func = stack[funcIndex];
+        if (!func.isClosure()) {
+          throw VMError(std::string("Cannot call non-function value: ") + typeName(func.type()), ip);
+        }
+        ClosureObject* closure = func.asClosure();
+        const FunctionTemplate& fn = *closure->tmpl;
+        if (argCount != fn.paramCount) {
+          std::string name = closure->name != nullptr ? *closure->name : "<anonymous>";
+          throw VMError("Function " + name + " expects " + std::to_string(fn.paramCount) + " arguments, got " +
+                            std::to_string(argCount),
+                        ip);
+        }
+
+        if (insn->op == DOP_TAIL_CALL) {
+          // The callee takes over this frame: close what closures captured
+          // from it, then move the arguments down to its base.
+          uint32_t bp = frame->bp;
+          if (!openUpvalues_.empty()) closeUpvaluesFrom(bp);
+          for (uint32_t i = 0; i < argCount; i++) stack[bp + i] = stack[funcIndex + 1 + i];
+          sp_ = bp + argCount;
+          frame->closure = closure;
+          for (uint32_t i = argCount; i < fn.localCount; i++) push(Value::null());
+
+          frame->code = program_.instructions(fn);
+          frame->codeLength = fn.codeLength;
+          code = frame->code;
+          length = frame->codeLength;
+          ip = 0;
+          DISPATCH();
+        }
+
+        // Slide the arguments down over the function slot so they become
+        // locals 0..argCount-1 of the new frame.
+        for (size_t i = funcIndex; i + 1 < sp_; i++) stack[i] = stack[i + 1];
+        sp_--;
+        for (uint32_t i = argCount; i < fn.localCount; i++) push(Value::null());
+
+        frame->ip = ip;
+        frames_.push_back(CallFrame{closure, program_.instructions(fn), fn.codeLength, 0,
+                                    static_cast<uint32_t>(funcIndex)});
+        if (frames_.size() > kMaxFrames) {
+          throw VMError("Call stack overflow (max " + std::to_string(kMaxFrames) + ")");
+        }
+        frame = &frames_.back();
+        code = frame->code;
+        length = frame->codeLength;
+        ip = 0;
+        DISPATCH();
+      }
+
+      TARGET(RETURN): {
+        Value returnValue = pop();
+        uint32_t oldBp = frame->bp;
+        frames_.pop_back();
+
+        if (frames_.empty()) {
+          // Returned from entry point - halt execution
+          result_ = returnValue;
+          return RunStatus::Completed;
+        }
+
+        // Close any open upvalues before popping locals
+        if (!openUpvalues_.empty()) closeUpvaluesFrom(oldBp);
+        if (sp_ > oldBp) sp_ = oldBp;
+        push(returnValue);
+
+        frame = &frames_.back();
+        code = frame->code;
+        length = frame->codeLength;
+        ip = frame->ip;
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Builtins
+      // =================================================================
+
+      TARGET(CALL_BUILTIN): {
+        uint32_t nameIndex = insn->operand;
+        uint32_t argCount = insn->extra1;
+        callBuiltin(nameIndex, argCount, ip);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Effects (Algebraic Effects with Continuations)
+      // =================================================================
+
+      TARGET(EFFECT): {
+        uint32_t nameIndex = insn->operand;
+        uint32_t argCount = insn->extra1;
+        if (nameIndex >= program_.names().size()) {
+          throw VMError("Name index " + std::to_string(nameIndex) + " out of bounds");
+        }
+        if (sp_ < argCount) throw VMError("Stack underflow");
+
+        effectName_ = &program_.names()[nameIndex];
+        effectArgs_.assign(stack + (sp_ - argCount), stack + sp_);
+        sp_ -= argCount;
+
+        // Suspend: the live frames and stack are the continuation.
+        frame->ip = ip;
+        suspended_ = true;
+        return RunStatus::Suspended;
+      }
+
+      // =================================================================
+      // Arrays
+      // =================================================================
+
+      TARGET(MAKE_ARRAY): {
+        uint32_t elementCount = insn->operand;
+        if (sp_ < elementCount) throw VMError("Stack underflow");
+        auto* array = heap_.make<ArrayObject>(std::vector<Value>(stack + (sp_ - elementCount), stack + sp_));
+        sp_ -= elementCount;
+        push(Value::array(array));
+        DISPATCH();
+      }
+
+      TARGET(GET_INDEX): {
+        Value key = pop();
+        Value array = pop();
+        if (array.isObject()) {
+          std::string display;
+          std::string_view name = key.isString() ? std::string_view(key.asString()->value)
+                                                 : std::string_view(display = displayValue(key));
+          const Value* property = array.asObject()->find(name);
+          push(property != nullptr ? *property : Value::null());
+          DISPATCH();
+        }
+        double index = toNumber(key);
+        if (!array.isArray()) {
+          throw VMError(std::string("Cannot index non-array value: ") + typeName(array.type()), ip);
+        }
+        const auto& elements = array.asArray()->elements;
+        double idx = std::floor(index);
+        if (idx >= 0 && idx < static_cast<double>(elements.size())) {
+          push(elements[static_cast<size_t>(idx)]);
+        } else {
+          push(Value::null());
+        }
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Superinstructions (produced by the peephole optimizer)
+      // =================================================================
+
+      TARGET(TEE_LOCAL): {
+        uint32_t index = insn->operand;
+        if (sp_ == 0) throw VMError("Stack underflow");
+        size_t slot = static_cast<size_t>(frame->bp) + index;
+        if (slot >= sp_ - 1) throw VMError("Local variable index " + std::to_string(index) + " out of bounds");
+        stack[slot] = stack[sp_ - 1];
+        DISPATCH();
+      }
+
+      TARGET(LOAD_LOCAL_CALL_BUILTIN): {
+        uint32_t index = insn->operand;
+        uint32_t nameIndex = insn->extra1;
+        uint32_t argCount = insn->extra2;
+        size_t slot = static_cast<size_t>(frame->bp) + index;
+        if (slot >= sp_) throw VMError("Local variable index " + std::to_string(index) + " out of bounds");
+        push(stack[slot]);
+        callBuiltin(nameIndex, argCount, ip);
+        DISPATCH();
+      }
+
+      TARGET(EQ_JUMP_IF_FALSE):
+      TARGET(NE_JUMP_IF_FALSE):
+      TARGET(LT_JUMP_IF_FALSE):
+      TARGET(GT_JUMP_IF_FALSE):
+      TARGET(LE_JUMP_IF_FALSE):
+      TARGET(GE_JUMP_IF_FALSE): {
+        Value b = pop();
+        Value a = pop();
+        if (!compareForJump(insn->op, a, b)) JUMP_TO(insn->operand);
+        DISPATCH();
+      }
+
+      // =================================================================
+      // Malformed Code
+      // =================================================================
+
+      TARGET(UNKNOWN):
+        throw VMError("Unknown opcode: 0x" + hexOpcode(static_cast<uint8_t>(insn->operand)), ip);
+
+      TARGET(TRUNCATED):
+        throw VMError("Unexpected end of bytecode", insn->operand);
+
+      TARGET(END):
+        throw VMError("Instruction pointer out of bounds", ip);
+
+    }
+  }
+}
+
+#undef TARGET
+#undef DISPATCH
+#undef JUMP_TO
+
+}  // namespace pex
@@ -0,0 +1,139 @@
+/**
+ * Native stack-based virtual machine for PEX bytecode.
+ *
+ * Executes a loaded Program with the same semantics as the TypeScript VM in
+ * packages/core/src/vm/vm.ts: same stack and call-depth limits, same value
+ * coercions and the same error messages.
+ *
+ * Algebraic effects work by suspension rather than a host callback: when an
+ * EFFECT instruction executes, run()/resume() return RunStatus::Suspended
+ * with the effect name and arguments available on the VM. The live stack
+ * and frames are the continuation; calling resume(value) pushes the value
+ * as the effect's result and continues. Not resuming aborts the run, which
+ * the TypeScript VM reports as a null result.
+ */
+
+#ifndef PEX_ENGINE_VM_H_
+#define PEX_ENGINE_VM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "builtins.h"
+#include "program.h"
+#include "value.h"
+
+namespace pex {
+
+/**
+ * Stack limits for safety (MAX_STACK_SIZE / MAX_FRAMES in vm.ts).
+ */
+constexpr size_t kMaxStackSize = 10000;
+constexpr size_t kMaxFrames = 1000;
+
+/**
+ * VM runtime error with optional instruction pointer (VMError).
+ */
+class VMError : public std::runtime_error {
+ public:
+  explicit VMError(const std::string& message) : std::runtime_error(message), hasIp_(false), ip_(0) {}
+  VMError(const std::string& message, uint32_t ip) : std::runtime_error(message), hasIp_(true), ip_(ip) {}
+
+  bool hasIp() const { return hasIp_; }
+  uint32_t ip() const { return ip_; }
+
+ private:
+  bool hasIp_;
+  uint32_t ip_;
+};
+
+enum class RunStatus {
+  Completed,
+  Suspended,
+};
+
+struct CallFrame {
+  ClosureObject* closure;
+  const Instruction* code;  // Decoded code, indexed by byte offset
+  uint32_t codeLength;
+  uint32_t ip;
+  uint32_t bp;
+};
+
+class VM {
+ public:
+  explicit VM(const Program& program);
+
+  /**
+   * Heap for values created during the current run. Values passed to run()
+   * and resume() should be allocated here so they share its lifetime.
+   */
+  Heap& heap() { return heap_; }
+
+  /**
+   * Drop all state from the previous run, including its heap values.
+   */
+  void reset();
+
+  /**
+   * Run the entry point with the given input (bound to local 0).
+   */
+  RunStatus run(Value input);
+
+  /**
+   * Continue a suspended run, using `value` as the result of the effect.
+   * @throws VMError if no effect is pending
+   */
+  RunStatus resume(Value value);
+
+  bool suspended() const { return suspended_; }
+
+  /** Return value of the entry function once Completed. */
+  Value result() const { return result_; }
+
+  /** Pending effect, valid while suspended. */
+  const std::string& effectName() const { return *effectName_; }
+  const std::vector<Value>& effectArgs() const { return effectArgs_; }
+
+ private:
+  RunStatus execute();
+
+  void push(Value value) {
+    if (sp_ >= kMaxStackSize) throw VMError("Stack overflow (max " + std::to_string(kMaxStackSize) + ")");
+    stack_[sp_++] = value;
+  }
+  Value pop() {
+    if (sp_ == 0) throw VMError("Stack underflow");
+    return stack_[--sp_];
+  }
+
+  Upvalue* captureUpvalue(uint32_t stackIndex);
+  void closeUpvaluesFrom(uint32_t stackIndex);
+  void resolveBuiltins();
+  void callBuiltin(uint32_t nameIndex, uint32_t argCount, uint32_t ip);
+
+  const Program& program_;
+  Heap heap_;
+  std::unique_ptr<Value[]> stack_;
+  size_t sp_ = 0;
+  std::vector<CallFrame> frames_;
+  std::vector<Upvalue*> openUpvalues_;
+
+  // Builtins called by the program, indexed by name index and resolved once
+  // when the VM is created. Names that are not called as builtins are null.
+  std::vector<Builtin> builtins_;
+
+  ClosureObject* entryClosure_ = nullptr;
+  Value result_;
+  bool suspended_ = false;
+  const std::string* effectName_ = nullptr;
+  std::vector<Value> effectArgs_;
+};
+
+}  // namespace pex
+
+#endif  // PEX_ENGINE_VM_H_
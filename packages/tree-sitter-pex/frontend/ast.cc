@@ -0,0 +1,410 @@
+/**
+ * Tree-sitter CST to PEX AST conversion.
+ *
+ * Mirrors the shapes built by packages/core/src/parser/parser.ts: a
+ * pipeline with one stage is just that stage, several atoms in a row are an
+ * implicit call (a List), and a parenthesized pipeline is the Pipeline
+ * itself rather than a List around it.
+ */
+
+#include "ast.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "tree_sitter/api.h"
+
+extern "C" const TSLanguage* tree_sitter_pex();
+
+namespace pex {
+
+namespace {
+
+// Longest excerpt of unexpected input quoted in an error message
+constexpr size_t kMaxErrorExcerpt = 20;
+
+struct Symbols {
+  explicit Symbols(const TSLanguage* language)
+      : expression(lookup(language, "expression")),
+        pipeline(lookup(language, "pipeline")),
+        implicitCall(lookup(language, "implicit_call")),
+        list(lookup(language, "list")),
+        atom(lookup(language, "atom")),
+        number(lookup(language, "number")),
+        string(lookup(language, "string")),
+        regex(lookup(language, "regex")),
+        boolean(lookup(language, "boolean")),
+        null(lookup(language, "null")),
+        sourceRef(lookup(language, "source_ref")),
+        effectIdent(lookup(language, "effect_ident")),
+        identifier(lookup(language, "identifier")),
+        comment(lookup(language, "comment")) {}
+
+  static TSSymbol lookup(const TSLanguage* language, const char* name) {
+    return ts_language_symbol_for_name(language, name, static_cast<uint32_t>(std::strlen(name)), true);
+  }
+
+  TSSymbol expression;
+  TSSymbol pipeline;
+  TSSymbol implicitCall;
+  TSSymbol list;
+  TSSymbol atom;
+  TSSymbol number;
+  TSSymbol string;
+  TSSymbol regex;
+  TSSymbol boolean;
+  TSSymbol null;
+  TSSymbol sourceRef;
+  TSSymbol effectIdent;
+  TSSymbol identifier;
+  TSSymbol comment;
+};
+
+const Symbols& symbols() {
+  static const Symbols instance(tree_sitter_pex());
+  return instance;
+}
+
+struct ParserDeleter {
+  void operator()(TSParser* parser) const { ts_parser_delete(parser); }
+};
+
+struct TreeDeleter {
+  void operator()(TSTree* tree) const { ts_tree_delete(tree); }
+};
+
+/**
+ * Call `fn` with each named child of `node` except comments.
+ */
+template <typename Fn>
+void forEachChild(TSNode node, Fn fn) {
+  TSTreeCursor cursor = ts_tree_cursor_new(node);
+  if (ts_tree_cursor_goto_first_child(&cursor)) {
+    do {
+      TSNode child = ts_tree_cursor_current_node(&cursor);
+      if (ts_node_is_named(child) && ts_node_symbol(child) != symbols().comment) {
+        fn(child);
+      }
+    } while (ts_tree_cursor_goto_next_sibling(&cursor));
+  }
+  ts_tree_cursor_delete(&cursor);
+}
+
+TSNode firstChild(TSNode node) {
+  TSNode first = {};
+  bool found = false;
+  forEachChild(node, [&](TSNode child) {
+    if (!found) {
+      first = child;
+      found = true;
+    }
+  });
+  return first;
+}
+
+bool isSymbol(TSNode node, TSSymbol symbol) {
+  return !ts_node_is_null(node) && ts_node_symbol(node) == symbol;
+}
+
+/**
+ * First ERROR or MISSING node in document order, or a null node.
+ */
+TSNode findError(TSNode node) {
+  if (ts_node_is_missing(node) || std::strcmp(ts_node_type(node), "ERROR") == 0) {
+    return node;
+  }
+  uint32_t count = ts_node_child_count(node);
+  for (uint32_t i = 0; i < count; i++) {
+    TSNode child = ts_node_child(node, i);
+    if (ts_node_has_error(child)) {
+      return findError(child);
+    }
+  }
+  return TSNode{};
+}
+
+class AstBuilder {
+ public:
+  AstBuilder(const char* source, bool shellMode) : source_(source), shellMode_(shellMode) {}
+
+  std::string build(TSNode root) {
+    size_t countOffset = reserveU32();
+    uint32_t count = 0;
+    size_t lastStart = 0;
+    bool lastHasSourceRef = false;
+
+    forEachChild(root, [&](TSNode expression) {
+      lastStart = out_.size();
+      sawSourceRef_ = false;
+      TSNode child = firstChild(expression);
+      if (isSymbol(child, symbols().pipeline)) {
+        pipeline(child);
+      } else {
+        primary(child);
+      }
+      lastHasSourceRef = sawSourceRef_;
+      count++;
+    });
+    patchU32(countOffset, count);
+
+    // Shell mode feeds $$ into the last expression unless it reads a source
+    // reference itself
+    if (shellMode_ && count > 0 && !lastHasSourceRef) {
+      std::string input;
+      input.push_back(static_cast<char>(kAstIdentifier));
+      appendU32(input, 2);
+      input.append("$$");
+
+      if (static_cast<uint8_t>(out_[lastStart]) == kAstPipeline) {
+        patchU32(lastStart + 1, readU32(lastStart + 1) + 1);
+        out_.insert(lastStart + 5, input);
+      } else {
+        std::string wrapper;
+        wrapper.push_back(static_cast<char>(kAstPipeline));
+        appendU32(wrapper, 2);
+        wrapper.append(input);
+        out_.insert(lastStart, wrapper);
+      }
+    }
+
+    return std::move(out_);
+  }
+
+ private:
+  // A pipeline stage or top-level expression: an implicit call or a single
+  // expression
+  void primary(TSNode node) {
+    if (isSymbol(node, symbols().implicitCall)) {
+      writeTag(kAstList);
+      size_t countOffset = reserveU32();
+      uint32_t count = 0;
+      forEachChild(node, [&](TSNode child) {
+        single(child);
+        count++;
+      });
+      patchU32(countOffset, count);
+      return;
+    }
+
+    // Shell mode treats a lone identifier as a call with no arguments
+    if (shellMode_ && isSymbol(node, symbols().atom)) {
+      TSNode value = firstChild(node);
+      if (isSymbol(value, symbols().identifier) || isSymbol(value, symbols().sourceRef)) {
+        writeTag(kAstList);
+        appendU32(out_, 1);
+      }
+    }
+    single(node);
+  }
+
+  void single(TSNode node) {
+    if (isSymbol(node, symbols().list)) {
+      list(node);
+    } else {
+      atom(node);
+    }
+  }
+
+  void list(TSNode node) {
+    TSNode first = firstChild(node);
+    if (isSymbol(first, symbols().pipeline)) {
+      pipeline(first);
+      return;
+    }
+
+    writeTag(kAstList);
+    size_t countOffset = reserveU32();
+    uint32_t count = 0;
+    forEachChild(node, [&](TSNode child) {
+      single(child);
+      count++;
+    });
+    patchU32(countOffset, count);
+  }
+
+  void pipeline(TSNode node) {
+    writeTag(kAstPipeline);
+    size_t countOffset = reserveU32();
+    uint32_t count = 0;
+    forEachChild(node, [&](TSNode stage) {
+      primary(stage);
+      count++;
+    });
+    patchU32(countOffset, count);
+  }
+
+  void atom(TSNode node) {
+    TSNode value = firstChild(node);
+    const char* start = source_ + ts_node_start_byte(value);
+    size_t length = ts_node_end_byte(value) - ts_node_start_byte(value);
+    TSSymbol symbol = ts_node_symbol(value);
+    const Symbols& s = symbols();
+
+    if (symbol == s.number) {
+      writeTag(kAstNumber);
+      writeF64(std::strtod(std::string(start, length).c_str(), nullptr));
+      writeString(start, length);
+    } else if (symbol == s.string) {
+      writeTag(kAstString);
+      std::string unescaped = unescape(start, length);
+      writeString(unescaped.data(), unescaped.size());
+      writeString(start, length);
+    } else if (symbol == s.regex) {
+      // /pattern/flags; the pattern may contain escaped slashes
+      size_t lastSlash = length - 1;
+      while (lastSlash > 0 && start[lastSlash] != '/') {
+        lastSlash--;
+      }
+      writeTag(kAstRegex);
+      writeString(start + 1, lastSlash - 1);
+      writeString(start + lastSlash + 1, length - lastSlash - 1);
+      writeString(start, length);
+    } else if (symbol == s.boolean) {
+      writeTag(kAstBoolean);
+      out_.push_back(start[0] == 't' ? 1 : 0);
+    } else if (symbol == s.null) {
+      writeTag(kAstNull);
+    } else if (symbol == s.effectIdent) {
+      writeTag(kAstEffect);
+      writeString(start, length - 1);  // without the trailing ':'
+    } else {
+      if (symbol == s.sourceRef) {
+        sawSourceRef_ = true;
+      }
+      writeTag(kAstIdentifier);
+      writeString(start, length);
+    }
+  }
+
+  /**
+   * Decode a quoted string literal the way the TS lexer does: \n, \t and
+   * \r are control characters and any other escaped character stands for
+   * itself.
+   */
+  static std::string unescape(const char* text, size_t length) {
+    std::string value;
+    value.reserve(length);
+    for (size_t i = 1; i + 1 < length; i++) {
+      if (text[i] != '\\' || i + 2 >= length) {
+        value.push_back(text[i]);
+        continue;
+      }
+      char escaped = text[++i];
+      switch (escaped) {
+        case 'n':
+          value.push_back('\n');
+          break;
+        case 't':
+          value.push_back('\t');
+          break;
+        case 'r':
+          value.push_back('\r');
+          break;
+        default:
+          value.push_back(escaped);
+          // Keep the continuation bytes of an escaped multi-byte character
+          while (i + 2 < length && (static_cast<unsigned char>(text[i + 1]) & 0xC0) == 0x80) {
+            value.push_back(text[++i]);
+          }
+      }
+    }
+    return value;
+  }
+
+  void writeTag(AstTag tag) { out_.push_back(static_cast<char>(tag)); }
+
+  void writeString(const char* data, size_t length) {
+    appendU32(out_, static_cast<uint32_t>(length));
+    out_.append(data, length);
+  }
+
+  void writeF64(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) {
+      out_.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+    }
+  }
+
+  static void appendU32(std::string& buffer, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  size_t reserveU32() {
+    size_t offset = out_.size();
+    out_.append(4, '\0');
+    return offset;
+  }
+
+  void patchU32(size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      out_[offset + static_cast<size_t>(i)] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+  }
+
+  uint32_t readU32(size_t offset) const {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+      value = (value << 8) | static_cast<unsigned char>(out_[offset + static_cast<size_t>(i)]);
+    }
+    return value;
+  }
+
+  const char* source_;
+  bool shellMode_;
+  bool sawSourceRef_ = false;
+  std::string out_;
+};
+
+std::string errorMessage(TSNode node, const char* source) {
+  if (ts_node_is_missing(node)) {
+    return std::string("Expected '") + ts_node_type(node) + "'";
+  }
+
+  const char* start = source + ts_node_start_byte(node);
+  size_t length = ts_node_end_byte(node) - ts_node_start_byte(node);
+  if (length == 0) {
+    return "Unexpected end of input";
+  }
+
+  size_t excerpt = 0;
+  while (excerpt < length && excerpt < kMaxErrorExcerpt && start[excerpt] != '\n') {
+    excerpt++;
+  }
+  // Do not cut a multi-byte character in half
+  while (excerpt < length && excerpt > 0 && (static_cast<unsigned char>(start[excerpt]) & 0xC0) == 0x80) {
+    excerpt--;
+  }
+  return "Unexpected '" + std::string(start, excerpt) + "'";
+}
+
+}  // namespace
+
+std::string parseToAst(const char* source, size_t length, bool shellMode) {
+  // Parsers are reused across calls; the language never changes
+  thread_local std::unique_ptr<TSParser, ParserDeleter> parser;
+  if (!parser) {
+    parser.reset(ts_parser_new());
+    ts_parser_set_language(parser.get(), tree_sitter_pex());
+  }
+
+  std::unique_ptr<TSTree, TreeDeleter> tree(
+      ts_parser_parse_string(parser.get(), nullptr, source, static_cast<uint32_t>(length)));
+  TSNode root = ts_tree_root_node(tree.get());
+
+  if (ts_node_has_error(root)) {
+    TSNode error = findError(root);
+    if (ts_node_is_null(error)) {
+      error = root;
+    }
+    TSPoint point = ts_node_start_point(error);
+    throw SyntaxError(errorMessage(error, source), point.row + 1, point.column + 1);
+  }
+
+  return AstBuilder(source, shellMode).build(root);
+}
+
+}  // namespace pex
@@ -0,0 +1,71 @@
+/**
+ * Native PEX front end: parses source with the tree-sitter grammar and
+ * builds the AST from packages/core/src/parser/ast.ts without going through
+ * JavaScript node objects.
+ *
+ * The AST is returned as one compact buffer, decoded on the JS side by
+ * src/frontend.ts. All integers are little-endian:
+ *
+ *   Program    := u32 expressionCount, Node*
+ *   Node       := u8 tag, payload
+ *     List       (0): u32 count, Node*
+ *     Pipeline   (1): u32 count, Node*
+ *     Number     (2): f64 value, Str raw
+ *     String     (3): Str value, Str raw
+ *     Regex      (4): Str pattern, Str flags, Str raw
+ *     Boolean    (5): u8 value
+ *     Null       (6)
+ *     Identifier (7): Str name
+ *     Effect     (8): Str name
+ *   Str        := u32 byteLength, UTF-8 bytes
+ */
+
+#ifndef PEX_FRONTEND_AST_H_
+#define PEX_FRONTEND_AST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace pex {
+
+enum AstTag : uint8_t {
+  kAstList = 0,
+  kAstPipeline = 1,
+  kAstNumber = 2,
+  kAstString = 3,
+  kAstRegex = 4,
+  kAstBoolean = 5,
+  kAstNull = 6,
+  kAstIdentifier = 7,
+  kAstEffect = 8,
+};
+
+/**
+ * Error raised for source with syntax errors (ParseError). Line and column
+ * are 1-based; the column counts bytes.
+ */
+class SyntaxError : public std::runtime_error {
+ public:
+  SyntaxError(const std::string& message, uint32_t line, uint32_t column)
+      : std::runtime_error(message), line_(line), column_(column) {}
+
+  uint32_t line() const { return line_; }
+  uint32_t column() const { return column_; }
+
+ private:
+  uint32_t line_;
+  uint32_t column_;
+};
+
+/**
+ * Parse UTF-8 source and serialize its AST. Produces the same tree as
+ * parse() from @pex/core, including shell mode's $$ injection.
+ * @throws SyntaxError at the first ERROR or MISSING node
+ */
+std::string parseToAst(const char* source, size_t length, bool shellMode);
+
+}  // namespace pex
+
+#endif  // PEX_FRONTEND_AST_H_
@@ -1,3 +1,4 @@
+from os import environ
 from os.path import isdir, join
 from platform import system
 
@@ -6,6 +7,29 @@ from setuptools.command.build import build
 from wheel.bdist_wheel import bdist_wheel
 
 
+def tree_sitter_lib():
+    """The tree-sitter runtime sources that parse_many() links against.
+
+    TREE_SITTER_LIB may point at the `lib` directory of a tree-sitter
+    checkout; otherwise the copy shipped with the tree-sitter npm package is
+    used, as in binding.gyp.
+    """
+    candidates = [
+        environ.get("TREE_SITTER_LIB"),
+        join("node_modules", "tree-sitter", "vendor", "tree-sitter", "lib"),
+        join("..", "..", "node_modules", "tree-sitter", "vendor", "tree-sitter", "lib"),
+    ]
+    for candidate in candidates:
+        if candidate and isdir(join(candidate, "src")):
+            return candidate
+    raise RuntimeError(
+        "tree-sitter runtime sources not found; run `bun install` or set TREE_SITTER_LIB"
+    )
+
+
+TREE_SITTER_LIB = tree_sitter_lib()
+
+
 class Build(build):
     def run(self):
         if isdir("queries"):
@@ -37,6 +61,7 @@ setup(
                 "bindings/python/tree_sitter_pex/binding.c",
                 "src/parser.c",
                 # NOTE: if your language uses an external scanner, add it here.
+                join(TREE_SITTER_LIB, "src", "lib.c"),
             ],
             extra_compile_args=[
                 "-std=c11",
@@ -48,7 +73,8 @@ setup(
                 ("Py_LIMITED_API", "0x03080000"),
                 ("PY_SSIZE_T_CLEAN", None)
             ],
-            include_dirs=["src"],
+            include_dirs=["src", join(TREE_SITTER_LIB, "include"), join(TREE_SITTER_LIB, "src")],
+            libraries=["pthread"] if system() != "Windows" else [],
             py_limited_api=True,
         )
     ],
@@ -0,0 +1,110 @@
+/**
+ * Decoder for the serialized AST of the native front end
+ *
+ * Shared by the Node addon (frontend.ts) and the WebAssembly build
+ * (wasm.ts); it depends on nothing but the @pex/core AST types.
+ */
+
+import type { Atom, Program, SExpr } from '@pex/core/parser';
+
+// Node tags, see frontend/ast.h
+enum Tag {
+  List = 0,
+  Pipeline = 1,
+  Number = 2,
+  String = 3,
+  Regex = 4,
+  Boolean = 5,
+  Null = 6,
+  Identifier = 7,
+  Effect = 8,
+}
+
+const decoder = new TextDecoder();
+
+/**
+ * Decoder for the serialized AST layout documented in frontend/ast.h.
+ */
+class AstReader {
+  private readonly bytes: Uint8Array;
+  private readonly view: DataView;
+  private offset: number = 0;
+
+  constructor(bytes: Uint8Array) {
+    this.bytes = bytes;
+    this.view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  }
+
+  program(): Program {
+    return { type: 'Program', expressions: this.nodes() };
+  }
+
+  private nodes(): SExpr[] {
+    const count = this.u32();
+    const nodes: SExpr[] = new Array(count);
+    for (let i = 0; i < count; i++) {
+      nodes[i] = this.node();
+    }
+    return nodes;
+  }
+
+  private node(): SExpr {
+    const tag = this.bytes[this.offset++] as Tag;
+    switch (tag) {
+      case Tag.List:
+        return { type: 'List', elements: this.nodes() };
+      case Tag.Pipeline:
+        return { type: 'Pipeline', stages: this.nodes() };
+      case Tag.Number: {
+        const value = this.view.getFloat64(this.offset, true);
+        this.offset += 8;
+        return literal('number', value, this.string());
+      }
+      case Tag.String: {
+        const value = this.string();
+        return literal('string', value, this.string());
+      }
+      case Tag.Regex: {
+        const pattern = this.string();
+        const flags = this.string();
+        return literal('regex', new RegExp(pattern, flags), this.string());
+      }
+      case Tag.Boolean: {
+        const value = this.bytes[this.offset++] === 1;
+        return literal('boolean', value, String(value));
+      }
+      case Tag.Null:
+        return literal('null', null, 'null');
+      case Tag.Identifier:
+        return { type: 'Atom', atomType: 'identifier', value: this.string() };
+      case Tag.Effect:
+        return { type: 'Atom', atomType: 'effect', value: this.string() };
+      default:
+        throw new Error(`Invalid AST node tag ${tag} at offset ${this.offset - 1}`);
+    }
+  }
+
+  private u32(): number {
+    const value = this.view.getUint32(this.offset, true);
+    this.offset += 4;
+    return value;
+  }
+
+  private string(): string {
+    const length = this.u32();
+    const start = this.offset;
+    this.offset += length;
+    return decoder.decode(this.bytes.subarray(start, this.offset));
+  }
+}
+
+function literal(atomType: Atom['atomType'], value: Atom['value'], raw: string): Atom {
+  return { type: 'Atom', atomType, value, raw };
+}
+
+/**
+ * Decode a buffer returned by the native parseAST().
+ */
+export function decodeAst(bytes: Uint8Array): Program {
+  return new AstReader(bytes).program();
+}
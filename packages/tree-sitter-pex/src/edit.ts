@@ -0,0 +1,43 @@
+/**
+ * Helpers for describing source edits to PEXParser.edit()
+ */
+
+import type Parser from 'tree-sitter';
+
+/**
+ * Build a tree-sitter edit for replacing `oldSource[startIndex, oldEndIndex)`
+ * with `newText`, e.g. from an editor change event. Indices and columns are
+ * in UTF-16 code units, as used by JavaScript strings.
+ */
+export function createEdit(
+  oldSource: string,
+  startIndex: number,
+  oldEndIndex: number,
+  newText: string
+): Parser.Edit {
+  const startPosition = pointAt(oldSource, startIndex);
+  return {
+    startIndex,
+    oldEndIndex,
+    newEndIndex: startIndex + newText.length,
+    startPosition,
+    oldEndPosition: pointAt(oldSource, oldEndIndex),
+    newEndPosition: advancePoint(startPosition, newText),
+  };
+}
+
+function pointAt(source: string, index: number): Parser.Point {
+  return advancePoint({ row: 0, column: 0 }, source.substring(0, index));
+}
+
+function advancePoint(point: Parser.Point, text: string): Parser.Point {
+  const lastNewline = text.lastIndexOf('\n');
+  if (lastNewline === -1) {
+    return { row: point.row, column: point.column + text.length };
+  }
+  let rows = 0;
+  for (let i = text.indexOf('\n'); i !== -1; i = text.indexOf('\n', i + 1)) {
+    rows++;
+  }
+  return { row: point.row + rows, column: text.length - lastNewline - 1 };
+}
@@ -0,0 +1,247 @@
+/**
+ * TypeScript wrapper for the native PEX bytecode engine
+ *
+ * The engine lives in the same Node addon as the Tree-sitter grammar
+ * (engine/*.cc) and runs bytecode produced by @pex/core with the same
+ * semantics as the TypeScript VM.
+ */
+
+import { createRequire } from 'node:module';
+import { writeBytecode, nullValue, shapedObjectValue, Shape } from '@pex/core';
+import type { BytecodeFile, ObjectValue, Value } from '@pex/core';
+
+/**
+ * A column of rows in the Apache Arrow layout. Bitmaps hold one bit per row,
+ * least significant bit first; in `validity` a clear bit makes the row null.
+ * Strings are UTF-8, with row `i` spanning `data[offsets[i]..offsets[i + 1])`.
+ * A struct column's rows are objects of its fields' rows.
+ *
+ * `length` defaults to the length of `values` or `offsets` (or of the first
+ * field), and is required where that is ambiguous.
+ */
+export type Column =
+  | { type: 'null'; length: number }
+  | { type: 'boolean'; length: number; values: Uint8Array; validity?: Uint8Array }
+  | { type: 'number'; length?: number; values: Float64Array; validity?: Uint8Array }
+  | { type: 'string'; length?: number; offsets: Int32Array; data: Uint8Array; validity?: Uint8Array }
+  | { type: 'struct'; length?: number; fields: Record<string, Column>; validity?: Uint8Array };
+
+/**
+ * A column produced by NativeVM.runColumns(). `validity` is omitted when no
+ * row is null.
+ */
+export type OutputColumn =
+  | { type: 'null'; length: number }
+  | { type: 'boolean'; length: number; values: Uint8Array; validity?: Uint8Array }
+  | { type: 'number'; length: number; values: Float64Array; validity?: Uint8Array }
+  | { type: 'string'; length: number; offsets: Int32Array; data: Uint8Array; validity?: Uint8Array };
+
+interface NativeEngine {
+  run(input: Value): Value | undefined;
+  resume(value: Value): Value | undefined;
+  runBatch(inputs: Value[], start?: number): Value[];
+  runColumns(input: Column): OutputColumn;
+  pendingEffect(): { name: string; args: Value[] } | null;
+}
+
+type NativeEngineConstructor = new (
+  bytecode: Uint8Array,
+  templates?: unknown[],
+  makeObject?: (keys: string[], slots: Value[]) => ObjectValue,
+) => NativeEngine;
+
+// Objects returned by the engine share shapes with those of the TypeScript VM
+const makeObject = (keys: string[], slots: Value[]): ObjectValue => shapedObjectValue(Shape.of(keys), slots);
+
+let Engine: NativeEngineConstructor | undefined;
+try {
+  const require = createRequire(import.meta.url);
+  Engine = require('../bindings/node').Engine;
+} catch {
+  Engine = undefined;
+}
+
+/**
+ * Whether the native addon was built and exposes the engine.
+ */
+export function isNativeEngineAvailable(): boolean {
+  return Engine !== undefined;
+}
+
+/**
+ * Error raised by the native engine. Mirrors VMError from @pex/core.
+ */
+export class NativeVMError extends Error {
+  constructor(message: string, public readonly ip?: number) {
+    super(message);
+    this.name = 'VMError';
+  }
+}
+
+/**
+ * One-shot continuation handed to a NativeEffectHandler.
+ *
+ * The native VM keeps the suspended stack in place, so the continuation must
+ * be resumed before the handler returns; a handler that returns without
+ * resuming aborts the run (the result is null, as in the TypeScript VM).
+ */
+export class NativeContinuation {
+  private resumed: boolean = false;
+  private settled: boolean = false;
+  value: Value | undefined;
+
+  resume(value: Value): void {
+    if (this.resumed) {
+      throw new Error(
+        'Continuation has already been resumed. Continuations are one-shot and cannot be resumed twice.'
+      );
+    }
+    if (this.settled) {
+      throw new Error('Native continuations must be resumed before the effect handler returns.');
+    }
+    this.resumed = true;
+    this.value = value;
+  }
+
+  isResumed(): boolean {
+    return this.resumed;
+  }
+
+  /** @internal */
+  settle(): void {
+    this.settled = true;
+  }
+}
+
+export type NativeEffectHandler = (
+  effectName: string,
+  args: Value[],
+  continuation: NativeContinuation,
+) => void;
+
+/**
+ * Default effect handler that throws on any unhandled effect.
+ */
+export const throwingNativeEffectHandler: NativeEffectHandler = (effectName) => {
+  throw new Error(
+    `Unhandled effect: ${effectName}. Please provide an EffectHandler to handle effects.`
+  );
+};
+
+/**
+ * Native counterpart of the @pex/core VM.
+ *
+ * The bytecode is serialized and loaded once; each run() reuses the loaded
+ * program. Builtin calls are resolved at load time, so a program that calls
+ * an unknown builtin is rejected by the constructor.
+ */
+export class NativeVM {
+  private engine: NativeEngine;
+  private effectHandler: NativeEffectHandler;
+
+  constructor(bytecode: BytecodeFile, effectHandler: NativeEffectHandler = throwingNativeEffectHandler) {
+    if (Engine === undefined) {
+      throw new Error('Native PEX engine is not available. Build the addon with `node-gyp rebuild`.');
+    }
+    const Loaded = Engine;
+    this.engine = this.step(() => new Loaded(writeBytecode(bytecode), bytecode.functionTemplates.templates, makeObject));
+    this.effectHandler = effectHandler;
+  }
+
+  /**
+   * Run the program with the given input value.
+   */
+  run(input: Value): Value {
+    return this.complete(this.step(() => this.engine.run(input)));
+  }
+
+  /**
+   * Run the program over every input in a single native call, returning the
+   * results in input order. Inputs that perform effects are completed through
+   * the effect handler before the batch continues.
+   */
+  runBatch(inputs: Value[]): Value[] {
+    const results: Value[] = [];
+    while (results.length < inputs.length) {
+      const start = results.length;
+      const batch = this.step(() => this.engine.runBatch(inputs, start));
+      for (const result of batch) {
+        results.push(result);
+      }
+      if (results.length < inputs.length) {
+        // inputs[results.length] is suspended on an effect
+        results.push(this.complete(undefined));
+      }
+    }
+    return results;
+  }
+
+  /**
+   * Run the program over every row of a column in a single native call, with
+   * the row as `$$`, and return the results as a column. Neither the input
+   * nor the output is converted to Values: strings are read from and written
+   * to UTF-8 buffers directly.
+   *
+   * The output type is that of the first non-null result; every result must
+   * be null or of that type, and a boolean, number or string. Rows cannot
+   * perform effects. Either problem fails the whole call with an error named
+   * ColumnError, whose `row` is the row at fault.
+   */
+  runColumns(input: Column): OutputColumn {
+    return this.step(() => this.engine.runColumns(input));
+  }
+
+  /**
+   * Drive the effect loop until the current input finishes.
+   */
+  private complete(initial: Value | undefined): Value {
+    let result = initial;
+    while (result === undefined) {
+      const effect = this.engine.pendingEffect()!;
+      const continuation = new NativeContinuation();
+      try {
+        this.effectHandler(effect.name, effect.args, continuation);
+      } finally {
+        continuation.settle();
+      }
+      if (!continuation.isResumed()) {
+        return nullValue();
+      }
+      result = this.step(() => this.engine.resume(continuation.value!));
+    }
+    return result;
+  }
+
+  private step<T>(fn: () => T): T {
+    try {
+      return fn();
+    } catch (error) {
+      if (error instanceof Error && error.name === 'VMError') {
+        throw new NativeVMError(error.message, (error as Error & { ip?: number }).ip);
+      }
+      throw error;
+    }
+  }
+}
+
+/**
+ * Create a NativeVM and run it over every input, returning results in order.
+ */
+export function runNativeBatch(
+  bytecode: BytecodeFile,
+  inputs: Value[],
+  effectHandler: NativeEffectHandler = throwingNativeEffectHandler,
+): Value[] {
+  return new NativeVM(bytecode, effectHandler).runBatch(inputs);
+}
+
+/**
+ * Create a NativeVM and run it with the given bytecode and input.
+ */
+export function runNative(
+  bytecode: BytecodeFile,
+  input: Value,
+  effectHandler: NativeEffectHandler = throwingNativeEffectHandler,
+): Value {
+  return new NativeVM(bytecode, effectHandler).run(input);
+}
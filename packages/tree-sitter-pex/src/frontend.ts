@@ -0,0 +1,53 @@
+/**
+ * Native PEX front end
+ *
+ * parseNative() parses with the tree-sitter grammar and builds the AST in
+ * C++ (frontend/ast.cc). The whole tree comes back as one serialized buffer,
+ * so there is a single JS/native crossing per parse instead of one per
+ * syntax node. It produces the same Program as parse() from @pex/core.
+ */
+
+import { createRequire } from 'node:module';
+import { ParseError } from '@pex/core/parser';
+import type { ParseOptions, Program } from '@pex/core/parser';
+import { decodeAst } from './ast.ts';
+
+export { decodeAst };
+
+type NativeParseAST = (source: string, shellMode?: boolean) => Uint8Array;
+
+let parseAST: NativeParseAST | undefined;
+try {
+  const require = createRequire(import.meta.url);
+  parseAST = require('../bindings/node').parseAST;
+} catch {
+  parseAST = undefined;
+}
+
+/**
+ * Whether the native addon was built with the native front end.
+ */
+export function isNativeFrontendAvailable(): boolean {
+  return parseAST !== undefined;
+}
+
+/**
+ * Parse PEX source with the native front end.
+ * @throws ParseError on syntax errors; columns count UTF-8 bytes
+ */
+export function parseNative(source: string, options: ParseOptions = {}): Program {
+  if (parseAST === undefined) {
+    throw new Error('Native PEX front end is not available. Build the addon with `node-gyp rebuild`.');
+  }
+  let bytes: Uint8Array;
+  try {
+    bytes = parseAST(source, options.shellMode ?? false);
+  } catch (error) {
+    if (error instanceof Error && error.name === 'ParseError') {
+      const { line, column } = error as Error & { line: number; column: number };
+      throw new ParseError(error.message, line, column);
+    }
+    throw error;
+  }
+  return decodeAst(bytes);
+}
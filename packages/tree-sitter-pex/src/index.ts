@@ -5,6 +5,7 @@
  */
 
 export { PEXParser, parse } from './parser.ts';
+export { createEdit } from './edit.ts';
 export type {
   PEXSyntaxNode,
   PEXNodeType,
@@ -14,6 +15,22 @@ export type {
   QueryMatch,
 } from './types.ts';
 
+export {
+  NativeVM,
+  NativeVMError,
+  NativeContinuation,
+  isNativeEngineAvailable,
+  runNative,
+  runNativeBatch,
+  throwingNativeEffectHandler,
+} from './engine.ts';
+export type { NativeEffectHandler, Column, OutputColumn } from './engine.ts';
+
+export { parseNative, decodeAst, isNativeFrontendAvailable } from './frontend.ts';
+
+export { PexWasm, WasmProgram, WasmEngineError, throwingWasmEffectHandler } from './wasm.ts';
+export type { WasmEffectHandler } from './wasm.ts';
+
 // Re-export the language grammar for direct use
 // @ts-expect-error - Dynamic import of compiled C parser
 import PEXLanguage from '../index.js';
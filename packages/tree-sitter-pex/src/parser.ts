@@ -11,9 +11,14 @@ import PEXLanguage from '../index.js';
 
 /**
  * PEX Parser class with TypeScript support
+ *
+ * The parser keeps the tree from the last parse. Editors can describe each
+ * change with edit() and call reparse(), which reuses the unchanged parts
+ * of the old tree instead of parsing the whole source again.
  */
 export class PEXParser {
   private parser: Parser;
+  private tree: Parser.Tree | null = null;
 
   constructor() {
     this.parser = new Parser();
@@ -21,63 +26,117 @@ export class PEXParser {
   }
 
   /**
-   * Parse PEX source code
+   * Parse PEX source code from scratch
    */
   parse(source: string, options?: ParseOptions): ParseResult {
-    const tree = this.parser.parse(source, undefined, options);
-    const rootNode = tree.rootNode as PEXSyntaxNode;
+    this.tree = this.parser.parse(source, undefined, options);
+    return this.result(this.tree);
+  }
 
-    // Find all ERROR nodes
-    const errors: PEXSyntaxNode[] = [];
-    this.visitNode(rootNode, (node) => {
-      if (node.type === 'ERROR') {
-        errors.push(node as PEXSyntaxNode);
-      }
-    });
+  /**
+   * Record an edit to the source of the last parse. Call once per change,
+   * in order, before reparse().
+   * @throws Error if nothing has been parsed yet
+   */
+  edit(edit: Parser.Edit): void {
+    if (!this.tree) {
+      throw new Error('Nothing to edit: call parse() before edit()');
+    }
+    this.tree.edit(edit);
+  }
 
-    return {
-      rootNode,
-      success: errors.length === 0,
-      errors,
-    };
+  /**
+   * Parse the edited source, reusing the last tree. If nothing has been
+   * parsed yet this is a full parse and changedRanges is empty.
+   */
+  reparse(source: string, options?: ParseOptions): ParseResult {
+    const oldTree = this.tree;
+    if (!oldTree) {
+      return this.parse(source, options);
+    }
+
+    this.tree = this.parser.parse(source, oldTree, options);
+    const result = this.result(this.tree);
+    result.changedRanges = oldTree.getChangedRanges(this.tree);
+    return result;
   }
 
   /**
-   * Parse source code and return the raw tree
+   * Forget the last tree, so the next reparse() is a full parse
    */
-  parseRaw(source: string, options?: ParseOptions): Parser.Tree {
-    return this.parser.parse(source, undefined, options);
+  reset(): void {
+    this.tree = null;
   }
 
   /**
-   * Visit all nodes in the tree depth-first
+   * Parse source code and return the raw tree
    */
-  private visitNode(node: Parser.SyntaxNode, callback: (node: Parser.SyntaxNode) => void): void {
-    callback(node);
-    for (const child of node.children) {
-      this.visitNode(child, callback);
-    }
+  parseRaw(source: string, options?: ParseOptions): Parser.Tree {
+    return this.parser.parse(source, undefined, options);
   }
 
   /**
    * Get all nodes of a specific type
    */
   findNodesOfType(rootNode: PEXSyntaxNode, type: string): PEXSyntaxNode[] {
-    const nodes: PEXSyntaxNode[] = [];
-    this.visitNode(rootNode, (node) => {
-      if (node.type === type) {
-        nodes.push(node as PEXSyntaxNode);
-      }
-    });
-    return nodes;
+    return collectNodes(rootNode, (cursor) => cursor.nodeType === type);
   }
 
   /**
-   * Get the text content of a node
+   * Get the text content of a node. This copies the text; use
+   * nodeTextEquals() to compare it without copying.
    */
   getNodeText(node: PEXSyntaxNode, source: string): string {
     return source.substring(node.startIndex, node.endIndex);
   }
+
+  /**
+   * Whether the text of a node is `text`, compared in place in the source
+   */
+  nodeTextEquals(node: PEXSyntaxNode, source: string, text: string): boolean {
+    return node.endIndex - node.startIndex === text.length && source.startsWith(text, node.startIndex);
+  }
+
+  private result(tree: Parser.Tree): ParseResult {
+    const rootNode = tree.rootNode as PEXSyntaxNode;
+
+    // Most parses are clean, and hasError is cached on every node
+    const errors = rootNode.hasError
+      ? collectNodes(rootNode, (cursor) => cursor.nodeType === 'ERROR' || cursor.nodeIsMissing)
+      : [];
+
+    return {
+      rootNode,
+      success: errors.length === 0,
+      errors,
+    };
+  }
+}
+
+/**
+ * Collect the nodes under `root` (inclusive) that match, depth-first. Walks
+ * with a TreeCursor, so only matching nodes are materialized.
+ */
+function collectNodes(
+  root: Parser.SyntaxNode,
+  matches: (cursor: Parser.TreeCursor) => boolean
+): PEXSyntaxNode[] {
+  const nodes: PEXSyntaxNode[] = [];
+  const cursor = root.walk();
+
+  for (;;) {
+    if (matches(cursor)) {
+      nodes.push(cursor.currentNode as PEXSyntaxNode);
+    }
+    if (cursor.gotoFirstChild()) {
+      continue;
+    }
+    while (!cursor.gotoNextSibling()) {
+      if (!cursor.gotoParent()) {
+        return nodes;
+      }
+    }
+  }
 }
 
 /**
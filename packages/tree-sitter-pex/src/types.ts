@@ -41,14 +41,21 @@ export interface ParseResult {
   rootNode: PEXSyntaxNode;
 
   /**
-   * Whether the parse was successful (no ERROR nodes)
+   * Whether the parse was successful (no ERROR or MISSING nodes)
    */
   success: boolean;
 
   /**
-   * List of syntax errors encountered
+   * List of syntax errors encountered: ERROR nodes and MISSING nodes
+   * inserted by error recovery
    */
   errors: PEXSyntaxNode[];
+
+  /**
+   * Ranges whose syntactic structure changed since the previous tree.
+   * Only set by PEXParser.reparse().
+   */
+  changedRanges?: Parser.Range[];
 }
 
 export interface QueryCapture {
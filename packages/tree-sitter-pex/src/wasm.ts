@@ -0,0 +1,246 @@
+/**
+ * WebAssembly build of the native front end and engine
+ *
+ * `make wasm` compiles the tree-sitter parser, frontend/ast.cc and the
+ * engine into build/wasm/pex.wasm (see bindings/wasm/binding.cc). Unlike
+ * the Node addon it runs in browsers and edge isolates, and this shim needs
+ * nothing from @pex/core at runtime beyond ParseError: programs are loaded
+ * as bytecode already written by writeBytecode(), and inputs, results and
+ * effect arguments cross as JSON values, as valueFromJSON() and
+ * valueToJSON() would convert them.
+ *
+ * Strings are copied once each way through the module's linear memory.
+ */
+
+import { ParseError } from '@pex/core/parser';
+import type { ParseOptions, Program } from '@pex/core/parser';
+import { decodeAst } from './ast.ts';
+
+interface Exports {
+  memory: WebAssembly.Memory;
+  _initialize?: () => void;
+  pex_alloc(size: number): number;
+  pex_free(pointer: number): void;
+  pex_output(): number;
+  pex_output_length(): number;
+  pex_parse_ast(source: number, length: number, shellMode: number): number;
+  pex_engine_new(bytecode: number, length: number): number;
+  pex_engine_delete(engine: number): void;
+  pex_engine_run(engine: number, input: number, length: number): number;
+  pex_engine_resume(engine: number, value: number, length: number): number;
+}
+
+// Return codes of the pex_* calls, see bindings/wasm/binding.cc
+enum Status {
+  Completed = 0,
+  Suspended = 1,
+  Error = 2,
+}
+
+// WASI errno returned by the stubbed system calls
+const ENOSYS = 52;
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
+/**
+ * Error raised by the WebAssembly engine. `name` is the error's name in the
+ * Node addon: VMError (with `ip`), BytecodeReadError (with `offset`), or
+ * JsonError (with `offset`) for input that is not JSON.
+ */
+export class WasmEngineError extends Error {
+  constructor(
+    name: string,
+    message: string,
+    public readonly ip?: number,
+    public readonly offset?: number,
+  ) {
+    super(message);
+    this.name = name;
+  }
+}
+
+/**
+ * Effect handler for WasmProgram.run(). It is called synchronously while the
+ * run is suspended and returns the effect's result; returning undefined
+ * abandons the run, whose result is then null (as when a continuation is
+ * never resumed).
+ */
+export type WasmEffectHandler = (effectName: string, args: unknown[]) => unknown;
+
+/**
+ * Default effect handler that throws on any unhandled effect.
+ */
+export const throwingWasmEffectHandler: WasmEffectHandler = (effectName) => {
+  throw new Error(
+    `Unhandled effect: ${effectName}. Please provide an EffectHandler to handle effects.`
+  );
+};
+
+/**
+ * An instantiated pex.wasm module.
+ */
+export class PexWasm {
+  private constructor(private readonly exports: Exports) {}
+
+  /**
+   * Instantiate the module from its bytes or, where compiling at runtime is
+   * not allowed (Cloudflare Workers), from an imported WebAssembly.Module.
+   */
+  static async instantiate(source: BufferSource | WebAssembly.Module): Promise<PexWasm> {
+    const module = source instanceof WebAssembly.Module ? source : await WebAssembly.compile(source);
+    const instance = await WebAssembly.instantiate(module, stubImports(module));
+    const exports = instance.exports as unknown as Exports;
+    exports._initialize?.();
+    return new PexWasm(exports);
+  }
+
+  /**
+   * Serialized AST of `source`, in the layout of frontend/ast.h.
+   * @throws ParseError on syntax errors; columns count UTF-8 bytes
+   */
+  parseAST(source: string, shellMode: boolean = false): Uint8Array {
+    const status = this.call(encoder.encode(source), (pointer, length) =>
+      this.exports.pex_parse_ast(pointer, length, shellMode ? 1 : 0)
+    );
+    if (status !== Status.Completed) {
+      const error = this.outputJSON() as { message: string; line: number; column: number };
+      throw new ParseError(error.message, error.line, error.column);
+    }
+    return this.output().slice();
+  }
+
+  /**
+   * Parse PEX source; produces the same Program as parse() from @pex/core.
+   * @throws ParseError on syntax errors; columns count UTF-8 bytes
+   */
+  parse(source: string, options: ParseOptions = {}): Program {
+    return decodeAst(this.parseAST(source, options.shellMode ?? false));
+  }
+
+  /**
+   * Load a program from the output of writeBytecode(). Builtin calls are
+   * resolved here, so a program that calls an unknown builtin is rejected.
+   * @throws WasmEngineError for malformed bytecode or unknown builtins
+   */
+  load(bytecode: Uint8Array): WasmProgram {
+    const engine = this.call(bytecode, (pointer, length) => this.exports.pex_engine_new(pointer, length));
+    if (engine === 0) {
+      throw this.outputError();
+    }
+    return new WasmProgram(this, engine);
+  }
+
+  /** @internal */
+  step(engine: number, value: unknown, resume: boolean): { status: number; json: unknown } {
+    const text = JSON.stringify(value === undefined ? null : value);
+    const status = this.call(encoder.encode(text), (pointer, length) =>
+      resume
+        ? this.exports.pex_engine_resume(engine, pointer, length)
+        : this.exports.pex_engine_run(engine, pointer, length)
+    );
+    if (status === Status.Error) {
+      throw this.outputError();
+    }
+    return { status, json: this.outputJSON() };
+  }
+
+  /** @internal */
+  release(engine: number): void {
+    this.exports.pex_engine_delete(engine);
+  }
+
+  /**
+   * Copy `bytes` into linear memory for the duration of `fn`.
+   */
+  private call(bytes: Uint8Array, fn: (pointer: number, length: number) => number): number {
+    const pointer = this.exports.pex_alloc(bytes.length);
+    try {
+      // Read memory.buffer on every access: it is replaced when memory grows
+      new Uint8Array(this.exports.memory.buffer, pointer, bytes.length).set(bytes);
+      return fn(pointer, bytes.length);
+    } finally {
+      this.exports.pex_free(pointer);
+    }
+  }
+
+  /** The output buffer, valid until the next call into the module. */
+  private output(): Uint8Array {
+    return new Uint8Array(this.exports.memory.buffer, this.exports.pex_output(), this.exports.pex_output_length());
+  }
+
+  private outputJSON(): unknown {
+    return JSON.parse(decoder.decode(this.output()));
+  }
+
+  private outputError(): Error {
+    const { name, message, ip, offset } = this.outputJSON() as {
+      name: string;
+      message: string;
+      ip?: number;
+      offset?: number;
+    };
+    return name === 'Error' ? new Error(message) : new WasmEngineError(name, message, ip, offset);
+  }
+}
+
+/**
+ * A program loaded into a PexWasm instance. Each run() reuses the loaded
+ * program; call dispose() to free it.
+ */
+export class WasmProgram {
+  /** @internal */
+  constructor(
+    private readonly wasm: PexWasm,
+    private engine: number,
+  ) {}
+
+  /**
+   * Run the program with `input` as `$$` and return its result. Objects in
+   * the result have their keys in JSON.parse() order.
+   * @throws WasmEngineError on runtime errors
+   */
+  run(input: unknown, effectHandler: WasmEffectHandler = throwingWasmEffectHandler): unknown {
+    if (this.engine === 0) {
+      throw new Error('WasmProgram has been disposed.');
+    }
+    let { status, json } = this.wasm.step(this.engine, input, false);
+    while (status === Status.Suspended) {
+      const effect = json as { name: string; args: unknown[] };
+      const value = effectHandler(effect.name, effect.args);
+      if (value === undefined) {
+        return null;
+      }
+      ({ status, json } = this.wasm.step(this.engine, value, true));
+    }
+    return json;
+  }
+
+  dispose(): void {
+    if (this.engine !== 0) {
+      this.wasm.release(this.engine);
+      this.engine = 0;
+    }
+  }
+}
+
+/**
+ * Imports for a standalone module: every WASI or libc call it links
+ * against fails with ENOSYS, since the engine does no I/O of its own.
+ */
+function stubImports(module: WebAssembly.Module): WebAssembly.Imports {
+  const imports: Record<string, Record<string, WebAssembly.ImportValue>> = {};
+  for (const { module: namespace, name, kind } of WebAssembly.Module.imports(module)) {
+    if (kind !== 'function') {
+      throw new Error(`pex.wasm imports unsupported ${kind} ${namespace}.${name}`);
+    }
+    imports[namespace] ??= {};
+    imports[namespace][name] =
+      name === 'proc_exit'
+        ? (code: number) => {
+            throw new Error(`pex.wasm exited with code ${code}`);
+          }
+        : () => ENOSYS;
+  }
+  return imports;
+}
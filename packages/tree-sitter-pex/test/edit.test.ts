@@ -0,0 +1,41 @@
+/**
+ * Tests for building incremental-parse edits from editor changes
+ */
+
+import { describe, test, expect } from 'bun:test';
+import { createEdit } from '../src/edit.ts';
+
+describe('createEdit', () => {
+  test('insertion on one line', () => {
+    expect(createEdit('$$ | trim', 4, 4, 'lower | ')).toEqual({
+      startIndex: 4,
+      oldEndIndex: 4,
+      newEndIndex: 12,
+      startPosition: { row: 0, column: 4 },
+      oldEndPosition: { row: 0, column: 4 },
+      newEndPosition: { row: 0, column: 12 },
+    });
+  });
+
+  test('replacement spanning lines', () => {
+    const source = '(let: x 1);\n(let: y 2);\n(+ x y)';
+    // Replace "2);\n(+" with "3);\n\n(*"
+    const start = source.indexOf('2');
+    const end = source.indexOf('+') + 1;
+    expect(createEdit(source, start, end, '3);\n\n(*')).toEqual({
+      startIndex: start,
+      oldEndIndex: end,
+      newEndIndex: start + 7,
+      startPosition: { row: 1, column: 8 },
+      oldEndPosition: { row: 2, column: 2 },
+      newEndPosition: { row: 3, column: 2 },
+    });
+  });
+
+  test('deletion', () => {
+    const edit = createEdit('a\nbc', 1, 3, '');
+    expect(edit.newEndIndex).toBe(1);
+    expect(edit.oldEndPosition).toEqual({ row: 1, column: 1 });
+    expect(edit.newEndPosition).toEqual({ row: 0, column: 1 });
+  });
+});
@@ -0,0 +1,363 @@
+/**
+ * Differential tests for the native PEX engine
+ *
+ * Every program is run on both the TypeScript VM from @pex/core and the
+ * native engine; results and error messages must match.
+ *
+ * These tests require the native module to be built first
+ * (`node-gyp rebuild`) and are skipped otherwise.
+ */
+
+import { describe, test, expect } from 'bun:test';
+import {
+  compilePEX,
+  VM,
+  booleanValue,
+  nullValue,
+  numberValue,
+  stringValue,
+  throwingEffectHandler,
+  valueFromJSON,
+} from '@pex/core';
+import type { EffectHandler, Value } from '@pex/core';
+import { isNativeEngineAvailable, NativeVM } from '../src/engine.ts';
+import type { Column, NativeEffectHandler, OutputColumn } from '../src/engine.ts';
+
+type Outcome = { value: Value } | { error: string };
+
+function attempt(fn: () => Value): Outcome {
+  try {
+    return { value: fn() };
+  } catch (error) {
+    return { error: (error as Error).message };
+  }
+}
+
+function runTS(source: string, input: Value, handler: EffectHandler = throwingEffectHandler): Outcome {
+  return attempt(() => new VM(compilePEX(source), handler).run(input));
+}
+
+function runNative(source: string, input: Value, handler?: NativeEffectHandler): Outcome {
+  return attempt(() => new NativeVM(compilePEX(source), handler).run(input));
+}
+
+function expectSame(source: string, input: Value = nullValue()): void {
+  expect(runNative(source, input)).toEqual(runTS(source, input));
+}
+
+function bitmap(length: number, isSet: (row: number) => boolean): Uint8Array {
+  const bits = new Uint8Array(Math.ceil(length / 8));
+  for (let row = 0; row < length; row++) {
+    if (isSet(row)) bits[row >> 3]! |= 1 << (row & 7);
+  }
+  return bits;
+}
+
+function stringColumn(rows: (string | null)[]): Column {
+  const encoder = new TextEncoder();
+  const parts = rows.map((row) => encoder.encode(row ?? ''));
+  const offsets = new Int32Array(rows.length + 1);
+  parts.forEach((part, i) => (offsets[i + 1] = offsets[i]! + part.length));
+  const data = new Uint8Array(offsets[rows.length]!);
+  parts.forEach((part, i) => data.set(part, offsets[i]));
+  return { type: 'string', offsets, data, validity: bitmap(rows.length, (row) => rows[row] !== null) };
+}
+
+/** The rows of an output column as Values. */
+function columnValues(column: OutputColumn): Value[] {
+  const decoder = new TextDecoder();
+  return Array.from({ length: column.length }, (_, row) => {
+    if (column.type === 'null' || (column.validity && !((column.validity[row >> 3]! >> (row & 7)) & 1))) {
+      return nullValue();
+    }
+    switch (column.type) {
+      case 'boolean':
+        return booleanValue(((column.values[row >> 3]! >> (row & 7)) & 1) === 1);
+      case 'number':
+        return numberValue(column.values[row]!);
+      case 'string':
+        return stringValue(decoder.decode(column.data.subarray(column.offsets[row], column.offsets[row + 1])));
+    }
+  });
+}
+
+function columnError(fn: () => unknown): { name: string; message: string; row?: number } {
+  try {
+    fn();
+  } catch (error) {
+    const { name, message, row } = error as Error & { row?: number };
+    return { name, message, row };
+  }
+  throw new Error('Expected the call to fail');
+}
+
+describe.skipIf(!isNativeEngineAvailable())('NativeVM', () => {
+  test('literals and arithmetic', () => {
+    for (const source of ['null', 'true', '42', '3.14', '(+ 10 20)', '(/ 1 3)', '(% -7 2)', '(* 1e21 10)', '(/ 1 1e7)']) {
+      expectSame(source);
+    }
+  });
+
+  test('comparison, logic and conditionals', () => {
+    for (const source of ['(== 5 5)', '(< 5 10)', '(and 1 "x")', '(or 0 "")', '(if null 1 2)', '(?? null 42)']) {
+      expectSame(source);
+    }
+  });
+
+  test('pipelines over input', () => {
+    expectSame('$$ | lower | trim', stringValue('  HELLO  '));
+    expectSame('$$ | split " " | (len $)', stringValue('hello world test'));
+    expectSame('$$ | (* $ 2) | (+ $ $$)', numberValue(5));
+  });
+
+  test('string builtins', () => {
+    for (const source of [
+      '(split "a,b,c,d" "," 2)',
+      '(join "a" 1 true null)',
+      '(upper "straße ñ")',
+      '(substring "héllo😀x" 1 4)',
+      '(replace "john smith" /(\\w+)\\s(\\w+)/ "$2, $1")',
+      '(match "abc123def456" /\\d+/g)',
+      '(test "abc" /B/i)',
+      '(int "0x1F")',
+      '(string (/ 2 3))',
+    ]) {
+      expectSame(source);
+    }
+  });
+
+  test('regex kernels', () => {
+    const input = stringValue('Call  (555) 123-4567\u00a0 ext. 89, héllo');
+    for (const pattern of ['/\\D/g', '/\\s+/g', '/[^\\s,]+/', '/[a-c\\d]+/g', '/ext\\./g', '/\\W/']) {
+      expectSame(`(replace $$ ${pattern} "<$&>")`, input);
+      expectSame(`(replace $$ ${pattern} "")`, input);
+      expectSame(`(match $$ ${pattern})`, input);
+      expectSame(`(test $$ ${pattern})`, input);
+    }
+    // A global regex keeps no position between calls
+    expectSame('let: r /a/g; (and (test "a" r) (test "a" r))');
+  });
+
+  test('long inputs to std::regex fail instead of overflowing the stack', () => {
+    const long = stringValue('ab'.repeat(50_000));
+    for (const source of ['(test $$ /(a|b)*c/)', '(match $$ /((a|b))*/)', '(replace $$ /(a|b)*/g "x")']) {
+      expect((runNative(source, long) as { error: string }).error).toContain('Input too long for');
+    }
+    // Below the limit, and with kernels at any length, results still match
+    expectSame('(match $$ /(a|b)*/)', stringValue('ab'.repeat(500)));
+    expectSame('(len (replace $$ /a/g ""))', long);
+  });
+
+  test('string slices', () => {
+    const input = stringValue('  Héllo,wörld,ABC,x  ');
+    expectSame('$$ | trim | lower | split "," | first', input);
+    expectSame('(split (substring (trim $$) 2) "l")', input);
+    expectSame('(upper (get (split (trim $$) ",") 2))', input);
+    expectSame('(match (substring $$ 3) /[a-z]+/g)', input);
+    expectSame('(== (substring (trim $$) 0 2) (substring "xHéy" 1 3))', input);
+    expectSame('(len (substring (substring $$ 4 12) 1 5))', input);
+  });
+
+  test('functions, recursion and closures', () => {
+    expectSame('fn: double (x) (* x 2); (double 5)');
+    expectSame('fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 15)');
+    expectSame('fn: make_counter (start) (fn: count (n) (+ start n)) count; let: counter (make_counter 100); (counter 42)');
+    expectSame('fn: f (x) (fn: g (y) (fn: h (z) (+ x (+ y z))) h) g; (((f 1) 2) 3)');
+    expectSame('fn: count (n acc) (if (<= n 0) acc (count (- n 1) (+ acc 1))); (count 100000 0)');
+    expectSame('fn: apply (g) (g); fn: wrap (x) (fn: get () (* x 2)) (apply get); (wrap 21)');
+  });
+
+  test('returned closures carry their template', () => {
+    const bytecode = compilePEX('fn: f (x) x; f');
+    const result = new NativeVM(bytecode).run(nullValue());
+    const expected = new VM(bytecode, throwingEffectHandler).run(nullValue());
+    expect(result.type).toBe('closure');
+    if (result.type === 'closure' && expected.type === 'closure') {
+      expect(result.name).toBe(expected.name);
+      expect(result.template).toBe(expected.template);
+    }
+  });
+
+  test('runtime errors match', () => {
+    for (const source of [
+      '(/ 10 0)',
+      'fn: add (a b) (+ a b); (add 1)',
+      'let: x 10; (x)',
+      '(unknownfn 1)',
+      '(len 5)',
+      'fn: sum (n) (if (<= n 0) 0 (+ n (sum (- n 1)))); (sum 2000)',
+    ]) {
+      expectSame(source);
+    }
+  });
+
+  test('unknown builtins are rejected at load time', () => {
+    // The call is never reached, but is still resolved when the VM is created
+    const bytecode = compilePEX('(if false (upper "a") 1)');
+    bytecode.nameTable.names = bytecode.nameTable.names.map((name) => (name === 'upper' ? 'nope' : name));
+    expect(() => new VM(bytecode, throwingEffectHandler)).toThrow('Unknown builtin function: nope');
+    expect(() => new NativeVM(bytecode)).toThrow('Unknown builtin function: nope');
+  });
+
+  test('effects resume with the handler value', () => {
+    const source = 'fn: f (x) (+ x (ask: x)); (f 3)';
+    const native = runNative(source, nullValue(), (name, args, continuation) => {
+      expect(name).toBe('ask');
+      expect(args).toEqual([numberValue(3)]);
+      continuation.resume(numberValue(7));
+    });
+    const ts = runTS(source, nullValue(), (_name, _args, continuation) => continuation.resume(numberValue(7)));
+    expect(native).toEqual(ts);
+    expect(native).toEqual({ value: numberValue(10) });
+  });
+
+  test('unresumed effects abort with null', () => {
+    const native = new NativeVM(compilePEX('let: x (ask: 1); (+ x 1)'), () => {});
+    expect(native.run(nullValue())).toEqual(nullValue());
+  });
+
+  test('unhandled effects throw', () => {
+    expectSame('print: "hello"; 42');
+  });
+
+  test('continuations are one-shot', () => {
+    const native = new NativeVM(compilePEX('(ask: 1)'), (_name, _args, continuation) => {
+      continuation.resume(numberValue(1));
+      expect(() => continuation.resume(numberValue(2))).toThrow('already been resumed');
+    });
+    expect(native.run(nullValue())).toEqual(numberValue(1));
+  });
+
+  test('a NativeVM can be run repeatedly', () => {
+    const native = new NativeVM(compilePEX('$$ | upper'));
+    expect(native.run(stringValue('a'))).toEqual(stringValue('A'));
+    expect(native.run(stringValue('b'))).toEqual(stringValue('B'));
+  });
+
+  test('peephole-optimized bytecode matches the TypeScript VM', () => {
+    const cases: Array<[string, Value]> = [
+      ['$$ | lower | trim | (replace $ /o/g "0")', stringValue('  HELLO World ')],
+      ['fn: fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))); (fib 15)', nullValue()],
+      ['(if (not (== $$ 1)) (if (>= $$ 3) "big" "two") "one")', numberValue(3)],
+      ['(and 1 "x")', nullValue()],
+      ['(< "a" $$)', stringValue('b')],
+      ['$$ | (len $)', numberValue(5)],
+    ];
+    for (const [source, input] of cases) {
+      const bytecode = compilePEX(source, { optimize: true });
+      const expected = attempt(() => new VM(bytecode, throwingEffectHandler).run(input));
+      const actual = attempt(() => new NativeVM(bytecode).run(input));
+      expect(actual).toEqual(expected);
+      expect(expected).toEqual(runTS(source, input));
+    }
+  });
+
+  test('object properties match the TypeScript VM', () => {
+    const input = valueFromJSON({ id: 7, name: 'Ada', tags: ['x'], 1: 'one' });
+    for (const source of ['(get $$ "name")', '(get $$ 1)', '(get $$ "email")', '(get $$ "email" "-")', '$$', '(get $$ "tags")']) {
+      expectSame(source, input);
+    }
+    expectSame('(get $$ "id")', stringValue('id'));
+
+    const records = [{ id: 1, name: 'a' }, { name: 'b', id: 2 }, { id: 3 }].map(valueFromJSON);
+    expect(new NativeVM(compilePEX('$$')).runBatch(records)).toEqual(records);
+  });
+
+  test('runBatch matches the TypeScript VM', () => {
+    const bytecode = compilePEX('$$ | lower | trim | (replace $ /o/g "0")');
+    const inputs = ['  HELLO ', 'World', ' foo '].map(stringValue);
+    const expected = new VM(bytecode, throwingEffectHandler).runBatch(inputs);
+    expect(new NativeVM(bytecode).runBatch(inputs)).toEqual(expected);
+  });
+
+  test('runBatch completes inputs that perform effects', () => {
+    const bytecode = compilePEX('(if (> $$ 1) (+ (ask: $$) 1) $$)');
+    const inputs = [1, 2, 1, 3].map(numberValue);
+    const native = new NativeVM(bytecode, (_name, args, continuation) => {
+      continuation.resume(numberValue((args[0] as { value: number }).value * 10));
+    });
+    expect(native.runBatch(inputs)).toEqual([1, 21, 1, 31].map(numberValue));
+  });
+
+  test('runBatch reports errors', () => {
+    const native = new NativeVM(compilePEX('(/ 1 $$)'));
+    expect(() => native.runBatch([numberValue(1), numberValue(0)])).toThrow('Division by zero');
+  });
+
+  test('runColumns matches runBatch on the same rows', () => {
+    const strings = ['  HELLO ', null, 'straße ñ', '', '😀 x', 'World'];
+    const numbers = [1, 2.5, -3, NaN, 0, 1e21];
+    const cases: Array<[string, Column, Value[]]> = [
+      [
+        '$$ | lower | trim | (replace $ /o/g "0")',
+        stringColumn(strings),
+        strings.map((s) => (s === null ? nullValue() : stringValue(s))),
+      ],
+      ['(len (?? $$ ""))', stringColumn(strings), strings.map((s) => (s === null ? nullValue() : stringValue(s)))],
+      ['(> $$ 0)', { type: 'number', values: Float64Array.from(numbers) }, numbers.map(numberValue)],
+      [
+        '(if (> $$ 0) (string $$) null)',
+        { type: 'number', values: Float64Array.from(numbers), validity: bitmap(6, (row) => row !== 1) },
+        numbers.map((n, row) => (row === 1 ? nullValue() : numberValue(n))),
+      ],
+      [
+        '(if $$ 1 0)',
+        { type: 'boolean', length: 3, values: bitmap(3, (row) => row !== 1) },
+        [true, false, true].map(booleanValue),
+      ],
+      ['$$', { type: 'null', length: 2 }, [nullValue(), nullValue()]],
+    ];
+    for (const [source, input, rows] of cases) {
+      const bytecode = compilePEX(source);
+      const expected = new NativeVM(bytecode).runBatch(rows);
+      expect(columnValues(new NativeVM(bytecode).runColumns(input))).toEqual(expected);
+      expect(expected).toEqual(new VM(bytecode, throwingEffectHandler).runBatch(rows));
+    }
+  });
+
+  test('runColumns reads struct rows as objects', () => {
+    const input: Column = {
+      type: 'struct',
+      fields: { id: { type: 'number', values: Float64Array.of(1, 2) }, name: stringColumn(['a', null]) },
+    };
+    const output = new NativeVM(compilePEX('(string $$)')).runColumns(input);
+    expect(columnValues(output)).toEqual([stringValue('{id: 1, name: a}'), stringValue('{id: 2, name: null}')]);
+    const names = new NativeVM(compilePEX('(get $$ "name" "?")')).runColumns(input);
+    expect(columnValues(names)).toEqual([stringValue('a'), nullValue()]);
+  });
+
+  test('runColumns omits validity when no result is null', () => {
+    const output = new NativeVM(compilePEX('(* $$ 2)')).runColumns({ type: 'number', values: Float64Array.of(1, 2) });
+    expect(output).toEqual({ type: 'number', length: 2, values: Float64Array.of(2, 4) });
+  });
+
+  test('runColumns reports errors', () => {
+    const numbers: Column = { type: 'number', values: Float64Array.of(1, 0, 2) };
+    expect(columnError(() => new NativeVM(compilePEX('(/ 1 $$)')).runColumns(numbers))).toEqual({
+      name: 'VMError',
+      message: 'Division by zero',
+      row: undefined,
+    });
+    expect(columnError(() => new NativeVM(compilePEX('(if (> $$ 0) 1 "x")')).runColumns(numbers))).toEqual({
+      name: 'ColumnError',
+      message: 'Row 1 returned a string in a number column',
+      row: 1,
+    });
+    expect(columnError(() => new NativeVM(compilePEX('(split (string $$) ",")')).runColumns(numbers)).message).toBe(
+      'Row 0 returned a value of type array, which a column cannot hold'
+    );
+    expect(columnError(() => new NativeVM(compilePEX('(ask: $$)')).runColumns(numbers)).message).toBe(
+      'Row 0 performed effect "ask", but columnar runs cannot suspend'
+    );
+
+    const bytecode = compilePEX('$$');
+    const strings: Column = { type: 'string', offsets: Int32Array.of(0, 4, 2), data: new Uint8Array(4) };
+    expect(columnError(() => new NativeVM(bytecode).runColumns(strings)).name).toBe('ColumnError');
+    expect(columnError(() => new NativeVM(bytecode).runColumns({ ...numbers, length: 4 })).message).toBe(
+      'Values of a number column of 4 rows needs 4 entries, got 3'
+    );
+    expect(() => new NativeVM(bytecode).runColumns({ type: 'number', values: new Uint8Array(2) } as never)).toThrow(
+      'Column values must be a Float64Array'
+    );
+  });
+});
@@ -0,0 +1,68 @@
+/**
+ * Differential tests for the native front end
+ *
+ * Every program is parsed by both parse() from @pex/core and the native
+ * tree-sitter front end; the ASTs must match.
+ *
+ * These tests require the native module to be built first
+ * (`node-gyp rebuild`) and are skipped otherwise, unless PEX_REQUIRE_NATIVE
+ * is set, as in CI, where a missing module fails them.
+ */
+
+import { describe, test, expect } from 'bun:test';
+import { parse, ParseError } from '@pex/core/parser';
+import { decodeAst, isNativeFrontendAvailable, parseNative } from '../src/frontend.ts';
+
+const PROGRAMS = [
+  '$$ | lower | trim | upper',
+  '(+ 1 2)',
+  '(let: x 42); (print: x)',
+  'fn: f (x) (if (< x 3) (+ x 3) (* x 2)); (f 1)',
+  '"a\\nb\\t\\"q\\\\"',
+  "'it\\'s'",
+  '(replace $ /A(\\w)\\/b/gi "$1")',
+  '-3.25; true; false; null',
+  '$ $0 $12',
+  '()',
+  '(a | b c | (d))',
+  ';; comment\n(+ 1 2) ;; trailing\n',
+  '',
+  '"é😀"',
+];
+
+const required = process.env.PEX_REQUIRE_NATIVE !== undefined;
+
+describe.skipIf(!required && !isNativeFrontendAvailable())('parseNative', () => {
+  for (const shellMode of [false, true]) {
+    for (const source of PROGRAMS) {
+      test(`${JSON.stringify(source)}${shellMode ? ' (shell mode)' : ''}`, () => {
+        expect(parseNative(source, { shellMode })).toEqual(parse(source, { shellMode }));
+      });
+    }
+  }
+
+  test('reports the first syntax error', () => {
+    expect(() => parseNative('(+ 1\n  (* 2 3)')).toThrow(ParseError);
+    expect(() => parseNative('(+ 1\n  (* 2 3)')).toThrow("line 2, column 10: Expected ')'");
+  });
+});
+
+describe('decodeAst', () => {
+  test('decodes every node kind', () => {
+    // (f "a" 1.5) | /x/g, then a pipeline of true, null and e:
+    const bytes = Uint8Array.from([
+      2, 0, 0, 0,
+      1, 2, 0, 0, 0,
+      0, 3, 0, 0, 0,
+      7, 1, 0, 0, 0, 0x66,
+      3, 1, 0, 0, 0, 0x61, 3, 0, 0, 0, 0x22, 0x61, 0x22,
+      2, 0, 0, 0, 0, 0, 0, 0xf8, 0x3f, 3, 0, 0, 0, 0x31, 0x2e, 0x35,
+      4, 1, 0, 0, 0, 0x78, 1, 0, 0, 0, 0x67, 4, 0, 0, 0, 0x2f, 0x78, 0x2f, 0x67,
+      1, 3, 0, 0, 0,
+      5, 1,
+      6,
+      8, 1, 0, 0, 0, 0x65,
+    ]);
+    expect(decodeAst(bytes)).toEqual(parse('(f "a" 1.5) | /x/g; true | null | e:'));
+  });
+});
@@ -4,10 +4,16 @@
  * Note: These tests require the native module to be built first.
  * Run `npm install` or `node-gyp rebuild` to build the native parser.
  *
- * For now, these tests are skipped until native compilation is set up.
+ * The incremental parsing tests below run whenever the parser loads; the
+ * older tests are still commented out until native compilation is set up.
  */
 
 import { describe, test, expect } from 'bun:test';
+import { createEdit } from '../src/edit.ts';
+
+// src/parser.ts needs the tree-sitter runtime and the compiled grammar
+const parserModule = await import('../src/parser.ts').catch(() => undefined);
+const available = parserModule !== undefined;
 
 // Skip these tests for now - they require native module compilation
 describe.skip('PEX Parser', () => {
@@ -16,10 +22,47 @@ describe.skip('PEX Parser', () => {
   });
 });
 
+describe.skipIf(!available)('PEX Parser incremental parsing', () => {
+  test('missing nodes are errors', () => {
+    const result = parserModule!.parse('(+ 1 2');
+    expect(result.success).toBe(false);
+  });
+
+  test('reparse after an edit', () => {
+    const parser = new parserModule!.PEXParser();
+    const before = '$$ | trim';
+    parser.parse(before);
+
+    const after = '$$ | lower | trim';
+    parser.edit(createEdit(before, 4, 4, 'lower | '));
+    const result = parser.reparse(after);
+
+    expect(result.success).toBe(true);
+    expect(parser.getNodeText(result.rootNode, after)).toBe(after);
+    expect(result.changedRanges!.length).toBeGreaterThan(0);
+  });
+
+  test('edit before parse throws', () => {
+    const parser = new parserModule!.PEXParser();
+    expect(() => parser.edit(createEdit('', 0, 0, 'x'))).toThrow('call parse()');
+  });
+
+  test('reset makes the next reparse a full parse', () => {
+    const parser = new parserModule!.PEXParser();
+    parser.parse('$$ | trim');
+    parser.reset();
+
+    const result = parser.reparse('$$ | lower');
+    expect(result.success).toBe(true);
+    expect(result.changedRanges ?? []).toHaveLength(0);
+    expect(() => parser.edit(createEdit('', 0, 0, 'x'))).toThrow('call parse()');
+  });
+});
+
 /*
 // Uncomment after setting up native module compilation
 describe('PEX Parser (requires native build)', () => {
-  const { parse, PEXParser } = require('../src/index.ts');
+  const { parse, PEXParser, createEdit } = require('../src/index.ts');
   test('parse simple pipeline', () => {
     const result = parse('$$ | lower | trim');
     expect(result.success).toBe(true);
@@ -54,6 +97,8 @@ describe('PEX Parser (requires native build)', () => {
 
     const text = parser.getNodeText(result.rootNode, source);
     expect(text).toBe(source);
+    expect(parser.nodeTextEquals(result.rootNode, source, source)).toBe(true);
+    expect(parser.nodeTextEquals(result.rootNode, source, '"hello"')).toBe(false);
   });
 
   test('parse multiple expressions with semicolons', () => {
@@ -88,5 +133,6 @@ describe('PEX Parser (requires native build)', () => {
     const result = parse('(+ (* 2 3) 4)');
     expect(result.success).toBe(true);
   });
+
 });
 */
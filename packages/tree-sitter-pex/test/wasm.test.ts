@@ -0,0 +1,94 @@
+/**
+ * Differential tests for the WebAssembly build
+ *
+ * Programs are parsed and run both by @pex/core and by pex.wasm through
+ * src/wasm.ts; ASTs, results and error messages must match.
+ *
+ * These tests require the module to be built first (`make wasm`) and are
+ * skipped otherwise, unless PEX_REQUIRE_WASM is set, as in CI, where a
+ * missing module fails them.
+ */
+
+import { describe, test, expect } from 'bun:test';
+import { existsSync, readFileSync } from 'node:fs';
+import { compilePEX, VM, valueFromJSON, valueToJSON, writeBytecode } from '@pex/core';
+import type { EffectHandler } from '@pex/core';
+import { parse, ParseError } from '@pex/core/parser';
+import { PexWasm, WasmEngineError } from '../src/wasm.ts';
+import type { WasmEffectHandler } from '../src/wasm.ts';
+
+const WASM_PATH = new URL('../build/wasm/pex.wasm', import.meta.url);
+const required = process.env.PEX_REQUIRE_WASM !== undefined;
+const wasm =
+  required || existsSync(WASM_PATH) ? await PexWasm.instantiate(readFileSync(WASM_PATH)) : undefined;
+
+type Outcome = { value: unknown } | { error: string };
+
+function attempt(fn: () => unknown): Outcome {
+  try {
+    return { value: fn() };
+  } catch (error) {
+    return { error: (error as Error).message };
+  }
+}
+
+function runTS(source: string, input: unknown, handler?: EffectHandler): Outcome {
+  return attempt(() => valueToJSON(new VM(compilePEX(source), handler).run(valueFromJSON(input))));
+}
+
+function runWasm(source: string, input: unknown, handler?: WasmEffectHandler): Outcome {
+  return attempt(() => wasm!.load(writeBytecode(compilePEX(source))).run(input, handler));
+}
+
+function expectSame(source: string, input: unknown = null): void {
+  expect(runWasm(source, input)).toEqual(runTS(source, input));
+}
+
+describe.skipIf(wasm === undefined)('PexWasm', () => {
+  test('parses like @pex/core', () => {
+    for (const source of ['$$ | lower | trim', '(+ 1 2)', 'fn: f (x) (* x 2); (f 3)', '"é😀"', '']) {
+      expect(wasm!.parse(source)).toEqual(parse(source));
+    }
+    expect(wasm!.parse('lower | trim', { shellMode: true })).toEqual(parse('lower | trim', { shellMode: true }));
+  });
+
+  test('raises ParseError with a position', () => {
+    expect(() => wasm!.parse('(+ 1 2')).toThrow(ParseError);
+  });
+
+  test('runs programs like the TypeScript VM', () => {
+    expectSame('(+ 1 2)');
+    expectSame('$$ | split "," | (get $ 1)', 'a,b,c');
+    expectSame('(get $$ "name")', { name: 'pex', tags: [1, 2] });
+    expectSame('$$', { b: [1, 'x', null, true], a: { nested: 'é😀' } });
+  });
+
+  test('reports runtime errors as VMError', () => {
+    expectSame('(get "x" 1)');
+    const program = wasm!.load(writeBytecode(compilePEX('(get "x" 1)')));
+    try {
+      program.run(null);
+      throw new Error('expected a VMError');
+    } catch (error) {
+      expect(error).toBeInstanceOf(WasmEngineError);
+      expect((error as WasmEngineError).name).toBe('VMError');
+    }
+  });
+
+  test('rejects malformed bytecode', () => {
+    expect(() => wasm!.load(new Uint8Array([1, 2, 3, 4]))).toThrow(WasmEngineError);
+  });
+
+  test('resumes effects with the handler result', () => {
+    const seen: unknown[] = [];
+    const program = wasm!.load(writeBytecode(compilePEX('(+ (ask: 1 "x") 1)')));
+    const result = program.run(null, (name, args) => {
+      seen.push([name, args]);
+      return 41;
+    });
+    expect(result).toBe(42);
+    expect(seen).toEqual([['ask', [1, 'x']]]);
+    expect(program.run(null, () => undefined)).toBeNull();
+    program.dispose();
+  });
+});